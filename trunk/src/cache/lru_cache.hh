@@ -33,6 +33,18 @@ public:
 	}
 	;
 
+	bool tryGet(const keyType &key, valueType &value) {
+		std::lock_guard<std::mutex> lk(_cacheMutex);
+		typename valueMapType::iterator it = _valueMap.find(key);
+		if (it == _valueMap.end())
+			return false;
+		_accessTimeList.splice(_accessTimeList.end(), _accessTimeList,
+				((*it).second.second));
+		value = (*it).second.first;
+		return true;
+	}
+	;
+
 	typename valueMapType::iterator find(const keyType &key) {
 		std::lock_guard<std::mutex> lk(_cacheMutex);
 		return _valueMap.find(key);
@@ -73,8 +85,10 @@ public:
 	void remove(const keyType &key) {
 		std::lock_guard<std::mutex> lk(_cacheMutex);
 		typename valueMapType::iterator it = _valueMap.find(key);
+		if (it == _valueMap.end())
+			return;
+        _accessTimeList.erase((*it).second.second);
         _valueMap.erase(it);
-        _accessTimeList.remove(key);
 	}
 
 	void pop_back() {
@@ -23,12 +23,14 @@ extern ConfigLayer* configLayer;
 Client::Client(uint32_t clientId) {
 	_clientCommunicator = new ClientCommunicator();
 	_storageModule = new ClientStorageModule();
+	_codingModule = new CodingModule();
 
 	_clientId = clientId;
 
 	_numClientThreads = configLayer->getConfigInt(
 			"Communication>NumClientThreads");
-	_tp.size_controller().resize(_numClientThreads);
+	_isClientEncoding = (configLayer->getConfigInt(
+			"Communication>ClientEncoding") == 1);
 }
 
 /**
@@ -52,6 +54,14 @@ void startUploadThread(uint32_t clientId, uint32_t sockfd,
 	MemoryPool::getInstance().poolFree(segmentData.buf);
 }
 
+void startEncodedUploadThread(uint32_t primary,
+		struct SegmentData segmentData, CodingScheme codingScheme,
+		string codingSetting) {
+	client->putEncodedSegment(primary, segmentData, codingScheme,
+			codingSetting);
+	MemoryPool::getInstance().poolFree(segmentData.buf);
+}
+
 void startDownloadThread(uint32_t clientId, uint32_t sockfd, uint64_t segmentId,
 		uint64_t offset, FILE* filePtr, string dstPath) {
 	client->getSegment(clientId, sockfd, segmentId, offset, filePtr, dstPath);
@@ -63,9 +73,7 @@ struct SegmentData Client::getSegment(uint32_t clientId,
 	struct SegmentData segmentCache = { };
 
 	// If currently modifying cache, wait!
-	while (_pendingSegmentChunk.count(segmentId)) {
-		usleep(USLEEP_DURATION);
-	}
+	_pendingSegmentChunk.waitErase(segmentId);
 
 	// get segment from cache directly if possible
 	if (_storageModule->locateSegmentCache(segmentId)) {
@@ -80,9 +88,7 @@ struct SegmentData Client::getSegment(uint32_t clientId,
     }
 
 	// wait until the segment is fully downloaded
-	while (_pendingSegmentChunk.count(segmentId)) {
-		usleep(USLEEP_DURATION);
-	}
+	_pendingSegmentChunk.waitErase(segmentId);
 
 	// write segment from cache to file
 	segmentCache = _storageModule->getSegmentCache(segmentId);
@@ -130,6 +136,9 @@ uint32_t Client::uploadFileRequest(string path, CodingScheme codingScheme,
 				fileMetaData._segmentList[i], fileMetaData._primaryList[i]);
 	}
 
+	// at most _numClientThreads segments in flight
+	TaskGroup uploadTasks(FOREGROUND_TASK, _numClientThreads);
+
 	for (uint32_t i = 0; i < segmentCount; ++i) {
 		struct SegmentData segmentData = _storageModule->readSegmentFromFile(path,
 				i);
@@ -138,13 +147,19 @@ uint32_t Client::uploadFileRequest(string path, CodingScheme codingScheme,
 		uint32_t dstOsdSockfd = _clientCommunicator->getSockfdFromId(primary);
 		segmentData.info.segmentId = fileMetaData._segmentList[i];
 
-		_tp.schedule(
-				boost::bind(startUploadThread, _clientId, dstOsdSockfd,
-						segmentData, codingScheme, codingSetting));
+		if (_isClientEncoding) {
+			uploadTasks.run(
+					boost::bind(startEncodedUploadThread, primary, segmentData,
+							codingScheme, codingSetting));
+		} else {
+			uploadTasks.run(
+					boost::bind(startUploadThread, _clientId, dstOsdSockfd,
+							segmentData, codingScheme, codingSetting));
+		}
 	}
 
 	// wait for every thread to finish
-	_tp.wait();
+	uploadTasks.wait();
 
 	// Time and Rate calculation (in seconds)
 	Clock::time_point t1 = Clock::now();
@@ -165,6 +180,69 @@ uint32_t Client::uploadFileRequest(string path, CodingScheme codingScheme,
 	return fileMetaData._id;
 }
 
+/**
+ * 1. Encode the segment into blocks
+ * 2. Get the OSD of each block from the MONITOR, block 0 on the primary
+ * 3. Send all blocks in parallel
+ * 4. Commit the segment to the primary, which acknowledges the MDS
+ */
+
+void Client::putEncodedSegment(uint32_t primary,
+		struct SegmentData segmentData, CodingScheme codingScheme,
+		string codingSetting) {
+
+	const uint64_t segmentId = segmentData.info.segmentId;
+	const uint32_t segLength = segmentData.info.segLength;
+
+	vector<struct BlockData> blockDataList =
+			_codingModule->encodeSegmentToBlock(codingScheme, segmentId,
+					segmentData.buf, segLength, codingSetting);
+	const uint32_t blockCount = blockDataList.size();
+
+	vector<struct BlockLocation> blockLocationList =
+			_clientCommunicator->getOsdListRequest(segmentId, MONITOR,
+					blockCount, primary, blockDataList[0].info.blockSize);
+
+	// same parity list as the primary would attach
+	const uint32_t parityNum = _codingModule->getParityNumber(codingScheme,
+			codingSetting);
+	vector<BlockLocation> parityList;
+	for (uint32_t i = parityNum; i >= 1; --i) {
+		BlockLocation blockLocation;
+		blockLocation.blockId = blockCount - i;
+		blockLocation.osdId = blockLocationList[blockCount - i].osdId;
+		parityList.push_back(blockLocation);
+	}
+
+	vector<uint32_t> nodeList;
+	{
+		TaskGroup blockTasks(FOREGROUND_TASK);
+		for (uint32_t i = 0; i < blockCount; i++) {
+			struct BlockData blockData = blockDataList[i];
+			blockData.info.codingScheme = codingScheme;
+			blockData.info.codingSetting = codingSetting;
+			blockData.info.segmentSize = segLength;
+			blockData.info.parityVector = parityList;
+
+			const uint32_t osdId = blockLocationList[i].osdId;
+			const uint32_t dstSockfd = _clientCommunicator->getSockfdFromId(
+					osdId);
+			nodeList.push_back(osdId);
+
+			blockTasks.run([this, dstSockfd, blockData]() {
+				_clientCommunicator->sendBlock(dstSockfd, blockData, UPLOAD);
+				MemoryPool::getInstance().poolFree(blockData.buf);
+			});
+		}
+	}
+
+	_clientCommunicator->commitSegment(
+			_clientCommunicator->getSockfdFromId(primary), segmentId,
+			segLength, codingScheme, codingSetting, nodeList);
+
+	cout << "Put Segment ID = " << segmentId << " Finished" << endl;
+}
+
 void Client::deleteFileRequest(string path, uint32_t fileId) {
 	_clientCommunicator->deleteFile(_clientId, path, fileId);
 }
@@ -204,6 +282,8 @@ void Client::downloadFileRequest(uint32_t fileId, string dstPath) {
 
 	vector <uint64_t> segmentList = fileMetaData._segmentList;
 
+	TaskGroup downloadTasks(FOREGROUND_TASK, _numClientThreads);
+
 	uint32_t i = 0;
 	for (uint64_t segmentId : segmentList) {
 		uint32_t dstComponentId = fileMetaData._primaryList[i];
@@ -211,14 +291,14 @@ void Client::downloadFileRequest(uint32_t fileId, string dstPath) {
 				dstComponentId);
 
 		const uint64_t offset = segmentSize * i;
-		_tp.schedule(
+		downloadTasks.run(
 				boost::bind(startDownloadThread, _clientId, dstSockfd, segmentId,
 						offset, filePtr, dstPath));
 
 		i++;
 	}
 
-	_tp.wait();
+	downloadTasks.wait();
 
 	_storageModule->closeFile(filePtr);
 
@@ -241,10 +321,6 @@ void Client::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
 		uint64_t segmentId, uint32_t segLength, uint32_t bufLength, uint32_t chunkCount,
 		bool isSmallSegment) {
 
-	// initialize chunkCount value
-	_pendingSegmentChunk.set(segmentId, chunkCount);
-	debug("Init Chunkcount = %" PRIu32 "\n", chunkCount);
-
 	// create segment and cache
 	if (!_storageModule->locateSegmentCache(segmentId))
     {
@@ -252,6 +328,10 @@ void Client::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
         memset(_storageModule->getSegmentCache(segmentId).buf, 'a', segLength);
     }
 
+	// initialize chunkCount value, releases the chunks that arrived already
+	_pendingSegmentChunk.set(segmentId, chunkCount);
+	debug("Init Chunkcount = %" PRIu32 "\n", chunkCount);
+
 	if (!isSmallSegment) {
 	    _clientCommunicator->replyPutSegmentInit(requestId, sockfd, segmentId);
 	}
@@ -262,32 +342,24 @@ void Client::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
 		uint64_t segmentId, bool isSmallSegment) {
 
 	// TODO: check integrity of segment received
-	bool chunkRemaining = false;
-
-	while (1) {
 
-		chunkRemaining = _pendingSegmentChunk.count(segmentId);
+	// the last SegmentDataProcessor erases the entry
+	_pendingSegmentChunk.waitErase(segmentId);
 
-		if (!chunkRemaining) {
-			// if all chunks have arrived, send ack
-			_clientCommunicator->replyPutSegmentEnd(requestId, sockfd, segmentId, isSmallSegment);
-			break;
-		} else {
-			usleep(USLEEP_DURATION); // sleep 0.01s
-		}
-
-	}
+	// if all chunks have arrived, send ack
+	_clientCommunicator->replyPutSegmentEnd(requestId, sockfd, segmentId, isSmallSegment);
 }
 
 uint32_t Client::SegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
 		uint64_t segmentId, uint64_t offset, uint32_t length, char* buf) {
 
+	// chunks are sent right behind the init request, before its reply
+	_pendingSegmentChunk.waitGet(segmentId);
+
 	uint32_t byteWritten;
 	byteWritten = _storageModule->writeSegmentCache(segmentId, buf, offset,
 			length);
-	_pendingSegmentChunk.decrement(segmentId);
-
-	if (_pendingSegmentChunk.get(segmentId) == 0) {
+	if (_pendingSegmentChunk.decrement(segmentId) == 0) {
 		_pendingSegmentChunk.erase(segmentId);
 	}
 	return byteWritten;
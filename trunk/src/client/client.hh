@@ -9,8 +9,9 @@
 
 #include "../cache/cache.hh"
 #include "../common/metadata.hh"
-#include "../datastructure/concurrentmap.hh"
-#include "../../lib/threadpool/threadpool.hpp"
+#include "../datastructure/concurrenthashmap.hh"
+#include "../common/executor.hh"
+#include "../osd/codingmodule.hh"
 
 class Client {
 public:
@@ -128,6 +129,17 @@ public:
 	 */
 	uint32_t getClientId();
 
+	/**
+	 * Encode a segment and store its blocks on the OSDs directly, then
+	 * commit it to the primary
+	 * @param primary Primary OSD ID of the segment
+	 * @param segmentData SegmentData structure
+	 * @param codingScheme Coding Scheme specified
+	 * @param codingSetting Coding Scheme setting
+	 */
+	void putEncodedSegment(uint32_t primary, struct SegmentData segmentData,
+			CodingScheme codingScheme, string codingSetting);
+
 	struct SegmentData getSegment(uint32_t clientId, uint32_t dstSockfd, uint64_t segmentId);
 	void getSegment(uint32_t clientId, uint32_t dstSockfd, uint64_t segmentId,
 			uint64_t offset, FILE* filePtr, string dstPath);
@@ -140,12 +152,13 @@ private:
 
 	ClientCommunicator* _clientCommunicator;
 	ClientStorageModule* _storageModule;
+	CodingModule* _codingModule;
 
-	ConcurrentMap<uint64_t, int> _pendingSegmentChunk;
+	ConcurrentHashMap<uint64_t, int> _pendingSegmentChunk;
 
 	// thread pool for upload
-	uint32_t _numClientThreads;
-	boost::threadpool::pool _tp;
+	uint32_t _numClientThreads; // segments transferred in parallel
+	bool _isClientEncoding; // encode uploads here instead of on the primary
 
 };
 #endif
@@ -22,6 +22,7 @@
 #include "../protocol/transfer/getsegmentrequest.hh"
 #include "../protocol/nodelist/getosdlistrequest.hh"
 #include "../protocol/nodelist/getosdlistreply.hh"
+#include "../protocol/metadata/uploadsegmentack.hh"
 
 /**
  * @brief	Send List Folder Request to MDS (Blocking)
@@ -274,3 +275,23 @@ void ClientCommunicator::getOsdListAndConnect() {
 	}
 	
 }
+
+void ClientCommunicator::commitSegment(uint32_t dstOsdSockfd,
+		uint64_t segmentId, uint32_t segLength, CodingScheme codingScheme,
+		string codingSetting, vector<uint32_t> nodeList) {
+
+	UploadSegmentAckMsg* uploadSegmentAckMsg = new UploadSegmentAckMsg(this,
+			dstOsdSockfd, segmentId, segLength, codingScheme, codingSetting,
+			nodeList);
+	uploadSegmentAckMsg->prepareProtocolMsg();
+	addMessage(uploadSegmentAckMsg, true);
+
+	MessageStatus status = uploadSegmentAckMsg->waitForStatusChange();
+	if (status == READY) {
+		waitAndDelete(uploadSegmentAckMsg);
+		return;
+	} else {
+		debug_error("Segment Commit Failed [%" PRIu64 "]\n", segmentId);
+		exit(-1);
+	}
+}
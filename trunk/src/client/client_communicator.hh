@@ -152,6 +152,20 @@ public:
 	 */
 	void getOsdListAndConnect();
 
+	/**
+	 * Commit a segment whose blocks the client has stored on the OSDs
+	 * The primary acknowledges the upload to the MDS (Blocking)
+	 * @param dstOsdSockfd Socket Descriptor of the primary OSD
+	 * @param segmentId Segment ID
+	 * @param segLength Segment length
+	 * @param codingScheme Coding Scheme
+	 * @param codingSetting Coding Setting
+	 * @param nodeList OSD of each block, the primary first
+	 */
+	void commitSegment(uint32_t dstOsdSockfd, uint64_t segmentId,
+			uint32_t segLength, CodingScheme codingScheme,
+			string codingSetting, vector<uint32_t> nodeList);
+
 private:
 
 };
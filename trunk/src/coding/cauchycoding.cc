@@ -5,17 +5,12 @@
 #include <string.h>
 #include "coding.hh"
 #include "cauchycoding.hh"
+#include "codingcontext.hh"
 #include "../common/debug.hh"
 #include "../common/blockdata.hh"
 #include "../common/segmentdata.hh"
 #include "../common/memorypool.hh"
 
-extern "C" {
-#include "../../lib/jerasure/jerasure.h"
-#include "../../lib/jerasure/cauchy.h"
-
-}
-
 using namespace std;
 
 CauchyCoding::CauchyCoding() {
@@ -43,96 +38,32 @@ vector<BlockData> CauchyCoding::encode(SegmentData segmentData, string setting)
 		exit(-1);
 	}
 
-	int *matrix = cauchy_good_general_coding_matrix(k, m, w);
-	int *bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
-	int **smart = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
-
-	char **data, **code;
-	data = talloc<char*, uint32_t>(k);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			CAUCHY, k, m, w);
 
+	// data and parity blocks are filled stripe by stripe in encodeSegment()
+	vector<char*> data(k), code(m);
 	for (uint32_t i = 0; i < k; i++) {
 		struct BlockData blockData;
 		blockData.info.segmentId = segmentData.info.segmentId;
 		blockData.info.blockId = i;
 		blockData.info.blockSize = size*w;
-		blockData.buf = MemoryPool::getInstance().poolMalloc(size*w);
-		char* bufPos = segmentData.buf + i * size*w;
-		if (i * w *size >= segmentData.info.segLength) {
-			//Zero Padding
-		} else if ((i + 1) * w * size > segmentData.info.segLength) {
-			memcpy(blockData.buf, bufPos,
-					segmentData.info.segLength - i * w * size);
-			memset(blockData.buf + segmentData.info.segLength - i * w * size, 0,
-					(i + 1) * w * size - segmentData.info.segLength);
-		} else
-			memcpy(blockData.buf, bufPos, w * size);
-
+		blockData.buf = MemoryPool::getInstance().poolMalloc(size*w, false);
 		data[i] = blockData.buf;
-
 		blockDataList.push_back(blockData);
 	}
-
-	if (m == 0){
-		tfree(data);
-		return blockDataList;
-	}
-
-	code = talloc<char*, uint32_t>(m);
-	for (uint32_t i = 0; i < m; i++) {
-		code[i] = talloc<char, uint32_t>(size*w);
-	}
-
-	jerasure_schedule_encode(k, m, w, smart, data, code, w*size, size);
-
-	//	for (uint32_t i = 0; i < k; i++) {
-	//		char path[100];
-	//		sprintf (path, "encode %" PRIu32, i);
-	//		FILE* f = fopen (path, "w");
-	//		fwrite (data[i], w*size, 1,f);
-	//	}
-	//	for (uint32_t i = 0; i < m; i++) {
-	//		char path[100];
-	//		sprintf (path, "encode %" PRIu32, i+k);
-	//		FILE* f = fopen (path, "w");
-	//		fwrite (code[i], w*size, 1,f);
-	//	}
-
 	for (uint32_t i = 0; i < m; i++) {
 		struct BlockData blockData;
 		blockData.info.segmentId = segmentData.info.segmentId;
 		blockData.info.blockId = k + i;
 		blockData.info.blockSize = size*w;
-
-		blockData.buf = code[i];
-		//		blockData.buf = MemoryPool::getInstance().poolMalloc(size*w);
-		//		memcpy(blockData.buf, code[i], size*w);
-
+		blockData.buf = MemoryPool::getInstance().poolMalloc(size*w, false);
+		code[i] = blockData.buf;
 		blockDataList.push_back(blockData);
 	}
 
-	//	for (uint32_t i = 0; i < k+m; i++) {
-	//		char path[100];
-	//		sprintf (path, "ENCODE %" PRIu32, i);
-	//		FILE* f = fopen (path, "w");
-	//		fwrite (blockDataList[i].buf, blockDataList[i].info.blockSize, 1,f);
-	//	}
-	//	for (uint32_t i = 0; i < k+m; i++) {
-	//			char path[100];
-	//			sprintf (path, "ENCODE %" PRIu32, i);
-	//			FILE* f = fopen (path, "w");
-	//			fwrite (blockDataList[i].buf, blockDataList[i].info.blockSize, 1, f);
-	//		}
-
-	// free memory
-	//for (uint32_t i = 0; i < k; i++) {
-	//	tfree(data[i]);
-	//}
-	tfree(data);
-
-	//for (uint32_t i = 0; i < m; i++) {
-	//	tfree(code[i]);
-	//}
-	tfree(code);
+	CodingContextCache::getInstance().encodeSegment(context, segmentData.buf,
+			segmentData.info.segLength, data.data(), code.data(), w*size, size);
 
 	return blockDataList;
 }
@@ -173,17 +104,14 @@ SegmentData CauchyCoding::decode(vector<BlockData> &blockDataList,
 
 	set<uint32_t> blockIdListSet(blockIdList.begin(), blockIdList.end());
 
-	int *matrix = cauchy_good_general_coding_matrix(k, m, w);
-	int *bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
-	//		int **smart = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			CAUCHY, k, m, w);
 
 	char **data, **code;
-	int *erasures;
-	int j = 0;
+	vector<int> erasures;
 
 	data = talloc<char*, uint32_t>(k);
 	code = talloc<char*, uint32_t>(m);
-	erasures = talloc<int, uint32_t>(k + m - blockIdList.size() + 1);
 
 	for (uint32_t i = 0; i < k + m; i++) {
 		i < k ? data[i] = talloc<char, uint32_t>(size*w) : code[i - k] =
@@ -192,10 +120,9 @@ SegmentData CauchyCoding::decode(vector<BlockData> &blockDataList,
 			i < k ? memcpy(data[i], blockDataList[i].buf, size*w) : memcpy(
 					code[i - k], blockDataList[i].buf, size*w);
 		} else {
-			erasures[j++] = i;
+			erasures.push_back(i);
 		}
 	}
-	erasures[j] = -1;
 
 
 	//		for (uint32_t i = 0; i < k; i++) {
@@ -210,7 +137,8 @@ SegmentData CauchyCoding::decode(vector<BlockData> &blockDataList,
 	//					FILE* f = fopen (path, "w");
 	//					fwrite (code[i], w*size, 1,f);
 	//				}
-	jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures, data, code, w*size, size, 1);
+	CodingContextCache::getInstance().decode(context, erasures, data, code,
+			w*size, size);
 
 	//	for (uint32_t i = 0; i < k+m; i++) {
 	//		char path[100];
@@ -220,11 +148,11 @@ SegmentData CauchyCoding::decode(vector<BlockData> &blockDataList,
 	//	}
 
 	uint64_t offset = 0;
-	for (uint32_t i = 0; i < k - 1; i++) {
-		memcpy(segmentData.buf + offset, data[i], size);
-		offset += size;
+	for (uint32_t i = 0; i < k && offset < segmentSize; i++) {
+		const uint64_t length = min((uint64_t) size*w, segmentSize - offset);
+		memcpy(segmentData.buf + offset, data[i], length);
+		offset += length;
 	}
-	memcpy(segmentData.buf + offset, data[k - 1], segmentSize - offset);
 
 
 	// free memory
@@ -237,8 +165,6 @@ SegmentData CauchyCoding::decode(vector<BlockData> &blockDataList,
 		tfree(code[i]);
 	}
 	tfree(code);
-	tfree(erasures);
-	tfree(matrix);
 
 	return segmentData;
 }
@@ -335,17 +261,14 @@ vector<BlockData> CauchyCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 	set<uint32_t> blockIdListSet(blockIdList.begin(), blockIdList.end());
 
 	//if (blockIdList.size() != k + m) {
-	int *matrix = cauchy_good_general_coding_matrix(k, m, w);
-	int *bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
-	//	int **smart = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			CAUCHY, k, m, w);
 
 	char **data, **code;
-	int *erasures;
-	int j = 0;
+	vector<int> erasures;
 
 	data = talloc<char*, uint32_t>(k);
 	code = talloc<char*, uint32_t>(m);
-	erasures = talloc<int, uint32_t>(k + m - blockIdList.size() + 1);
 
 	for (uint32_t i = 0; i < k + m; i++) {
 		i < k ? data[i] = talloc<char, uint32_t>(size*w) : code[i - k] =
@@ -354,12 +277,12 @@ vector<BlockData> CauchyCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 			i < k ? memcpy(data[i], blockData[i].buf, size*w) : memcpy(
 					code[i - k], blockData[i].buf, size*w);
 		} else {
-			erasures[j++] = i;
+			erasures.push_back(i);
 		}
 	}
-	erasures[j] = -1;
 
-	jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures, data, code, w*size, size, 1);
+	CodingContextCache::getInstance().decode(context, erasures, data, code,
+			w*size, size);
 
 	for (uint32_t i = 0; i < repairBlockIdList.size(); i++) {
 		struct BlockData temp;
@@ -388,14 +311,15 @@ vector<BlockData> CauchyCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 		tfree(code[i]);
 	}
 	tfree(code);
-
-	free(matrix);
-	tfree(erasures);
 	//}
 
 	return ret;
 }
 
+bool CauchyCoding::canDecodeFromAnyBlocks() {
+	return true;
+}
+
 uint32_t CauchyCoding::getBlockCountFromSetting(string setting) {
 	vector<uint32_t> params = getParameters(setting);
 	const uint32_t k = params[0];
@@ -421,13 +345,5 @@ uint32_t CauchyCoding::getBlockSize(uint32_t segmentSize, string setting) {
 //
 
 vector<uint32_t> CauchyCoding::getParameters(string setting) {
-	vector<uint32_t> params(3);
-	int i = 0;
-	string token;
-	stringstream stream(setting);
-	while (getline(stream, token, ':')) {
-		istringstream(token) >> params[i++];
-	}
-	return params;
-
+	return CodingContextCache::getInstance().getParameters(setting, 3);
 }
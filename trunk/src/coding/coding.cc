@@ -1,6 +1,9 @@
+#include <string.h>
+#include <algorithm>
 #include "coding.hh"
 #include "../common/debug.hh"
 #include "../common/memorypool.hh"
+#include "galoisregion.hh"
 
 Coding::Coding() {
 }
@@ -21,28 +24,59 @@ uint32_t Coding::roundTo(uint32_t numToRound, uint32_t multiple) {
 }
 
 void Coding::bitwiseXor(char* result, char* srcA, char* srcB, uint32_t length) {
+    char* srcs[2] = { srcA, srcB };
+    bitwiseXor(result, srcs, 2, length);
+}
 
-    uint64_t* srcA64 = (uint64_t*) srcA;
-    uint64_t* srcB64 = (uint64_t*) srcB;
-    uint64_t* result64 = (uint64_t*) result;
+void Coding::bitwiseXor(char* result, char** srcs, uint32_t srcCount,
+        uint32_t length) {
+    GaloisRegion::xorRegions(result, srcs, srcCount, length,
+            GaloisRegion::getBestKernel());
+}
 
-    uint64_t xor64Count = length / sizeof(uint64_t);
-    uint64_t offset = 0;
+uint32_t Coding::getParityCountFromSetting(string setting) {
+    return 0;
+}
 
-    // finish all the word-by-word XOR
-    for (uint64_t i = 0; i < xor64Count; i++) {
-        result64[i] = srcA64[i] ^ srcB64[i];
-        offset += sizeof(uint64_t); // processed bytes
-    }
+// default function, can be overridden
+block_list_t Coding::getRangeBlockSymbols(uint64_t offset, uint32_t length,
+		vector<bool> blockStatus, uint32_t segmentSize, string setting) {
 
-    // finish remaining byte-by-byte XOR
-    for (uint64_t j = offset; j < length; j++) {
-        result[j] = srcA[j] ^ srcB[j];
-    }
+	const uint32_t dataBlockCount = getBlockCountFromSetting(setting)
+			- getParityCountFromSetting(setting);
+	const uint32_t blockSize = getBlockSize(segmentSize, setting);
+
+	block_list_t blockSymbols;
+	if (blockSize == 0 || offset >= segmentSize) {
+		return blockSymbols;
+	}
+	uint64_t end = min(offset + length, (uint64_t) segmentSize);
+
+	while (offset < end) {
+		const uint32_t blockId = offset / blockSize;
+		const uint32_t blockOffset = offset % blockSize;
+		const uint32_t symbolLength = min(end - offset,
+				(uint64_t) (blockSize - blockOffset));
+
+		// a lost data block has to be decoded
+		if (blockId >= dataBlockCount || blockId >= blockStatus.size()
+				|| !blockStatus[blockId]) {
+			return {};
+		}
+
+		blockSymbols.push_back(
+				make_pair(blockId,
+						vector<offset_length_t> { make_pair(blockOffset,
+								symbolLength) }));
+		offset += symbolLength;
+	}
+
+	return blockSymbols;
 }
 
-uint32_t Coding::getParityCountFromSetting(string setting) {
-    return 0;
+// default function, can be overridden
+bool Coding::canDecodeFromAnyBlocks() {
+	return false;
 }
 
 // default function, can be overridden
@@ -56,8 +90,13 @@ vector<BlockData> Coding::computeDelta(BlockData oldBlock, BlockData newBlock,
         BlockData &delta = deltas[i];
         delta = oldBlock;
         delta.info.blockId = parityBlockIdVector[i];
-        delta.buf = MemoryPool::getInstance().poolMalloc(combinedLength);
-        bitwiseXor(delta.buf, oldBlock.buf, newBlock.buf, combinedLength);
+        delta.buf = MemoryPool::getInstance().poolMalloc(combinedLength, false);
+        if (i == 0) {
+            bitwiseXor(delta.buf, oldBlock.buf, newBlock.buf, combinedLength);
+        } else {
+            // every parity gets the same delta
+            memcpy(delta.buf, deltas[0].buf, combinedLength);
+        }
     }
     return deltas;
 }
@@ -86,6 +86,32 @@ public:
 			vector<struct BlockData> &blockData, block_list_t &symbolList,
 			uint32_t segmentSize, string setting) = 0;
 
+	/**
+	 * Get the symbols that hold a byte range of the segment
+	 * The default is for systematic codes whose data block i holds segment
+	 * bytes [i * blockSize, (i + 1) * blockSize)
+	 * @param offset Offset of the range in the segment
+	 * @param length Length of the range
+	 * @param blockStatus True if block[i] is available, false otherwise
+	 * @param segmentSize Segment Size
+	 * @param setting Coding Setting
+	 * @return vector <blockId, vector <offset, length>> in segment order,
+	 * empty if the range cannot be read without decoding the segment
+	 */
+
+	virtual block_list_t getRangeBlockSymbols(uint64_t offset,
+			uint32_t length, vector<bool> blockStatus, uint32_t segmentSize,
+			string setting);
+
+	/**
+	 * Whether the segment can be decoded from any set of blocks that
+	 * getRequiredBlockSymbols chooses when exactly that set is available,
+	 * each read whole. Used by hedged reads to swap a slow block for another
+	 * @return true for MDS codes, false by default
+	 */
+
+	virtual bool canDecodeFromAnyBlocks();
+
 	virtual uint32_t getBlockCountFromSetting (string setting) = 0;
 
 	virtual uint32_t getParityCountFromSetting (string setting);
@@ -115,6 +141,17 @@ public:
 	static void bitwiseXor(char* result, char* srcA, char* srcB,
 			uint32_t length);
 
+	/**
+	 * XOR a list of regions in one pass
+	 * @param result XOR-ed result, may be one of the sources
+	 * @param srcs Source regions
+	 * @param srcCount Number of source regions
+	 * @param length Number of bytes to do XOR
+	 */
+
+	static void bitwiseXor(char* result, char** srcs, uint32_t srcCount,
+			uint32_t length);
+
 	uint32_t getCombinedLength(vector<offset_length_t> offsetLength);
 
 	// For using Memory Pool in Jerasure implementations
@@ -0,0 +1,676 @@
+#include <sstream>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include "codingcontext.hh"
+#include "galoisregion.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+#include "../common/executor.hh"
+
+extern "C" {
+#include "../../lib/jerasure/jerasure.h"
+#include "../../lib/jerasure/reed_sol.h"
+#include "../../lib/jerasure/cauchy.h"
+}
+
+/**
+ * Stripes of one encodeSegment() call, shared with the helper tasks
+ * Helpers that start after the last stripe is taken leave without
+ * touching the caller, so the caller only waits for stripes in progress
+ */
+
+struct StripeProgress {
+	vector<CodingStripe> stripes;
+	atomic<uint32_t> nextStripe;
+	uint32_t doneCount; // guarded by doneMutex
+	mutex doneMutex;
+	condition_variable doneCondition;
+};
+
+static void copySegmentRange(char* dst, const char* segment,
+		uint64_t segLength, uint64_t offset, uint32_t length) {
+	const uint32_t copyLength =
+			(offset >= segLength) ?
+					0 : (uint32_t) min((uint64_t) length, segLength - offset);
+	memcpy(dst, segment + offset, copyLength);
+	memset(dst + copyLength, 0, length - copyLength);
+}
+
+CodingContextCache::CodingContextCache() {
+
+}
+
+CodingContextCache::~CodingContextCache() {
+	for (auto contextEntry : _contextCache) {
+		CodingContext* context = contextEntry.second;
+		for (auto decodingEntry : context->decodingCache) {
+			DecodingContext* decoding = decodingEntry.second;
+			if (decoding->schedule != NULL) {
+				jerasure_free_schedule(decoding->schedule);
+			}
+			delete decoding;
+		}
+		if (context->schedule != NULL) {
+			jerasure_free_schedule(context->schedule);
+		}
+		free(context->bitmatrix);
+		free(context->matrix);
+		delete context;
+	}
+}
+
+vector<uint32_t> CodingContextCache::getParameters(const string& setting,
+		uint32_t count) {
+
+	{
+		lock_guard<mutex> lk(_settingMutex);
+		auto it = _settingCache.find(setting);
+		if (it != _settingCache.end() && it->second.size() == count) {
+			return it->second;
+		}
+	}
+
+	vector<uint32_t> params(count);
+	uint32_t i = 0;
+	string token;
+	stringstream stream(setting);
+	while (i < count && getline(stream, token, ':')) {
+		istringstream(token) >> params[i++];
+	}
+
+	// settings come from clients, do not let the cache grow unbounded
+	lock_guard<mutex> lk(_settingMutex);
+	if (_settingCache.size() < CODING_SETTING_CACHE_SIZE) {
+		_settingCache[setting] = params;
+	}
+	return params;
+}
+
+CodingContext* CodingContextCache::getContext(CodingScheme codingScheme,
+		uint32_t k, uint32_t m, uint32_t w) {
+
+	const vector<uint32_t> key = { (uint32_t) codingScheme, k, m, w };
+
+	lock_guard<mutex> lk(_contextMutex);
+	auto it = _contextCache.find(key);
+	if (it != _contextCache.end()) {
+		return it->second;
+	}
+
+	CodingContext* context = new CodingContext();
+	context->codingScheme = codingScheme;
+	context->k = k;
+	context->m = m;
+	context->w = w;
+	context->matrix = NULL;
+	context->bitmatrix = NULL;
+	context->schedule = NULL;
+
+	if (codingScheme == RS_CODING) {
+		context->matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
+		// Jerasure fills its tables on first use without a lock, do it
+		// here before the stripes are coded in parallel
+		if (w == 16) {
+			galois_create_log_tables(16);
+		} else if (w == 32) {
+			galois_create_split_w8_tables();
+		}
+	} else if (codingScheme == CAUCHY) {
+		context->matrix = cauchy_good_general_coding_matrix(k, m, w);
+		context->bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w,
+				context->matrix);
+		context->schedule = jerasure_smart_bitmatrix_to_schedule(k, m, w,
+				context->bitmatrix);
+	} else {
+		debug_error("No coding context for coding scheme %d\n",
+				(int) codingScheme);
+		exit(-1);
+	}
+
+	debug("Coding context created for scheme %d k = %" PRIu32 " m = %" PRIu32 " w = %" PRIu32 "\n",
+			(int) codingScheme, k, m, w);
+
+	_contextCache[key] = context;
+	return context;
+}
+
+void CodingContextCache::encode(CodingContext* context, char** data,
+		char** code, uint32_t size, uint32_t packetSize) {
+	encodeSegment(context, NULL, 0, data, code, size, packetSize);
+}
+
+void CodingContextCache::encodeSegment(CodingContext* context,
+		const char* segment, uint64_t segLength, char** data, char** code,
+		uint32_t size, uint32_t packetSize) {
+
+	const bool isSchedule = (context->schedule != NULL);
+	const uint32_t packet = isSchedule ? packetSize : size;
+	shared_ptr<StripeProgress> progress = make_shared<StripeProgress>();
+	vector<CodingStripe>& stripes = progress->stripes;
+	stripes = getStripes(context, size, packetSize, CODING_STRIPE_SIZE);
+	if (stripes.empty()) {
+		return;
+	}
+
+	progress->nextStripe = 0;
+	progress->doneCount = 0;
+	auto doStripes = [=]() {
+		uint32_t i;
+		uint32_t finished = 0;
+		while ((i = progress->nextStripe++) < progress->stripes.size()) {
+			encodeStripe(context, progress->stripes[i], segment, segLength,
+					data, code, size, packet);
+			finished++;
+		}
+		if (finished > 0) {
+			lock_guard<mutex> lk(progress->doneMutex);
+			progress->doneCount += finished;
+			if (progress->doneCount == progress->stripes.size()) {
+				progress->doneCondition.notify_all();
+			}
+		}
+	};
+
+	// the caller works too
+	const uint32_t helperCount = min(
+			CODING_THREADS > 0 ?
+					CODING_THREADS : Executor::getInstance().getNumWorkers(),
+			(uint32_t) stripes.size() - 1);
+	for (uint32_t i = 0; i < helperCount; i++) {
+		Executor::getInstance().schedule(FOREGROUND_TASK, doStripes);
+	}
+	doStripes();
+
+	unique_lock<mutex> lk(progress->doneMutex);
+	if (progress->doneCount < stripes.size()) {
+		Executor::BlockingScope blocking;
+		progress->doneCondition.wait(lk,
+				[&] {return progress->doneCount == stripes.size();});
+	}
+}
+
+vector<CodingStripe> CodingContextCache::getStripes(CodingContext* context,
+		uint32_t size, uint32_t packetSize, uint32_t stripeSize) {
+
+	const bool isSchedule = (context->schedule != NULL);
+	const uint32_t packet = isSchedule ? packetSize : size;
+	const uint32_t packetCount = isSchedule ? context->w : 1;
+	const uint32_t groupSize = packet * packetCount;
+	vector<CodingStripe> stripes;
+	if (size == 0 || groupSize == 0) {
+		return stripes;
+	}
+	const uint32_t groupCount = size / groupSize;
+
+	// whole groups if they are small, otherwise a range of every packet
+	if (groupSize >= stripeSize) {
+		const uint32_t length = max(stripeSize / packetCount / 64 * 64,
+				(uint32_t) 64);
+		for (uint32_t g = 0; g < groupCount; g++) {
+			for (uint32_t offset = 0; offset < packet; offset += length) {
+				stripes.push_back( { g, 1, offset, min(length, packet - offset) });
+			}
+		}
+	} else {
+		const uint32_t groups = stripeSize / groupSize;
+		for (uint32_t g = 0; g < groupCount; g += groups) {
+			stripes.push_back( { g, min(groups, groupCount - g), 0, packet });
+		}
+	}
+	return stripes;
+}
+
+void CodingContextCache::encodeBlockStripe(CodingContext* context,
+		const CodingStripe& stripe, uint32_t blockId, char* data, char** code,
+		uint32_t size, uint32_t packetSize) {
+
+	const uint32_t k = context->k;
+	const uint32_t m = context->m;
+	const uint32_t w = context->w;
+
+	if (context->schedule == NULL) {
+		// parity[i] ^= matrix[i][blockId] * data, over the stripe
+		for (uint32_t i = 0; i < m; i++) {
+			const int coefficient = context->matrix[i * k + blockId];
+			char* src = data + stripe.offset;
+			char* dst = code[i] + stripe.offset;
+			if (coefficient == 0) {
+				continue;
+			} else if (w == 8) {
+				GaloisRegion::w08RegionMultiply(src, dst, stripe.length,
+						coefficient, true, GaloisRegion::getBestKernel());
+			} else {
+				// Jerasure accumulates a long at a time, the odd tail of the
+				// last stripe is done word by word
+				const uint32_t bulk = stripe.length / sizeof(long)
+						* sizeof(long);
+				if (w == 16) {
+					galois_w16_region_multiply(src, coefficient, bulk, dst, 1);
+					for (uint32_t j = bulk; j < stripe.length; j += 2) {
+						*(uint16_t*) (dst + j) ^= galois_single_multiply(
+								*(uint16_t*) (src + j), coefficient, 16);
+					}
+				} else {
+					galois_w32_region_multiply(src, coefficient, bulk, dst, 1);
+					for (uint32_t j = bulk; j < stripe.length; j += 4) {
+						*(uint32_t*) (dst + j) ^= galois_single_multiply(
+								*(uint32_t*) (src + j), coefficient, 32);
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	// parity packet (i, r) ^= data packets c with bit (i * w + r, blockId * w + c)
+	const uint32_t groupSize = packetSize * w;
+	const GaloisKernel kernel = GaloisRegion::getBestKernel();
+	vector<char*> srcs;
+	for (uint32_t g = stripe.firstGroup;
+			g < stripe.firstGroup + stripe.groupCount; g++) {
+		char* src = data + g * groupSize + stripe.offset;
+		for (uint32_t i = 0; i < m; i++) {
+			for (uint32_t r = 0; r < w; r++) {
+				char* dst = code[i] + g * groupSize + r * packetSize
+						+ stripe.offset;
+				const int* row = context->bitmatrix + (i * w + r) * k * w
+						+ blockId * w;
+				srcs.clear();
+				srcs.push_back(dst);
+				for (uint32_t c = 0; c < w; c++) {
+					if (row[c]) {
+						srcs.push_back(src + c * packetSize);
+					}
+				}
+				if (srcs.size() > 1) {
+					GaloisRegion::xorRegions(dst, srcs.data(), srcs.size(),
+							stripe.length, kernel);
+				}
+			}
+		}
+	}
+}
+
+void CodingContextCache::decode(CodingContext* context,
+		const vector<int>& erasures, char** data, char** code, uint32_t size,
+		uint32_t packetSize) {
+
+	if (erasures.empty()) {
+		return;
+	}
+
+	const int k = context->k;
+	const int m = context->m;
+	const int w = context->w;
+	DecodingContext* decoding = getDecodingContext(context, erasures);
+
+	if (decoding->schedule != NULL) {
+
+		// same pointer layout as jerasure_schedule_decode_lazy():
+		// surviving blocks first, then erased data and erased parity blocks
+
+		char* ptrs[k + m];
+		vector<bool> erased(k + m, false);
+		for (int id : erasures) {
+			erased[id] = true;
+		}
+		int j = k;
+		int x = k;
+		for (int i = 0; i < k; i++) {
+			if (!erased[i]) {
+				ptrs[i] = data[i];
+			} else {
+				while (erased[j]) {
+					j++;
+				}
+				ptrs[i] = code[j - k];
+				j++;
+				ptrs[x++] = data[i];
+			}
+		}
+		for (int i = k; i < k + m; i++) {
+			if (erased[i]) {
+				ptrs[x++] = code[i - k];
+			}
+		}
+
+		runSchedule(decoding->schedule, ptrs, k + m, w, size, packetSize, 0,
+				packetSize);
+		return;
+	}
+
+	// decode the data blocks, then re-encode the erased parity blocks
+	for (uint32_t i = 0; i < decoding->targets.size(); i++) {
+		matrixDotprod(context, &decoding->rows[i * k],
+				&decoding->srcIds[i * k], decoding->targets[i], data, code,
+				size);
+	}
+	for (int id : erasures) {
+		if (id >= k) {
+			matrixDotprod(context, context->matrix + (id - k) * k, NULL, id,
+					data, code, size);
+		}
+	}
+}
+
+//
+// PRIVATE FUNCTION
+//
+
+void CodingContextCache::matrixDotprod(CodingContext* context,
+		int* matrixRow, int* srcIds, int destId, char** data, char** code,
+		uint32_t size) {
+
+	// w = 8 has SIMD kernels, other word sizes stay with Jerasure
+	if (context->w == 8) {
+		GaloisRegion::w08Dotprod(context->k, matrixRow, srcIds, destId, data,
+				code, size, GaloisRegion::getBestKernel());
+	} else {
+		jerasure_matrix_dotprod(context->k, context->w, matrixRow, srcIds,
+				destId, data, code, size);
+	}
+}
+
+void CodingContextCache::encodeStripe(CodingContext* context,
+		const CodingStripe& stripe, const char* segment, uint64_t segLength,
+		char** data, char** code, uint32_t size, uint32_t packetSize) {
+
+	const int k = context->k;
+	const int m = context->m;
+	const bool isSchedule = (context->schedule != NULL);
+	const uint32_t packetCount = isSchedule ? context->w : 1;
+	const uint32_t groupSize = packetSize * packetCount;
+	const uint32_t start = stripe.firstGroup * groupSize;
+
+	if (segment != NULL) {
+		for (int i = 0; i < k; i++) {
+			const uint64_t blockOffset = (uint64_t) i * size;
+			if (stripe.length == packetSize) {
+				copySegmentRange(data[i] + start, segment, segLength,
+						blockOffset + start, stripe.groupCount * groupSize);
+				continue;
+			}
+			for (uint32_t p = 0; p < stripe.groupCount * packetCount; p++) {
+				const uint32_t pos = start + p * packetSize + stripe.offset;
+				copySegmentRange(data[i] + pos, segment, segLength,
+						blockOffset + pos, stripe.length);
+			}
+		}
+	}
+
+	if (isSchedule) {
+		char* ptrs[k + m];
+		for (int i = 0; i < k; i++) {
+			ptrs[i] = data[i] + start;
+		}
+		for (int i = 0; i < m; i++) {
+			ptrs[k + i] = code[i] + start;
+		}
+		runSchedule(context->schedule, ptrs, k + m, context->w,
+				stripe.groupCount * groupSize, packetSize, stripe.offset,
+				stripe.length);
+	} else {
+		char* dataPtrs[k];
+		char* codePtrs[m];
+		for (int i = 0; i < k; i++) {
+			dataPtrs[i] = data[i] + stripe.offset;
+		}
+		for (int i = 0; i < m; i++) {
+			codePtrs[i] = code[i] + stripe.offset;
+		}
+		for (int i = 0; i < m; i++) {
+			matrixDotprod(context, context->matrix + i * k, NULL, k + i,
+					dataPtrs, codePtrs, stripe.length);
+		}
+	}
+}
+
+void CodingContextCache::runSchedule(int** schedule, char** ptrs,
+		int count, uint32_t w, uint32_t size, uint32_t packetSize,
+		uint32_t offset, uint32_t length) {
+
+	// same result as jerasure_do_scheduled_operations() on bytes
+	// [offset, offset + length) of every packet, but the copy and XORs of
+	// one destination packet are merged into one multi-source XOR
+
+	const GaloisKernel kernel = GaloisRegion::getBestKernel();
+	vector<char*> srcs;
+	char* base[count];
+	for (int i = 0; i < count; i++) {
+		base[i] = ptrs[i] + offset;
+	}
+
+	for (uint32_t done = 0; done < size; done += packetSize * w) {
+		int op = 0;
+		while (schedule[op][0] >= 0) {
+			char* dst = base[schedule[op][2]] + schedule[op][3] * packetSize;
+			srcs.clear();
+			if (schedule[op][4]) {
+				srcs.push_back(dst); // XOR into the current content
+			}
+			while (schedule[op][0] >= 0
+					&& base[schedule[op][2]] + schedule[op][3] * packetSize
+							== dst) {
+				if (!schedule[op][4]) {
+					srcs.clear(); // copy overwrites
+				}
+				srcs.push_back(base[schedule[op][0]]
+						+ schedule[op][1] * packetSize);
+				op++;
+			}
+			GaloisRegion::xorRegions(dst, srcs.data(), srcs.size(), length,
+					kernel);
+		}
+		for (int i = 0; i < count; i++) {
+			base[i] += packetSize * w;
+		}
+	}
+}
+
+DecodingContext* CodingContextCache::getDecodingContext(
+		CodingContext* context, const vector<int>& erasures) {
+
+	lock_guard<mutex> lk(context->decodingMutex);
+	auto it = context->decodingCache.find(erasures);
+	if (it != context->decodingCache.end()) {
+		return it->second;
+	}
+
+	DecodingContext* decoding;
+	if (context->bitmatrix != NULL) {
+		decoding = createScheduleDecoding(context, erasures);
+	} else {
+		decoding = createMatrixDecoding(context, erasures);
+	}
+	context->decodingCache[erasures] = decoding;
+	return decoding;
+}
+
+DecodingContext* CodingContextCache::createMatrixDecoding(
+		CodingContext* context, const vector<int>& erasures) {
+
+	const int k = context->k;
+	const int m = context->m;
+	const int w = context->w;
+	DecodingContext* decoding = new DecodingContext();
+	decoding->schedule = NULL;
+
+	vector<int> erased(k + m, 0);
+	for (int id : erasures) {
+		erased[id] = 1;
+	}
+
+	// follow jerasure_matrix_decode(): the first parity row of a
+	// Vandermonde matrix is all ones, so the last erased data block can be
+	// rebuilt with XOR only if parity 0 survives
+
+	const bool isParity0Erased = (m > 0 && erased[k]);
+	int edd = 0;
+	int lastdrive = k;
+	for (int i = 0; i < k; i++) {
+		if (erased[i]) {
+			edd++;
+			lastdrive = i;
+		}
+	}
+	if (isParity0Erased) {
+		lastdrive = k;
+	}
+
+	if (edd > 1 || (edd > 0 && isParity0Erased)) {
+		vector<int> decodingMatrix(k * k);
+		vector<int> dmIds(k);
+		if (jerasure_make_decoding_matrix(k, m, w, context->matrix,
+				erased.data(), decodingMatrix.data(), dmIds.data()) < 0) {
+			debug_error("%s\n", "Failed to create decoding matrix");
+			exit(-1);
+		}
+		for (int i = 0; edd > 0 && i < lastdrive; i++) {
+			if (erased[i]) {
+				decoding->targets.push_back(i);
+				decoding->rows.insert(decoding->rows.end(),
+						decodingMatrix.begin() + i * k,
+						decodingMatrix.begin() + (i + 1) * k);
+				decoding->srcIds.insert(decoding->srcIds.end(), dmIds.begin(),
+						dmIds.end());
+				edd--;
+			}
+		}
+	}
+
+	if (edd > 0) {
+		decoding->targets.push_back(lastdrive);
+		decoding->rows.insert(decoding->rows.end(), context->matrix,
+				context->matrix + k);
+		for (int i = 0; i < k; i++) {
+			decoding->srcIds.push_back(i < lastdrive ? i : i + 1);
+		}
+	}
+
+	return decoding;
+}
+
+DecodingContext* CodingContextCache::createScheduleDecoding(
+		CodingContext* context, const vector<int>& erasures) {
+
+	// same as jerasure_generate_decoding_schedule(), which jerasure keeps
+	// private: build one bitmatrix that rebuilds every erased block from
+	// the k surviving blocks in decode() pointer order, then schedule it
+
+	const int k = context->k;
+	const int m = context->m;
+	const int w = context->w;
+	const int* bitmatrix = context->bitmatrix;
+	const int rowSize = k * w * w; // ints per block in a bitmatrix
+
+	vector<bool> erased(k + m, false);
+	int ddf = 0;
+	int cdf = 0;
+	for (int id : erasures) {
+		erased[id] = true;
+		id < k ? ddf++ : cdf++;
+	}
+
+	// rowIds[i]: block in pointer slot i, indToRow[id]: slot of block id
+	vector<int> rowIds(k + m);
+	vector<int> indToRow(k + m);
+	int j = k;
+	int x = k;
+	for (int i = 0; i < k; i++) {
+		if (!erased[i]) {
+			rowIds[i] = i;
+			indToRow[i] = i;
+		} else {
+			while (erased[j]) {
+				j++;
+			}
+			rowIds[i] = j;
+			indToRow[j] = i;
+			j++;
+			rowIds[x] = i;
+			indToRow[i] = x;
+			x++;
+		}
+	}
+	for (int i = k; i < k + m; i++) {
+		if (erased[i]) {
+			rowIds[x] = i;
+			indToRow[i] = x;
+			x++;
+		}
+	}
+
+	vector<int> realDecodingMatrix(rowSize * (ddf + cdf), 0);
+
+	// erased data blocks: rows of the inverted survivor matrix
+	if (ddf > 0) {
+		vector<int> decodingMatrix(rowSize * k, 0);
+		for (int i = 0; i < k; i++) {
+			int* ptr = &decodingMatrix[rowSize * i];
+			if (rowIds[i] == i) {
+				for (int y = 0; y < w; y++) {
+					ptr[y + i * w + y * k * w] = 1;
+				}
+			} else {
+				memcpy(ptr, bitmatrix + rowSize * (rowIds[i] - k),
+						rowSize * sizeof(int));
+			}
+		}
+		vector<int> inverse(rowSize * k);
+		jerasure_invert_bitmatrix(decodingMatrix.data(), inverse.data(),
+				k * w);
+		for (int i = 0; i < ddf; i++) {
+			memcpy(&realDecodingMatrix[rowSize * i],
+					&inverse[rowSize * rowIds[k + i]], rowSize * sizeof(int));
+		}
+	}
+
+	// erased parity blocks: the distribution rows, with the columns of
+	// erased data blocks replaced by their decoding rows
+	for (int c = 0; c < cdf; c++) {
+		const int drive = rowIds[c + ddf + k] - k;
+		int* ptr = &realDecodingMatrix[rowSize * (ddf + c)];
+		memcpy(ptr, bitmatrix + drive * rowSize, rowSize * sizeof(int));
+
+		for (int i = 0; i < k; i++) {
+			if (rowIds[i] != i) {
+				for (int y = 0; y < w; y++) {
+					memset(ptr + y * k * w + i * w, 0, w * sizeof(int));
+				}
+			}
+		}
+
+		const int index = drive * rowSize;
+		for (int i = 0; i < k; i++) {
+			if (rowIds[i] == i) {
+				continue;
+			}
+			const int* b1 = &realDecodingMatrix[(indToRow[i] - k) * rowSize];
+			for (int r = 0; r < w; r++) {
+				int* b2 = ptr + r * k * w;
+				for (int y = 0; y < w; y++) {
+					if (bitmatrix[index + r * k * w + i * w + y]) {
+						for (int z = 0; z < k * w; z++) {
+							b2[z] ^= b1[z + y * k * w];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	DecodingContext* decoding = new DecodingContext();
+	decoding->schedule = jerasure_smart_bitmatrix_to_schedule(k, ddf + cdf,
+			w, realDecodingMatrix.data());
+
+	if (decoding->schedule == NULL) {
+		debug_error("%s\n", "Failed to create decoding schedule");
+		exit(-1);
+	}
+
+	return decoding;
+}
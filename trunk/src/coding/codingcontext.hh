@@ -0,0 +1,207 @@
+#ifndef __CODINGCONTEXT_HH__
+#define __CODINGCONTEXT_HH__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../common/enums.hh"
+
+using namespace std;
+
+/**
+ * Pre-computed state for decoding one erasure pattern
+ * Matrix codes keep one row of coefficients and k source IDs per erased
+ * data block, bitmatrix codes keep the decoding schedule
+ */
+
+struct DecodingContext {
+	vector<int> targets; // erased data blocks decoded by rows[]
+	vector<int> rows; // k coefficients per target
+	vector<int> srcIds; // k source block IDs per target
+	int** schedule;
+};
+
+/**
+ * Generator matrices and schedules of one (scheme, k, m, w) combination
+ * Contexts are created once and never freed until the cache is destroyed,
+ * so the pointers can be used without holding any lock
+ */
+
+struct CodingContext {
+	CodingScheme codingScheme;
+	uint32_t k;
+	uint32_t m;
+	uint32_t w;
+	int* matrix;
+	int* bitmatrix;
+	int** schedule;
+
+	mutex decodingMutex;
+	map<vector<int>, DecodingContext*> decodingCache; // keyed by erasures
+};
+
+/**
+ * Part of the blocks coded by one encoding task
+ * Packets of groups [firstGroup, firstGroup + groupCount), and bytes
+ * [offset, offset + length) of each packet. Matrix codes have one group
+ * with one packet per block.
+ */
+
+struct CodingStripe {
+	uint32_t firstGroup;
+	uint32_t groupCount;
+	uint32_t offset;
+	uint32_t length;
+};
+
+/**
+ * Cache of parsed coding settings, Jerasure matrices and schedules
+ * Building a matrix or a smart schedule costs more than coding a small
+ * segment, and the same few settings are used over and over again.
+ */
+
+class CodingContextCache {
+public:
+
+	/**
+	 * static method for Singleton implementation
+	 * @return reference to instance of singleton segment
+	 */
+
+	static CodingContextCache& getInstance() {
+		static CodingContextCache instance; // Guaranteed to be destroyed
+											// Instantiated on first use
+		return instance;
+	}
+
+	/**
+	 * Destructor
+	 */
+
+	~CodingContextCache();
+
+	/**
+	 * Parse a "k:m:w" style coding setting
+	 * @param setting Coding setting
+	 * @param count Number of parameters in the setting
+	 * @return List of parameters
+	 */
+
+	vector<uint32_t> getParameters(const string& setting, uint32_t count);
+
+	/**
+	 * Get the matrices and schedules for a coding setting
+	 * Only RS_CODING (Vandermonde) and CAUCHY are supported
+	 * @param codingScheme Coding scheme
+	 * @param k Number of data blocks
+	 * @param m Number of parity blocks
+	 * @param w Word size
+	 * @return Shared coding context
+	 */
+
+	CodingContext* getContext(CodingScheme codingScheme, uint32_t k,
+			uint32_t m, uint32_t w);
+
+	/**
+	 * Encode data blocks into parity blocks
+	 * @param context Coding context from getContext()
+	 * @param data Data block pointers
+	 * @param code Parity block pointers
+	 * @param size Size of each block
+	 * @param packetSize Packet size (bitmatrix codes only)
+	 */
+
+	void encode(CodingContext* context, char** data, char** code,
+			uint32_t size, uint32_t packetSize = 0);
+
+	/**
+	 * Copy a segment into the data blocks and encode the parity blocks
+	 * The blocks are split into stripes of about CODING_STRIPE_SIZE bytes,
+	 * each stripe is copied and encoded while it is in cache, and stripes
+	 * are processed in parallel by the caller and the encoding workers
+	 * @param context Coding context from getContext()
+	 * @param segment Segment buffer, NULL if the data blocks are filled
+	 * @param segLength Segment length, data blocks are zero padded after it
+	 * @param data Preallocated data block buffers, block i holds segment
+	 * bytes [i * size, (i + 1) * size)
+	 * @param code Preallocated parity block buffers
+	 * @param size Size of each block
+	 * @param packetSize Packet size (bitmatrix codes only)
+	 */
+
+	void encodeSegment(CodingContext* context, const char* segment,
+			uint64_t segLength, char** data, char** code, uint32_t size,
+			uint32_t packetSize = 0);
+
+	/**
+	 * Split the blocks into stripes of about stripeSize bytes of each block
+	 * @param context Coding context from getContext()
+	 * @param size Size of each block
+	 * @param packetSize Packet size (bitmatrix codes only)
+	 * @param stripeSize Bytes of each block per stripe
+	 * @return Stripes ordered by group, then by offset in the packets
+	 */
+
+	vector<CodingStripe> getStripes(CodingContext* context, uint32_t size,
+			uint32_t packetSize, uint32_t stripeSize);
+
+	/**
+	 * Add what one data block contributes to a stripe of the parity blocks
+	 * The data blocks of a stripe can be added one by one in any order onto
+	 * zero filled parity blocks, but not two at the same time
+	 * @param context Coding context from getContext()
+	 * @param stripe Stripe from getStripes()
+	 * @param blockId ID of the data block
+	 * @param data Data block buffer
+	 * @param code Parity block buffers
+	 * @param size Size of each block
+	 * @param packetSize Packet size (bitmatrix codes only)
+	 */
+
+	void encodeBlockStripe(CodingContext* context, const CodingStripe& stripe,
+			uint32_t blockId, char* data, char** code, uint32_t size,
+			uint32_t packetSize = 0);
+
+	/**
+	 * Rebuild the erased blocks in place
+	 * @param context Coding context from getContext()
+	 * @param erasures IDs of the erased blocks in ascending order
+	 * @param data Data block pointers
+	 * @param code Parity block pointers
+	 * @param size Size of each block
+	 * @param packetSize Packet size (bitmatrix codes only)
+	 */
+
+	void decode(CodingContext* context, const vector<int>& erasures,
+			char** data, char** code, uint32_t size, uint32_t packetSize = 0);
+
+private:
+	CodingContextCache();
+	CodingContextCache(CodingContextCache const&); // Don't Implement
+	void operator=(CodingContextCache const&); // Don't implement
+
+	void matrixDotprod(CodingContext* context, int* matrixRow, int* srcIds,
+			int destId, char** data, char** code, uint32_t size);
+	void encodeStripe(CodingContext* context, const CodingStripe& stripe,
+			const char* segment, uint64_t segLength, char** data, char** code,
+			uint32_t size, uint32_t packetSize);
+	void runSchedule(int** schedule, char** ptrs, int count, uint32_t w,
+			uint32_t size, uint32_t packetSize, uint32_t offset,
+			uint32_t length);
+	DecodingContext* getDecodingContext(CodingContext* context,
+			const vector<int>& erasures);
+	DecodingContext* createMatrixDecoding(CodingContext* context,
+			const vector<int>& erasures);
+	DecodingContext* createScheduleDecoding(CodingContext* context,
+			const vector<int>& erasures);
+
+	mutex _settingMutex;
+	map<string, vector<uint32_t> > _settingCache;
+
+	mutex _contextMutex;
+	map<vector<uint32_t>, CodingContext*> _contextCache;
+};
+
+#endif
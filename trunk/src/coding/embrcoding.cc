@@ -373,12 +373,24 @@ vector<BlockData> EMBRCoding::repairBlocks(vector<uint32_t> repairBlockIdList, v
 	return repairedBlockData;
 }
 
+bool EMBRCoding::canDecodeFromAnyBlocks() {
+	return false;
+}
+
 uint32_t EMBRCoding::getBlockCountFromSetting (string setting) {
 	vector<uint32_t> params = getParameters(setting);
 	const uint32_t n = params[0];
 	return n;
 }
 
+block_list_t EMBRCoding::getRangeBlockSymbols(uint64_t offset,
+		uint32_t length, vector<bool> blockStatus, uint32_t segmentSize,
+		string setting) {
+
+	// blocks hold replicated RS symbols, always decode the segment
+	return {};
+}
+
 uint32_t EMBRCoding::getBlockSize(uint32_t segmentSize, string setting) {
 	vector<uint32_t> params = getParameters(setting);
 	const uint32_t n = params[0];
@@ -42,13 +42,12 @@ vector<BlockData> EvenOddCoding::encode(SegmentData segmentData, string setting)
 
 	for(uint32_t i = k; i < n; ++i) {
 		blockData.info.blockId = i;
-		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);		
+		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize, false);
 		blockDataList[i] = blockData;
 	}
 
-	uint32_t d_group;
+	vector<char*> dataBufs;
 	for(uint32_t i = 0; i < k; ++i) {
-		d_group = i;
 		blockData.info.blockId = i;
 		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);		
 
@@ -64,28 +63,35 @@ vector<BlockData> EvenOddCoding::encode(SegmentData segmentData, string setting)
 		} else
 			memcpy(blockData.buf, bufPos, blockSize);
 
-		// Compute Row Parity Block
-		if (i == 0) {
-			memcpy(blockDataList[k].buf, blockData.buf, blockSize);
-		} else {
-			bitwiseXor(blockDataList[k].buf, blockDataList[k].buf, blockData.buf, blockSize);
-		}
-
-		// Compute Diagonal Parity Block
-		for(uint32_t j = 0; j < k - 1; ++j) {		
-			if(d_group == k - 1) {
-				for(uint32_t l = 0; l < k - 1; ++l) {
-					bitwiseXor(blockDataList[k + 1].buf + l * symbolSize, blockDataList[k + 1].buf + l * symbolSize, blockData.buf + j * symbolSize, symbolSize);
-				}
-			} else
-				bitwiseXor(blockDataList[k + 1].buf + d_group * symbolSize, blockDataList[k + 1].buf + d_group * symbolSize, blockData.buf + j * symbolSize, symbolSize);
+		blockDataList[i] = blockData;
+		dataBufs.push_back(blockData.buf);
+	}
 
-			d_group = (d_group + 1) % k;
+	// Compute Row Parity Block
+	bitwiseXor(blockDataList[k].buf, dataBufs.data(), k, blockSize);
+
+	// Compute Diagonal Parity Block
+	// Symbol j of block i is on diagonal (i + j) % k, the XOR of diagonal
+	// k - 1 (the adjuster) is added to every diagonal parity symbol
+	char* diagonal_adjuster = MemoryPool::getInstance().poolMalloc(symbolSize,
+			false);
+	vector<char*> srcs;
+	for(uint32_t d_group = k; d_group-- > 0; ) {
+		srcs.clear();
+		for(uint32_t i = 0; i < k; ++i) {
+			const uint32_t j = (d_group + k - i) % k;
+			if (j < k - 1)
+				srcs.push_back(blockDataList[i].buf + j * symbolSize);
+		}
+		if (d_group == k - 1) {
+			bitwiseXor(diagonal_adjuster, srcs.data(), srcs.size(), symbolSize);
+		} else {
+			srcs.push_back(diagonal_adjuster);
+			bitwiseXor(blockDataList[k + 1].buf + d_group * symbolSize,
+					srcs.data(), srcs.size(), symbolSize);
 		}
-
-
-		blockDataList[i] = blockData;
 	}
+	MemoryPool::getInstance().poolFree(diagonal_adjuster);
 
 	//debug("Block Data List Count: %zu\n", blockDataList.size());
 	return blockDataList;
@@ -129,8 +135,9 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 	std::fill_n (row_group_erasure, k - 1, k + 1);
 	std::fill_n (diagonal_group_erasure, k - 1, k);
 	std::fill_n (datadisk_block_erasure, k, k - 1);
-	char* diagonal_adjuster = MemoryPool::getInstance().poolMalloc(symbolSize);
-	char* repair_symbol = MemoryPool::getInstance().poolMalloc(symbolSize);
+	char* diagonal_adjuster = MemoryPool::getInstance().poolMalloc(symbolSize, false);
+	char* repair_symbol = MemoryPool::getInstance().poolMalloc(symbolSize, false);
+	vector<char*> srcs;
 
 	bool use_diagonal = false;
 	bool use_row = false;
@@ -180,12 +187,13 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 					//debug("%" PRIu32 ":%" PRIu32 " Diagonal Group %" PRIu32 "\n", id, firstSymbolId + i, diagonal_group);
 					if(diagonal_group == k - 1) {
 						//debug("bitwise %" PRIu32 ":%" PRIu32 "to adjuster\n", id, firstSymbolId + i);
-						bitwiseXor(diagonal_adjuster, tempBlock[id] + (firstSymbolId + i) * symbolSize, diagonal_adjuster, symbolSize);	
+						srcs.push_back(tempBlock[id] + (firstSymbolId + i) * symbolSize);
 					}
 				}
 			}
 		}
 	}
+	bitwiseXor(diagonal_adjuster, srcs.data(), srcs.size(), symbolSize);
 
 
 	bool diagonal_adjuster_failed = !(diagonal_group_erasure[k - 1] == 0);
@@ -211,7 +219,7 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 
 		target_id = (uint32_t)-1;
 		target_symbol = (uint32_t)-1;
-		memset(repair_symbol, 0, symbolSize);
+		srcs.clear();
 		bool cur_symbol_need_adjust = false;
 		for(uint32_t i = 0; i < k - 1; ++i) {
 			// Fix by Row
@@ -224,13 +232,14 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 					if((id < k) && (disk_block_status[id][symbol] == false))
 						target_id = id;
 					else {
-						bitwiseXor(repair_symbol, repair_symbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+						srcs.push_back(tempBlock[id] + symbol * symbolSize);
 						if(need_diagonal_adjust[id][symbol]){
 							//debug("%" PRIu32 ":%" PRIu32 " toggles need adjustment\n", id, symbol);
 							cur_symbol_need_adjust = !cur_symbol_need_adjust;
 						}
 					}
 				}
+				bitwiseXor(repair_symbol, srcs.data(), srcs.size(), symbolSize);
 
 				if(use_diagonal) {
 					uint32_t diagonal_group = (target_symbol + target_id) % k;
@@ -260,7 +269,7 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 						target_id = id;
 						target_symbol = symbol;
 					} else {
-						bitwiseXor(repair_symbol, repair_symbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+						srcs.push_back(tempBlock[id] + symbol * symbolSize);
 						if(need_diagonal_adjust[id][symbol]){
 							//debug("%" PRIu32 ":%" PRIu32 " toggles need adjustment\n", id, symbol);
 							cur_symbol_need_adjust = !cur_symbol_need_adjust;
@@ -269,7 +278,8 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 					id = (id - 1 + k) % k;
 					++symbol;
 				}
-				bitwiseXor(repair_symbol, repair_symbol, tempBlock[k + 1] + i * symbolSize, symbolSize);
+				srcs.push_back(tempBlock[k + 1] + i * symbolSize);
+				bitwiseXor(repair_symbol, srcs.data(), srcs.size(), symbolSize);
 
 				diagonal_clean[i] = diagonal_clean[i] != cur_symbol_need_adjust;
 
@@ -289,7 +299,7 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 			symbol = 0;
 			for(uint32_t i = 0; i < k - 1; ++i) {
 				if(disk_block_status[id][symbol]){
-					bitwiseXor(repair_symbol, repair_symbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+					srcs.push_back(tempBlock[id] + symbol * symbolSize);
 					if(need_diagonal_adjust[id][symbol]){
 						//debug("%" PRIu32 ":%" PRIu32 " toggles need adjustment\n", id, symbol);
 						cur_symbol_need_adjust = !cur_symbol_need_adjust;
@@ -301,6 +311,7 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 				--id;
 				++symbol;
 			}
+			bitwiseXor(repair_symbol, srcs.data(), srcs.size(), symbolSize);
 		}
 
 		if(target_id == (uint32_t)-1){
@@ -333,14 +344,16 @@ char** EvenOddCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_l
 			for(uint32_t i = 0; i < k - 1; ++i)
 				if(diagonal_clean[i] && (diagonal_group_erasure[i] == 0)){
 					//debug("Clean Diagonal Found at %" PRIu32 "\n", i);
-					memcpy(diagonal_adjuster, tempBlock[k + 1] + i * symbolSize, symbolSize);
+					srcs.clear();
+					srcs.push_back(tempBlock[k + 1] + i * symbolSize);
 					id = i;
 					symbol = 0;
 					for(uint32_t j = 0; j < k - 1; ++j){
-						bitwiseXor(diagonal_adjuster, diagonal_adjuster, tempBlock[id] + symbol * symbolSize, symbolSize);
+						srcs.push_back(tempBlock[id] + symbol * symbolSize);
 						id = (id - 1 + k) % k; 
 						symbol++;
 					} 
+					bitwiseXor(diagonal_adjuster, srcs.data(), srcs.size(), symbolSize);
 					break;
 				}
 		}
@@ -536,33 +549,32 @@ vector<BlockData> EvenOddCoding::repairBlocks(vector<uint32_t> repairBlockIdList
 
 		// Row Parity Block
 		if(targetBlock == k) {
-			for(uint32_t i = 0; i < k; ++i)
-				bitwiseXor(tempBlock[k], tempBlock[k], tempBlock[i], blockSize);
+			bitwiseXor(tempBlock[k], tempBlock, k, blockSize);
 		// Diagonal Parity Block
 		} else if(targetBlock == k + 1) {
 			// Reconstruct Diagonal Adjuster
-			char* diagonal_adjuster = MemoryPool::getInstance().poolMalloc(symbolSize);
+			char* diagonal_adjuster = MemoryPool::getInstance().poolMalloc(symbolSize, false);
+			vector<char*> srcs;
 			uint32_t id = k - 1;
 			uint32_t symbol = 0;
-			memcpy(diagonal_adjuster, tempBlock[id] + symbol * symbolSize, symbolSize);
-			--id;
-			++symbol;
-			for(uint32_t i = 1; i < k - 1; ++i) {
-				bitwiseXor(diagonal_adjuster, diagonal_adjuster, tempBlock[id] + symbol * symbolSize, symbolSize);
+			for(uint32_t i = 0; i < k - 1; ++i) {
+				srcs.push_back(tempBlock[id] + symbol * symbolSize);
 				--id;
 				++symbol;
 			} 
+			bitwiseXor(diagonal_adjuster, srcs.data(), srcs.size(), symbolSize);
 
 			for(uint32_t i = 0; i < k - 1; ++i) {
 				id = i;
 				symbol = 0;
-				char* targetSymbol = tempBlock[targetBlock] + i * symbolSize;
+				srcs.clear();
 				for(uint32_t j = 0; j < k - 1; ++j) {
-					bitwiseXor(targetSymbol, targetSymbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+					srcs.push_back(tempBlock[id] + symbol * symbolSize);
 					id = (id - 1 + k) % k;
 					++symbol;
 				}
-				bitwiseXor(targetSymbol, targetSymbol, diagonal_adjuster, symbolSize);
+				srcs.push_back(diagonal_adjuster);
+				bitwiseXor(tempBlock[targetBlock] + i * symbolSize, srcs.data(), srcs.size(), symbolSize);
 			}
 			MemoryPool::getInstance().poolFree(diagonal_adjuster);
 		}
@@ -0,0 +1,425 @@
+#include <string.h>
+#include "galoisregion.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GF_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+extern "C" {
+#include "../../lib/jerasure/galois.h"
+}
+
+/**
+ * Products of every multiplier with every low and high nibble
+ * table[c][x] = c * x, table[c][16 + x] = c * (x << 4)
+ */
+
+struct W08SplitTable {
+	uint8_t table[256][32] __attribute__((aligned(64)));
+
+	W08SplitTable() {
+		for (int c = 0; c < 256; c++) {
+			for (int x = 0; x < 16; x++) {
+				table[c][x] = galois_single_multiply(c, x, 8);
+				table[c][16 + x] = galois_single_multiply(c, x << 4, 8);
+			}
+		}
+	}
+};
+
+static const uint8_t* getSplitTable(int multiplier) {
+	static W08SplitTable splitTable; // built on first use
+	return splitTable.table[multiplier & 0xff];
+}
+
+// each kernel processes the multiple of its vector width it can and
+// returns the number of bytes done, the caller finishes the tail
+
+#ifdef GF_X86_KERNELS
+
+__attribute__((target("ssse3")))
+static uint32_t multiplySsse3(const uint8_t* src, uint8_t* dst, uint32_t size,
+		const uint8_t* table, bool accumulate) {
+	const __m128i lo = _mm_loadu_si128((const __m128i*) table);
+	const __m128i hi = _mm_loadu_si128((const __m128i*) (table + 16));
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	uint32_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i p = _mm_xor_si128(
+				_mm_shuffle_epi8(lo, _mm_and_si128(v, mask)),
+				_mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+		if (accumulate) {
+			p = _mm_xor_si128(p, _mm_loadu_si128((const __m128i*) (dst + i)));
+		}
+		_mm_storeu_si128((__m128i*) (dst + i), p);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static uint32_t multiplyAvx2(const uint8_t* src, uint8_t* dst, uint32_t size,
+		const uint8_t* table, bool accumulate) {
+	const __m256i lo = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) table));
+	const __m256i hi = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) (table + 16)));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	uint32_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i p = _mm256_xor_si256(
+				_mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask)),
+				_mm256_shuffle_epi8(hi,
+						_mm256_and_si256(_mm256_srli_epi64(v, 4), mask)));
+		if (accumulate) {
+			p = _mm256_xor_si256(p,
+					_mm256_loadu_si256((const __m256i*) (dst + i)));
+		}
+		_mm256_storeu_si256((__m256i*) (dst + i), p);
+	}
+	return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint32_t multiplyAvx512(const uint8_t* src, uint8_t* dst,
+		uint32_t size, const uint8_t* table, bool accumulate) {
+	// masked forms with a full mask, the unmasked broadcast, shuffle and
+	// shift pass an undefined vector and GCC 12 warns about it
+	__m512i lo = _mm512_castsi128_si512(
+			_mm_loadu_si128((const __m128i*) table));
+	lo = _mm512_mask_shuffle_i32x4(lo, (__mmask16) 0xffff, lo, lo, 0);
+	__m512i hi = _mm512_castsi128_si512(
+			_mm_loadu_si128((const __m128i*) (table + 16)));
+	hi = _mm512_mask_shuffle_i32x4(hi, (__mmask16) 0xffff, hi, hi, 0);
+	const __m512i mask = _mm512_set1_epi8(0x0f);
+	uint32_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		__m512i v = _mm512_loadu_si512((const void*) (src + i));
+		__m512i p = _mm512_xor_si512(
+				_mm512_shuffle_epi8(lo, _mm512_and_si512(v, mask)),
+				_mm512_shuffle_epi8(hi,
+						_mm512_and_si512(
+								_mm512_mask_srli_epi64(v, (__mmask8) 0xff, v,
+										4), mask)));
+		if (accumulate) {
+			p = _mm512_xor_si512(p, _mm512_loadu_si512((const void*) (dst + i)));
+		}
+		_mm512_storeu_si512((void*) (dst + i), p);
+	}
+	return i;
+}
+
+// XOR kernels work on [start, size), four vectors per pass over the
+// sources, and read all sources of a vector before storing it, so dst may
+// also be one of the sources
+
+__attribute__((target("sse2")))
+static uint32_t xorSse2(uint8_t* dst, const uint8_t* const* srcs,
+		uint32_t count, uint32_t start, uint32_t size, bool nonTemporal) {
+	uint32_t i = start;
+	for (; i + 64 <= size; i += 64) {
+		const __m128i* p = (const __m128i*) (srcs[0] + i);
+		__m128i v0 = _mm_loadu_si128(p);
+		__m128i v1 = _mm_loadu_si128(p + 1);
+		__m128i v2 = _mm_loadu_si128(p + 2);
+		__m128i v3 = _mm_loadu_si128(p + 3);
+		for (uint32_t j = 1; j < count; j++) {
+			p = (const __m128i*) (srcs[j] + i);
+			v0 = _mm_xor_si128(v0, _mm_loadu_si128(p));
+			v1 = _mm_xor_si128(v1, _mm_loadu_si128(p + 1));
+			v2 = _mm_xor_si128(v2, _mm_loadu_si128(p + 2));
+			v3 = _mm_xor_si128(v3, _mm_loadu_si128(p + 3));
+		}
+		__m128i* d = (__m128i*) (dst + i);
+		if (nonTemporal) {
+			_mm_stream_si128(d, v0);
+			_mm_stream_si128(d + 1, v1);
+			_mm_stream_si128(d + 2, v2);
+			_mm_stream_si128(d + 3, v3);
+		} else {
+			_mm_storeu_si128(d, v0);
+			_mm_storeu_si128(d + 1, v1);
+			_mm_storeu_si128(d + 2, v2);
+			_mm_storeu_si128(d + 3, v3);
+		}
+	}
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (srcs[0] + i));
+		for (uint32_t j = 1; j < count; j++) {
+			v = _mm_xor_si128(v, _mm_loadu_si128((const __m128i*) (srcs[j] + i)));
+		}
+		_mm_storeu_si128((__m128i*) (dst + i), v);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static uint32_t xorAvx2(uint8_t* dst, const uint8_t* const* srcs,
+		uint32_t count, uint32_t start, uint32_t size, bool nonTemporal) {
+	uint32_t i = start;
+	for (; i + 128 <= size; i += 128) {
+		const __m256i* p = (const __m256i*) (srcs[0] + i);
+		__m256i v0 = _mm256_loadu_si256(p);
+		__m256i v1 = _mm256_loadu_si256(p + 1);
+		__m256i v2 = _mm256_loadu_si256(p + 2);
+		__m256i v3 = _mm256_loadu_si256(p + 3);
+		for (uint32_t j = 1; j < count; j++) {
+			p = (const __m256i*) (srcs[j] + i);
+			v0 = _mm256_xor_si256(v0, _mm256_loadu_si256(p));
+			v1 = _mm256_xor_si256(v1, _mm256_loadu_si256(p + 1));
+			v2 = _mm256_xor_si256(v2, _mm256_loadu_si256(p + 2));
+			v3 = _mm256_xor_si256(v3, _mm256_loadu_si256(p + 3));
+		}
+		__m256i* d = (__m256i*) (dst + i);
+		if (nonTemporal) {
+			_mm256_stream_si256(d, v0);
+			_mm256_stream_si256(d + 1, v1);
+			_mm256_stream_si256(d + 2, v2);
+			_mm256_stream_si256(d + 3, v3);
+		} else {
+			_mm256_storeu_si256(d, v0);
+			_mm256_storeu_si256(d + 1, v1);
+			_mm256_storeu_si256(d + 2, v2);
+			_mm256_storeu_si256(d + 3, v3);
+		}
+	}
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (srcs[0] + i));
+		for (uint32_t j = 1; j < count; j++) {
+			v = _mm256_xor_si256(v,
+					_mm256_loadu_si256((const __m256i*) (srcs[j] + i)));
+		}
+		_mm256_storeu_si256((__m256i*) (dst + i), v);
+	}
+	return i;
+}
+
+__attribute__((target("avx512f")))
+static uint32_t xorAvx512(uint8_t* dst, const uint8_t* const* srcs,
+		uint32_t count, uint32_t start, uint32_t size, bool nonTemporal) {
+	uint32_t i = start;
+	for (; i + 256 <= size; i += 256) {
+		const __m512i* p = (const __m512i*) (srcs[0] + i);
+		__m512i v0 = _mm512_loadu_si512(p);
+		__m512i v1 = _mm512_loadu_si512(p + 1);
+		__m512i v2 = _mm512_loadu_si512(p + 2);
+		__m512i v3 = _mm512_loadu_si512(p + 3);
+		for (uint32_t j = 1; j < count; j++) {
+			p = (const __m512i*) (srcs[j] + i);
+			v0 = _mm512_xor_si512(v0, _mm512_loadu_si512(p));
+			v1 = _mm512_xor_si512(v1, _mm512_loadu_si512(p + 1));
+			v2 = _mm512_xor_si512(v2, _mm512_loadu_si512(p + 2));
+			v3 = _mm512_xor_si512(v3, _mm512_loadu_si512(p + 3));
+		}
+		__m512i* d = (__m512i*) (dst + i);
+		if (nonTemporal) {
+			_mm512_stream_si512(d, v0);
+			_mm512_stream_si512(d + 1, v1);
+			_mm512_stream_si512(d + 2, v2);
+			_mm512_stream_si512(d + 3, v3);
+		} else {
+			_mm512_storeu_si512(d, v0);
+			_mm512_storeu_si512(d + 1, v1);
+			_mm512_storeu_si512(d + 2, v2);
+			_mm512_storeu_si512(d + 3, v3);
+		}
+	}
+	for (; i + 64 <= size; i += 64) {
+		__m512i v = _mm512_loadu_si512((const void*) (srcs[0] + i));
+		for (uint32_t j = 1; j < count; j++) {
+			v = _mm512_xor_si512(v, _mm512_loadu_si512((const void*) (srcs[j] + i)));
+		}
+		_mm512_storeu_si512((void*) (dst + i), v);
+	}
+	return i;
+}
+
+#endif
+
+static uint32_t xorScalar(uint8_t* dst, const uint8_t* const* srcs,
+		uint32_t count, uint32_t start, uint32_t size) {
+	uint32_t i = start;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t v, s;
+		memcpy(&v, srcs[0] + i, sizeof(uint64_t));
+		for (uint32_t j = 1; j < count; j++) {
+			memcpy(&s, srcs[j] + i, sizeof(uint64_t));
+			v ^= s;
+		}
+		memcpy(dst + i, &v, sizeof(uint64_t));
+	}
+	for (; i < size; i++) {
+		uint8_t v = srcs[0][i];
+		for (uint32_t j = 1; j < count; j++) {
+			v ^= srcs[j][i];
+		}
+		dst[i] = v;
+	}
+	return i;
+}
+
+GaloisKernel GaloisRegion::getBestKernel() {
+	static GaloisKernel bestKernel = [] {
+		GaloisKernel kernel = GF_SCALAR_KERNEL;
+		for (int i = GF_SCALAR_KERNEL; i < GF_KERNEL_COUNT; i++) {
+			if (isKernelSupported((GaloisKernel) i)) {
+				kernel = (GaloisKernel) i;
+			}
+		}
+		debug("GF(2^8) region kernel = %s\n", getKernelName(kernel));
+		return kernel;
+	}();
+	return bestKernel;
+}
+
+bool GaloisRegion::isKernelSupported(GaloisKernel kernel) {
+	switch (kernel) {
+	case GF_SCALAR_KERNEL:
+		return true;
+#ifdef GF_X86_KERNELS
+	case GF_SSSE3_KERNEL:
+		return __builtin_cpu_supports("ssse3");
+	case GF_AVX2_KERNEL:
+		return __builtin_cpu_supports("avx2");
+	case GF_AVX512_KERNEL:
+		return __builtin_cpu_supports("avx512f")
+				&& __builtin_cpu_supports("avx512bw");
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GaloisRegion::getKernelName(GaloisKernel kernel) {
+	switch (kernel) {
+	case GF_SCALAR_KERNEL:
+		return "scalar";
+	case GF_SSSE3_KERNEL:
+		return "ssse3";
+	case GF_AVX2_KERNEL:
+		return "avx2";
+	case GF_AVX512_KERNEL:
+		return "avx512";
+	default:
+		return "unknown";
+	}
+}
+
+void GaloisRegion::w08RegionMultiply(const char* src, char* dst,
+		uint32_t size, int multiplier, bool accumulate, GaloisKernel kernel) {
+
+	const uint8_t* s = (const uint8_t*) src;
+	uint8_t* d = (uint8_t*) dst;
+	const uint8_t* table = getSplitTable(multiplier);
+	uint32_t done = 0;
+
+	switch (kernel) {
+#ifdef GF_X86_KERNELS
+	case GF_SSSE3_KERNEL:
+		done = multiplySsse3(s, d, size, table, accumulate);
+		break;
+	case GF_AVX2_KERNEL:
+		done = multiplyAvx2(s, d, size, table, accumulate);
+		break;
+	case GF_AVX512_KERNEL:
+		done = multiplyAvx512(s, d, size, table, accumulate);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	for (uint32_t i = done; i < size; i++) {
+		const uint8_t p = table[s[i] & 0x0f] ^ table[16 + (s[i] >> 4)];
+		d[i] = accumulate ? d[i] ^ p : p;
+	}
+}
+
+void GaloisRegion::w08Dotprod(int k, const int* matrixRow, const int* srcIds,
+		int destId, char** dataPtrs, char** codingPtrs, uint32_t size,
+		GaloisKernel kernel) {
+
+	char* dst = (destId < k) ? dataPtrs[destId] : codingPtrs[destId - k];
+	bool accumulate = false;
+
+	for (int i = 0; i < k; i++) {
+		if (matrixRow[i] == 0) {
+			continue;
+		}
+		const int id = (srcIds == NULL) ? i : srcIds[i];
+		const char* src = (id < k) ? dataPtrs[id] : codingPtrs[id - k];
+		w08RegionMultiply(src, dst, size, matrixRow[i], accumulate, kernel);
+		accumulate = true;
+	}
+
+	if (!accumulate) {
+		memset(dst, 0, size);
+	}
+}
+
+void GaloisRegion::xorRegions(char* dst, char* const* srcs, uint32_t count,
+		uint32_t size, GaloisKernel kernel) {
+
+	if (count == 0) {
+		memset(dst, 0, size);
+		return;
+	} else if (count == 1) {
+		if (srcs[0] != dst) {
+			memcpy(dst, srcs[0], size);
+		}
+		return;
+	}
+
+	uint8_t* d = (uint8_t*) dst;
+	const uint8_t* const* s = (const uint8_t* const*) srcs;
+	uint32_t done = 0;
+
+#ifdef GF_X86_KERNELS
+	uint32_t width = 0;
+	switch (kernel) {
+	case GF_SSSE3_KERNEL:
+		width = 16;
+		break;
+	case GF_AVX2_KERNEL:
+		width = 32;
+		break;
+	case GF_AVX512_KERNEL:
+		width = 64;
+		break;
+	default:
+		break;
+	}
+
+	// streaming stores need an aligned dst, do the head in scalar
+	const bool nonTemporal = (width > 0 && size >= XOR_NON_TEMPORAL_THRESHOLD);
+	if (nonTemporal) {
+		const uint32_t head = (width - ((uintptr_t) d & (width - 1)))
+				& (width - 1);
+		done = xorScalar(d, s, count, 0, head);
+	}
+
+	switch (kernel) {
+	case GF_SSSE3_KERNEL:
+		done = xorSse2(d, s, count, done, size, nonTemporal);
+		break;
+	case GF_AVX2_KERNEL:
+		done = xorAvx2(d, s, count, done, size, nonTemporal);
+		break;
+	case GF_AVX512_KERNEL:
+		done = xorAvx512(d, s, count, done, size, nonTemporal);
+		break;
+	default:
+		break;
+	}
+
+	if (nonTemporal) {
+		_mm_sfence();
+	}
+#endif
+
+	xorScalar(d, s, count, done, size);
+}
@@ -0,0 +1,95 @@
+#ifndef __GALOISREGION_HH__
+#define __GALOISREGION_HH__
+
+#include <stdint.h>
+
+/**
+ * Implementations of the GF(2^8) region multiply and XOR
+ * Ordered from the slowest to the fastest
+ */
+
+enum GaloisKernel {
+	GF_SCALAR_KERNEL, GF_SSSE3_KERNEL, GF_AVX2_KERNEL, GF_AVX512_KERNEL,
+	GF_KERNEL_COUNT
+};
+
+/**
+ * GF(2^w) region arithmetic: multi-source XOR (addition), and GF(2^8)
+ * multiplication using split (nibble) multiplication tables
+ * The SIMD kernels look up 16 / 32 / 64 products per pshufb, and all
+ * kernels produce exactly the same bytes as galois_w08_region_multiply()
+ * of Jerasure, since the tables are built with galois_single_multiply().
+ */
+
+class GaloisRegion {
+public:
+
+	/**
+	 * Get the fastest kernel supported by the running CPU
+	 * @return Kernel selected at first use
+	 */
+
+	static GaloisKernel getBestKernel();
+
+	/**
+	 * Check whether the running CPU supports a kernel
+	 * @param kernel Kernel to check
+	 * @return True if the kernel can be used
+	 */
+
+	static bool isKernelSupported(GaloisKernel kernel);
+
+	/**
+	 * Get the name of a kernel for printing
+	 * @param kernel Kernel
+	 * @return Name of the kernel
+	 */
+
+	static const char* getKernelName(GaloisKernel kernel);
+
+	/**
+	 * dst = multiplier * src, or dst ^= multiplier * src in GF(2^8)
+	 * @param src Source region
+	 * @param dst Destination region
+	 * @param size Number of bytes
+	 * @param multiplier Constant in GF(2^8)
+	 * @param accumulate XOR the product into dst instead of overwriting
+	 * @param kernel Implementation to use
+	 */
+
+	static void w08RegionMultiply(const char* src, char* dst, uint32_t size,
+			int multiplier, bool accumulate, GaloisKernel kernel);
+
+	/**
+	 * Same as jerasure_matrix_dotprod() for w = 8
+	 * Computes one block as the dot product of a matrix row and k blocks
+	 * @param k Number of source blocks
+	 * @param matrixRow k coefficients
+	 * @param srcIds IDs of the source blocks, NULL for data blocks 0 to k-1
+	 * @param destId ID of the destination block
+	 * @param dataPtrs Data block pointers
+	 * @param codingPtrs Parity block pointers
+	 * @param size Size of each block
+	 * @param kernel Implementation to use
+	 */
+
+	static void w08Dotprod(int k, const int* matrixRow, const int* srcIds,
+			int destId, char** dataPtrs, char** codingPtrs, uint32_t size,
+			GaloisKernel kernel);
+
+	/**
+	 * dst = srcs[0] ^ srcs[1] ^ ... ^ srcs[count - 1] in one pass
+	 * dst may be one of the sources. Results of XOR_NON_TEMPORAL_THRESHOLD
+	 * bytes or more are written with non-temporal stores.
+	 * @param dst Destination region
+	 * @param srcs Source regions
+	 * @param count Number of source regions
+	 * @param size Number of bytes
+	 * @param kernel Implementation to use
+	 */
+
+	static void xorRegions(char* dst, char* const* srcs, uint32_t count,
+			uint32_t size, GaloisKernel kernel);
+};
+
+#endif
@@ -117,10 +117,32 @@ vector<BlockData> Raid1Coding::repairBlocks(vector<uint32_t> repairBlockIdList,
 	return repairedBlockDataList;
 }
 
+bool Raid1Coding::canDecodeFromAnyBlocks() {
+	return true;
+}
+
 uint32_t Raid1Coding::getBlockCountFromSetting (string setting) {
 	return getParameters(setting);
 }
 
+block_list_t Raid1Coding::getRangeBlockSymbols(uint64_t offset,
+		uint32_t length, vector<bool> blockStatus, uint32_t segmentSize,
+		string setting) {
+
+	// every block is a full copy, read the range from any of them
+	if (offset >= segmentSize) {
+		return {};
+	}
+	length = min((uint64_t) length, segmentSize - offset);
+	for (uint32_t i = 0; i < blockStatus.size(); i++) {
+		if (blockStatus[i]) {
+			return {make_pair(i,
+					vector<offset_length_t> { make_pair(offset, length) })};
+		}
+	}
+	return {};
+}
+
 uint32_t Raid1Coding::getBlockSize(uint32_t segmentSize, string setting) {
 	return segmentSize;
 }
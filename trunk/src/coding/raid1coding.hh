@@ -23,6 +23,11 @@ public:
 			vector<BlockData> &blockData, block_list_t &symbolList,
 			uint32_t segmentSize, string setting);
 
+	block_list_t getRangeBlockSymbols(uint64_t offset, uint32_t length,
+			vector<bool> blockStatus, uint32_t segmentSize, string setting);
+
+	bool canDecodeFromAnyBlocks();
+
 	uint32_t getBlockCountFromSetting (string setting);
 
 	uint32_t getBlockSize(uint32_t segmentSize, string setting);
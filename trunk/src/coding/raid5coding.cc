@@ -43,7 +43,9 @@ vector<BlockData> Raid5Coding::encode(SegmentData segmentData, string setting) {
 	parityBlockData.info.segmentId = segmentData.info.segmentId;
 	parityBlockData.info.blockId = parityIndex;
 	parityBlockData.info.blockSize = stripeSize;
-	parityBlockData.buf = MemoryPool::getInstance().poolMalloc(stripeSize);
+	parityBlockData.buf = MemoryPool::getInstance().poolMalloc(stripeSize,
+			false);
+	vector<char*> dataBufs;
 
 	// for each data block
 	for (uint32_t i = 0; i < parityIndex; i++) {
@@ -67,18 +69,13 @@ vector<BlockData> Raid5Coding::encode(SegmentData segmentData, string setting) {
 			memcpy(blockData.buf, bufPos, stripeSize);
 
 		blockDataList.push_back(blockData);
-
-		// update parity block
-		if (i == 0) {
-			// first block: just copy
-			memcpy(parityBlockData.buf, blockData.buf, stripeSize);
-		} else {
-			// for second block onwards, do XOR
-			Coding::bitwiseXor(parityBlockData.buf, parityBlockData.buf,
-					blockData.buf, stripeSize);
-		}
+		dataBufs.push_back(blockData.buf);
 	}
 
+	// parity = XOR of all data blocks in one pass
+	Coding::bitwiseXor(parityBlockData.buf, dataBufs.data(), dataBufs.size(),
+			stripeSize);
+
 	// add parity block at the back
 	blockDataList.push_back(parityBlockData);
 
@@ -112,23 +109,16 @@ SegmentData Raid5Coding::decode(vector<BlockData> &blockDataList,
 
 	// if last block of blockIdList is the parity block, rebuild is needed
 	if (symbolList.back().first == parityIndex) {
-		rebuildBlockData.buf = MemoryPool::getInstance().poolMalloc(stripeSize);
+		rebuildBlockData.buf = MemoryPool::getInstance().poolMalloc(stripeSize,
+				false);
 
 		// rebuild
-		uint32_t i = 0;
+		vector<char*> srcBufs;
 		for (auto blockSymbols : symbolList) {
-			uint32_t blockId = blockSymbols.first;
-			if (i == 0) {
-				// memcpy first block
-				memcpy(rebuildBlockData.buf, blockDataList[blockId].buf,
-						stripeSize);
-			} else {
-				// XOR second block onwards
-				Coding::bitwiseXor(rebuildBlockData.buf, rebuildBlockData.buf,
-						blockDataList[blockId].buf, stripeSize);
-			}
-			i++;
+			srcBufs.push_back(blockDataList[blockSymbols.first].buf);
 		}
+		Coding::bitwiseXor(rebuildBlockData.buf, srcBufs.data(),
+				srcBufs.size(), stripeSize);
 
 		// write rebuildBlockData to BlockData
 		uint32_t repairedBlockIndex = 0;
@@ -268,22 +258,16 @@ vector<BlockData> Raid5Coding::repairBlocks(vector<uint32_t> repairBlockIdList,
 
 	struct BlockData rebuildBlockData;
 
-	rebuildBlockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);
+	rebuildBlockData.buf = MemoryPool::getInstance().poolMalloc(blockSize,
+			false);
 
 	// rebuild
-	uint32_t i = 0;
+	vector<char*> srcBufs;
 	for (auto block : symbolList) {
-		uint32_t blockId = block.first;
-		if (i == 0) {
-			// memcpy first block
-			memcpy(rebuildBlockData.buf, blockData[blockId].buf, blockSize);
-		} else {
-			// XOR second block onwards
-			Coding::bitwiseXor(rebuildBlockData.buf, rebuildBlockData.buf,
-					blockData[blockId].buf, blockSize);
-		}
-		i++;
+		srcBufs.push_back(blockData[block.first].buf);
 	}
+	Coding::bitwiseXor(rebuildBlockData.buf, srcBufs.data(), srcBufs.size(),
+			blockSize);
 
 	rebuildBlockData.info.blockId = repairBlockIdList[0];
 	rebuildBlockData.info.segmentId = blockData[symbolList[0].first].info.segmentId;
@@ -296,6 +280,10 @@ vector<BlockData> Raid5Coding::repairBlocks(vector<uint32_t> repairBlockIdList,
 	return {rebuildBlockData};
 }
 
+bool Raid5Coding::canDecodeFromAnyBlocks() {
+	return true;
+}
+
 uint32_t Raid5Coding::getBlockCountFromSetting (string setting) {
 	return getParameters(setting);
 }
@@ -87,13 +87,12 @@ vector<BlockData> RDPCoding::encode(SegmentData segmentData, string setting) {
 
 	for(uint32_t i = k; i < n; ++i) {
 		blockData.info.blockId = i;
-		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);		
+		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize, false);
 		blockDataList[i] = blockData;
 	}
 
-	uint32_t d_group;
+	vector<char*> dataBufs;
 	for(uint32_t i = 0; i < k; ++i) {
-		d_group = i;
 		blockData.info.blockId = i;
 		blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);		
 
@@ -109,29 +108,30 @@ vector<BlockData> RDPCoding::encode(SegmentData segmentData, string setting) {
 		} else
 			memcpy(blockData.buf, bufPos, blockSize);
 
-		// Compute Row Parity Block
-		if (i == 0) {
-			memcpy(blockDataList[k].buf, blockData.buf, blockSize);
-		} else {
-			bitwiseXor(blockDataList[k].buf, blockDataList[k].buf, blockData.buf, blockSize);
-		}
+		blockDataList[i] = blockData;
+		dataBufs.push_back(blockData.buf);
+	}
 
-		// Compute Diagonal Parity Block
-		for(uint32_t j = 0; j < k; ++j) {		
-			if(d_group == k) {
-				// Missing Diagonal
-			} else
-				bitwiseXor(blockDataList[k + 1].buf + d_group * symbolSize, blockDataList[k + 1].buf + d_group * symbolSize, blockData.buf + j * symbolSize, symbolSize);
+	// Compute Row Parity Block
+	bitwiseXor(blockDataList[k].buf, dataBufs.data(), k, blockSize);
 
-			d_group = (d_group + 1) % (k + 1);
+	// Compute Diagonal Parity Block
+	// Data symbol j of block i is on diagonal (i + j) % (k + 1), row parity
+	// symbol j on diagonal j - 1, diagonal k is missing
+	vector<char*> srcs;
+	for(uint32_t d_group = 0; d_group < k; ++d_group) {
+		srcs.clear();
+		for(uint32_t i = 0; i < k; ++i) {
+			const uint32_t j = (d_group + k + 1 - i) % (k + 1);
+			if (j < k)
+				srcs.push_back(blockDataList[i].buf + j * symbolSize);
 		}
-
-		blockDataList[i] = blockData;
+		if (d_group + 1 < k)
+			srcs.push_back(blockDataList[k].buf + (d_group + 1) * symbolSize);
+		bitwiseXor(blockDataList[k + 1].buf + d_group * symbolSize, srcs.data(),
+				srcs.size(), symbolSize);
 	}
 
-	// Adjust to Diagonal Parity
-	bitwiseXor(blockDataList[k+1].buf, blockDataList[k].buf + symbolSize , blockDataList[k+1].buf, (k - 1) * symbolSize);
-
 	//debug("Block Data List Count: %zu\n", blockDataList.size());
 	return blockDataList;
 }
@@ -193,7 +193,7 @@ char** RDPCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_list_
 	uint32_t symbol;
 	uint32_t target_id;
 	uint32_t target_symbol;
-	char* repair_symbol = MemoryPool::getInstance().poolMalloc(symbolSize);
+	vector<char*> srcs;
 	while(1) {
 		/*
 		for(uint32_t i = 0; i < k; ++i) {
@@ -207,7 +207,7 @@ char** RDPCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_list_
 
 		target_id = (uint32_t) - 1;
 		target_symbol = (uint32_t) - 1;
-		memset(repair_symbol, 0, symbolSize);
+		srcs.clear();
 		
 		for(uint32_t i = 0; i < k; ++i) {
 			// Fix by Row
@@ -219,7 +219,7 @@ char** RDPCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_list_
 						target_id = id;
 						target_symbol = symbol;
 					} else {
-						bitwiseXor(repair_symbol, repair_symbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+						srcs.push_back(tempBlock[id] + symbol * symbolSize);
 					}
 				}
 
@@ -240,7 +240,7 @@ char** RDPCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_list_
 						target_id = id;
 						target_symbol = symbol;
 					} else {
-						bitwiseXor(repair_symbol, repair_symbol, tempBlock[id] + symbol * symbolSize, symbolSize);
+						srcs.push_back(tempBlock[id] + symbol * symbolSize);
 					}
 					if (id == 0) id = k + 1;
 					else {
@@ -263,13 +263,12 @@ char** RDPCoding::repairDataBlocks(vector<BlockData> &blockDataList, block_list_
 		}
 
 		disk_block_status[target_id][target_symbol] = true;
-		memcpy(tempBlock[target_id] + target_symbol * symbolSize, repair_symbol, symbolSize);
+		bitwiseXor(tempBlock[target_id] + target_symbol * symbolSize, srcs.data(), srcs.size(), symbolSize);
 		--disk_block_erasure[target_id];
 		//debug("Disk %" PRIu32 " Erasure %" PRIu32 "\n", target_id, disk_block_erasure[target_id]);
 		if(disk_block_erasure[target_id] == 0)
 			--numOfFailedDisk;
 	}
-	MemoryPool::getInstance().poolFree(repair_symbol);
 	return tempBlock;
 }
 
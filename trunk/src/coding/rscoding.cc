@@ -5,16 +5,12 @@
 #include <string.h>
 #include "coding.hh"
 #include "rscoding.hh"
+#include "codingcontext.hh"
 #include "../common/debug.hh"
 #include "../common/blockdata.hh"
 #include "../common/segmentdata.hh"
 #include "../common/memorypool.hh"
 
-extern "C" {
-#include "../../lib/jerasure/jerasure.h"
-#include "../../lib/jerasure/reed_sol.h"
-}
-
 using namespace std;
 
 RSCoding::RSCoding() {
@@ -41,79 +37,32 @@ vector<BlockData> RSCoding::encode(SegmentData segmentData, string setting) {
 		exit(-1);
 	}
 
-	int *matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
-
-	char **data, **code;
-	data = talloc<char*, uint32_t>(k);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			RS_CODING, k, m, w);
 
+	// data and parity blocks are filled stripe by stripe in encodeSegment()
+	vector<char*> data(k), code(m);
 	for (uint32_t i = 0; i < k; i++) {
 		struct BlockData blockData;
 		blockData.info.segmentId = segmentData.info.segmentId;
 		blockData.info.blockId = i;
 		blockData.info.blockSize = size;
-
-		blockData.buf = MemoryPool::getInstance().poolMalloc(size);
-		char* bufPos = segmentData.buf + i * size;
-		
-		if (i * size >= segmentData.info.segLength) {
-			//Zero Padding
-		} else if ((i + 1) * size > segmentData.info.segLength) {
-			memcpy(blockData.buf, bufPos,
-					segmentData.info.segLength - i * size);
-			memset(blockData.buf + segmentData.info.segLength - i * size, 0,
-					(i + 1) * size - segmentData.info.segLength);
-		} else
-			memcpy(blockData.buf, bufPos, size);
-
-
-		/*
-		if (i == k - 1) {
-			//memset(blockData.buf, 0, size);
-			memcpy(blockData.buf, bufPos,
-					segmentData.info.segmentSize - i * size);
-			memset(blockData.buf + segmentData.info.segmentSize - i * size, 0,
-					k * size - segmentData.info.segmentSize);
-		} else
-			memcpy(blockData.buf, bufPos, size);
-		*/
-
+		blockData.buf = MemoryPool::getInstance().poolMalloc(size, false);
 		data[i] = blockData.buf;
-		//data[i] = talloc<char, uint32_t>(size);
-		//memcpy(data[i], blockData.buf, size);
-
 		blockDataList.push_back(blockData);
 	}
-
-	if (m == 0){
-		tfree(data);
-		free(matrix);
-		return blockDataList;
-	}
-
-	code = talloc<char*, uint32_t>(m);
-	for (uint32_t i = 0; i < m; i++) {
-		code[i] = talloc<char, uint32_t>(size);
-	}
-
-	jerasure_matrix_encode(k, m, w, matrix, data, code, size);
-
 	for (uint32_t i = 0; i < m; i++) {
 		struct BlockData blockData;
 		blockData.info.segmentId = segmentData.info.segmentId;
 		blockData.info.blockId = k + i;
 		blockData.info.blockSize = size;
-
-		blockData.buf = code[i];
-		//blockData.buf = MemoryPool::getInstance().poolMalloc(size);
-		//memcpy(blockData.buf, code[i], size);
-
+		blockData.buf = MemoryPool::getInstance().poolMalloc(size, false);
+		code[i] = blockData.buf;
 		blockDataList.push_back(blockData);
 	}
 
-	// free memory
-	tfree(data);
-	tfree(code);
-	free(matrix);
+	CodingContextCache::getInstance().encodeSegment(context, segmentData.buf,
+			segmentData.info.segLength, data.data(), code.data(), size);
 
 	return blockDataList;
 }
@@ -175,14 +124,13 @@ SegmentData RSCoding::decode(vector<BlockData> &blockDataList,
 		return segmentData;
 	}
 
-	int *matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			RS_CODING, k, m, w);
 	char **data, **code;
-	int *erasures;
-	int j = 0;
+	vector<int> erasures;
 
 	data = talloc<char*, uint32_t>(k);
 	code = talloc<char*, uint32_t>(m);
-	erasures = talloc<int, uint32_t>(k + m - blockIdList.size() + 1);
 
 	for (uint32_t i = 0; i < k + m; i++) {
 		i < k ? data[i] = talloc<char, uint32_t>(size) : code[i - k] =
@@ -191,12 +139,12 @@ SegmentData RSCoding::decode(vector<BlockData> &blockDataList,
 			i < k ? memcpy(data[i], blockDataList[i].buf, size) : 
 				memcpy(code[i - k], blockDataList[i].buf, size);
 		} else {
-			erasures[j++] = i;
+			erasures.push_back(i);
 		}
 	}
-	erasures[j] = -1;
 
-	jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, code, size);
+	CodingContextCache::getInstance().decode(context, erasures, data, code,
+			size);
 
 	/*
 	for (uint32_t i = 0; i < k + m - blockIdList.size(); i++) {
@@ -232,8 +180,6 @@ SegmentData RSCoding::decode(vector<BlockData> &blockDataList,
 		tfree(code[i]);
 	}
 	tfree(code);
-	tfree(erasures);
-	tfree(matrix);
 
 	return segmentData;
 }
@@ -326,14 +272,13 @@ vector<BlockData> RSCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 	set<uint32_t> blockIdListSet(blockIdList.begin(), blockIdList.end());
 
 	//if (blockIdList.size() != k + m) {
-	int *matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			RS_CODING, k, m, w);
 	char **data, **code;
-	int *erasures;
-	int j = 0;
+	vector<int> erasures;
 
 	data = talloc<char*, uint32_t>(k);
 	code = talloc<char*, uint32_t>(m);
-	erasures = talloc<int, uint32_t>(k + m - blockIdList.size() + 1);
 
 	for (uint32_t i = 0; i < k + m; i++) {
 		i < k ? data[i] = talloc<char, uint32_t>(size) : code[i - k] =
@@ -344,12 +289,12 @@ vector<BlockData> RSCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 			i < k ? memcpy(data[i], blockData[i].buf, size) : memcpy(
 					code[i - k], blockData[i].buf, size);
 		} else {
-			erasures[j++] = i;
+			erasures.push_back(i);
 		}
 	}
-	erasures[j] = -1;
 
-	jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, code, size);
+	CodingContextCache::getInstance().decode(context, erasures, data, code,
+			size);
 
 	for (uint32_t i = 0; i < repairBlockIdList.size(); i++) {
 		struct BlockData temp;
@@ -378,14 +323,15 @@ vector<BlockData> RSCoding::repairBlocks(vector<uint32_t> repairBlockIdList,
 		tfree(code[i]);
 	}
 	tfree(code);
-
-	free(matrix);
-	tfree(erasures);
 	//}
 
 	return ret;
 }
 
+bool RSCoding::canDecodeFromAnyBlocks() {
+	return true;
+}
+
 uint32_t RSCoding::getBlockCountFromSetting(string setting) {
 	vector<uint32_t> params = getParameters(setting);
 	const uint32_t k = params[0];
@@ -458,12 +404,5 @@ vector<BlockData> RSCoding::computeDelta(BlockData oldBlock, BlockData newBlock,
 //
 
 vector<uint32_t> RSCoding::getParameters(string setting) {
-	vector<uint32_t> params(3);
-	int i = 0;
-	string token;
-	stringstream stream(setting);
-	while (getline(stream, token, ':')) {
-		istringstream(token) >> params[i++];
-	}
-	return params;
+	return CodingContextCache::getInstance().getParameters(setting, 3);
 }
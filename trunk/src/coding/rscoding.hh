@@ -24,6 +24,8 @@ public:
 			vector<BlockData> &blockData, block_list_t &symbolList,
 			uint32_t segmentSize, string setting);
 
+	bool canDecodeFromAnyBlocks();
+
 	uint32_t getBlockCountFromSetting (string setting);
 
 	uint32_t getParityCountFromSetting (string setting);
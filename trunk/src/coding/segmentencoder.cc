@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <string.h>
+#include "segmentencoder.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+#include "../common/memorypool.hh"
+
+using namespace std;
+
+static uint32_t roundUp(uint32_t numToRound, uint32_t multiple) {
+	return (numToRound + multiple - 1) / multiple * multiple;
+}
+
+bool SegmentEncoder::isSupported(CodingScheme codingScheme) {
+	return codingScheme == RS_CODING || codingScheme == CAUCHY;
+}
+
+SegmentEncoder::SegmentEncoder(CodingScheme codingScheme, string setting,
+		uint32_t segLength) :
+		_completeStripes(0) {
+
+	CodingContextCache& cache = CodingContextCache::getInstance();
+	const vector<uint32_t> params = cache.getParameters(setting, 3);
+	_k = params[0];
+	_m = params[1];
+	const uint32_t w = params[2];
+
+	// same block sizes as RSCoding::encode() and CauchyCoding::encode()
+	if (codingScheme == RS_CODING) {
+		_packetSize = 0;
+		_blockSize = roundUp(roundUp(segLength, _k) / _k, 4);
+		_packet = _blockSize;
+		_packetCount = 1;
+	} else if (codingScheme == CAUCHY) {
+		_packetSize = roundUp(roundUp(segLength, _k * w) / (_k * w), 4);
+		_blockSize = _packetSize * w;
+		_packet = _packetSize;
+		_packetCount = w;
+	} else {
+		debug_error("Coding scheme %d cannot be streamed\n", codingScheme);
+		exit(-1);
+	}
+	_groupSize = _packet * _packetCount;
+	_context = cache.getContext(codingScheme, _k, _m, w);
+
+	_data = MemoryPool::getInstance().poolMalloc(_k * _blockSize, false);
+	memset(_data + segLength, 0, _k * _blockSize - segLength);
+	for (uint32_t i = 0; i < _m; i++) {
+		_code.push_back(MemoryPool::getInstance().poolMalloc(_blockSize));
+	}
+
+	_stripes = cache.getStripes(_context, _blockSize, _packetSize,
+			STREAM_STRIPE_SIZE);
+	_stripesPerGroup = 0;
+	while (_stripesPerGroup < _stripes.size()
+			&& _stripes[_stripesPerGroup].firstGroup == 0) {
+		_stripesPerGroup++;
+	}
+	_remaining = new atomic<uint32_t>[_k * _stripes.size()];
+	_stripeMutex = new mutex[_stripes.size()];
+	_addedBlocks = new uint32_t[_stripes.size()];
+
+	// count the bytes each data block is waiting for, pieces in the
+	// padding are complete already
+	vector<BlockPiece> pieces;
+	for (uint32_t s = 0; s < _stripes.size(); s++) {
+		_addedBlocks[s] = 0;
+		for (uint32_t i = 0; i < _k; i++) {
+			const uint64_t blockStart = (uint64_t) i * _blockSize;
+			const uint32_t realLength =
+					(segLength > blockStart) ?
+							(uint32_t) min((uint64_t) _blockSize,
+									segLength - blockStart) :
+							0;
+			pieces.clear();
+			addPieces(i, s, pieces);
+			uint32_t missing = 0;
+			for (BlockPiece& piece : pieces) {
+				if (piece.offset < realLength) {
+					missing += min(piece.length, realLength - piece.offset);
+				}
+			}
+			_remaining[i * _stripes.size() + s] = missing;
+		}
+	}
+	for (uint32_t s = 0; s < _stripes.size(); s++) {
+		for (uint32_t i = 0; i < _k; i++) {
+			if (_remaining[i * _stripes.size() + s] == 0) {
+				completeBlockStripe(i, s, true, _paddingPieces);
+			}
+		}
+	}
+}
+
+SegmentEncoder::~SegmentEncoder() {
+	MemoryPool::getInstance().poolFree(_data);
+	for (char* code : _code) {
+		MemoryPool::getInstance().poolFree(code);
+	}
+	delete[] _remaining;
+	delete[] _stripeMutex;
+	delete[] _addedBlocks;
+}
+
+vector<BlockPiece> SegmentEncoder::write(const char* buf, uint64_t offset,
+		uint32_t length) {
+
+	vector<BlockPiece> pieces;
+	while (length > 0) {
+		const uint32_t blockId = offset / _blockSize;
+		uint32_t runLength;
+		const uint32_t stripeId = findStripe(offset % _blockSize, runLength);
+		runLength = min(runLength, length);
+
+		memcpy(_data + offset, buf, runLength);
+
+		// the thread that writes the last bytes encodes the stripe
+		if (_remaining[blockId * _stripes.size() + stripeId].fetch_sub(
+				runLength) == runLength) {
+			completeBlockStripe(blockId, stripeId, false, pieces);
+		}
+
+		buf += runLength;
+		offset += runLength;
+		length -= runLength;
+	}
+	return pieces;
+}
+
+vector<BlockPiece> SegmentEncoder::getPaddingPieces() {
+	return _paddingPieces;
+}
+
+uint32_t SegmentEncoder::getPieceCount(uint32_t blockId) {
+	vector<BlockPiece> pieces;
+	for (uint32_t s = 0; s < _stripes.size(); s++) {
+		addPieces(blockId, s, pieces);
+	}
+	return pieces.size();
+}
+
+bool SegmentEncoder::isComplete() {
+	return _completeStripes == _stripes.size();
+}
+
+uint32_t SegmentEncoder::getBlockCount() {
+	return _k + _m;
+}
+
+uint32_t SegmentEncoder::getParityCount() {
+	return _m;
+}
+
+uint32_t SegmentEncoder::getBlockSize() {
+	return _blockSize;
+}
+
+char* SegmentEncoder::getBlock(uint32_t blockId) {
+	if (blockId < _k) {
+		return _data + (uint64_t) blockId * _blockSize;
+	}
+	return _code[blockId - _k];
+}
+
+//
+// PRIVATE FUNCTION
+//
+
+/**
+ * Find the stripe that holds a byte of a block
+ * @param pos Offset in the block
+ * @param runLength Bytes from pos that belong to the same stripe
+ * @return Index of the stripe
+ */
+
+uint32_t SegmentEncoder::findStripe(uint32_t pos, uint32_t& runLength) {
+	const uint32_t group = pos / _groupSize;
+	const uint32_t posInPacket = pos % _packet;
+	const CodingStripe& first = _stripes[0];
+	const uint32_t stripeId = (group / first.groupCount) * _stripesPerGroup
+			+ posInPacket / first.length;
+	const CodingStripe& stripe = _stripes[stripeId];
+	if (stripe.length < _packet) {
+		runLength = stripe.offset + stripe.length - posInPacket;
+	} else {
+		runLength = (stripe.firstGroup + stripe.groupCount) * _groupSize - pos;
+	}
+	return stripeId;
+}
+
+void SegmentEncoder::addPieces(uint32_t blockId, uint32_t stripeId,
+		vector<BlockPiece>& pieces) {
+	const CodingStripe& stripe = _stripes[stripeId];
+	const uint32_t start = stripe.firstGroup * _groupSize;
+	if (stripe.length == _packet) {
+		pieces.push_back( { blockId, start, stripe.groupCount * _groupSize });
+		return;
+	}
+	for (uint32_t p = 0; p < _packetCount; p++) {
+		pieces.push_back( { blockId, start + p * _packet + stripe.offset,
+				stripe.length });
+	}
+}
+
+void SegmentEncoder::completeBlockStripe(uint32_t blockId, uint32_t stripeId,
+		bool isPadding, vector<BlockPiece>& pieces) {
+	lock_guard<mutex> lk(_stripeMutex[stripeId]);
+
+	// zero padding adds nothing to the parity
+	if (!isPadding) {
+		CodingContextCache::getInstance().encodeBlockStripe(_context,
+				_stripes[stripeId], blockId, getBlock(blockId), _code.data(),
+				_blockSize, _packetSize);
+	}
+	addPieces(blockId, stripeId, pieces);
+
+	if (++_addedBlocks[stripeId] == _k) {
+		for (uint32_t i = 0; i < _m; i++) {
+			addPieces(_k + i, stripeId, pieces);
+		}
+		_completeStripes++;
+	}
+}
@@ -0,0 +1,134 @@
+#ifndef __SEGMENT_ENCODER_HH__
+#define __SEGMENT_ENCODER_HH__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "codingcontext.hh"
+#include "../common/enums.hh"
+
+using namespace std;
+
+/**
+ * Bytes [offset, offset + length) of a block that can be sent
+ */
+
+struct BlockPiece {
+	uint32_t blockId;
+	uint32_t offset;
+	uint32_t length;
+};
+
+/**
+ * Encodes a segment while its chunks arrive, in any order
+ *
+ * Data block i is bytes [i * blockSize, (i + 1) * blockSize) of the
+ * segment, so chunks are copied straight into the data blocks. The blocks
+ * are split into the stripes of CodingContextCache. Once a data block has
+ * all its bytes of a stripe, its contribution is added to the parity of
+ * that stripe and the piece can be sent. Once all k data blocks of a
+ * stripe are added, the parity pieces of the stripe can be sent too.
+ * Only RS_CODING and CAUCHY, whose parity is linear in each data block.
+ */
+
+class SegmentEncoder {
+public:
+
+	/**
+	 * Check if a coding scheme can be encoded while chunks arrive
+	 * @param codingScheme Coding scheme
+	 * @return true for RS_CODING and CAUCHY
+	 */
+
+	static bool isSupported(CodingScheme codingScheme);
+
+	/**
+	 * Constructor, allocates zero filled blocks
+	 * @param codingScheme Coding scheme, see isSupported()
+	 * @param setting Coding setting
+	 * @param segLength Segment length
+	 */
+
+	SegmentEncoder(CodingScheme codingScheme, string setting,
+			uint32_t segLength);
+
+	/**
+	 * Destructor, frees the blocks
+	 */
+
+	~SegmentEncoder();
+
+	/**
+	 * Copy a chunk of the segment and encode the stripes it completes
+	 * Chunks must not overlap
+	 * @param buf Chunk
+	 * @param offset Offset of the chunk in the segment
+	 * @param length Length of the chunk
+	 * @return Pieces of data and parity blocks completed by the chunk
+	 */
+
+	vector<BlockPiece> write(const char* buf, uint64_t offset,
+			uint32_t length);
+
+	/**
+	 * Get the pieces that are complete before any chunk arrives
+	 * They only hold the zero padding after the end of the segment
+	 * @return Pieces of data and parity blocks
+	 */
+
+	vector<BlockPiece> getPaddingPieces();
+
+	/**
+	 * Get the number of pieces each block is sent in
+	 * @param blockId Block ID
+	 * @return Number of pieces
+	 */
+
+	uint32_t getPieceCount(uint32_t blockId);
+
+	/**
+	 * Check if every stripe of every block is complete
+	 * @return true if all chunks have been written
+	 */
+
+	bool isComplete();
+
+	uint32_t getBlockCount();
+	uint32_t getParityCount();
+	uint32_t getBlockSize();
+	char* getBlock(uint32_t blockId);
+
+private:
+	SegmentEncoder(SegmentEncoder const&); // Don't Implement
+	void operator=(SegmentEncoder const&); // Don't implement
+
+	uint32_t findStripe(uint32_t pos, uint32_t& runLength);
+	void addPieces(uint32_t blockId, uint32_t stripeId,
+			vector<BlockPiece>& pieces);
+	void completeBlockStripe(uint32_t blockId, uint32_t stripeId,
+			bool isPadding, vector<BlockPiece>& pieces);
+
+	CodingContext* _context;
+	uint32_t _k;
+	uint32_t _m;
+	uint32_t _blockSize;
+	uint32_t _packetSize; // bitmatrix codes only
+	uint32_t _packet; // bytes of a block per packet
+	uint32_t _groupSize; // bytes of a block per group of packets
+	uint32_t _packetCount; // packets per group
+
+	char* _data; // k data blocks back to back
+	vector<char*> _code;
+
+	vector<CodingStripe> _stripes;
+	uint32_t _stripesPerGroup;
+	atomic<uint32_t>* _remaining; // bytes missing per data block and stripe
+	mutex* _stripeMutex; // one contribution per stripe at a time
+	uint32_t* _addedBlocks; // data blocks added, guarded by _stripeMutex
+	atomic<uint32_t> _completeStripes;
+	vector<BlockPiece> _paddingPieces;
+};
+
+#endif
@@ -18,6 +18,7 @@
 #include "../common/convertor.hh"
 #include "../common/debug.hh"
 #include "docoding.hh"
+#include "microbench.hh"
 
 using namespace std;
 
@@ -38,6 +39,14 @@ void printUsage() {
 		<< endl;
 	cout << "Repair: ./coding_tester repair [SEGMENT_ID] [SEGMENT_SIZE]"
 		<< endl;
+	cout << "Memory Pool Bench: ./coding_tester mempool [SIZE] [ITERATION] (THREADS)"
+		<< endl;
+	cout << "GF Kernel Bench: ./coding_tester gfbench [K] [M] [W] [BLOCK_SIZE] (ITERATION)"
+		<< endl;
+	cout << "XOR Kernel Bench: ./coding_tester xorbench [SOURCES] [SIZE] (ITERATION)"
+		<< endl;
+	cout << "Concurrent Map Bench: ./coding_tester mapbench [THREADS] [KEYS] (ITERATION)"
+		<< endl;
 }
 
 void printOsdStatus(vector<bool> secondaryOsdStatus) {
@@ -172,11 +181,45 @@ uint32_t readConfig(const char* configFile) {
 int main(int argc, char* argv[]) {
 
 	// check arguments
-	if (argc < 3 || argc > 5) {
+	if (argc < 3 || argc > 7) {
 		printUsage();
 		exit(0);
 	}
 
+	// micro benchmarks do not need the config file
+	if (string(argv[1]) == "mempool") {
+		const uint32_t size = stringToByte(argv[2]);
+		const uint32_t iteration = argc > 3 ? atoi(argv[3]) : 100000;
+		const uint32_t numThreads = argc > 4 ? atoi(argv[4]) : 1;
+		doMemoryPoolBench(size, iteration, numThreads);
+		return 0;
+	} else if (string(argv[1]) == "gfbench") {
+		if (argc < 6) {
+			printUsage();
+			exit(-1);
+		}
+		const uint32_t iteration = argc > 6 ? atoi(argv[6]) : 100;
+		doGaloisBench(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]),
+				stringToByte(argv[5]), iteration);
+		return 0;
+	} else if (string(argv[1]) == "xorbench") {
+		if (argc < 4) {
+			printUsage();
+			exit(-1);
+		}
+		const uint32_t iteration = argc > 4 ? atoi(argv[4]) : 100;
+		doXorBench(atoi(argv[2]), stringToByte(argv[3]), iteration);
+		return 0;
+	} else if (string(argv[1]) == "mapbench") {
+		if (argc < 4) {
+			printUsage();
+			exit(-1);
+		}
+		const uint32_t iteration = argc > 4 ? atoi(argv[4]) : 1000000;
+		doConcurrentMapBench(atoi(argv[2]), atoi(argv[3]), iteration);
+		return 0;
+	}
+
 	// read config file
 	configLayer = new ConfigLayer("coding_tester_config.xml");
 	uint32_t numBlocks = readConfig("coding_tester_config.xml");
@@ -0,0 +1,372 @@
+/*
+ * microbench.cc
+ */
+
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include "microbench.hh"
+#include "../common/memorypool.hh"
+#include "../datastructure/concurrenthashmap.hh"
+#include "../coding/codingcontext.hh"
+#include "../coding/galoisregion.hh"
+
+extern "C" {
+#include "../../lib/jerasure/jerasure.h"
+#include "../../lib/jerasure/reed_sol.h"
+}
+
+using namespace std;
+
+typedef chrono::high_resolution_clock Clock;
+typedef chrono::microseconds microseconds;
+
+// number of buffers alive at the same time in each thread
+#define BENCH_LIVE_BUFFERS 16
+
+enum AllocMode {
+	CALLOC_MODE, POOL_MODE, POOL_NO_ZERO_MODE
+};
+
+static void allocLoop(AllocMode mode, uint32_t size, uint32_t iteration) {
+	char* bufs[BENCH_LIVE_BUFFERS];
+	for (uint32_t i = 0; i < iteration; i += BENCH_LIVE_BUFFERS) {
+		for (uint32_t j = 0; j < BENCH_LIVE_BUFFERS; j++) {
+			if (mode == CALLOC_MODE) {
+				bufs[j] = (char*) calloc(size, 1);
+			} else {
+				bufs[j] = MemoryPool::getInstance().poolMalloc(size,
+						mode == POOL_MODE);
+			}
+			// touch the first and last byte like a real user would
+			bufs[j][0] = (char) j;
+			bufs[j][size - 1] = (char) j;
+		}
+		for (uint32_t j = 0; j < BENCH_LIVE_BUFFERS; j++) {
+			if (mode == CALLOC_MODE) {
+				free(bufs[j]);
+			} else {
+				MemoryPool::getInstance().poolFree(bufs[j]);
+			}
+		}
+	}
+}
+
+static double runAlloc(AllocMode mode, uint32_t size, uint32_t iteration,
+		uint32_t numThreads) {
+	Clock::time_point tStart = Clock::now();
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; i++) {
+		threads.push_back(thread(allocLoop, mode, size, iteration));
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+	Clock::time_point tEnd = Clock::now();
+	return chrono::duration_cast < microseconds > (tEnd - tStart).count();
+}
+
+void doMemoryPoolBench(uint32_t size, uint32_t iteration, uint32_t numThreads) {
+	const char* modeName[] = { "calloc", "poolMalloc", "poolMalloc(no zero)" };
+	const double totalOps = (double) iteration * numThreads;
+
+	// warm up the pool so that the arenas and caches exist
+	runAlloc(POOL_MODE, size, BENCH_LIVE_BUFFERS, numThreads);
+
+	cout << "Size = " << size << " Iteration = " << iteration << " Threads = "
+			<< numThreads << endl;
+	cout << fixed << setprecision(2);
+	for (int mode = CALLOC_MODE; mode <= POOL_NO_ZERO_MODE; mode++) {
+		double duration = runAlloc((AllocMode) mode, size, iteration,
+				numThreads);
+		cout << setw(20) << modeName[mode] << ": " << duration / 1000.0
+				<< " ms " << totalOps / duration << " Mops/s "
+				<< duration * 1000.0 / totalOps << " ns/op" << endl;
+	}
+
+	MemoryPool::getInstance().printStats();
+}
+
+static void printThroughput(const string& name, uint64_t dataBytes,
+		double duration, bool isIdentical) {
+	cout << setw(20) << name << ": " << duration / 1000.0 << " ms "
+			<< dataBytes / duration / 1000.0 << " GB/s"
+			<< (isIdentical ? "" : " [OUTPUT MISMATCH]") << endl;
+}
+
+void doGaloisBench(uint32_t k, uint32_t m, uint32_t w, uint32_t size,
+		uint32_t iteration) {
+
+	// Cauchy needs the size to be a multiple of w packets
+	size -= size % (w * sizeof(long));
+	uint32_t packetSize = 2048;
+	while (size > 0 && (size / w) % packetSize != 0) {
+		packetSize /= 2;
+	}
+	if (k == 0 || m == 0 || size == 0) {
+		cout << "Bad Parameters" << endl;
+		return;
+	}
+
+	vector<char*> data(k), code(m), reference(m);
+	for (uint32_t i = 0; i < k; i++) {
+		data[i] = MemoryPool::getInstance().poolMalloc(size, false);
+		for (uint32_t j = 0; j < size; j++) {
+			data[i][j] = (char) rand();
+		}
+	}
+	for (uint32_t i = 0; i < m; i++) {
+		code[i] = MemoryPool::getInstance().poolMalloc(size);
+		reference[i] = MemoryPool::getInstance().poolMalloc(size);
+	}
+	const uint64_t dataBytes = (uint64_t) k * size * iteration;
+
+	cout << "k = " << k << " m = " << m << " w = " << w << " Block Size = "
+			<< size << " Iteration = " << iteration << endl;
+	cout << fixed << setprecision(2);
+
+	// Jerasure is the reference output
+	int* matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
+	Clock::time_point tStart = Clock::now();
+	for (uint32_t n = 0; n < iteration; n++) {
+		jerasure_matrix_encode(k, m, w, matrix, data.data(), reference.data(),
+				size);
+	}
+	double duration = chrono::duration_cast < microseconds
+			> (Clock::now() - tStart).count();
+	printThroughput("jerasure", dataBytes, duration, true);
+
+	for (int kernel = GF_SCALAR_KERNEL; w == 8 && kernel < GF_KERNEL_COUNT;
+			kernel++) {
+		if (!GaloisRegion::isKernelSupported((GaloisKernel) kernel)) {
+			continue;
+		}
+		tStart = Clock::now();
+		for (uint32_t n = 0; n < iteration; n++) {
+			for (uint32_t i = 0; i < m; i++) {
+				GaloisRegion::w08Dotprod(k, matrix + i * k, NULL, k + i,
+						data.data(), code.data(), size, (GaloisKernel) kernel);
+			}
+		}
+		duration = chrono::duration_cast < microseconds
+				> (Clock::now() - tStart).count();
+
+		bool isIdentical = true;
+		for (uint32_t i = 0; i < m; i++) {
+			isIdentical &= (memcmp(code[i], reference[i], size) == 0);
+		}
+		printThroughput(GaloisRegion::getKernelName((GaloisKernel) kernel),
+				dataBytes, duration, isIdentical);
+	}
+	free(matrix);
+
+	// Cauchy RS is XOR-only, shown for comparison
+	CodingContext* context = CodingContextCache::getInstance().getContext(
+			CAUCHY, k, m, w);
+	tStart = Clock::now();
+	for (uint32_t n = 0; n < iteration; n++) {
+		CodingContextCache::getInstance().encode(context, data.data(),
+				code.data(), size, packetSize);
+	}
+	duration = chrono::duration_cast < microseconds
+			> (Clock::now() - tStart).count();
+	printThroughput("cauchy", dataBytes, duration, true);
+
+	for (uint32_t i = 0; i < k; i++) {
+		MemoryPool::getInstance().poolFree(data[i]);
+	}
+	for (uint32_t i = 0; i < m; i++) {
+		MemoryPool::getInstance().poolFree(code[i]);
+		MemoryPool::getInstance().poolFree(reference[i]);
+	}
+}
+
+void doXorBench(uint32_t srcCount, uint32_t size, uint32_t iteration) {
+
+	if (srcCount == 0 || size == 0) {
+		cout << "Bad Parameters" << endl;
+		return;
+	}
+
+	vector<char*> srcs(srcCount);
+	for (uint32_t i = 0; i < srcCount; i++) {
+		srcs[i] = MemoryPool::getInstance().poolMalloc(size, false);
+		for (uint32_t j = 0; j < size; j++) {
+			srcs[i][j] = (char) rand();
+		}
+	}
+	char* result = MemoryPool::getInstance().poolMalloc(size);
+	char* reference = MemoryPool::getInstance().poolMalloc(size);
+	const uint64_t dataBytes = (uint64_t) srcCount * size * iteration;
+
+	cout << "Sources = " << srcCount << " Size = " << size << " Iteration = "
+			<< iteration << endl;
+	cout << fixed << setprecision(2);
+
+	// one source at a time, word by word
+	Clock::time_point tStart = Clock::now();
+	for (uint32_t n = 0; n < iteration; n++) {
+		memcpy(reference, srcs[0], size);
+		for (uint32_t i = 1; i < srcCount; i++) {
+			uint64_t* dst64 = (uint64_t*) reference;
+			const uint64_t* src64 = (const uint64_t*) srcs[i];
+			for (uint32_t j = 0; j < size / sizeof(uint64_t); j++) {
+				dst64[j] ^= src64[j];
+			}
+			for (uint32_t j = size - size % sizeof(uint64_t); j < size; j++) {
+				reference[j] ^= srcs[i][j];
+			}
+		}
+	}
+	double duration = chrono::duration_cast < microseconds
+			> (Clock::now() - tStart).count();
+	printThroughput("pairwise", dataBytes, duration, true);
+
+	for (int kernel = GF_SCALAR_KERNEL; kernel < GF_KERNEL_COUNT; kernel++) {
+		if (!GaloisRegion::isKernelSupported((GaloisKernel) kernel)) {
+			continue;
+		}
+		tStart = Clock::now();
+		for (uint32_t n = 0; n < iteration; n++) {
+			GaloisRegion::xorRegions(result, srcs.data(), srcCount, size,
+					(GaloisKernel) kernel);
+		}
+		duration = chrono::duration_cast < microseconds
+				> (Clock::now() - tStart).count();
+		printThroughput(GaloisRegion::getKernelName((GaloisKernel) kernel),
+				dataBytes, duration, memcmp(result, reference, size) == 0);
+	}
+
+	for (uint32_t i = 0; i < srcCount; i++) {
+		MemoryPool::getInstance().poolFree(srcs[i]);
+	}
+	MemoryPool::getInstance().poolFree(result);
+	MemoryPool::getInstance().poolFree(reference);
+}
+
+/**
+ * Baseline of the map bench: one std::map behind one mutex, the way the
+ * OSD and MDS maps used to be protected
+ */
+
+class LockedMap {
+public:
+	uint64_t get(uint64_t key) {
+		lock_guard<mutex> lk(_m);
+		auto it = _map.find(key);
+		return it == _map.end() ? 0 : it->second;
+	}
+
+	void set(uint64_t key, uint64_t value) {
+		lock_guard<mutex> lk(_m);
+		_map[key] = value;
+	}
+
+	uint64_t increment(uint64_t key) {
+		lock_guard<mutex> lk(_m);
+		return ++_map[key];
+	}
+
+private:
+	mutex _m;
+	map<uint64_t, uint64_t> _map;
+};
+
+/**
+ * Half reads, a quarter increments and a quarter writes on random keys
+ * Every 4th key is only incremented so that the total can be checked
+ */
+
+template<class M>
+static void mapLoop(M* m, uint32_t numKeys, uint32_t iteration,
+		uint32_t seed, atomic<uint64_t>* incremented) {
+	uint64_t x = seed * 2654435761ULL + 1;
+	uint64_t localIncremented = 0;
+	uint64_t sink = 0;
+	for (uint32_t i = 0; i < iteration; i++) {
+		// xorshift, cheap enough not to show up in the profile
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		const uint64_t key = (x >> 8) % numKeys;
+		const uint32_t op = x & 3;
+		if (key % 4 == 0 || op == 1) {
+			if (key % 4 == 0) {
+				m->increment(key);
+				localIncremented++;
+			} else {
+				sink += m->get(key);
+			}
+		} else if (op == 0) {
+			m->set(key, x);
+		} else {
+			sink += m->get(key);
+		}
+	}
+	incremented->fetch_add(localIncremented);
+
+	// keep the reads from being optimized away
+	volatile uint64_t keep = sink;
+	(void) keep;
+}
+
+template<class M>
+static double runMap(M* m, uint32_t numKeys, uint32_t iteration,
+		uint32_t numThreads, bool* isCorrect) {
+	atomic<uint64_t> incremented(0);
+	Clock::time_point tStart = Clock::now();
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; i++) {
+		threads.push_back(
+				thread(mapLoop<M>, m, numKeys, iteration, i + 1,
+						&incremented));
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+	Clock::time_point tEnd = Clock::now();
+
+	uint64_t total = 0;
+	for (uint32_t key = 0; key < numKeys; key += 4) {
+		total += m->get(key);
+	}
+	*isCorrect = (total == incremented);
+	return chrono::duration_cast < microseconds > (tEnd - tStart).count();
+}
+
+void doConcurrentMapBench(uint32_t numThreads, uint32_t numKeys,
+		uint32_t iteration) {
+
+	if (numThreads == 0 || numKeys == 0) {
+		cout << "Bad Parameters" << endl;
+		return;
+	}
+
+	const double totalOps = (double) iteration * numThreads;
+	bool isCorrect = false;
+
+	cout << "Threads = " << numThreads << " Keys = " << numKeys
+			<< " Iteration = " << iteration << " Shards = "
+			<< CONCURRENT_MAP_SHARDS << endl;
+	cout << fixed << setprecision(2);
+
+	LockedMap lockedMap;
+	double duration = runMap(&lockedMap, numKeys, iteration, numThreads,
+			&isCorrect);
+	cout << setw(20) << "map + mutex" << ": " << duration / 1000.0 << " ms "
+			<< totalOps / duration << " Mops/s"
+			<< (isCorrect ? "" : " [COUNT MISMATCH]") << endl;
+
+	ConcurrentHashMap<uint64_t, uint64_t> hashMap;
+	duration = runMap(&hashMap, numKeys, iteration, numThreads, &isCorrect);
+	cout << setw(20) << "ConcurrentHashMap" << ": " << duration / 1000.0
+			<< " ms " << totalOps / duration << " Mops/s"
+			<< (isCorrect ? "" : " [COUNT MISMATCH]") << endl;
+}
@@ -0,0 +1,57 @@
+/*
+ * microbench.hh
+ */
+
+#ifndef MICROBENCH_HH_
+#define MICROBENCH_HH_
+
+#include <stdint.h>
+
+using namespace std;
+
+/**
+ * Compare MemoryPool against the calloc baseline
+ * @param size Size of each allocation
+ * @param iteration Number of allocations per thread
+ * @param numThreads Number of threads allocating concurrently
+ */
+
+void doMemoryPoolBench(uint32_t size, uint32_t iteration, uint32_t numThreads);
+
+/**
+ * Measure the encoding throughput of every GF(2^w) kernel
+ * Vandermonde RS with each supported kernel (w = 8 only) and Jerasure,
+ * then Cauchy RS, are run on the same data
+ * @param k Number of data blocks
+ * @param m Number of parity blocks
+ * @param w Word size
+ * @param size Size of each block
+ * @param iteration Number of encodes per kernel
+ */
+
+void doGaloisBench(uint32_t k, uint32_t m, uint32_t w, uint32_t size,
+		uint32_t iteration);
+
+/**
+ * Measure the throughput of the multi-source XOR kernels
+ * The baseline XORs one source at a time into the result, as the
+ * RAID-5 / RDP / EVENODD coders used to do
+ * @param srcCount Number of source regions
+ * @param size Size of each region
+ * @param iteration Number of XORs per kernel
+ */
+
+void doXorBench(uint32_t srcCount, uint32_t size, uint32_t iteration);
+
+/**
+ * Compare ConcurrentHashMap against one std::map behind one mutex
+ * under a mixed get / set / increment load on random keys
+ * @param numThreads Number of threads accessing the map concurrently
+ * @param numKeys Number of distinct keys
+ * @param iteration Number of operations per thread
+ */
+
+void doConcurrentMapBench(uint32_t numThreads, uint32_t numKeys,
+		uint32_t iteration);
+
+#endif /* MICROBENCH_HH_ */
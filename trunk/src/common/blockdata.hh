@@ -2,6 +2,7 @@
 #define __BLOCKDATA_HH__
 
 #include <string>
+#include <memory>
 #include <stdint.h>
 #include "enums.hh"
 #include "../common/blocklocation.hh"
@@ -37,4 +38,12 @@ struct BlockData {
 	char* buf;
 };
 
+// part of a block stored in a file, sent from the file without a copy
+struct BlockFileRange {
+	int fd;
+	uint64_t offset; // offset in the file
+	uint32_t length;
+	shared_ptr<void> pin; // keeps the range unchanged until released
+};
+
 #endif
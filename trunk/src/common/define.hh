@@ -21,8 +21,12 @@ typedef boost::unique_lock<RWMutex> writeLock;
 
 // osd/storagemodule.cc
 #define MAX_OPEN_FILES 100
+#define BLOCK_STORE_NO_DELTA UINT32_MAX
 // #define NO_WRITE
 
+// osd/extentblockstore.cc
+#define EXTENT_FILE_SIZE 1073741824ULL
+
 // benchmark/benchmark.cc
 #define RANDOM_SHUFFLE_SEGMENT_ORDER
 
@@ -31,16 +35,45 @@ typedef boost::unique_lock<RWMutex> writeLock;
 #define DEBUG 1
 #endif
 
-// communicator/message.cc
-#define NUM_THREADS_PER_MSG 10
+// coding/codingcontext.cc
+#define CODING_SETTING_CACHE_SIZE 1024
+#define CODING_STRIPE_SIZE 32768 // bytes of each block per encoding task, sized so (k + m) stripes stay in L2
+#define CODING_THREADS 0 // encoding tasks besides the caller, 0 = one per executor worker
+
+// coding/segmentencoder.cc
+#define STREAM_STRIPE_SIZE 262144 // bytes of each block encoded and sent together while a segment arrives
+
+// coding/galoisregion.cc
+#define XOR_NON_TEMPORAL_THRESHOLD 4194304 // larger XOR results bypass the cache
+
+// common/memorypool.cc
+#define MEMPOOL_SMALL_MAX 262144 // larger requests are mapped and cached by size
+#define MEMPOOL_ARENA_SIZE 2097152 // slab arena, one huge page
+#define MEMPOOL_THREAD_CACHE_BYTES 1048576 // per size class per thread
+#define MEMPOOL_LARGE_CACHE_BYTES 268435456ULL // cached large blocks per pool
+#define MEMPOOL_LARGE_CACHE_PER_SIZE 16 // cached large blocks of one size
+#define MEMPOOL_MAX_POOLS 4
+#define MEMPOOL_USE_HUGE_PAGE
+
+// common/executor.cc
+#define EXECUTOR_THREADS 0 // workers with their own queue, 0 = one per core
+#define EXECUTOR_MAX_THREADS 1024 // workers plus spares standing in for blocked tasks
+#define EXECUTOR_FOREGROUND_PERCENT 75 // share of the workers data transfers may use
+#define EXECUTOR_RECOVERY_PERCENT 25 // share of the workers recovery may use
+#define EXECUTOR_SPARE_IDLE_TIME 1000 // ms before an idle spare worker exits
+#define EXECUTOR_SPIN 16 // yields of an idle worker before it sleeps
 
 // config/config.hh
 #define DEFAULT_CONFIG_PATH	"config.xml"
 #define DEFAUTT_COMMON_CONFIG "common.xml"
 #define XML_ROOT_NODE "CodfsConfig"
 
-// datastructure/lowlockqueue.hh
+// datastructure/boundedqueue.hh
 #define CACHE_LINE_SIZE 64
+#define BOUNDED_QUEUE_SPIN 64 // yields before a producer sleeps on a full ring
+
+// datastructure/concurrenthashmap.hh
+#define CONCURRENT_MAP_SHARDS 64 // locks per map, power of 2
 
 // fuse/client_fuse.cc
 #define FUSE_USE_VERSION 26
@@ -50,21 +83,66 @@ typedef boost::unique_lock<RWMutex> writeLock;
 // osd/osd.cc
 #define INF (1<<29)
 #define DISK_PATH "/"
-#define RECOVERY_THREADS 10
-#define MAX_NUM_PROCESSING_SEGMENT 10
+#define STREAM_ENCODE // encode and send RS / Cauchy uploads while the chunks arrive
+#define SEGMENT_INFO_CACHE_SIZE 65536 // segments whose coding info and OSD list are kept
+#define HEDGED_READ // fetch any k blocks of MDS codes, hedging slow OSDs
+#define MAX_NUM_PROCESSING_SEGMENT 10 // uploads admitted across all connections
+
+// osd/osdlatencytracker.cc
+#define HEDGE_LATENCY_SAMPLES 64 // recent block fetches kept per OSD
+#define HEDGE_MIN_SAMPLES 8 // fetches of an OSD before its percentile is trusted
+#define HEDGE_PERCENTILE 95 // latency after which another block is requested
+#define HEDGE_DEFAULT_DELAY 50000 // us to wait for an OSD with too few samples
+#define HEDGE_MIN_DELAY 1000 // us, lower bound of the hedge delay
+
+// osd/decodedsegmentcache.cc
+#define SEGMENT_CACHE_SIZE 268435456ULL // bytes of decoded segments kept on the primary
+#define SEGMENT_CACHE_IN_PERCENT 25 // share of the cache for segments read once (2Q A1in)
+#define SEGMENT_CACHE_GHOSTS 16384 // IDs of segments evicted from A1in that are promoted if read again
 
 // osd/storagemodule.cc
 #define HOTNESS_ALG TOP_HOTNESS_ALG
-#define IO_THREADS 2
 #define IO_POLL_INTERVAL 10000
 //#define USE_FSYNC
 
+// osd/compactionscheduler.cc
+#define COMPACTION_WATERMARK 50 // percent of the reserved space used before a block is merged in background
+#define COMPACTION_IDLE_TIME 1000000 // us without foreground I/O before any block with deltas is merged
+#define COMPACTION_RATE 52428800ULL // bytes per second of merge I/O while foreground I/O is running
+#define COMPACTION_POLL_INTERVAL 100000 // us between looks at the backlog when nothing is due
+
+// osd/ioengine.cc
+#define USE_IO_URING // fall back to IO_THREADS if the kernel has no io_uring
+#define IO_URING_DEPTH 128 // submission entries of the ring
+#define IO_THREADS 16 // I/O threads of the fallback engine
+
+// osd/groupcommit.cc
+#define GROUP_COMMIT_WINDOW 500 // us a round waits for more writers before syncing
+#define GROUP_COMMIT_MAX_BATCH 256 // writers that close a round without waiting out the window
+
 // monitor/selectionmodule.cc
 //#define RR_DISTRIBUTE
 #define RANDOM_CHOOSE_SECONDARY
 
 // Receive Optimization
 #define RECV_BUF_PER_SOCKET 10485760
+#define DIRECT_RECV_THRESHOLD 65536
+
+// communicator/communicator.cc
+#define NUM_REACTOR_THREADS 1
+#define MAX_EPOLL_EVENTS 64
+#define NUM_SENDER_THREADS 4
+#define SEND_BATCHES_PER_TURN 8
+#define SEND_BATCH_SIZE 16 // messages popped and sent together
+#define OUT_QUEUE_CAPACITY 1024 // messages per out queue, producers block when full
+#define TRANSFER_WINDOW_SIZE 33554432 // segment data in flight per connection
+#define TRANSFER_CREDIT_BATCH 4194304 // segment data handled per credit message
+
+// protocol/transfer/getsegmentrangerequest.cc
+#define SEGMENT_RANGE_WHOLE_SEGMENT UINT32_MAX // block ID of a range counted from the start of the segment
+
+// fuse/filedatacache.cc
+#define RANGE_READ_MAX_SIZE 1048576 // uncached reads up to this size fetch only the requested bytes
 
 // Trigger Recovery or not
 //#define TRIGGER_RECOVERY
@@ -9,8 +9,13 @@ enum FailureReason {
 	UNREACHABLE, DISKFAILURE, SEGMENTLOST
 };
 
+enum TaskClass {
+	CONTROL_TASK, FOREGROUND_TASK, RECOVERY_TASK, // highest priority first
+	TASK_CLASS_COUNT
+};
+
 enum MessageStatus {
-	WAITING, READY, TIMEOUT
+	WAITING, READY, TIMEOUT, FAILED
 };
 
 enum FileType {
@@ -30,6 +35,10 @@ enum UpdateScheme {
 	FO, FL, PL, PLR
 };
 
+enum BlockStoreType {
+	FILE_BLOCK_STORE, EXTENT_BLOCK_STORE
+};
+
 enum BlockType {
     DEFAULT_BLOCK_TYPE = 15,
     DATA_BLOCK = 0,     // must be 0 to make it compatible with boolean
@@ -78,6 +87,9 @@ enum MsgType {
 	BLOCK_DATA,
 	GET_SEGMENT_REQUEST,
 	GET_BLOCK_INIT_REQUEST,
+	TRANSFER_CREDIT,
+	GET_SEGMENT_RANGE_REQUEST,
+	GET_SEGMENT_RANGE_REPLY,
 
 	// STATUS
 	OSD_STARTUP,
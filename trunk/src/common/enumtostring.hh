@@ -33,6 +33,8 @@ public:
       case GET_SEGMENT_ID_LIST_REQUEST: return "GET_SEGMENT_ID_LIST_REQUEST";
       case GET_SEGMENT_INFO_REPLY: return "GET_SEGMENT_INFO_REPLY";
       case GET_SEGMENT_INFO_REQUEST: return "GET_SEGMENT_INFO_REQUEST";
+      case GET_SEGMENT_RANGE_REPLY: return "GET_SEGMENT_RANGE_REPLY";
+      case GET_SEGMENT_RANGE_REQUEST: return "GET_SEGMENT_RANGE_REQUEST";
       case GET_SEGMENT_REQUEST: return "GET_SEGMENT_REQUEST";
       case HANDSHAKE_REPLY: return "HANDSHAKE_REPLY";
       case HANDSHAKE_REQUEST: return "HANDSHAKE_REQUEST";
@@ -61,6 +63,7 @@ public:
       case SEGMENT_TRANSFER_END_REPLY: return "SEGMENT_TRANSFER_END_REPLY";
       case SEGMENT_TRANSFER_END_REQUEST: return "SEGMENT_TRANSFER_END_REQUEST";
       case SET_FILE_SIZE_REQUEST: return "SET_FILE_SIZE_REQUEST";
+      case TRANSFER_CREDIT: return "TRANSFER_CREDIT";
       case UPLOAD_FILE_REPLY: return "UPLOAD_FILE_REPLY";
       case UPLOAD_FILE_REQUEST: return "UPLOAD_FILE_REQUEST";
       case UPLOAD_SEGMENT_ACK: return "UPLOAD_SEGMENT_ACK";
@@ -124,6 +127,14 @@ public:
     return "???";
   }
 
+  static const char * toString( BlockStoreType en ) {
+    switch( en ) {
+      case EXTENT_BLOCK_STORE: return "EXTENT_BLOCK_STORE";
+      case FILE_BLOCK_STORE: return "FILE_BLOCK_STORE";
+    }
+    return "???";
+  }
+
   static const char * toString( UpdateScheme en ) {
     switch( en ) {
       case FL: return "FL";
@@ -144,8 +155,19 @@ public:
     return "???";
   }
 
+  static const char * toString( TaskClass en ) {
+    switch( en ) {
+      case CONTROL_TASK: return "CONTROL_TASK";
+      case FOREGROUND_TASK: return "FOREGROUND_TASK";
+      case RECOVERY_TASK: return "RECOVERY_TASK";
+      case TASK_CLASS_COUNT: return "TASK_CLASS_COUNT";
+    }
+    return "???";
+  }
+
   static const char * toString( MessageStatus en ) {
     switch( en ) {
+      case FAILED: return "FAILED";
       case READY: return "READY";
       case TIMEOUT: return "TIMEOUT";
       case WAITING: return "WAITING";
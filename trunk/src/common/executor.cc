@@ -0,0 +1,311 @@
+/**
+ * executor.cc
+ */
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "executor.hh"
+#include "enumtostring.hh"
+#include "debug.hh"
+
+using namespace std;
+
+/**
+ * State of the calling thread if it is an executor thread
+ */
+
+struct ExecutorThread {
+	int32_t queueId; // -1 for spare workers
+	bool isInTask;
+	TaskClass taskClass; // class of the running task
+	uint32_t blockingDepth; // nested BlockingScope count
+};
+
+static thread_local ExecutorThread* currentThread = NULL;
+
+Executor::Executor() :
+		_nextQueue(0), _idleThreads(0), _signaledThreads(0), _numThreads(0), _blockedThreads(
+				0) {
+
+	_numWorkers = EXECUTOR_THREADS;
+	if (_numWorkers == 0) {
+		_numWorkers = max(thread::hardware_concurrency(), 2u);
+	}
+
+	_classCap[CONTROL_TASK] = EXECUTOR_MAX_THREADS;
+	_classCap[FOREGROUND_TASK] = max(
+			_numWorkers * EXECUTOR_FOREGROUND_PERCENT / 100, 1u);
+	_classCap[RECOVERY_TASK] = max(
+			_numWorkers * EXECUTOR_RECOVERY_PERCENT / 100, 1u);
+
+	for (int i = 0; i < TASK_CLASS_COUNT; i++) {
+		_queued[i] = 0;
+		_running[i] = 0;
+	}
+
+	for (uint32_t i = 0; i < _numWorkers; i++) {
+		_queues.push_back(new WorkerQueue());
+	}
+
+	lock_guard<mutex> lk(_idleMutex);
+	for (uint32_t i = 0; i < _numWorkers; i++) {
+		_numThreads++;
+		thread(&Executor::workerLoop, this, (int32_t) i).detach();
+	}
+}
+
+uint32_t Executor::getNumWorkers() {
+	return _numWorkers;
+}
+
+/**
+ * 1. Count the task before it becomes visible so that counters never
+ *    drop below zero
+ * 2. Push it to the queue of the calling worker, or round robin
+ * 3. Wake up an idle worker
+ */
+
+void Executor::schedule(TaskClass taskClass, function<void()> task) {
+	uint32_t queueId;
+	if (currentThread != NULL && currentThread->queueId >= 0) {
+		queueId = currentThread->queueId;
+	} else {
+		queueId = _nextQueue++ % _numWorkers;
+	}
+
+	_queued[taskClass]++;
+	{
+		lock_guard<mutex> lk(_queues[queueId]->m);
+		_queues[queueId]->tasks[taskClass].push_back(move(task));
+	}
+	wakeWorker();
+}
+
+void Executor::printStats() {
+	lock_guard<mutex> lk(_idleMutex);
+	for (int i = 0; i < TASK_CLASS_COUNT; i++) {
+		debug("[%s] Queued: %" PRIu32 " Running: %" PRIu32 "/%" PRIu32 "\n",
+				EnumToString::toString((TaskClass )i), _queued[i].load(),
+				_running[i].load(), _classCap[i]);
+	}
+	debug("Threads: %" PRIu32 " Idle: %" PRIu32 " Blocked: %" PRIu32 "\n",
+			_numThreads, _idleThreads.load(), _blockedThreads);
+}
+
+void Executor::workerLoop(int32_t queueId) {
+	ExecutorThread self;
+	self.queueId = queueId;
+	self.isInTask = false;
+	self.taskClass = CONTROL_TASK;
+	self.blockingDepth = 0;
+	currentThread = &self;
+
+	TaskClass taskClass;
+	function<void()> task;
+	uint32_t spinCount = 0;
+
+	while (1) {
+		if (takeTask(queueId, taskClass, task)) {
+			self.isInTask = true;
+			self.taskClass = taskClass;
+			task();
+			task = nullptr;
+			self.isInTask = false;
+			releaseClass(taskClass);
+			spinCount = 0;
+			continue;
+		}
+
+		// messages come in bursts, look again before going to sleep
+		if (spinCount++ < EXECUTOR_SPIN) {
+			this_thread::yield();
+			continue;
+		}
+		spinCount = 0;
+
+		unique_lock<mutex> lk(_idleMutex);
+		_idleThreads++;
+		while (!hasRunnableTask()) {
+			bool isTimeout = false;
+			if (queueId >= 0) {
+				_idleCond.wait(lk);
+			} else {
+				isTimeout = _idleCond.wait_for(lk,
+						chrono::milliseconds(EXECUTOR_SPARE_IDLE_TIME))
+						== cv_status::timeout;
+			}
+			if (_signaledThreads > 0) {
+				_signaledThreads--;
+			}
+			if (isTimeout && !hasRunnableTask()
+					&& _numThreads - _blockedThreads > _numWorkers) {
+				// the blocked tasks that needed this spare are back
+				_idleThreads--;
+				_numThreads--;
+				currentThread = NULL;
+				return;
+			}
+		}
+		_idleThreads--;
+	}
+}
+
+/**
+ * Take the oldest task of the highest class that is below its cap
+ * Own queue first, then steal from the next workers in turn
+ */
+
+bool Executor::takeTask(int32_t queueId, TaskClass& taskClass,
+		function<void()>& task) {
+	for (int i = 0; i < TASK_CLASS_COUNT; i++) {
+		taskClass = (TaskClass) i;
+		if (_queued[i].load() == 0 || !tryAcquireClass(taskClass)) {
+			continue;
+		}
+		const uint32_t start = queueId >= 0 ? queueId : _nextQueue.load();
+		for (uint32_t j = 0; j < _numWorkers; j++) {
+			if (popFrom(*_queues[(start + j) % _numWorkers], taskClass,
+					task)) {
+				_queued[i]--;
+				return true;
+			}
+		}
+		// counted but not pushed yet
+		_running[i]--;
+	}
+	return false;
+}
+
+bool Executor::popFrom(WorkerQueue& queue, TaskClass taskClass,
+		function<void()>& task) {
+	lock_guard<mutex> lk(queue.m);
+	if (queue.tasks[taskClass].empty()) {
+		return false;
+	}
+	task = move(queue.tasks[taskClass].front());
+	queue.tasks[taskClass].pop_front();
+	return true;
+}
+
+bool Executor::tryAcquireClass(TaskClass taskClass) {
+	uint32_t running = _running[taskClass].load();
+	while (running < _classCap[taskClass]) {
+		if (_running[taskClass].compare_exchange_weak(running, running + 1)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Executor::releaseClass(TaskClass taskClass) {
+	_running[taskClass]--;
+	if (_queued[taskClass].load() > 0) {
+		wakeWorker();
+	}
+}
+
+bool Executor::hasRunnableTask() {
+	for (int i = 0; i < TASK_CLASS_COUNT; i++) {
+		if (_queued[i].load() > 0 && _running[i].load() < _classCap[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Executor::wakeWorker() {
+	// workers count themselves idle under _idleMutex before checking the
+	// counters, and the counters are updated before this check, so either
+	// the worker sees the task or this sees the worker
+	// idle workers are all inside wait() while the lock is free, a worker
+	// that is woken up already will look at the queues again
+	if (_idleThreads.load() > _signaledThreads.load()) {
+		lock_guard<mutex> lk(_idleMutex);
+		if (_idleThreads > _signaledThreads) {
+			_signaledThreads++;
+			_idleCond.notify_one();
+		}
+	}
+}
+
+/**
+ * Keep _numWorkers threads runnable while tasks are blocked
+ * Called with _idleMutex held
+ */
+
+void Executor::startSpareIfNeeded() {
+	if (_numThreads - _blockedThreads >= _numWorkers
+			|| _numThreads >= EXECUTOR_MAX_THREADS) {
+		return;
+	}
+	_numThreads++;
+	thread(&Executor::workerLoop, this, -1).detach();
+}
+
+void Executor::beginBlocking() {
+	releaseClass(currentThread->taskClass);
+	lock_guard<mutex> lk(_idleMutex);
+	_blockedThreads++;
+	startSpareIfNeeded();
+}
+
+void Executor::endBlocking() {
+	{
+		lock_guard<mutex> lk(_idleMutex);
+		_blockedThreads--;
+	}
+	// may go above the cap for a while, later tasks wait until it drops
+	_running[currentThread->taskClass]++;
+}
+
+Executor::BlockingScope::BlockingScope() :
+		_isBlocking(false) {
+	if (currentThread != NULL && currentThread->isInTask
+			&& currentThread->blockingDepth++ == 0) {
+		_isBlocking = true;
+		Executor::getInstance().beginBlocking();
+	}
+}
+
+Executor::BlockingScope::~BlockingScope() {
+	if (currentThread != NULL && currentThread->isInTask
+			&& --currentThread->blockingDepth == 0 && _isBlocking) {
+		Executor::getInstance().endBlocking();
+	}
+}
+
+TaskGroup::TaskGroup(TaskClass taskClass, uint32_t maxRunning) :
+		_taskClass(taskClass), _maxRunning(maxRunning), _unfinished(0) {
+}
+
+TaskGroup::~TaskGroup() {
+	wait();
+}
+
+void TaskGroup::run(function<void()> task) {
+	{
+		unique_lock<mutex> lk(_mutex);
+		if (_maxRunning > 0 && _unfinished >= _maxRunning) {
+			Executor::BlockingScope blocking;
+			_finished.wait(lk, [this] {return _unfinished < _maxRunning;});
+		}
+		_unfinished++;
+	}
+
+	Executor::getInstance().schedule(_taskClass, [this, task]() {
+		task();
+		// notify with the lock held, the group may go away once it is free
+		lock_guard<mutex> lk(_mutex);
+		_unfinished--;
+		_finished.notify_all();
+	});
+}
+
+void TaskGroup::wait() {
+	unique_lock<mutex> lk(_mutex);
+	if (_unfinished > 0) {
+		Executor::BlockingScope blocking;
+		_finished.wait(lk, [this] {return _unfinished == 0;});
+	}
+}
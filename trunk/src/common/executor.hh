@@ -0,0 +1,168 @@
+#ifndef __EXECUTOR_HH__
+#define __EXECUTOR_HH__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <stdint.h>
+#include "enums.hh"
+#include "define.hh"
+
+using namespace std;
+
+/**
+ * Process-wide work-stealing executor shared by message handlers,
+ * block transfers, recovery and segment encoding
+ *
+ * Each worker owns one queue per TaskClass and takes the oldest task of
+ * the highest class it may run, from its own queue first and then from
+ * the others. Foreground and recovery tasks are capped to a share of the
+ * workers so that control messages (replies, status) always find a free
+ * worker. A task that blocks inside a BlockingScope gives its worker up:
+ * it no longer counts towards its class cap, and a spare worker is started
+ * if fewer than the configured number of workers are left runnable.
+ */
+
+class Executor {
+public:
+
+	/**
+	 * static method for Singleton implementation
+	 * @return reference to instance of singleton executor
+	 */
+
+	static Executor& getInstance() {
+		// never destroyed, detached workers may still run while the
+		// process exits
+		static Executor* instance = new Executor();
+		return *instance;
+	}
+
+	/**
+	 * Queue a task, workers run it as soon as its class cap allows
+	 * @param taskClass Priority class of the task
+	 * @param task Task to run
+	 */
+
+	void schedule(TaskClass taskClass, function<void()> task);
+
+	/**
+	 * Get the number of workers that own a queue
+	 * @return Number of workers
+	 */
+
+	uint32_t getNumWorkers();
+
+	/**
+	 * Print queued, running and blocked tasks and the number of threads
+	 */
+
+	void printStats();
+
+	/**
+	 * Mark the calling task as blocked for the lifetime of the scope
+	 * Wrap every wait that may depend on another task. Outside of the
+	 * executor threads the scope does nothing.
+	 */
+
+	class BlockingScope {
+	public:
+		BlockingScope();
+		~BlockingScope();
+	private:
+		BlockingScope(BlockingScope const&); // Don't Implement
+		void operator=(BlockingScope const&); // Don't implement
+		bool _isBlocking;
+	};
+
+private:
+	Executor();
+	Executor(Executor const&); // Don't Implement
+	void operator=(Executor const&); // Don't implement
+
+	struct WorkerQueue {
+		mutex m;
+		deque<function<void()> > tasks[TASK_CLASS_COUNT];
+		char pad[CACHE_LINE_SIZE]; // keep neighbouring locks apart
+	};
+
+	void workerLoop(int32_t queueId);
+	bool takeTask(int32_t queueId, TaskClass& taskClass,
+			function<void()>& task);
+	bool popFrom(WorkerQueue& queue, TaskClass taskClass,
+			function<void()>& task);
+	bool tryAcquireClass(TaskClass taskClass);
+	void releaseClass(TaskClass taskClass);
+	bool hasRunnableTask();
+	void wakeWorker();
+	void startSpareIfNeeded();
+	void beginBlocking();
+	void endBlocking();
+
+	uint32_t _numWorkers;
+	uint32_t _classCap[TASK_CLASS_COUNT];
+	vector<WorkerQueue*> _queues;
+	atomic<uint32_t> _nextQueue;
+
+	atomic<uint32_t> _queued[TASK_CLASS_COUNT];
+	atomic<uint32_t> _running[TASK_CLASS_COUNT];
+
+	mutex _idleMutex;
+	condition_variable _idleCond;
+	atomic<uint32_t> _idleThreads; // changed under _idleMutex only
+	atomic<uint32_t> _signaledThreads; // idle threads already woken up
+	uint32_t _numThreads; // guarded by _idleMutex
+	uint32_t _blockedThreads; // guarded by _idleMutex
+};
+
+/**
+ * Tasks scheduled on the executor and waited for together
+ * Bounds the number of tasks queued or running at the same time, which
+ * is how many segments a client transfers in parallel
+ */
+
+class TaskGroup {
+public:
+
+	/**
+	 * Constructor
+	 * @param taskClass Priority class of the tasks
+	 * @param maxRunning Maximum number of unfinished tasks, 0 for no limit
+	 */
+
+	TaskGroup(TaskClass taskClass, uint32_t maxRunning = 0);
+
+	/**
+	 * Destructor, waits for the unfinished tasks
+	 */
+
+	~TaskGroup();
+
+	/**
+	 * Schedule a task, block while maxRunning tasks are unfinished
+	 * @param task Task to run
+	 */
+
+	void run(function<void()> task);
+
+	/**
+	 * Block until every task of the group has finished
+	 */
+
+	void wait();
+
+private:
+	TaskGroup(TaskGroup const&); // Don't Implement
+	void operator=(TaskGroup const&); // Don't implement
+
+	TaskClass _taskClass;
+	uint32_t _maxRunning;
+	uint32_t _unfinished; // guarded by _mutex
+	mutex _mutex;
+	condition_variable _finished;
+};
+
+#endif
@@ -4,21 +4,386 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
+#include <sys/mman.h>
 
 #include "memorypool.hh"
+#include "debug.hh"
+
+using namespace std;
+
+#define LARGE_SIZE_CLASS ((uint32_t) -1)
+#define PAGE_SIZE_BYTES 4096ULL
+#define HUGE_PAGE_SIZE_BYTES 2097152ULL
+
+/**
+ * Prefix of every block handed out by the pool
+ */
+
+struct BlockHeader {
+	uint32_t sizeClass; // LARGE_SIZE_CLASS for blocks mapped on their own
+	uint32_t dirty; // 0 if the block still holds the zeroes from mmap
+	uint64_t blockSize; // including this header
+};
+
+const uint32_t BLOCK_HEADER_SIZE = sizeof(struct BlockHeader);
+
+struct ThreadCache {
+	MemoryPool* pool;
+	vector<vector<char*> > lists; // free blocks of each size class
+	uint64_t mallocCount;
+	uint64_t freeCount;
+	uint64_t hitCount;
+	uint64_t zeroFillCount;
+};
+
+/**
+ * Thread caches of all the pools used by a thread
+ * Blocks go back to the central lists when the thread exits
+ */
+
+struct ThreadCacheHolder {
+	ThreadCacheHolder() {
+		memset(caches, 0, sizeof(caches));
+	}
+	~ThreadCacheHolder() {
+		for (uint32_t i = 0; i < MEMPOOL_MAX_POOLS; i++) {
+			if (caches[i] != NULL) {
+				caches[i]->pool->releaseThreadCache(caches[i]);
+				delete caches[i];
+			}
+		}
+	}
+	ThreadCache* caches[MEMPOOL_MAX_POOLS];
+};
+
+static thread_local ThreadCacheHolder threadCacheHolder;
+static atomic<uint32_t> nextPoolId(0);
 
 MemoryPool::MemoryPool() {
+	_poolId = nextPoolId++;
+	_maxMsgSize = 0;
+
+	// 4 classes per power of two, at most 25% internal fragmentation
+	const uint32_t maxBlockSize = MEMPOOL_SMALL_MAX + BLOCK_HEADER_SIZE;
+	for (uint32_t base = 64; _classSize.empty()
+			|| _classSize.back() < maxBlockSize; base *= 2) {
+		for (uint32_t step = 0; step < 4; step++) {
+			const uint32_t size = base + base / 4 * step;
+			_classSize.push_back(size);
+			_classCacheCount.push_back(
+					max(MEMPOOL_THREAD_CACHE_BYTES / size, (uint32_t) 2));
+			_centralMutex.push_back(new mutex());
+			if (size >= maxBlockSize)
+				break;
+		}
+	}
+	_centralList.resize(_classSize.size());
+
+	_mallocCount = 0;
+	_freeCount = 0;
+	_threadCacheHit = 0;
+	_largeCacheHit = 0;
+	_zeroFillCount = 0;
+	_bytesReserved = 0;
+	_bytesCached = 0;
 }
 
 MemoryPool::~MemoryPool() {
+	// memory is left to the OS, other threads may still be running at exit
 }
 
-char* MemoryPool::poolMalloc(uint32_t length) {
-	return (char*) calloc(length, 1);
+char* MemoryPool::poolMalloc(uint32_t length, bool zeroFill) {
+	char* block;
+	if (length <= MEMPOOL_SMALL_MAX) {
+		block = mallocSmall(getSizeClass(length + BLOCK_HEADER_SIZE));
+	} else {
+		block = mallocLarge((uint64_t) length + BLOCK_HEADER_SIZE);
+	}
+
+	struct BlockHeader* header = (struct BlockHeader*) block;
+	char* ptr = block + BLOCK_HEADER_SIZE;
+	if (zeroFill && header->dirty) {
+		memset(ptr, 0, length);
+		if (header->sizeClass == LARGE_SIZE_CLASS) {
+			_zeroFillCount++;
+		} else {
+			ThreadCache* cache = getThreadCache();
+			if (cache != NULL) {
+				cache->zeroFillCount++;
+			} else {
+				_zeroFillCount++;
+			}
+		}
+	}
+	header->dirty = 1;
+	return ptr;
 }
 
 void MemoryPool::poolFree(char* ptr) {
-	free(ptr);
+	if (ptr == NULL) {
+		return;
+	}
+	char* block = ptr - BLOCK_HEADER_SIZE;
+	if (((struct BlockHeader*) block)->sizeClass == LARGE_SIZE_CLASS) {
+		freeLarge(block);
+	} else {
+		freeSmall(block);
+	}
+}
+
+struct MemoryPoolStats MemoryPool::getStats() {
+	struct MemoryPoolStats stats;
+	stats.mallocCount = _mallocCount;
+	stats.freeCount = _freeCount;
+	stats.threadCacheHit = _threadCacheHit;
+	stats.largeCacheHit = _largeCacheHit;
+	stats.zeroFillCount = _zeroFillCount;
+	stats.bytesReserved = _bytesReserved;
+	stats.bytesCached = _bytesCached;
+	return stats;
+}
+
+void MemoryPool::printStats() {
+	struct MemoryPoolStats stats = getStats();
+	cout << "===== MEMORY POOL " << _poolId << " =====" << endl;
+	cout << "Malloc: " << stats.mallocCount << " Free: " << stats.freeCount
+			<< endl;
+	cout << "Thread Cache Hit: " << stats.threadCacheHit
+			<< " Large Cache Hit: " << stats.largeCacheHit << " Zero Fill: "
+			<< stats.zeroFillCount << endl;
+	cout << "Reserved: " << stats.bytesReserved << " bytes Cached: "
+			<< stats.bytesCached << " bytes" << endl;
+}
+
+void MemoryPool::releaseThreadCache(struct ThreadCache* cache) {
+	for (uint32_t i = 0; i < _classSize.size(); i++) {
+		flushThreadCache(cache, i, 0);
+	}
+	foldThreadStats(cache);
+}
+
+//
+// PRIVATE FUNCTIONS
+//
+
+struct ThreadCache* MemoryPool::getThreadCache() {
+	if (_poolId >= MEMPOOL_MAX_POOLS) {
+		return NULL;
+	}
+	ThreadCache* cache = threadCacheHolder.caches[_poolId];
+	if (cache == NULL) {
+		cache = new ThreadCache();
+		cache->pool = this;
+		cache->lists.resize(_classSize.size());
+		cache->mallocCount = 0;
+		cache->freeCount = 0;
+		cache->hitCount = 0;
+		cache->zeroFillCount = 0;
+		threadCacheHolder.caches[_poolId] = cache;
+	}
+	return cache;
+}
+
+uint32_t MemoryPool::getSizeClass(uint32_t blockSize) {
+	return lower_bound(_classSize.begin(), _classSize.end(), blockSize)
+			- _classSize.begin();
+}
+
+char* MemoryPool::mallocSmall(uint32_t sizeClass) {
+	ThreadCache* cache = getThreadCache();
+
+	if (cache == NULL) {
+		// no thread cache slot left, go to the central list directly
+		ThreadCache temp;
+		temp.pool = this;
+		temp.lists.resize(_classSize.size());
+		temp.mallocCount = 1;
+		temp.freeCount = temp.hitCount = temp.zeroFillCount = 0;
+		refillThreadCache(&temp, sizeClass);
+		char* block = temp.lists[sizeClass].back();
+		temp.lists[sizeClass].pop_back();
+		flushThreadCache(&temp, sizeClass, 0);
+		foldThreadStats(&temp);
+		return block;
+	}
+
+	vector<char*>& list = cache->lists[sizeClass];
+	if (list.empty()) {
+		refillThreadCache(cache, sizeClass);
+	} else {
+		cache->hitCount++;
+	}
+	char* block = list.back();
+	list.pop_back();
+	cache->mallocCount++;
+	return block;
+}
+
+void MemoryPool::freeSmall(char* block) {
+	const uint32_t sizeClass = ((struct BlockHeader*) block)->sizeClass;
+	ThreadCache* cache = getThreadCache();
+
+	if (cache == NULL) {
+		lock_guard<mutex> lk(*_centralMutex[sizeClass]);
+		_centralList[sizeClass].push_back(block);
+		_freeCount++;
+		return;
+	}
+
+	vector<char*>& list = cache->lists[sizeClass];
+	list.push_back(block);
+	cache->freeCount++;
+	if (list.size() > _classCacheCount[sizeClass]) {
+		flushThreadCache(cache, sizeClass, _classCacheCount[sizeClass] / 2);
+	}
+}
+
+void MemoryPool::refillThreadCache(struct ThreadCache* cache,
+		uint32_t sizeClass) {
+	const uint32_t classSize = _classSize[sizeClass];
+	const uint32_t batch = max(_classCacheCount[sizeClass] / 2, (uint32_t) 1);
+	vector<char*>& list = cache->lists[sizeClass];
+	vector<char*>& central = _centralList[sizeClass];
+
+	{
+		lock_guard<mutex> lk(*_centralMutex[sizeClass]);
+
+		// carve a new arena into blocks of this class
+		if (central.empty()) {
+			const uint64_t arenaSize = max((uint64_t) MEMPOOL_ARENA_SIZE,
+					(uint64_t) classSize);
+			char* arena = mapMemory(arenaSize);
+			for (uint64_t offset = 0; offset + classSize <= arenaSize; offset +=
+					classSize) {
+				struct BlockHeader* header = (struct BlockHeader*) (arena
+						+ offset);
+				header->sizeClass = sizeClass;
+				header->dirty = 0;
+				header->blockSize = classSize;
+				central.push_back(arena + offset);
+			}
+		}
+
+		const uint32_t count = min((uint32_t) central.size(), batch);
+		list.insert(list.end(), central.end() - count, central.end());
+		central.resize(central.size() - count);
+	}
+
+	foldThreadStats(cache);
+}
+
+void MemoryPool::flushThreadCache(struct ThreadCache* cache,
+		uint32_t sizeClass, uint32_t keep) {
+	vector<char*>& list = cache->lists[sizeClass];
+	if (list.size() <= keep) {
+		return;
+	}
+	{
+		lock_guard<mutex> lk(*_centralMutex[sizeClass]);
+		_centralList[sizeClass].insert(_centralList[sizeClass].end(),
+				list.begin() + keep, list.end());
+	}
+	list.resize(keep);
+	foldThreadStats(cache);
+}
+
+void MemoryPool::foldThreadStats(struct ThreadCache* cache) {
+	_mallocCount += cache->mallocCount;
+	_freeCount += cache->freeCount;
+	_threadCacheHit += cache->hitCount;
+	_zeroFillCount += cache->zeroFillCount;
+	cache->mallocCount = 0;
+	cache->freeCount = 0;
+	cache->hitCount = 0;
+	cache->zeroFillCount = 0;
+}
+
+char* MemoryPool::mallocLarge(uint64_t blockSize) {
+	// round up to page size so that recurring lengths share a cache entry
+	blockSize = (blockSize + PAGE_SIZE_BYTES - 1) & ~(PAGE_SIZE_BYTES - 1);
+	_mallocCount++;
+
+	{
+		lock_guard<mutex> lk(_largeMutex);
+		multimap<uint64_t, char*>::iterator it = _largeCache.find(blockSize);
+		if (it != _largeCache.end()) {
+			char* block = it->second;
+			_largeCache.erase(it);
+			_bytesCached -= blockSize;
+			_largeCacheHit++;
+			return block;
+		}
+	}
+
+	char* block = mapMemory(blockSize);
+	struct BlockHeader* header = (struct BlockHeader*) block;
+	header->sizeClass = LARGE_SIZE_CLASS;
+	header->dirty = 0;
+	header->blockSize = blockSize;
+	return block;
+}
+
+void MemoryPool::freeLarge(char* block) {
+	const uint64_t blockSize = ((struct BlockHeader*) block)->blockSize;
+	_freeCount++;
+
+	{
+		lock_guard<mutex> lk(_largeMutex);
+		if (_bytesCached + blockSize <= MEMPOOL_LARGE_CACHE_BYTES
+				&& _largeCache.count(blockSize)
+						< MEMPOOL_LARGE_CACHE_PER_SIZE) {
+			_largeCache.insert(make_pair(blockSize, block));
+			_bytesCached += blockSize;
+			return;
+		}
+	}
+
+	munmap(block, blockSize);
+	_bytesReserved -= blockSize;
+}
+
+char* MemoryPool::mapMemory(uint64_t length) {
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	char* ptr;
+
+#ifdef MEMPOOL_USE_HUGE_PAGE
+	if (length >= HUGE_PAGE_SIZE_BYTES && length % HUGE_PAGE_SIZE_BYTES == 0) {
+		// over-map and trim so that the region is huge page aligned
+		char* raw = (char*) mmap(NULL, length + HUGE_PAGE_SIZE_BYTES, prot,
+				flags, -1, 0);
+		if (raw == MAP_FAILED) {
+			perror("mmap");
+			debug_error("Cannot map %" PRIu64 " bytes\n", length);
+			exit(-1);
+		}
+		ptr = (char*) (((uintptr_t) raw + HUGE_PAGE_SIZE_BYTES - 1)
+				& ~(HUGE_PAGE_SIZE_BYTES - 1));
+		if (ptr > raw) {
+			munmap(raw, ptr - raw);
+		}
+		munmap(ptr + length, raw + HUGE_PAGE_SIZE_BYTES - ptr);
+		madvise(ptr, length, MADV_HUGEPAGE);
+		_bytesReserved += length;
+		return ptr;
+	}
+#endif
+
+	ptr = (char*) mmap(NULL, length, prot, flags, -1, 0);
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		debug_error("Cannot map %" PRIu64 " bytes\n", length);
+		exit(-1);
+	}
+#ifdef MEMPOOL_USE_HUGE_PAGE
+	if (length >= HUGE_PAGE_SIZE_BYTES) {
+		madvise(ptr, length, MADV_HUGEPAGE);
+	}
+#endif
+	_bytesReserved += length;
+	return ptr;
 }
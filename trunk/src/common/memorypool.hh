@@ -9,13 +9,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
 #include "../common/define.hh"
 
+struct ThreadCache;
+
+/**
+ * Counters of a memory pool
+ * Small-object counters are folded in when a thread cache exchanges
+ * blocks with the central lists, so they may lag behind
+ */
+
+struct MemoryPoolStats {
+	uint64_t mallocCount;
+	uint64_t freeCount;
+	uint64_t threadCacheHit; // small requests served without locking
+	uint64_t largeCacheHit; // large requests served by a cached block
+	uint64_t zeroFillCount; // reused blocks cleared for zeroed requests
+	uint64_t bytesReserved; // memory obtained from the OS
+	uint64_t bytesCached; // large blocks kept for reuse
+};
+
 /**
  * Provide a memory pool for optimizing frequent malloc / free calls
- * TODO: A dummy memory pool using singleton pattern for now
- * TODO: Should be thread-safe in c++11 (verification needed)
+ * Small requests are served from size-classed slabs carved out of
+ * huge-page arenas, with a per-thread cache in front of each class.
+ * Large requests (segments, blocks, chunks) are mmap-ed and cached by
+ * exact size, since the same configured sizes recur all the time.
  * Singleton Reference: http://stackoverflow.com/questions/1008019/c-singleton-design-pattern
  */
 
@@ -48,10 +72,11 @@ public:
 	/**
 	 * Obtain a piece of memory
 	 * @param length Length of memory
+	 * @param zeroFill Whether the memory should be zero-filled (like calloc)
 	 * @return Pointer to assigned memory
 	 */
 
-	char* poolMalloc(uint32_t length);
+	char* poolMalloc(uint32_t length, bool zeroFill = true);
 
 	/**
 	 * Retuen a piece of memory
@@ -62,6 +87,27 @@ public:
 
 	char* poolMallocMsg();
 
+	/**
+	 * Obtain the counters of the pool
+	 * @return Snapshot of the counters
+	 */
+
+	struct MemoryPoolStats getStats();
+
+	/**
+	 * DEBUG: Print the counters of the pool
+	 */
+
+	void printStats();
+
+	/**
+	 * Return the blocks of a thread cache to the central lists
+	 * Called when the owning thread exits
+	 * @param cache Thread cache to release
+	 */
+
+	void releaseThreadCache(struct ThreadCache* cache);
+
 private:
 	// Dont forget to declare these two. You want to make sure they
 	// are unaccessable otherwise you may accidently get copies of
@@ -70,6 +116,38 @@ private:
 	MemoryPool(MemoryPool const&); // Don't Implement
 	void operator=(MemoryPool const&); // Don't implement
 
+	struct ThreadCache* getThreadCache();
+	uint32_t getSizeClass(uint32_t blockSize);
+	char* mallocSmall(uint32_t sizeClass);
+	void freeSmall(char* block);
+	char* mallocLarge(uint64_t blockSize);
+	void freeLarge(char* block);
+	void refillThreadCache(struct ThreadCache* cache, uint32_t sizeClass);
+	void flushThreadCache(struct ThreadCache* cache, uint32_t sizeClass,
+			uint32_t keep);
+	void foldThreadStats(struct ThreadCache* cache);
+	char* mapMemory(uint64_t length);
+
+	uint32_t _poolId; // index of this pool in the thread cache holder
+	std::vector<uint32_t> _classSize; // block size (with header) of each class
+	std::vector<uint32_t> _classCacheCount; // blocks kept per thread per class
+
+	// central free lists, one per size class
+	std::vector<std::mutex*> _centralMutex;
+	std::vector<std::vector<char*> > _centralList;
+
+	// large blocks cached by exact mapped size
+	std::mutex _largeMutex;
+	std::multimap<uint64_t, char*> _largeCache;
+
+	std::atomic<uint64_t> _mallocCount;
+	std::atomic<uint64_t> _freeCount;
+	std::atomic<uint64_t> _threadCacheHit;
+	std::atomic<uint64_t> _largeCacheHit;
+	std::atomic<uint64_t> _zeroFillCount;
+	std::atomic<uint64_t> _bytesReserved;
+	std::atomic<uint64_t> _bytesCached;
+
 	uint32_t _maxMsgSize;
 };
 #endif
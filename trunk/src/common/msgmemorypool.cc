@@ -6,13 +6,10 @@
 #include "../protocol/message.hh"
 
 MsgMemoryPool::MsgMemoryPool() {
-	_maxMsgSize = 0;
 }
 
 char* MsgMemoryPool::poolMalloc(uint32_t size) {
-	if (size > _maxMsgSize)
-		_maxMsgSize = size;
-
-	return MemoryPool::poolMalloc(_maxMsgSize);
+	// messages rely on zeroed members, keep zero-filling
+	return MemoryPool::poolMalloc(size, true);
 }
 
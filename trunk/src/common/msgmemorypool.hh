@@ -7,9 +7,9 @@ const apr_size_t MSG_POOL_MAX_FREE_SIZE = 1 * 1024 * 1024;
 #endif
 
 /**
- * Provide a memory pool for optimizing frequent malloc / free calls
- * TODO: A dummy memory pool using singleton pattern for now
- * TODO: Should be thread-safe in c++11 (verification needed)
+ * Memory pool for Message objects (operator new / delete)
+ * Kept apart from MemoryPool so that the small size classes of messages
+ * have their own central lists and thread caches
  * Singleton Reference: http://stackoverflow.com/questions/1008019/c-singleton-design-pattern
  */
 
@@ -22,8 +22,6 @@ public:
 	}
 	MsgMemoryPool();
 	char* poolMalloc(uint32_t size);
-private:
-	uint32_t _maxMsgSize;
 };
 
 #endif
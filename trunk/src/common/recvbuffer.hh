@@ -7,14 +7,27 @@ using namespace std;
 
 struct RecvBuffer {
 	RecvBuffer() {
+		start = 0;
 		len = 0;
-		buf = MemoryPool::getInstance().poolMalloc(RECV_BUF_PER_SOCKET);
+		buf = MemoryPool::getInstance().poolMalloc(RECV_BUF_PER_SOCKET, false);
+		msgBuf = NULL;
+		msgLength = 0;
+		msgReceived = 0;
 	}
 	~RecvBuffer() {
 		MemoryPool::getInstance().poolFree(buf);
+		if (msgBuf != NULL) {
+			MemoryPool::getInstance().poolFree(msgBuf);
+		}
 	}
-	uint32_t len;
+	uint32_t start; // first byte not yet parsed
+	uint32_t len; // end of received data
 	char* buf;
+
+	// large message being received in place
+	char* msgBuf;
+	uint32_t msgLength;
+	uint32_t msgReceived;
 };
 
 #endif
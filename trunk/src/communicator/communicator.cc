@@ -5,10 +5,10 @@
 #include <iostream>
 #include <mutex>
 #include <thread>
-#include <sys/types.h>		// required by select()
-#include <unistd.h>		// required by select()
-#include <sys/select.h>	// required by select()
-#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>		// required by epoll_wait()
 #include <boost/thread/thread.hpp>
 #include <arpa/inet.h>
 #include "connection.hh"
@@ -32,6 +32,12 @@
 #include "../protocol/transfer/segmenttransferendrequest.hh"
 #include "../protocol/transfer/segmentdatamsg.hh"
 #include "../protocol/transfer/putsmallsegmentrequest.hh"
+#include "../protocol/transfer/transfercreditmsg.hh"
+#include "../protocol/transfer/putblockinitrequest.hh"
+#include "../protocol/transfer/blocktransferendrequest.hh"
+#include "../protocol/transfer/blockdatamsg.hh"
+#include "../protocol/transfer/getsegmentrangerequest.hh"
+#include "../protocol/nodelist/getsecondarylistrequest.hh"
 #include "../common/netfunc.hh"
 
 #ifdef COMPILE_FOR_MONITOR
@@ -51,19 +57,13 @@ extern Client* client;
 
 using namespace std;
 
-#include <boost/bind.hpp>
-#include "../../lib/threadpool/threadpool.hpp"
-using namespace boost::threadpool;
-
-pool _parsingtp;
-pool threadPools[MSGTYPE_END];
+#include "../common/executor.hh"
 
 // global variable defined in each component
 extern ConfigLayer* configLayer;
 
 // mutex
 boost::shared_mutex connectionMapMutex;
-boost::shared_mutex threadPoolMapMutex;
 
 const uint32_t MSG_HEADER_SIZE = sizeof(struct MsgHeader);
 
@@ -75,12 +75,11 @@ Communicator::Communicator() {
     // initialize variables
     _requestId = 0;
     _updateId = 0;
-    _maxFd = 0;
     _connectionMap = {};
 
     _sockfdBufMap = {};
 
-    // select timeout
+    // epoll_wait timeout
     _timeoutSec = configLayer->getConfigInt("Communication>SelectTimeout>sec");
     _timeoutUsec = configLayer->getConfigInt(
             "Communication>SelectTimeout>usec");
@@ -92,8 +91,38 @@ Communicator::Communicator() {
     // default: use random port
     _serverPort = 0;
 
-    _pollingInterval = configLayer->getConfigInt(
-            "Communication>SendPollingInterval");
+    // number of sender threads, not related to number of connections
+    int numSenders = configLayer->getConfigInt(
+            "Communication>NumSenderThreads");
+    if (numSenders <= 0) {
+        numSenders = NUM_SENDER_THREADS;
+    }
+    _numSenders = (uint32_t) numSenders;
+
+    // number of receive reactors, each owns an epoll instance
+    int numReactors = configLayer->getConfigInt(
+            "Communication>NumReactorThreads");
+    if (numReactors <= 0) {
+        numReactors = NUM_REACTOR_THREADS;
+    }
+    _numReactors = (uint32_t) numReactors;
+
+    // create the epoll instances here so that connections established
+    // before waitForMessage() starts can already be registered
+    for (uint32_t i = 0; i < _numReactors; i++) {
+        int epollFd = epoll_create1(0);
+        if (epollFd < 0) {
+            perror("epoll_create1");
+            debug_error("%s\n", "Cannot create epoll instance");
+            exit(-1);
+        }
+        _epollFd.push_back(epollFd);
+    }
+
+    _isSending = true;
+    for (uint32_t i = 0; i < _numSenders; i++) {
+        _senderThreads.push_back(thread(&Communicator::sendThread, this));
+    }
 
 	int forwardMode = configLayer->getConfigInt("Communication>ForwardMode");
 	if (forwardMode == 1) {
@@ -109,6 +138,17 @@ Communicator::Communicator() {
 }
 
 Communicator::~Communicator() {
+    {
+        lock_guard<mutex> lk(_sendReadyMutex);
+        _isSending = false;
+    }
+    _sendReadyCond.notify_all();
+    for (thread& t : _senderThreads) {
+        t.join();
+    }
+    for (int epollFd : _epollFd) {
+        close(epollFd);
+    }
     debug("%s\n", "Communicator destructed");
 }
 
@@ -134,186 +174,270 @@ void Communicator::createServerSocket() {
 }
 
 /*
- * Runs in a while (1) loop
- * 1. Add serverSockfd to fd_set
- * 2. Add sockfd for all connections to fd_set
- * 3. Use select to monitor all fds
- * 4. If select returns:
- * 		serverSockfd is set : accept connection and save in map
- * 		other sockfd is set : receive a header
- * 		timeout: check if all connections are still alive
+ * 1. Look up the executor class of each MsgType
+ * 2. Register serverSockfd to the first reactor
+ * 3. Start a thread for each additional reactor
+ * 4. Run the first reactor in the calling thread
  */
 
 void Communicator::waitForMessage() {
 
-    map<uint32_t, Connection*>::iterator p; // connectionMap iterator
-
-    int result; // return value for select
-    fd_set sockfdSet; // fd_set for select
-    struct timeval tv; // timeout for select
-
-    const uint32_t serverSockfd = _serverSocket.getSockfd();
-
-    // adjust _maxFd
-    if (serverSockfd > _maxFd) {
-        _maxFd = serverSockfd;
-    }
-
-    // each MsgType has its own threadpool
-    // number of threads in each pool is defined in _threadPoolSize in the message
-    // pool threadPools[MSGTYPE_END]; MOVE TO GLOBAL
+    // all MsgTypes share the executor, the class is defined in _taskClass
+    // in the message
+    _msgTaskClass[DEFAULT] = CONTROL_TASK;
     for (int i = 1; i < MSGTYPE_END; i++) { // i = 1 skip DEFAULT
         Message* tempMessage = MessageFactory::createMessage(this, (MsgType) i);
-        uint32_t threadPoolSize = tempMessage->getThreadPoolSize();
-        threadPools[i].size_controller().resize(threadPoolSize);
+        _msgTaskClass[i] = tempMessage->getTaskClass();
         delete tempMessage;
     }
 
-    while (1) {
+    // listen socket is level-triggered, one accept per wakeup
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = _serverSocket.getSockfd();
+    if (epoll_ctl(_epollFd[0], EPOLL_CTL_ADD, ev.data.fd, &ev) < 0) {
+        perror("epoll_ctl");
+        debug_error("Cannot add server sockfd = %" PRIu32 " to epoll\n",
+                _serverSocket.getSockfd());
+        exit(-1);
+    }
 
-        // reset timeout
-        tv.tv_sec = _timeoutSec;
-        tv.tv_usec = _timeoutUsec;
+    for (uint32_t i = 1; i < _numReactors; i++) {
+        _reactorThreads.push_back(
+                thread(&Communicator::reactorLoop, this, i));
+    }
 
-        FD_ZERO(&sockfdSet);
+    reactorLoop(0);
 
-        // add listen socket
-        FD_SET(serverSockfd, &sockfdSet);
+}
 
-        // add all socket descriptors into sockfdSet
-        {
-            boost::shared_lock<boost::shared_mutex> lock(connectionMapMutex);
-            for (p = _connectionMap.begin(); p != _connectionMap.end(); p++) {
-                if (p->second->getIsDisconnected() == false) {
-                    FD_SET(p->second->getSockfd(), &sockfdSet);
-                }
-            }
-        }
+/*
+ * Runs in a while (1) loop
+ * 1. Wait for events on the epoll instance of this reactor
+ * 2. For each event:
+ * 		serverSockfd : accept connection and save in map
+ * 		other sockfd : drain the socket and parse the messages
+ */
+
+void Communicator::reactorLoop(uint32_t reactorId) {
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    const int epollFd = _epollFd[reactorId];
+    const int serverSockfd = _serverSocket.getSockfd();
+    const int timeout = _timeoutSec * 1000 + _timeoutUsec / 1000;
+
+    debug("Reactor %" PRIu32 " started on epoll fd = %d\n", reactorId, epollFd);
+
+    while (1) {
 
-        // invoke select
-        result = select(_maxFd + 1, &sockfdSet, NULL, NULL, &tv);
+        int result = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, timeout);
 
         if (result < 0) {
-            cerr << "select error" << endl;
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "epoll_wait error" << endl;
             return;
-        } else if (result == 0) {
-            // select timeout
-        } else {
-            // select returns normally
         }
 
-        // if there is a new connection
-        if (FD_ISSET(_serverSocket.getSockfd(), &sockfdSet)) {
-
-            // accept connection
-            Connection* conn = new Connection();
-            _serverSocket.accept(conn->getSocket());
-
-            // add connection to _connectionMap
-            {
-                boost::unique_lock<boost::shared_mutex> lock(
-                        connectionMapMutex);
-                _connectionMap[conn->getSockfd()] = conn;
-                //thread tempSendThread(&Communicator::sendMessage,this,conn->getSockfd());
-                _outMessageQueue[conn->getSockfd()] = new struct LowLockQueue<
-                        Message *>();
-                _outDataQueue[conn->getSockfd()] = new struct LowLockQueue<
-                        Message *>();
-                _outBlockQueue[conn->getSockfd()] = new struct LowLockQueue<
-                        Message *>();
-                _dataMutex[conn->getSockfd()] = new mutex();
-                _sendThread[conn->getSockfd()] = thread(
-                        &Communicator::sendMessage, this, conn->getSockfd());
+        for (int i = 0; i < result; i++) {
+            const uint32_t sockfd = (uint32_t) events[i].data.fd;
+            if (events[i].data.fd == serverSockfd) {
+                acceptConnection();
+                continue;
             }
 
-            // Receive Optimization
-            // add new socket to mutexMap and bufMap
-            _sockfdBufMap[conn->getSockfd()] = new RecvBuffer();
-            debug_cyan("Add socket to mutex and buf map %" PRIu32 "\n",
-                    conn->getSockfd());
-
-            debug("New connection sockfd = %" PRIu32 "\n", conn->getSockfd());
+            // socket drained by peer, resume the pending send
+            if (events[i].events & EPOLLOUT) {
+                setWaitWritable(sockfd, false);
+                pushSendReady(sockfd);
+            }
 
-            // adjust _maxFd
-            if (conn->getSockfd() > _maxFd) {
-                _maxFd = conn->getSockfd();
+            // EPOLLRDHUP / EPOLLHUP are detected by a zero-byte recv
+            if (events[i].events & ~EPOLLOUT) {
+                receiveFromSocket(sockfd);
             }
         }
 
-        // if there is data in existing connections
-        { // start critical session
-            boost::upgrade_lock<boost::shared_mutex> lock(connectionMapMutex);
-            p = _connectionMap.begin();
-            while (p != _connectionMap.end()) {
+    } // end while (1)
 
-                uint32_t sockfd = p->second->getSockfd();
+}
 
-                // if socket has data available
-                if (FD_ISSET(sockfd, &sockfdSet)) {
+void Communicator::acceptConnection() {
 
-                    //debug("FD_ISSET FD = %" PRIu32 "\n", sockfd);
+    // accept connection
+    Connection* conn = new Connection();
+    if (!_serverSocket.accept(conn->getSocket())) {
+        perror("accept");
+        delete conn;
+        return;
+    }
 
-                    // check if connection is lost
-                    int nbytes = 0;
-                    ioctl(p->second->getSockfd(), FIONREAD, &nbytes);
-                    if (nbytes == 0) {
+    registerConnection(conn);
 
-                        /*
-                             // upgrade shared lock to exclusive lock
-                             boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(
-                             lock);
-                         */
+    debug("New connection sockfd = %" PRIu32 "\n", conn->getSockfd());
+}
 
-                        // disconnect and remove from _connectionMap
-                        debug("SOCKFD = %" PRIu32 " connection lost\n",
-                                p->first);
+/**
+ * 1. Make the socket non-blocking for the reactors and sendfile
+ * 2. Add the connection to _connectionMap and create its out queues
+ * 3. Allocate the receive buffer
+ * 4. Register the sockfd to its reactor (edge-triggered)
+ */
 
-                        // Receive Optimization
-                        _sockfdBufMap.erase(p->first);
-                        debug("SOCKET %" PRIu32 " deleted from Map\n",
-                                p->first);
-                        debug(
-                                "SOCKFD = %" PRIu32 " delete from mutex map\n",
-                                p->first);
+void Communicator::registerConnection(Connection* conn) {
 
-#ifdef COMPILE_FOR_MONITOR
-                        monitor->getStatModule()->removeStatBySockfd(
-                                sockfd);
-#endif
-                        // hack: post-increment adjusts iterator even erase is called
-                        //							_connectionMap.erase(p++);
-                        p->second->setIsDisconnected(true);
-                        p++;
-
-                        continue;
-                    } else {
-
-                        struct RecvBuffer* rb = _sockfdBufMap[sockfd];
-
-                        int32_t byteRead =
-                                p->second->getSocket()->aggressiveRecv(
-                                        rb->buf + rb->len,
-                                        RECV_BUF_PER_SOCKET - rb->len);
-                        rb->len += byteRead;
-                        if (byteRead != 0) {
-                            parsing(sockfd);
-                        }
+    const uint32_t sockfd = conn->getSockfd();
+    conn->getSocket()->set_non_blocking(true);
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(connectionMapMutex);
+        _connectionMap[sockfd] = conn;
+        _outMessageQueue[sockfd] = new struct BoundedQueue<Message *>(
+                OUT_QUEUE_CAPACITY);
+        _outDataQueue[sockfd] = new struct BoundedQueue<Message *>(
+                OUT_QUEUE_CAPACITY);
+        _outBlockQueue[sockfd] = new struct BoundedQueue<Message *>(
+                OUT_QUEUE_CAPACITY);
+        _transferWindow[sockfd] = new struct TransferWindow();
+
+        // Receive Optimization
+        // buffer must exist before the reactor sees the sockfd
+        if (_sockfdBufMap.count(sockfd)) {
+            delete _sockfdBufMap[sockfd];
+        }
+        _sockfdBufMap[sockfd] = new RecvBuffer();
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(_epollFd[sockfd % _numReactors], EPOLL_CTL_ADD, sockfd, &ev)
+            < 0) {
+        perror("epoll_ctl");
+        debug_error("Cannot add sockfd = %" PRIu32 " to epoll\n", sockfd);
+        exit(-1);
+    }
+}
+
+/**
+ * Edge-triggered: keep reading until the socket is drained,
+ * parsing after every read so that the buffer is freed for the next one
+ */
+
+void Communicator::receiveFromSocket(uint32_t sockfd) {
+
+    bool connectionLost = false;
+
+    { // start critical section
+        boost::shared_lock<boost::shared_mutex> lock(connectionMapMutex);
+
+        map<uint32_t, Connection*>::iterator p = _connectionMap.find(sockfd);
+        map<uint32_t, struct RecvBuffer*>::iterator q = _sockfdBufMap.find(
+                sockfd);
+        if (p == _connectionMap.end() || q == _sockfdBufMap.end()
+                || p->second->getIsDisconnected()) {
+            return;
+        }
+
+        Socket* socket = p->second->getSocket();
+        struct RecvBuffer* rb = q->second;
+
+        while (1) {
+
+            int32_t byteRead;
+
+            if (rb->msgBuf != NULL) {
+                // large message: receive the rest straight into its buffer
+                byteRead = socket->nonBlockingRecv(
+                        rb->msgBuf + rb->msgReceived,
+                        rb->msgLength - rb->msgReceived);
+                if (byteRead > 0) {
+                    rb->msgReceived += byteRead;
+                    if (rb->msgReceived == rb->msgLength) {
+                        scheduleDispatch(rb->msgBuf, sockfd);
+                        rb->msgBuf = NULL;
                     }
+                    continue;
+                }
+            } else {
+                // a full buffer is compacted by parsing(), messages that
+                // cannot fit are moved out and received in place
+                if (rb->len == RECV_BUF_PER_SOCKET) {
+                    parsing(sockfd);
+                }
+                byteRead = socket->nonBlockingRecv(rb->buf + rb->len,
+                        RECV_BUF_PER_SOCKET - rb->len);
+                if (byteRead > 0) {
+                    rb->len += byteRead;
+                    parsing(sockfd);
+                    continue;
                 }
+            }
 
-                p++;
+            if (byteRead == 0) {
+                connectionLost = true;
             }
-        } // end critical section
+            // otherwise drained
+            break;
+        }
+    } // end critical section
 
-    } // end while (1)
+    if (connectionLost) {
+        handleDisconnect(sockfd);
+    }
+}
+
+void Communicator::handleDisconnect(uint32_t sockfd) {
+
+    // disconnect and remove from _connectionMap
+    debug("SOCKFD = %" PRIu32 " connection lost\n", sockfd);
+
+    vector<uint32_t> offlineOsdList;
+    {
+        boost::unique_lock<boost::shared_mutex> lock(connectionMapMutex);
+
+        epoll_ctl(_epollFd[sockfd % _numReactors], EPOLL_CTL_DEL, sockfd,
+                NULL);
+
+        // Receive Optimization
+        if (_sockfdBufMap.count(sockfd)) {
+            delete _sockfdBufMap[sockfd];
+            _sockfdBufMap.erase(sockfd);
+        }
+        debug("SOCKET %" PRIu32 " deleted from Map\n", sockfd);
+
+#ifdef COMPILE_FOR_MONITOR
+        offlineOsdList = monitor->getStatModule()->removeStatBySockfd(sockfd);
+#endif
+
+        if (_connectionMap.count(sockfd)) {
+            _connectionMap[sockfd]->setIsDisconnected(true);
+        }
+    }
 
+    // sending takes connectionMapMutex again and may block on a full queue
+#ifdef COMPILE_FOR_MONITOR
+    for (uint32_t osdId : offlineOsdList) {
+        monitor->getStatModule()->broadcastOsdShutdown(this, osdId);
+    }
+#endif
 }
 
+/**
+ * 1. Copy each complete message out of the receive buffer and dispatch it
+ * 2. If a large message is incomplete, move the received part to a buffer
+ *    of the message size and receive the rest into it directly
+ * 3. Rewind the buffer when it is drained, only compact when it is full
+ */
+
 void Communicator::parsing(uint32_t sockfd) {
     struct RecvBuffer* recvBuffer = _sockfdBufMap[sockfd];
     debug("PARSING START FOR SOCKFD %" PRIu32 " BUF LEN = %" PRIu32 "\n",
-            sockfd, recvBuffer->len);
-    uint32_t idx = 0;
+            sockfd, recvBuffer->len - recvBuffer->start);
+    uint32_t idx = recvBuffer->start;
     struct MsgHeader *msgHeader;
     MsgType msgType;
     while (idx + MSG_HEADER_SIZE <= recvBuffer->len) {
@@ -327,34 +451,58 @@ void Communicator::parsing(uint32_t sockfd) {
                 EnumToString::toString(msgType), sockfd, recvBuffer->len, idx,
                 totalMsgSize);
         if (idx + totalMsgSize <= recvBuffer->len) {
-            char* buffer = MemoryPool::getInstance().poolMalloc(totalMsgSize);
+            char* buffer = MemoryPool::getInstance().poolMalloc(totalMsgSize,
+                    false);
             memcpy(buffer, recvBuffer->buf + idx, totalMsgSize);
-            // DISPATCH
-            threadPools[msgType].schedule(
-                    boost::bind(&Communicator::dispatch, this, buffer, sockfd,
-                            0));
-            debug("Add Thread Pool [%s] Active: %d/Pending: %d/Size: %d\n",
-                    EnumToString::toString(msgType),
-                    (int )threadPools[msgType].active(),
-                    (int )threadPools[msgType].pending(),
-                    (int )threadPools[msgType].size());
+            scheduleDispatch(buffer, sockfd);
             idx += totalMsgSize;
+        } else if (totalMsgSize >= DIRECT_RECV_THRESHOLD
+                || totalMsgSize > RECV_BUF_PER_SOCKET) {
+            // poolFree in message.cc->handle()
+            const uint32_t byteReceived = recvBuffer->len - idx;
+            recvBuffer->msgBuf = MemoryPool::getInstance().poolMalloc(
+                    totalMsgSize, false);
+            memcpy(recvBuffer->msgBuf, recvBuffer->buf + idx, byteReceived);
+            recvBuffer->msgLength = totalMsgSize;
+            recvBuffer->msgReceived = byteReceived;
+            idx = recvBuffer->len;
+            break;
         } else {
-            // Not receive complete message, memmove to head
+            // Not receive complete message
             break;
         }
     }
-    if (idx > 0) {
-        memmove(recvBuffer->buf, recvBuffer->buf + idx, recvBuffer->len - idx);
-        recvBuffer->len = recvBuffer->len - idx;
+
+    if (idx == recvBuffer->len) {
+        recvBuffer->start = 0;
+        recvBuffer->len = 0;
+    } else {
+        recvBuffer->start = idx;
+        // the incomplete message is small, move it to head only if no space
+        if (recvBuffer->len == RECV_BUF_PER_SOCKET) {
+            memmove(recvBuffer->buf, recvBuffer->buf + idx,
+                    recvBuffer->len - idx);
+            recvBuffer->len = recvBuffer->len - idx;
+            recvBuffer->start = 0;
+        }
     }
 
 }
 
+void Communicator::scheduleDispatch(char* buf, uint32_t sockfd) {
+    const MsgType msgType = ((struct MsgHeader*) buf)->protocolMsgType;
+    // DISPATCH
+    Executor::getInstance().schedule(_msgTaskClass[msgType],
+            [this, buf, sockfd]() {dispatch(buf, sockfd, 0);});
+    debug("Add Task [%s] to %s\n", EnumToString::toString(msgType),
+            EnumToString::toString(_msgTaskClass[msgType]));
+}
+
 /**
  * 1. Set a requestId for a message if it is 0
- * 2. Push the message to _outMessageQueue
+ * 2. Push the message to _outMessageQueue, block while the queue is full
  * 3. If need to wait for reply, add the message to waitReplyMessageMap
+ * 4. Wake up a sender thread for the socket
  */
 
 void Communicator::addMessage(Message* message, bool expectReply,
@@ -396,6 +544,7 @@ void Communicator::addMessage(Message* message, bool expectReply,
         _outMessageQueue[message->getSockfd()]->push(message);
     }
 
+    scheduleSend(message->getSockfd());
 }
 
 Message* Communicator::popWaitReplyMessage(uint32_t requestId) {
@@ -412,57 +561,98 @@ Message* Communicator::popWaitReplyMessage(uint32_t requestId) {
     return NULL;
 }
 
-void Communicator::sendMessage(uint32_t fd) {
+void Communicator::scheduleSend(uint32_t sockfd) {
+    {
+        boost::shared_lock<boost::shared_mutex> lock(connectionMapMutex);
+        map<uint32_t, Connection*>::iterator p = _connectionMap.find(sockfd);
+        if (p == _connectionMap.end() || !p->second->trySetSendScheduled()) {
+            return;
+        }
+    }
+    pushSendReady(sockfd);
+}
 
-    while (1) {
+void Communicator::pushSendReady(uint32_t sockfd) {
+    {
+        lock_guard<mutex> lk(_sendReadyMutex);
+        _sendReadyQueue.push_back(sockfd);
+    }
+    _sendReadyCond.notify_one();
+}
 
-        vector<Message*> messages;
-        Message* message;
+void Communicator::setWaitWritable(uint32_t sockfd, bool enable) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (enable) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = sockfd;
+    if (epoll_ctl(_epollFd[sockfd % _numReactors], EPOLL_CTL_MOD, sockfd, &ev)
+            < 0) {
+        perror("epoll_ctl");
+        debug_error("Cannot modify sockfd = %" PRIu32 " in epoll\n", sockfd);
+    }
+}
 
-        // send all message in the outMessageQueue
-        while ((message = popMessage(fd)) != NULL) {
-            messages.push_back(message);
-            if (messages.size() > 10) break;
-        }
-        if (messages.size() > 0) {
-            message = messages[0];
-            const uint32_t sockfd = message->getSockfd();
-
-            // handle disconnected component
-            if (sockfd == (uint32_t) -1) {
-                debug("Message (ID: %" PRIu32 ") disconnected, ignore\n",
-                        message->getMsgHeader().requestId);
-                debug(
-                        "Deleting Message since sockfd == -1 (Type = %d ID: %" PRIu32 ")\n",
-                        (int )message->getMsgHeader().protocolMsgType,
-                        message->getMsgHeader().requestId);
-                for (Message* message : messages) {
-                    delete message;
+/**
+ * 1. Finish the batch left by the last turn
+ * 2. Send the queued messages in batches
+ * 3. If the socket is full, wait for EPOLLOUT and keep the socket scheduled
+ * 4. If the queues are empty, release the socket
+ * 5. If the turn is used up, requeue the socket behind the others
+ */
+
+void Communicator::sendMessage(uint32_t fd) {
+
+    boost::shared_lock<boost::shared_mutex> lock(connectionMapMutex);
+
+    map<uint32_t, Connection*>::iterator p = _connectionMap.find(fd);
+    if (p == _connectionMap.end() || p->second->getIsDisconnected()) {
+        debug("Connection SOCKFD = %" PRIu32 " not found, drop messages\n",
+                fd);
+        Message* messages[SEND_BATCH_SIZE];
+        uint32_t count;
+        while ((count = popMessages(fd, messages, SEND_BATCH_SIZE)) > 0) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (!messages[i]->isExpectReply()) {
+                    delete messages[i];
                 }
-                continue;
             }
+        }
+        if (p != _connectionMap.end()) {
+            p->second->clearSendScheduled();
+        }
+        return;
+    }
+    Connection* conn = p->second;
 
-            {
-                boost::shared_lock<boost::shared_mutex> lock(
-                        connectionMapMutex);
-                if (!(_connectionMap.count(sockfd))) {
-                    debug("Connection SOCKFD = %" PRIu32 " not found!\n",
-                            sockfd);
-                    debug(
-                            "Deleting Message since sockfd not found (Type = %d ID: %" PRIu32 ")\n",
-                            (int )message->getMsgHeader().protocolMsgType,
-                            message->getMsgHeader().requestId);
-                    for (Message* message : messages) {
-                        delete message;
-                    }
-                    continue;
-                }
-                _connectionMap[sockfd]->sendMessages(messages);
+    if (!conn->flushSendBuffer()) {
+        setWaitWritable(fd, true);
+        return;
+    }
+
+    for (uint32_t turn = 0; turn < SEND_BATCHES_PER_TURN; turn++) {
+
+        vector<Message*> messages(SEND_BATCH_SIZE);
+        messages.resize(popMessages(fd, messages.data(), SEND_BATCH_SIZE));
+
+        if (messages.empty()) {
+            conn->clearSendScheduled();
+            // a message may be pushed before the flag is cleared
+            if (!hasOutMessage(fd) || !conn->trySetSendScheduled()) {
+                return;
             }
+            continue;
         }
 
-        usleep(_pollingInterval); // in terms of 10^-6 seconds
+        if (!conn->sendMessages(messages)) {
+            setWaitWritable(fd, true);
+            return;
+        }
     }
+
+    pushSendReady(fd);
 }
 
 /**
@@ -478,24 +668,7 @@ uint32_t Communicator::connectAndAdd(string ip, uint16_t port,
     const uint32_t sockfd = conn->doConnect(ip, port, connectionType);
 
     // Save the connection into corresponding list
-    {
-        boost::unique_lock<boost::shared_mutex> lock(connectionMapMutex);
-        _connectionMap[sockfd] = conn;
-        //	thread tempSendThread(&Communicator::sendMessage,this,conn->getSockfd());
-        _outMessageQueue[conn->getSockfd()] =
-                new struct LowLockQueue<Message *>();
-        _outDataQueue[conn->getSockfd()] = new struct LowLockQueue<Message *>();
-        _outBlockQueue[conn->getSockfd()] =
-                new struct LowLockQueue<Message *>();
-        _dataMutex[conn->getSockfd()] = new mutex();
-        _sendThread[conn->getSockfd()] = thread(&Communicator::sendMessage,
-                this, conn->getSockfd());
-    }
-
-    // adjust _maxFd
-    if (sockfd > _maxFd) {
-        _maxFd = sockfd;
-    }
+    registerConnection(conn);
 
     return sockfd;
 }
@@ -573,6 +746,22 @@ void Communicator::handleThread(Message* message) {
 
 // static function
 void Communicator::sendThread(Communicator* communicator) {
+    while (1) {
+        uint32_t sockfd;
+        {
+            unique_lock<mutex> lk(communicator->_sendReadyMutex);
+            while (communicator->_sendReadyQueue.empty()
+                    && communicator->_isSending) {
+                communicator->_sendReadyCond.wait(lk);
+            }
+            if (communicator->_sendReadyQueue.empty()) {
+                return;
+            }
+            sockfd = communicator->_sendReadyQueue.front();
+            communicator->_sendReadyQueue.pop_front();
+        }
+        communicator->sendMessage(sockfd);
+    }
 }
 
 /**
@@ -613,16 +802,23 @@ void Communicator::dispatch(char* buf, uint32_t sockfd,
     message->handle();
 }
 
-Message* Communicator::popMessage(uint32_t fd) {
-    Message* message = NULL;
-    if (_outMessageQueue[fd]->pop(message) != false) {
-        return message;
-    } else if (_outDataQueue[fd]->pop(message) != false) {
-        return message;
-    } else if (_outBlockQueue[fd]->pop(message) != false) {
-        return message;
-    } else
-        return NULL;
+uint32_t Communicator::popMessages(uint32_t fd, Message** messages,
+        uint32_t maxCount) {
+    uint32_t count = _outMessageQueue[fd]->popBatch(messages, maxCount);
+    if (count < maxCount) {
+        count += _outDataQueue[fd]->popBatch(messages + count,
+                maxCount - count);
+    }
+    if (count < maxCount) {
+        count += _outBlockQueue[fd]->popBatch(messages + count,
+                maxCount - count);
+    }
+    return count;
+}
+
+bool Communicator::hasOutMessage(uint32_t fd) {
+    return !_outMessageQueue[fd]->isEmpty() || !_outDataQueue[fd]->isEmpty()
+            || !_outBlockQueue[fd]->isEmpty();
 }
 
 void Communicator::waitAndDelete(Message* message) {
@@ -800,9 +996,6 @@ void Communicator::connectToComponents(vector<Component> componentList) {
 void Communicator::connectToMyself(string ip, uint16_t port,
         ComponentType type) {
     uint32_t sockfd = connectAndAdd(ip, port, type);
-    _sockfdBufMap[sockfd] = new RecvBuffer();
-    debug_cyan("connectToMySelf: Add socket to mutex and buf map %" PRIu32 "\n",
-            sockfd);
     requestHandshake(sockfd, _componentId, _componentType);
 }
 
@@ -812,10 +1005,6 @@ void Communicator::connectToMonitor() {
     for (Component component : monitorList) {
         uint32_t sockfd = connectAndAdd(component.ip, component.port,
                 component.type);
-        _sockfdBufMap[sockfd] = new RecvBuffer();
-        debug_cyan(
-                "connectToMonitor: Add socket to mutex and buf map %" PRIu32 "\n",
-                sockfd);
         requestHandshake(sockfd, _componentId, _componentType);
     }
 }
@@ -826,10 +1015,6 @@ void Communicator::connectToMds() {
     for (Component component : mdsList) {
         uint32_t sockfd = connectAndAdd(component.ip, component.port,
                 component.type);
-        _sockfdBufMap[sockfd] = new RecvBuffer();
-        debug_cyan(
-                "connectToMds: Add socket to mutex and buf map %" PRIu32 "\n",
-                sockfd);
         requestHandshake(sockfd, _componentId, _componentType);
     }
 }
@@ -837,9 +1022,6 @@ void Communicator::connectToMds() {
 void Communicator::connectToOsd(uint32_t dstOsdIp, uint32_t dstOsdPort) {
     uint32_t sockfd = connectAndAdd(Ipv4Int2Str(dstOsdIp), dstOsdPort,
             _componentType);
-    _sockfdBufMap[sockfd] = new RecvBuffer();
-    debug_cyan("connectToOsd: Add socket to mutex and buf map %" PRIu32 "\n",
-            sockfd);
     requestHandshake(sockfd, _componentId, _componentType);
 }
 
@@ -922,16 +1104,16 @@ uint32_t Communicator::sendSegment(uint32_t componentId, uint32_t sockfd,
                 codingSetting, updateKey, buf, offsetLength);
     }
 
-    // Step 1 : Send Init message (wait for reply)
+    // Step 1 : Queue Init message, the reply is waited for after the data
 
-    lockDataQueue(sockfd);
+    PutSegmentInitRequestMsg* putSegmentInitRequestMsg = putSegmentInit(
+            componentId, sockfd, segmentId, segmentData.info.segLength,
+            totalSize, chunkCount, codingScheme, codingSetting, updateKey);
 
-    DataMsgType dataMsgType = putSegmentInit(componentId, sockfd, segmentId,
-            segmentData.info.segLength, totalSize, chunkCount, codingScheme,
-            codingSetting, updateKey);
-    debug("%s\n", "Put Segment Init ACK-ed");
-
-    // Step 2 : Send data chunk by chunk
+    // Step 2 : Send data chunk by chunk within the transfer window
+    // chunks of other segments to the same sockfd may be interleaved, the
+    // receiver finds the transfer by updateKey and learns the data msg type
+    // from the Init message that is queued ahead of the first chunk
 
     uint64_t byteToSend = 0;
     uint64_t byteProcessed = 0;
@@ -945,16 +1127,18 @@ uint32_t Communicator::sendSegment(uint32_t componentId, uint32_t sockfd,
             byteToSend = byteRemaining;
         }
 
+        acquireSendCredit(sockfd, byteToSend);
         putSegmentData(componentId, sockfd, segmentId, buf, byteProcessed,
-                byteToSend, dataMsgType, updateKey);
+                byteToSend, DEFAULT_DATA_MSG, updateKey);
         byteProcessed += byteToSend;
         byteRemaining -= byteToSend;
 
     }
 
-    // Step 3: Send End message
+    DataMsgType dataMsgType = waitPutSegmentInit(putSegmentInitRequestMsg);
+    debug("%s\n", "Put Segment Init ACK-ed");
 
-    unlockDataQueue(sockfd);
+    // Step 3: Send End message
 
     putSegmentEnd(componentId, sockfd, segmentId, dataMsgType, updateKey,
             offsetLength);
@@ -965,18 +1149,301 @@ uint32_t Communicator::sendSegment(uint32_t componentId, uint32_t sockfd,
 
 }
 
-void Communicator::lockDataQueue(uint32_t sockfd) {
-    _dataMutex[sockfd]->lock();
+/**
+ * 1. Wait until the chunk fits in the window, or the window is nearly empty
+ * 2. Count the chunk as outstanding
+ */
+
+void Communicator::acquireSendCredit(uint32_t sockfd, uint32_t length) {
+    struct TransferWindow* window = _transferWindow[sockfd];
+    unique_lock<mutex> lk(window->m);
+    if (window->outstanding + length > TRANSFER_WINDOW_SIZE
+            && window->outstanding >= TRANSFER_CREDIT_BATCH) {
+        Executor::BlockingScope blocking;
+        window->creditReturned.wait(lk,
+                [window, length] {
+                    return window->outstanding + length <= TRANSFER_WINDOW_SIZE
+                    || window->outstanding < TRANSFER_CREDIT_BATCH;
+                });
+    }
+    window->outstanding += length;
+}
+
+void Communicator::addSendCredit(uint32_t sockfd, uint32_t credit) {
+    struct TransferWindow* window = _transferWindow[sockfd];
+    lock_guard<mutex> lk(window->m);
+    if (credit > window->outstanding) {
+        debug_error("Credit %" PRIu32 " > outstanding %" PRIu64 " sockfd = %"
+                PRIu32 "\n", credit, window->outstanding, sockfd);
+        window->outstanding = 0;
+    } else {
+        window->outstanding -= credit;
+    }
+    window->creditReturned.notify_all();
 }
 
-void Communicator::unlockDataQueue(uint32_t sockfd) {
-    _dataMutex[sockfd]->unlock();
+void Communicator::returnCredit(uint32_t sockfd, uint32_t length) {
+    struct TransferWindow* window = _transferWindow[sockfd];
+    uint32_t credit = 0;
+    {
+        lock_guard<mutex> lk(window->m);
+        window->handled += length;
+        if (window->handled >= TRANSFER_CREDIT_BATCH) {
+            credit = window->handled;
+            window->handled = 0;
+        }
+    }
+    if (credit > 0) {
+        TransferCreditMsg* transferCreditMsg = new TransferCreditMsg(this,
+                sockfd, credit);
+        transferCreditMsg->prepareProtocolMsg();
+        addMessage(transferCreditMsg);
+    }
 }
+
+uint32_t Communicator::sendBlock(uint32_t sockfd, struct BlockData blockData,
+		DataMsgType dataMsgType, string updateKey) {
+
+	uint64_t segmentId = blockData.info.segmentId;
+	uint32_t blockId = blockData.info.blockId;
+    // this is buffer length held in the BlockData, not the block size
+	uint32_t length = blockData.info.blockSize; 
+	char* buf = blockData.buf;
+	const uint32_t chunkCount = ((length - 1) / _chunkSize) + 1;
+
+	vector<offset_length_t> offsetLength = blockData.info.offlenVector;
+	vector<BlockLocation> parityList = blockData.info.parityVector;
+
+	// step 1: send init message, wait for ack
+
+    debug("XXXXX segmentId = %" PRIu64 " blockid = %" PRIu32 " blocksize = %" PRIu32 "\n", segmentId, blockId, length);
+	debug("Put Block Init to FD = %" PRIu32 "\n", sockfd);
+	putBlockInit(sockfd, segmentId, blockId, length, chunkCount, dataMsgType, updateKey);
+	debug("Put Block Init ACK-ed from FD = %" PRIu32 "\n", sockfd);
+
+	// step 2: send data
+
+	uint64_t byteToSend = 0;
+	uint64_t byteProcessed = 0;
+	uint64_t byteRemaining = length;
+
+	while (byteProcessed < length) {
+
+		if (byteRemaining > _chunkSize) {
+			byteToSend = _chunkSize;
+		} else {
+			byteToSend = byteRemaining;
+		}
+
+		putBlockData(sockfd, segmentId, blockId, buf, byteProcessed, byteToSend,
+				dataMsgType, updateKey);
+		byteProcessed += byteToSend;
+		byteRemaining -= byteToSend;
+
+	}
+
+	// Step 3: Send End message
+
+    putBlockEnd(sockfd, segmentId, blockId, dataMsgType, updateKey,
+            offsetLength, parityList, blockData.info.codingScheme,
+            blockData.info.codingSetting, blockData.info.segmentSize);
+
+	cout << "Put Block ID = " << segmentId << "." << blockId << " Finished"
+			<< endl;
+
+	return 0;
+}
+
+
+uint32_t Communicator::sendBlockFile(uint32_t sockfd, struct BlockData blockData,
+		vector<BlockFileRange> fileRanges, DataMsgType dataMsgType,
+		string updateKey) {
+
+	uint64_t segmentId = blockData.info.segmentId;
+	uint32_t blockId = blockData.info.blockId;
+	uint32_t length = blockData.info.blockSize;
+
+	// chunks do not cross the ranges, each is sent from one file
+	vector<BlockFileRange> chunkList;
+	for (BlockFileRange fileRange : fileRanges) {
+		uint32_t rangeProcessed = 0;
+		while (rangeProcessed < fileRange.length) {
+			BlockFileRange chunk = fileRange;
+			chunk.offset += rangeProcessed;
+			chunk.length = min(_chunkSize, fileRange.length - rangeProcessed);
+			chunkList.push_back(chunk);
+			rangeProcessed += chunk.length;
+		}
+	}
+
+	// step 1: send init message, wait for ack
+
+	debug("Put Block Init to FD = %" PRIu32 "\n", sockfd);
+	putBlockInit(sockfd, segmentId, blockId, length, chunkList.size(),
+			dataMsgType, updateKey);
+	debug("Put Block Init ACK-ed from FD = %" PRIu32 "\n", sockfd);
+
+	// step 2: send data from the files
+
+	uint64_t byteProcessed = 0;
+	for (BlockFileRange chunk : chunkList) {
+		putBlockFileData(sockfd, segmentId, blockId, chunk, byteProcessed,
+				dataMsgType, updateKey);
+		byteProcessed += chunk.length;
+	}
+
+	// Step 3: Send End message
+
+	putBlockEnd(sockfd, segmentId, blockId, dataMsgType, updateKey,
+			blockData.info.offlenVector, blockData.info.parityVector,
+			blockData.info.codingScheme, blockData.info.codingSetting,
+			blockData.info.segmentSize);
+
+	cout << "Put Block ID = " << segmentId << "." << blockId
+			<< " Finished (sendfile)" << endl;
+
+	return 0;
+}
+
+vector<struct BlockLocation> Communicator::getOsdListRequest(
+		uint64_t segmentId, ComponentType dstComponent, uint32_t blockCount,
+		uint32_t primaryId, uint64_t blockSize) {
+
+	GetSecondaryListRequestMsg* getSecondaryListRequestMsg =
+			new GetSecondaryListRequestMsg(this, getMonitorSockfd(), blockCount,
+					primaryId, blockSize);
+	getSecondaryListRequestMsg->prepareProtocolMsg();
+
+	addMessage(getSecondaryListRequestMsg, true);
+	MessageStatus status = getSecondaryListRequestMsg->waitForStatusChange();
+
+	if (status == READY) {
+		vector<struct BlockLocation> osdList =
+				getSecondaryListRequestMsg->getSecondaryList();
+		waitAndDelete(getSecondaryListRequestMsg);
+		return osdList;
+	}
+
+	return {};
+}
+
+bool Communicator::getSegmentRange(uint32_t sockfd, uint64_t segmentId,
+		uint32_t blockId, uint64_t offset, uint32_t length, char* buf,
+		bool isParity) {
+
+	GetSegmentRangeRequestMsg* getSegmentRangeRequestMsg =
+			new GetSegmentRangeRequestMsg(this, sockfd, segmentId, blockId,
+					offset, length, buf, isParity);
+	getSegmentRangeRequestMsg->prepareProtocolMsg();
+
+	addMessage(getSegmentRangeRequestMsg, true);
+	MessageStatus status = getSegmentRangeRequestMsg->waitForStatusChange();
+
+	if (status == READY) {
+		const bool isServed = getSegmentRangeRequestMsg->getIsServed();
+		waitAndDelete(getSegmentRangeRequestMsg);
+		return isServed;
+	}
+
+	return false;
+}
+
+
+void Communicator::putBlockInit(uint32_t sockfd, uint64_t segmentId,
+		uint32_t blockId, uint32_t length, uint32_t chunkCount,
+		DataMsgType dataMsgType, string updateKey) {
+
+	// Step 1 of the upload process
+
+	PutBlockInitRequestMsg* putBlockInitRequestMsg = new PutBlockInitRequestMsg(
+			this, sockfd, segmentId, blockId, length, chunkCount, dataMsgType,
+			updateKey);
+
+	putBlockInitRequestMsg->prepareProtocolMsg();
+	addMessage(putBlockInitRequestMsg, true);
+
+	MessageStatus status = putBlockInitRequestMsg->waitForStatusChange();
+	if (status == READY) {
+		waitAndDelete(putBlockInitRequestMsg);
+		return;
+	} else {
+		debug_error("Put Block Init Failed %" PRIu64 ".%" PRIu32 "\n",
+				segmentId, blockId);
+		exit(-1);
+	}
+
+}
+
+
+void Communicator::putBlockData(uint32_t sockfd, uint64_t segmentId,
+		uint32_t blockId, char* buf, uint64_t offset, uint32_t length,
+		DataMsgType dataMsgType, string updateKey) {
+
+	// Step 2 of the upload process
+	BlockDataMsg* blockDataMsg = new BlockDataMsg(this, sockfd, segmentId,
+			blockId, offset, length, dataMsgType, updateKey);
+
+	blockDataMsg->prepareProtocolMsg();
+	blockDataMsg->preparePayload(buf + offset, length);
+
+	addMessage(blockDataMsg, false);
+}
+
+void Communicator::putBlockFileData(uint32_t sockfd, uint64_t segmentId,
+		uint32_t blockId, BlockFileRange fileRange, uint64_t offset,
+		DataMsgType dataMsgType, string updateKey) {
+
+	BlockDataMsg* blockDataMsg = new BlockDataMsg(this, sockfd, segmentId,
+			blockId, offset, fileRange.length, dataMsgType, updateKey);
+
+	blockDataMsg->prepareProtocolMsg();
+
+	// the message closes its own descriptor once the chunk is sent
+	const int fd = dup(fileRange.fd);
+	if (fd < 0) {
+		perror("dup");
+		exit(-1);
+	}
+	blockDataMsg->preparePayloadFile(fd, fileRange.offset, fileRange.length,
+			fileRange.pin);
+
+	addMessage(blockDataMsg, false);
+}
+
+
+void Communicator::putBlockEnd(uint32_t sockfd, uint64_t segmentId,
+		uint32_t blockId, DataMsgType dataMsgType, string updateKey,
+		vector<offset_length_t> offsetLength, vector<BlockLocation> parityList,
+		CodingScheme codingScheme, string codingSetting, uint64_t segmentSize,
+		bool isAborted, uint32_t unsentChunkCount) {
+
+	// Step 3 of the upload process
+
+	BlockTransferEndRequestMsg* blockTransferEndRequestMsg =
+			new BlockTransferEndRequestMsg(this, sockfd, segmentId, blockId,
+					dataMsgType, updateKey, offsetLength, parityList,
+					codingScheme, codingSetting, segmentSize, isAborted,
+					unsentChunkCount);
+
+	blockTransferEndRequestMsg->prepareProtocolMsg();
+	addMessage(blockTransferEndRequestMsg, true);
+
+	MessageStatus status = blockTransferEndRequestMsg->waitForStatusChange();
+	if (status == READY) {
+		waitAndDelete(blockTransferEndRequestMsg);
+		return;
+	} else {
+		debug_error("Block Transfer End Failed %" PRIu64 ".%" PRIu32 "\n",
+				segmentId, blockId);
+		exit(-1);
+	}
+}
+
 //
 // PRIVATE FUNCTIONS
 //
 
-DataMsgType Communicator::putSegmentInit(uint32_t componentId,
+PutSegmentInitRequestMsg* Communicator::putSegmentInit(uint32_t componentId,
         uint32_t dstOsdSockfd, uint64_t segmentId, uint32_t segLength,
         uint32_t bufLength, uint32_t chunkCount, CodingScheme codingScheme,
         string codingSetting, string updateKey) {
@@ -991,13 +1458,19 @@ DataMsgType Communicator::putSegmentInit(uint32_t componentId,
     putSegmentInitRequestMsg->prepareProtocolMsg();
     addMessage(putSegmentInitRequestMsg, true);
 
+    return putSegmentInitRequestMsg;
+}
+
+DataMsgType Communicator::waitPutSegmentInit(
+        PutSegmentInitRequestMsg* putSegmentInitRequestMsg) {
+
     MessageStatus status = putSegmentInitRequestMsg->waitForStatusChange();
     if (status == READY) {
         DataMsgType dataMsgType = putSegmentInitRequestMsg->getDataMsgType();
         waitAndDelete(putSegmentInitRequestMsg);
         return dataMsgType;
     } else {
-        debug_error("Put Segment Init Failed %" PRIu64 "\n", segmentId);
+        debug_error("%s\n", "Put Segment Init Failed");
         exit(-1);
     }
     return DEFAULT_DATA_MSG;
@@ -11,24 +11,47 @@
 #include <queue>
 #include <map>
 #include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include "../protocol/messagefactory.hh"
 #include "../protocol/message.hh"
 #include "../common/enums.hh"
 #include "../common/define.hh"
 #include "../common/recvbuffer.hh"
-#include "../datastructure/concurrentmap.hh"
+#include "../common/blockdata.hh"
+#include "../common/blocklocation.hh"
+#include "../datastructure/concurrenthashmap.hh"
+#include "../datastructure/boundedqueue.hh"
 #include "socket.hh"
 #include "component.hh"
 #include "connection.hh"
 
-#include "../datastructure/lowlockqueue.hh"
-
 using namespace std;
 
 // forward declaration to avoid circular dependency
 class Message;
 class MessageFactory;
 class Connection;
+class PutSegmentInitRequestMsg;
+
+/**
+ * Credit-based flow control of the SEGMENT_DATA over one connection
+ * A sender may have TRANSFER_WINDOW_SIZE bytes that the receiver has not
+ * handled yet, the receiver returns credit in TRANSFER_CREDIT messages
+ * once it has handled TRANSFER_CREDIT_BATCH bytes
+ */
+
+struct TransferWindow {
+	mutex m;
+	condition_variable creditReturned;
+	uint64_t outstanding; // bytes sent, credit not returned yet
+	uint64_t handled; // bytes received and handled, credit not returned yet
+
+	TransferWindow() :
+			outstanding(0), handled(0) {
+	}
+};
 
 /**
  * Abstract Communication module for all components.
@@ -51,7 +74,8 @@ public:
 	virtual ~Communicator(); // destructor
 
 	/**
-	 * Listen to all the socket descriptors and call select for I/O multiplexing
+	 * Start the receive reactors (epoll) for I/O multiplexing
+	 * Sockets are sharded over the reactors by sockfd
 	 * When a Message is received, call dispatch() to execute handler
 	 */
 
@@ -68,6 +92,13 @@ public:
 	void addMessage(Message* message, bool expectReply = false,
 			uint32_t waitOnRequestId = 0);
 
+	/**
+	 * Write the queued messages of a socket until its queues are empty,
+	 * the socket is full or the turn is used up
+	 * Only one sender thread works on a socket at a time
+	 * @param fd Socket Descriptor scheduled by scheduleSend()
+	 */
+
 	void sendMessage(uint32_t fd);
 
 	/**
@@ -146,8 +177,8 @@ public:
 	void connectAllComponents();
 
 	/**
-	 * Runs in a separate detached thread
-	 * Execute communicator->sendMessage function
+	 * Runs in each of the sender threads
+	 * Wait for a scheduled socket and execute communicator->sendMessage
 	 * @param communicator Corresponding communicator of the component
 	 */
 	static void sendThread(Communicator* communicator);
@@ -199,8 +230,150 @@ public:
 			struct SegmentData segmentData, CodingScheme codingScheme =
 					DEFAULT_CODING, string codingSetting = "");
 
-	void lockDataQueue(uint32_t sockfd);
-	void unlockDataQueue(uint32_t sockfd);
+	/**
+	 * Send a block to an OSD
+	 * @param sockfd Socket Descriptor of the destination
+	 * @param blockData BlockData structure
+	 * @param dataMsgType Data Msg Type
+	 * @return 0 if success, -1 if failure
+	 */
+
+	uint32_t sendBlock(uint32_t sockfd, struct BlockData blockData,
+			DataMsgType dataMsgType, string updateKey = "");
+
+	/**
+	 * Send a block to an OSD straight from the files holding it
+	 * The descriptors are duplicated, the caller still closes them
+	 * @param sockfd Socket Descriptor of the destination
+	 * @param blockData BlockData structure (buf is not used)
+	 * @param fileRanges Ranges of the files holding the block, in order
+	 * @param dataMsgType Data Msg Type
+	 * @return 0 if success, -1 if failure
+	 */
+
+	uint32_t sendBlockFile(uint32_t sockfd, struct BlockData blockData,
+			vector<BlockFileRange> fileRanges, DataMsgType dataMsgType,
+			string updateKey = "");
+
+	/**
+	 * Send a request to get the secondary OSD list of an segment from MDS/Monitor
+	 * Block 0 is placed on the primary
+	 * @param segmentId Segment ID for query
+	 * @param dstComponent Type of the component to request (MDS / MONITOR)
+	 * @param blockCount (optional) Request a specific number of OSD to hold data
+	 * @return List of OSD ID that should contain the segment
+	 */
+
+	vector<struct BlockLocation> getOsdListRequest(uint64_t segmentId,
+			ComponentType dstComponent, uint32_t blockCount, uint32_t primaryId,
+			uint64_t blockSize);
+
+	/**
+	 * Request a byte range of a segment or a block and wait for the data
+	 * @param sockfd Destination OSD Socket Descriptor
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID, SEGMENT_RANGE_WHOLE_SEGMENT for a segment range
+	 * @param offset Offset of the range
+	 * @param length Length of the range
+	 * @param buf Buffer to store the range
+	 * @param isParity (Optional) Whether the block is a parity block
+	 * @return true if buf is filled, false if the range is not served
+	 */
+
+	bool getSegmentRange(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
+			uint64_t offset, uint32_t length, char* buf, bool isParity = false);
+
+	/**
+	 * Initiate upload process to OSD (Step 1)
+	 * @param sockfd Destination OSD Socket Descriptor
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID
+	 * @param length Size of the segment
+	 * @param chunkCount Number of chunks that will be sent
+	 * @param dataMsgType Data Msg Type
+	 * @param updateKey Update key
+	 */
+
+	void putBlockInit(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
+			uint32_t length, uint32_t chunkCount, DataMsgType dataMsgType, string updateKey);
+
+	/**
+	 * Send an segment chunk to OSD (Step 2)
+	 * @param sockfd Destination OSD Socket Descriptor
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID
+	 * @param buf Buffer containing the segment
+	 * @param offset Offset of the chunk inside the buffer
+	 * @param length Length of the chunk
+	 * @param dataMsgType Data Msg Type
+	 * @param updateKey Update key
+	 */
+
+	void putBlockData(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
+			char* buf, uint64_t offset, uint32_t length,
+			DataMsgType dataMsgType, string updateKey);
+
+	/**
+	 * Send a block chunk from a file to OSD (Step 2)
+	 * @param sockfd Destination OSD Socket Descriptor
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID
+	 * @param fileRange Range of the file holding the chunk
+	 * @param offset Offset of the chunk inside the block
+	 * @param dataMsgType Data Msg Type
+	 * @param updateKey Update key
+	 */
+
+	void putBlockFileData(uint32_t sockfd, uint64_t segmentId,
+			uint32_t blockId, BlockFileRange fileRange, uint64_t offset,
+			DataMsgType dataMsgType, string updateKey);
+
+	/**
+	 * Finalise upload process to OSD (Step 3)
+	 * @param sockfd Destination OSD Socket Descriptor
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID
+	 * @param dataMsgType Data Msg Type
+	 * @param updateKey Update key
+	 * @param offsetLength <offset, length> for block updates
+	 * @param isAborted Discard the block once the chunks sent have arrived
+	 * (UPLOAD only)
+	 * @param unsentChunkCount Chunks announced in the init but never sent
+	 */
+
+    void putBlockEnd(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
+            DataMsgType dataMsgType, string updateKey,
+            vector<offset_length_t> offsetLength,
+            vector<BlockLocation> parityList, CodingScheme codingScheme,
+            string codingSetting, uint64_t segmentSize, bool isAborted = false,
+            uint32_t unsentChunkCount = 0);
+
+	/**
+	 * Wait until the window of a connection has room for a chunk, then
+	 * count it as outstanding
+	 * The window may be exceeded by one chunk so that chunks larger than
+	 * the window, or than the credit not returned yet, still go out
+	 * @param sockfd Destination Socket Descriptor
+	 * @param length Length of the chunk
+	 */
+
+	void acquireSendCredit(uint32_t sockfd, uint32_t length);
+
+	/**
+	 * Take back the credit returned by the receiver
+	 * @param sockfd Socket Descriptor of the receiver
+	 * @param credit Number of bytes handled by the receiver
+	 */
+
+	void addSendCredit(uint32_t sockfd, uint32_t credit);
+
+	/**
+	 * Count a handled chunk and return the credit to its sender in batches
+	 * @param sockfd Socket Descriptor of the sender
+	 * @param length Length of the chunk
+	 */
+
+	void returnCredit(uint32_t sockfd, uint32_t length);
 
 	/**
 	 * Connect to monitor (test)
@@ -224,6 +397,8 @@ protected:
 
 	/**
 	 * Initiate upload process to OSD (Step 1)
+	 * Returns without waiting for the reply, the chunks are queued right
+	 * behind the request
 	 * @param componentId My Component ID
 	 * @param dstOsdSockfd Destination OSD Socket Descriptor
 	 * @param segmentId Segment ID
@@ -231,13 +406,23 @@ protected:
 	 * @param bufLength Size of the buf to be send
 	 * @param chunkCount Number of chunks that will be sent
 	 * @param updateKey Update Key
+	 * @return Request to pass to waitPutSegmentInit()
 	 */
 
-	DataMsgType putSegmentInit(uint32_t componentId, uint32_t dstOsdSockfd,
+	PutSegmentInitRequestMsg* putSegmentInit(uint32_t componentId, uint32_t dstOsdSockfd,
 			uint64_t segmentId, uint32_t segLength, uint32_t bufLength, 
             uint32_t chunkCount, CodingScheme codingScheme, 
             string codingSetting, string updateKey);
 
+	/**
+	 * Wait for the reply of a putSegmentInit() request and free it
+	 * @param putSegmentInitRequestMsg Request from putSegmentInit()
+	 * @return Data Msg Type chosen by the OSD
+	 */
+
+	DataMsgType waitPutSegmentInit(
+			PutSegmentInitRequestMsg* putSegmentInitRequestMsg);
+
 	/**
 	 * Send an segment chunk to OSD (Step 2)
 	 * @param componentId Component ID
@@ -291,7 +476,46 @@ protected:
 
 	void dispatch(char* buf, uint32_t sockfd, uint32_t threadPoolLevel);
 
-	Message* popMessage(uint32_t fd);
+	/**
+	 * Pop a batch of messages of a socket
+	 * Control messages go first, then segment data, then block data
+	 * @param fd Socket Descriptor
+	 * @param messages Array to hold the popped messages
+	 * @param maxCount Size of the array
+	 * @return Number of messages popped, 0 if all out queues are empty
+	 */
+
+	uint32_t popMessages(uint32_t fd, Message** messages, uint32_t maxCount);
+
+	/**
+	 * Check if any of the out queues of a socket has message
+	 * @param fd Socket Descriptor
+	 * @return true if there is message to send
+	 */
+
+	bool hasOutMessage(uint32_t fd);
+
+	/**
+	 * Hand a socket to the sender threads if it is not queued already
+	 * @param sockfd Socket Descriptor with new messages
+	 */
+
+	void scheduleSend(uint32_t sockfd);
+
+	/**
+	 * Push a socket to the ready queue and wake up a sender thread
+	 * @param sockfd Socket Descriptor already marked as scheduled
+	 */
+
+	void pushSendReady(uint32_t sockfd);
+
+	/**
+	 * Ask the reactor to report when the socket becomes writable
+	 * @param sockfd Socket Descriptor
+	 * @param enable true to wait for EPOLLOUT, false to stop waiting
+	 */
+
+	void setWaitWritable(uint32_t sockfd, bool enable);
 
 	/**
 	 * Delete the message when it is deletable
@@ -337,23 +561,75 @@ protected:
 	// DEBUG
 	void listThreadPool();
 
+	/**
+	 * Extract the complete messages from the receive buffer of a socket
+	 * @param sockfd Socket Descriptor
+	 */
+
 	void parsing(uint32_t sockfd);
 
+	/**
+	 * Schedule dispatch() of a complete message in its MsgType thread pool
+	 * @param buf Buffer holding the whole message, freed after handle()
+	 * @param sockfd Socket Descriptor of incoming connection
+	 */
+
+	void scheduleDispatch(char* buf, uint32_t sockfd);
+
+	/**
+	 * Event loop of a receive reactor, never returns
+	 * @param reactorId Index of the epoll instance in _epollFd
+	 */
+
+	void reactorLoop(uint32_t reactorId);
+
+	/**
+	 * Accept a new connection from the server socket and register it
+	 */
+
+	void acceptConnection();
+
+	/**
+	 * Save a connection into _connectionMap, start its send thread and
+	 * register its sockfd to the corresponding reactor
+	 * @param conn Connected Connection
+	 */
+
+	void registerConnection(Connection* conn);
+
+	/**
+	 * Read from a socket until EAGAIN and parse the received messages
+	 * @param sockfd Socket Descriptor with pending data
+	 */
+
+	void receiveFromSocket(uint32_t sockfd);
+
+	/**
+	 * Remove a lost connection from its reactor and mark it disconnected
+	 * @param sockfd Socket Descriptor of the lost connection
+	 */
+
+	void handleDisconnect(uint32_t sockfd);
+
 	string getIpPortFromSockfd (uint32_t sockfd);
 
-	map<uint32_t, thread> _sendThread;
-	map<uint32_t, mutex*> _dataMutex;
-	map<uint32_t, struct LowLockQueue<Message *>*> _outMessageQueue;
-	map<uint32_t, struct LowLockQueue<Message *>*> _outDataQueue;
-	map<uint32_t, struct LowLockQueue<Message *>*> _outBlockQueue;
+	map<uint32_t, struct TransferWindow*> _transferWindow;
+	TaskClass _msgTaskClass[MSGTYPE_END]; // executor class of each MsgType
+	map<uint32_t, struct BoundedQueue<Message *>*> _outMessageQueue;
+	map<uint32_t, struct BoundedQueue<Message *>*> _outDataQueue;
+	map<uint32_t, struct BoundedQueue<Message *>*> _outBlockQueue;
 	atomic<uint32_t> _requestId; // atomic monotically increasing request ID
 
 	uint16_t _serverPort; // listening port for incoming connections
 	Socket _serverSocket; // socket for accepting incoming connections
 	map<uint32_t, Connection*> _connectionMap; // a map of all connections
-	ConcurrentMap<uint32_t, uint32_t> _componentIdMap; // a map from component ID to sockfd
-	ConcurrentMap<uint32_t, Message *> _waitReplyMessageMap; // map of message waiting for reply
-	uint32_t _maxFd; // maximum number of socket descriptors among connections
+	ConcurrentHashMap<uint32_t, uint32_t> _componentIdMap; // a map from component ID to sockfd
+	ConcurrentHashMap<uint32_t, Message *> _waitReplyMessageMap; // map of message waiting for reply
+
+	// receive reactors
+	uint32_t _numReactors;
+	vector<int> _epollFd; // one epoll instance per reactor
+	vector<thread> _reactorThreads; // reactor 0 runs in waitForMessage()
 
 	// self identity
 	ComponentType _componentType;
@@ -362,7 +638,14 @@ protected:
 	// config values
 	uint32_t _timeoutSec, _timeoutUsec;
 	uint32_t _chunkSize;
-	uint32_t _pollingInterval;
+
+	// sender threads, shared by all connections
+	uint32_t _numSenders;
+	vector<thread> _senderThreads;
+	deque<uint32_t> _sendReadyQueue; // sockfd waiting for a sender thread
+	mutex _sendReadyMutex;
+	condition_variable _sendReadyCond;
+	bool _isSending; // false to stop the sender threads
 
 	// component list
 	vector<Component> mdsList;
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include "connection.hh"
 #include "socket.hh"
 #include "../common/enums.hh"
@@ -17,10 +18,18 @@ using namespace std;
 
 Connection::Connection() {
 	_isDisconnected = false;
+	_sendMetaBuf = NULL;
+	_sendIovIdx = 0;
+	_sendFileIdx = 0;
+	_sendScheduled = false;
 }
 
 Connection::Connection(string ip, uint16_t port, ComponentType connectionType) {
 	_isDisconnected = false;
+	_sendMetaBuf = NULL;
+	_sendIovIdx = 0;
+	_sendFileIdx = 0;
+	_sendScheduled = false;
 	doConnect(ip, port, connectionType);
 }
 
@@ -45,103 +54,137 @@ uint32_t Connection::doConnect(string ip, uint16_t port,
 }
 
 
-uint32_t Connection::sendMessages(vector<Message*> messages) {
-    int32_t byteSent = 0;
-    uint32_t totalByteSent = 0;
-    int32_t bufLength = 0;
-    char* aggregateBuf = MemoryPool::getInstance().poolMalloc(1<<23);
+bool Connection::sendMessages(vector<Message*> messages) {
 	const uint32_t headerLength = sizeof(struct MsgHeader);
 
-    for (Message* msg: messages) {
-	    struct MsgHeader msgHeader = msg->getMsgHeader();
-        int32_t msgLength = headerLength+msg->getProtocolMsg().length()+msgHeader.payloadSize;
-        if (msgLength + bufLength > (1<<23)) {
-            byteSent = _socket.sendn(aggregateBuf, bufLength);
-		    totalByteSent += byteSent;
-            bufLength = 0;
-        }
-        memcpy(aggregateBuf+bufLength, (const char*) &msgHeader, headerLength);
-        bufLength += headerLength;
-        memcpy(aggregateBuf+bufLength, msg->getProtocolMsg().data(), msg->getProtocolMsg().length());
-        bufLength += msg->getProtocolMsg().length();
-        if (msgHeader.payloadSize > 0) {
-            debug("payload size = %" PRIu32 " bufLength = %d\n", msgHeader.payloadSize, bufLength);
-            memcpy(aggregateBuf+bufLength, msg->getPayload(), msgHeader.payloadSize);
-            bufLength += msgHeader.payloadSize;
-        }
-
-        if (!msg->isExpectReply()) {
-            delete msg;
-        }
-    }
-    if (bufLength > 0) {
-        byteSent = _socket.sendn(aggregateBuf, bufLength);
-		totalByteSent += byteSent;
-    }
-    MemoryPool::getInstance().poolFree(aggregateBuf);
-    return totalByteSent;
-}
-
-uint32_t Connection::sendMessage(Message* message) {
-	int32_t byteSent = 0;
-	uint32_t totalByteSent = 0;
-
-	// send header
-
-	struct MsgHeader msgHeader = message->getMsgHeader();
-	const uint32_t headerLength = sizeof(struct MsgHeader);
-
-	if ((byteSent = _socket.sendn((const char*) &msgHeader, headerLength))
-			!= -1) {
-		totalByteSent += byteSent;
-	} else {
-		cerr << "Error in sending MsgHeader" << endl;
+	// headers and protocol messages are small, copy them into one buffer
+	uint32_t metaLength = 0;
+	for (Message* msg : messages) {
+		metaLength += headerLength + msg->getProtocolMsg().length();
 	}
 
-	debug("ID: %" PRIu32 " Header sent %" PRIu32 " bytes\n",
-			message->getMsgHeader().requestId, byteSent);
-
-	// send protocol message
-
-	byteSent = 0;
+	// poolFree in flushSendBuffer()
+	_sendMetaBuf = MemoryPool::getInstance().poolMalloc(metaLength, false);
+	_sendIov.clear();
+	_sendIovIdx = 0;
+	_sendFiles.clear();
+	_sendFileIdx = 0;
+	uint32_t offset = 0;
+
+	for (Message* msg : messages) {
+		struct MsgHeader msgHeader = msg->getMsgHeader();
+		string protocolMsg = msg->getProtocolMsg();
+		char* meta = _sendMetaBuf + offset;
+		memcpy(meta, (const char*) &msgHeader, headerLength);
+		memcpy(meta + headerLength, protocolMsg.data(), protocolMsg.length());
+		offset += headerLength + protocolMsg.length();
+
+		// extend the last iovec if the meta data is contiguous
+		if (!_sendIov.empty()
+				&& (char*) _sendIov.back().iov_base + _sendIov.back().iov_len
+						== meta) {
+			_sendIov.back().iov_len += headerLength + protocolMsg.length();
+		} else {
+			struct iovec iov = { meta, headerLength + protocolMsg.length() };
+			_sendIov.push_back(iov);
+		}
 
-	string protocolMessage = message->getProtocolMsg();
-	const uint32_t protocolLength = protocolMessage.length();
+		if (msgHeader.payloadSize > 0) {
+			debug("payload size = %" PRIu32 " iovcnt = %zu\n",
+					msgHeader.payloadSize, _sendIov.size());
+			if (msg->getPayloadFd() != -1) {
+				struct iovec iov = { NULL, msgHeader.payloadSize };
+				_sendIov.push_back(iov);
+				_sendFiles.push_back(
+						make_pair(msg->getPayloadFd(),
+								msg->getPayloadFileOffset()));
+			} else {
+				struct iovec iov = { msg->getPayload(), msgHeader.payloadSize };
+				_sendIov.push_back(iov);
+			}
+		}
 
-	if ((byteSent = _socket.sendn(protocolMessage.data(), protocolLength))
-			!= -1) {
-		totalByteSent += byteSent;
-	} else {
-		cerr << "Error in sending Protocol Message" << endl;
+		// payload is referenced until the batch is written
+		if (!msg->isExpectReply()) {
+			_sentMessages.push_back(msg);
+		}
 	}
 
-	debug("ID: %" PRIu32 " Protocol sent %" PRIu32 " bytes\n",
-			message->getMsgHeader().requestId, byteSent);
-
-	// send payload if there is one
-
-	byteSent = 0;
-
-	if (msgHeader.payloadSize > 0) {
-		char* payload = message->getPayload();
-		const uint32_t payloadLength = msgHeader.payloadSize;
+	return flushSendBuffer();
+}
 
-		if ((byteSent = _socket.sendn(payload, payloadLength)) != -1) {
-			totalByteSent += byteSent;
+bool Connection::flushSendBuffer() {
+	while (_sendIovIdx < _sendIov.size()) {
+		int32_t byteSent;
+		if (_sendIov[_sendIovIdx].iov_base == NULL) {
+			// payload in a file, the offset moves as it is sent
+			pair<int, uint64_t>& sendFile = _sendFiles[_sendFileIdx];
+			byteSent = _socket.nonBlockingSendfile(sendFile.first,
+					sendFile.second, _sendIov[_sendIovIdx].iov_len);
+			if (byteSent > 0) {
+				sendFile.second += byteSent;
+				_sendIov[_sendIovIdx].iov_len -= byteSent;
+				if (_sendIov[_sendIovIdx].iov_len == 0) {
+					_sendIovIdx++;
+					_sendFileIdx++;
+				}
+				continue;
+			} else if (byteSent == -2) {
+				// the header already promised the payload, the stream cannot
+				// be resynchronised, so close the connection for the peer
+				debug_error("Payload file ends %" PRIu32
+						" bytes early for sockfd = %" PRIu32 "\n",
+						(uint32_t) _sendIov[_sendIovIdx].iov_len, getSockfd());
+				_socket.shutdown();
+				byteSent = 0;
+			}
 		} else {
-			cerr << "Error in sending Protocol Message" << endl;
+			// gather the buffers up to the next payload in a file
+			int iovcnt = 0;
+			while (_sendIovIdx + iovcnt < _sendIov.size() && iovcnt < IOV_MAX
+					&& _sendIov[_sendIovIdx + iovcnt].iov_base != NULL) {
+				iovcnt++;
+			}
+			byteSent = _socket.nonBlockingSendv(&_sendIov[_sendIovIdx],
+					iovcnt);
+		}
+		if (byteSent < 0) {
+			// socket full, wait for writable
+			return false;
+		} else if (byteSent == 0) {
+			// connection lost, drop the rest
+			debug_error("Drop %zu buffers for sockfd = %" PRIu32 "\n",
+					_sendIov.size() - _sendIovIdx, getSockfd());
+			break;
 		}
 
+		// skip the buffers that are completely sent
+		while (byteSent > 0) {
+			struct iovec& iov = _sendIov[_sendIovIdx];
+			if ((size_t) byteSent >= iov.iov_len) {
+				byteSent -= iov.iov_len;
+				_sendIovIdx++;
+			} else {
+				iov.iov_base = (char*) iov.iov_base + byteSent;
+				iov.iov_len -= byteSent;
+				byteSent = 0;
+			}
+		}
 	}
 
-	debug("ID: %" PRIu32 " Payload sent %" PRIu32 " bytes\n",
-			message->getMsgHeader().requestId, byteSent);
-
-    if (!message->isExpectReply()) {
-        delete message;
-    }
-
-	return totalByteSent;
+	for (Message* msg : _sentMessages) {
+		delete msg;
+	}
+	_sentMessages.clear();
+	_sendIov.clear();
+	_sendIovIdx = 0;
+	_sendFiles.clear();
+	_sendFileIdx = 0;
+	if (_sendMetaBuf != NULL) {
+		MemoryPool::getInstance().poolFree(_sendMetaBuf);
+		_sendMetaBuf = NULL;
+	}
+	return true;
 }
 
 char* Connection::recvMessage() {
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <string>
+#include <atomic>
+#include <vector>
+#include <sys/uio.h>
 #include "../common/enums.hh"
 #include "../protocol/message.hh"
 #include "socket.hh"
@@ -48,13 +51,36 @@ public:
 	void disconnect();
 
 	/**
-	 * Send a message to the connection
-	 * @param msg Pointer to message to send
-	 * @return Bytes sent
+	 * Gather a batch of messages into one iovec and write as much as
+	 * the socket accepts without blocking
+	 * Headers and protocol messages are copied, payloads are sent in place
+	 * Payloads in files are sent with sendfile
+	 * @param messages Messages to send
+	 * @return true if the whole batch is written, false if the socket is full
 	 */
 
-	uint32_t sendMessage (Message *message);
-    uint32_t sendMessages (vector<Message*> messages);
+	bool sendMessages (vector<Message*> messages);
+
+	/**
+	 * Continue writing the remaining bytes of the last batch
+	 * @return true if nothing is left, false if the socket is full
+	 */
+
+	bool flushSendBuffer ();
+
+	/**
+	 * Mark the connection as queued for a writer thread
+	 * @return true if the caller should schedule it, false if already queued
+	 */
+
+	bool trySetSendScheduled () {
+		bool expected = false;
+		return _sendScheduled.compare_exchange_strong(expected, true);
+	}
+
+	void clearSendScheduled () {
+		_sendScheduled = false;
+	}
 
 	/**
 	 * Receive a message from the connection
@@ -104,6 +130,15 @@ private:
 	Socket _socket;
 	ComponentType _connectionType;
 	bool _isDisconnected;
+
+	// partially written batch, kept until the socket is writable again
+	char* _sendMetaBuf; // headers and protocol messages of the batch
+	vector<struct iovec> _sendIov; // iov_base is NULL for a payload in a file
+	uint32_t _sendIovIdx;
+	vector<pair<int, uint64_t>> _sendFiles; // fd and offset of each payload in a file
+	uint32_t _sendFileIdx;
+	vector<Message*> _sentMessages; // deleted when the batch is written
+	atomic<bool> _sendScheduled;
 };
 
 #endif
@@ -7,6 +7,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <netinet/tcp.h>
 #include "../common/debug.hh"
 #include "../common/convertor.hh"
 
@@ -37,6 +39,12 @@ bool Socket::create() {
 		debug("Failed to Set Send Buf Size to %d\n",sndbuf_size);				
 	}
 
+	// messages are coalesced before sending, do not wait for Nagle
+	int nodelay = 1;
+	if (setsockopt(m_sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay))){
+		debug("%s\n", "Failed to Set TCP_NODELAY");
+	}
+
 	// TIME_WAIT - argh
 	int on = 1;
 	if (setsockopt(m_sock, SOL_SOCKET, SO_REUSEADDR, (const char*) &on,
@@ -87,8 +95,13 @@ bool Socket::accept(Socket* new_socket) const {
 
 	if (new_socket->m_sock <= 0)
 		return false;
-	else
-		return true;
+
+	int nodelay = 1;
+	if (setsockopt(new_socket->m_sock, IPPROTO_TCP, TCP_NODELAY, &nodelay,
+			sizeof(nodelay))) {
+		debug("%s\n", "Failed to Set TCP_NODELAY");
+	}
+	return true;
 }
 
 int32_t Socket::sendn(const char* buf, int32_t buf_len) {
@@ -160,6 +173,84 @@ int32_t Socket::aggressiveRecv(char* dst, int32_t maxRecvByte) {
 	return recvByte;
 }
 
+int32_t Socket::nonBlockingRecv(char* dst, int32_t maxRecvByte) {
+	const uint32_t sd = m_sock;
+	int32_t recvByte;
+	do {
+		recvByte = recv(sd, dst, maxRecvByte, MSG_DONTWAIT);
+	} while (recvByte < 0 && errno == EINTR);
+	if (recvByte < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return -1;
+		}
+		perror("Non-blocking Recv");
+		return 0;
+	}
+	return recvByte;
+}
+
+int32_t Socket::nonBlockingSend(const char* buf, int32_t buf_len) {
+	const uint32_t sd = m_sock;
+	int32_t sendByte;
+	do {
+		sendByte = send(sd, buf, buf_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (sendByte < 0 && errno == EINTR);
+	if (sendByte < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return -1;
+		}
+		perror("Non-blocking Send");
+		return 0;
+	}
+	return sendByte;
+}
+
+int32_t Socket::nonBlockingSendv(const struct iovec* iov, int iovcnt) {
+	const uint32_t sd = m_sock;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec*) iov;
+	msg.msg_iovlen = iovcnt;
+	int32_t sendByte;
+	do {
+		sendByte = sendmsg(sd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (sendByte < 0 && errno == EINTR);
+	if (sendByte < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return -1;
+		}
+		perror("Non-blocking Sendv");
+		return 0;
+	}
+	return sendByte;
+}
+
+int32_t Socket::nonBlockingSendfile(int fd, uint64_t offset,
+		uint32_t length) {
+	const uint32_t sd = m_sock;
+	off_t fileOffset = offset;
+	int32_t sendByte;
+	do {
+		sendByte = sendfile(sd, fd, &fileOffset, length);
+	} while (sendByte < 0 && errno == EINTR);
+	if (sendByte < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return -1;
+		}
+		perror("Non-blocking Sendfile");
+		return 0;
+	} else if (sendByte == 0 && length > 0) {
+		// the file is shorter than the range
+		return -2;
+	}
+	return sendByte;
+}
+
+void Socket::shutdown() {
+	if (is_valid())
+		::shutdown(m_sock, SHUT_RDWR);
+}
+
 bool Socket::connect(const std::string host, const int port) {
 	if (!is_valid())
 		return false;
@@ -5,6 +5,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h>
@@ -102,6 +103,48 @@ public:
 	 */
 	int32_t aggressiveRecv(char* dst, int32_t maxRecvByte);
 
+	/**
+	 * Non-blocking read for edge-triggered polling
+	 * @param dst buffer place
+	 * @param maxRecvByte max receive byte
+	 * @return Number of bytes received, 0 if connection is lost, -1 if no data
+	 */
+	int32_t nonBlockingRecv(char* dst, int32_t maxRecvByte);
+
+	/**
+	 * Non-blocking write for event-driven sending
+	 * @param buf Buffer to send
+	 * @param buf_len Max length to send
+	 * @return Number of bytes sent, 0 if connection is lost, -1 if socket is full
+	 */
+	int32_t nonBlockingSend(const char* buf, int32_t buf_len);
+
+	/**
+	 * Non-blocking gather write for event-driven sending
+	 * @param iov Buffers to send
+	 * @param iovcnt Number of buffers (at most IOV_MAX)
+	 * @return Number of bytes sent, 0 if connection is lost, -1 if socket is full
+	 */
+	int32_t nonBlockingSendv(const struct iovec* iov, int iovcnt);
+
+	/**
+	 * Non-blocking sendfile for event-driven sending
+	 * sendfile cannot take MSG_DONTWAIT, so the socket must be set
+	 * non-blocking with set_non_blocking() beforehand
+	 * @param fd File descriptor to send from
+	 * @param offset Offset of the range in the file
+	 * @param length Max length to send
+	 * @return Number of bytes sent, 0 if connection is lost, -1 if socket is
+	 * full, -2 if the file ends before the range
+	 */
+	int32_t nonBlockingSendfile(int fd, uint64_t offset, uint32_t length);
+
+	/**
+	 * Shut down both directions of the socket without closing it
+	 * The reactor sees the disconnect and cleans up the connection
+	 */
+	void shutdown();
+
 	void set_non_blocking(const bool);
 
 	/**
@@ -0,0 +1,251 @@
+/*
+ * boundedqueue.hh
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+
+#ifndef BOUNDEDQUEUE_HH_
+#define BOUNDEDQUEUE_HH_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <stdint.h>
+#include "../common/define.hh"
+#include "../common/executor.hh"
+
+using namespace std;
+
+/**
+ * Bounded multi-producer multi-consumer ring queue
+ * All cells are allocated up front. A cell carries a sequence number that
+ * tells whether it is free for the producer of a position or holds the
+ * value for the consumer of that position, so push and pop only need a
+ * CAS on the position counters. A producer that finds the ring full
+ * blocks in push() until a consumer frees a cell (backpressure).
+ */
+
+template<typename T>
+struct BoundedQueue {
+private:
+	struct Cell {
+		atomic<uint64_t> sequence;
+		T value;
+	};
+
+	char pad0[CACHE_LINE_SIZE];
+
+	Cell* const _cells;
+	const uint64_t _mask;
+
+	char pad1[CACHE_LINE_SIZE - sizeof(Cell*) - sizeof(uint64_t)];
+
+// next position to push
+	atomic<uint64_t> _enqueuePos;
+
+	char pad2[CACHE_LINE_SIZE - sizeof(atomic<uint64_t> )];
+
+// next position to pop
+	atomic<uint64_t> _dequeuePos;
+
+	char pad3[CACHE_LINE_SIZE - sizeof(atomic<uint64_t> )];
+
+// producers that may be sleeping on a full ring
+	atomic<uint32_t> _blockedProducers;
+	mutex _fullMutex;
+	condition_variable _notFull;
+
+	char pad4[CACHE_LINE_SIZE];
+
+	static uint64_t roundCapacity(uint64_t capacity) {
+		uint64_t rounded = 2;
+		while (rounded < capacity) {
+			rounded <<= 1;
+		}
+		return rounded;
+	}
+
+public:
+
+	/**
+	 * Constructor
+	 * @param capacity Maximum number of queued values, rounded up to a
+	 * power of 2
+	 */
+
+	BoundedQueue(uint64_t capacity) :
+			_cells(new Cell[roundCapacity(capacity)]), _mask(
+					roundCapacity(capacity) - 1), _enqueuePos(0), _dequeuePos(
+					0), _blockedProducers(0) {
+		for (uint64_t i = 0; i <= _mask; i++) {
+			_cells[i].sequence.store(i, memory_order_relaxed);
+		}
+	}
+
+	~BoundedQueue() {
+		delete[] _cells;
+	}
+
+	/**
+	 * Push a value if the ring has a free cell
+	 * @param t Value to push
+	 * @return false if the ring is full
+	 */
+
+	bool tryPush(const T& t) {
+		uint64_t pos = _enqueuePos.load(memory_order_relaxed);
+		while (1) {
+			Cell& cell = _cells[pos & _mask];
+			const uint64_t seq = cell.sequence.load(memory_order_acquire);
+			const int64_t diff = (int64_t) seq - (int64_t) pos;
+			if (diff == 0) {
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1,
+						memory_order_relaxed)) {
+					cell.value = t;
+					cell.sequence.store(pos + 1, memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false; // the consumer of the last round is behind
+			} else {
+				pos = _enqueuePos.load(memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Push a value, block while the ring is full
+	 * @param t Value to push
+	 */
+
+	void push(const T& t) {
+		if (tryPush(t)) {
+			return;
+		}
+
+		// a consumer is usually about to free a cell
+		for (uint32_t i = 0; i < BOUNDED_QUEUE_SPIN; i++) {
+			this_thread::yield();
+			if (tryPush(t)) {
+				return;
+			}
+		}
+
+		// the ring is drained by another thread
+		Executor::BlockingScope blocking;
+
+		// count in before the last try, consumers reset the count when
+		// they wake everyone, so a sleeper costs them one notify only
+		unique_lock<mutex> lk(_fullMutex);
+		while (1) {
+			_blockedProducers++;
+			atomic_thread_fence(memory_order_seq_cst);
+			if (tryPush(t)) {
+				return;
+			}
+			_notFull.wait(lk);
+		}
+	}
+
+	/**
+	 * Pop the oldest value
+	 * @param result Popped value
+	 * @return false if the ring is empty
+	 */
+
+	bool pop(T& result) {
+		return popBatch(&result, 1) == 1;
+	}
+
+	/**
+	 * Pop up to maxCount of the oldest values with one CAS
+	 * @param results Array to hold the popped values
+	 * @param maxCount Size of the array
+	 * @return Number of values popped, 0 if the ring is empty
+	 */
+
+	uint32_t popBatch(T* results, uint32_t maxCount) {
+		uint64_t pos = _dequeuePos.load(memory_order_relaxed);
+		uint32_t count;
+		while (1) {
+			// count the filled cells from pos onwards
+			count = 0;
+			while (count < maxCount) {
+				const uint64_t seq =
+						_cells[(pos + count) & _mask].sequence.load(
+								memory_order_acquire);
+				const int64_t diff = (int64_t) seq
+						- (int64_t) (pos + count + 1);
+				if (diff != 0) {
+					break;
+				}
+				count++;
+			}
+			if (count == 0) {
+				const uint64_t seq = _cells[pos & _mask].sequence.load(
+						memory_order_acquire);
+				if ((int64_t) seq - (int64_t) (pos + 1) < 0) {
+					return 0; // empty, or the next producer is not done
+				}
+				pos = _dequeuePos.load(memory_order_relaxed);
+				continue;
+			}
+			// the counted cells stay filled until their owner pops them
+			if (_dequeuePos.compare_exchange_weak(pos, pos + count,
+					memory_order_relaxed)) {
+				break;
+			}
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			Cell& cell = _cells[(pos + i) & _mask];
+			results[i] = cell.value;
+			cell.sequence.store(pos + i + _mask + 1, memory_order_release);
+		}
+
+		// order the cell release before reading the counter, a producer
+		// counts itself before retrying, so one of the two sees the other
+		atomic_thread_fence(memory_order_seq_cst);
+		if (_blockedProducers.load(memory_order_relaxed) > 0) {
+			lock_guard<mutex> lk(_fullMutex);
+			_blockedProducers = 0;
+			_notFull.notify_all();
+		}
+		return count;
+	}
+
+	/**
+	 * Check if the ring is empty
+	 * The answer is only a snapshot when other threads push or pop
+	 * @return true if there is no value to pop
+	 */
+
+	bool isEmpty() {
+		const uint64_t pos = _dequeuePos.load(memory_order_relaxed);
+		const uint64_t seq = _cells[pos & _mask].sequence.load(
+				memory_order_acquire);
+		return (int64_t) seq - (int64_t) (pos + 1) < 0;
+	}
+
+	/**
+	 * Get the number of queued values, including pushes in progress
+	 * @return Number of values
+	 */
+
+	uint64_t size() {
+		const uint64_t dequeuePos = _dequeuePos.load();
+		const uint64_t enqueuePos = _enqueuePos.load();
+		return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+	}
+
+	/**
+	 * Get the number of cells
+	 * @return Capacity of the ring
+	 */
+
+	uint64_t capacity() {
+		return _mask + 1;
+	}
+};
+
+#endif /* BOUNDEDQUEUE_HH_ */
@@ -0,0 +1,435 @@
+/*
+ * concurrenthashmap.hh
+ */
+
+#ifndef CONCURRENTHASHMAP_HH_
+#define CONCURRENTHASHMAP_HH_
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "../common/define.hh"
+#include "../common/executor.hh"
+
+/**
+ * Hash map sharded over CONCURRENT_MAP_SHARDS locks
+ * Each shard is an open-addressing (linear probing) table behind its own
+ * mutex, so operations on different keys rarely contend. Values are
+ * returned by copy, use update() / upsert() to modify a value in place
+ * under the shard lock. References into the map are never handed out,
+ * since a rehash moves the entries.
+ */
+
+template<class K, class V, class Hash = std::hash<K> >
+class ConcurrentHashMap {
+public:
+
+	ConcurrentHashMap() :
+			_size(0) {
+		static_assert((CONCURRENT_MAP_SHARDS & (CONCURRENT_MAP_SHARDS - 1)) == 0,
+				"CONCURRENT_MAP_SHARDS must be a power of 2");
+	}
+
+	void set(const K& key, const V& value) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		insertSlot(shard, key, hash).value = value;
+		notifyShard(shard);
+	}
+
+	/**
+	 * Get a copy of the value
+	 * @param key Key
+	 * @return Value, V() if the key is absent
+	 */
+
+	V get(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		Slot* slot = findSlot(shard, key, hash);
+		return slot == NULL ? V() : slot->value;
+	}
+
+	/**
+	 * Get a copy of the value if the key is present
+	 * @param key Key
+	 * @param value Set to the value if found
+	 * @return True if the key is present
+	 */
+
+	bool find(const K& key, V& value) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		Slot* slot = findSlot(shard, key, hash);
+		if (slot == NULL) {
+			return false;
+		}
+		value = slot->value;
+		return true;
+	}
+
+	bool empty() {
+		return size() == 0;
+	}
+
+	bool count(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		return findSlot(shard, key, hash) != NULL;
+	}
+
+	void erase(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		Slot* slot = findSlot(shard, key, hash);
+		if (slot != NULL) {
+			eraseSlot(shard, *slot);
+			notifyShard(shard);
+		}
+	}
+
+	void clear() {
+		for (Shard& shard : _shards) {
+			std::lock_guard<std::mutex> lk(shard.m);
+			_size -= shard.live;
+			shard.slots.clear();
+			shard.used = 0;
+			shard.live = 0;
+			notifyShard(shard);
+		}
+	}
+
+	/**
+	 * Remove a key and return its value
+	 * @param key Key
+	 * @return Value, V() if the key is absent
+	 */
+
+	V pop(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		Slot* slot = findSlot(shard, key, hash);
+		if (slot == NULL) {
+			return V();
+		}
+		V value = std::move(slot->value);
+		eraseSlot(shard, *slot);
+		notifyShard(shard);
+		return value;
+	}
+
+	/**
+	 * Add to a value, an absent key counts from V()
+	 * @param key Key
+	 * @param delta Amount to add
+	 * @return Value before the addition
+	 */
+
+	V fetchAdd(const K& key, V delta) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		V& value = insertSlot(shard, key, hash).value;
+		const V oldValue = value;
+		value += delta;
+		notifyShard(shard);
+		return oldValue;
+	}
+
+	V increment(const K& key) {
+		return fetchAdd(key, 1) + 1;
+	}
+
+	V decrement(const K& key) {
+		return fetchAdd(key, -1) - 1;
+	}
+
+	bool init(const K& key, const V& value) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		if (findSlot(shard, key, hash) != NULL) {
+			return false;
+		}
+		insertSlot(shard, key, hash).value = value;
+		notifyShard(shard);
+		return true;
+	}
+
+	/**
+	 * Modify a value in place under the shard lock
+	 * @param key Key
+	 * @param fn Called as fn(V&) if the key is present, must not use the map
+	 * @return True if the key is present
+	 */
+
+	template<class F>
+	bool update(const K& key, F fn) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		Slot* slot = findSlot(shard, key, hash);
+		if (slot == NULL) {
+			return false;
+		}
+		fn(slot->value);
+		notifyShard(shard);
+		return true;
+	}
+
+	/**
+	 * Modify a value in place under the shard lock, inserting V() first if
+	 * the key is absent
+	 * @param key Key
+	 * @param fn Called as fn(V&), must not use the map
+	 */
+
+	template<class F>
+	void upsert(const K& key, F fn) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::lock_guard<std::mutex> lk(shard.m);
+		fn(insertSlot(shard, key, hash).value);
+		notifyShard(shard);
+	}
+
+	/**
+	 * Erase every entry matching a predicate, one shard at a time
+	 * @param pred Called as pred(const K&, V&), must not use the map
+	 * @return Number of entries erased
+	 */
+
+	template<class P>
+	size_t eraseIf(P pred) {
+		size_t erased = 0;
+		for (Shard& shard : _shards) {
+			std::lock_guard<std::mutex> lk(shard.m);
+			const size_t before = shard.live;
+			for (Slot& slot : shard.slots) {
+				if (slot.state == FULL && pred((const K&) slot.key, slot.value)) {
+					eraseSlot(shard, slot);
+				}
+			}
+			if (shard.live != before) {
+				erased += before - shard.live;
+				notifyShard(shard);
+			}
+		}
+		return erased;
+	}
+
+	size_t size() {
+		return _size.load();
+	}
+
+	/**
+	 * Block until the key is absent or holds the given value
+	 * An absent key reads as V() through get(), so waiting for V() also
+	 * returns once the entry is erased
+	 * @param key Key to watch
+	 * @param value Value to wait for
+	 */
+
+	void waitValue(const K& key, const V& value) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::unique_lock<std::mutex> lk(shard.m);
+		waitShard(shard, lk, [&] {
+			Slot* slot = findSlot(shard, key, hash);
+			return slot == NULL || slot->value == value;
+		});
+	}
+
+	/**
+	 * Block until the key is present
+	 * @param key Key to watch
+	 * @return Copy of the value
+	 */
+
+	V waitGet(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::unique_lock<std::mutex> lk(shard.m);
+		waitShard(shard, lk, [&] {return findSlot(shard, key, hash) != NULL;});
+		return findSlot(shard, key, hash)->value;
+	}
+
+	/**
+	 * Block until the key is erased
+	 * @param key Key to watch
+	 */
+
+	void waitErase(const K& key) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::unique_lock<std::mutex> lk(shard.m);
+		waitShard(shard, lk, [&] {return findSlot(shard, key, hash) == NULL;});
+	}
+
+	/**
+	 * Block until the key is absent, then insert it in the same critical
+	 * section so that only one waiter claims the key
+	 * @param key Key to claim
+	 * @param value Initial value
+	 */
+
+	void waitInit(const K& key, const V& value) {
+		const size_t hash = hashOf(key);
+		Shard& shard = shardOf(hash);
+		std::unique_lock<std::mutex> lk(shard.m);
+		waitShard(shard, lk, [&] {return findSlot(shard, key, hash) == NULL;});
+		insertSlot(shard, key, hash).value = value;
+		notifyShard(shard);
+	}
+
+private:
+	enum SlotState : uint8_t {
+		EMPTY, FULL, DELETED
+	};
+
+	struct Slot {
+		K key;
+		V value;
+		SlotState state;
+
+		Slot() :
+				key(), value(), state(EMPTY) {
+		}
+	};
+
+	struct Shard {
+		std::mutex m;
+		std::condition_variable changed;
+		std::vector<Slot> slots; // capacity is a power of 2
+		size_t used; // FULL and DELETED slots
+		size_t live; // FULL slots
+		uint32_t waiters;
+		char pad[CACHE_LINE_SIZE]; // keep neighbouring locks apart
+
+		Shard() :
+				used(0), live(0), waiters(0) {
+		}
+	};
+
+	static size_t hashOf(const K& key) {
+		// integer keys hash to themselves, mix so both the shard and the
+		// slot index get well spread bits
+		uint64_t h = Hash()(key);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return (size_t) h;
+	}
+
+	Shard& shardOf(size_t hash) {
+		return _shards[(hash >> 48) & (CONCURRENT_MAP_SHARDS - 1)];
+	}
+
+	Slot* findSlot(Shard& shard, const K& key, size_t hash) {
+		const size_t mask = shard.slots.size() - 1;
+		if (shard.slots.empty()) {
+			return NULL;
+		}
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			Slot& slot = shard.slots[i];
+			if (slot.state == EMPTY) {
+				return NULL;
+			} else if (slot.state == FULL && slot.key == key) {
+				return &slot;
+			}
+		}
+	}
+
+	Slot& insertSlot(Shard& shard, const K& key, size_t hash) {
+		Slot* slot = findSlot(shard, key, hash);
+		if (slot != NULL) {
+			return *slot;
+		}
+
+		// keep at most 3/4 of the slots used, tombstones included
+		if ((shard.used + 1) * 4 > shard.slots.size() * 3) {
+			rehash(shard);
+		}
+
+		const size_t mask = shard.slots.size() - 1;
+		size_t i = hash & mask;
+		while (shard.slots[i].state == FULL) {
+			i = (i + 1) & mask;
+		}
+		slot = &shard.slots[i];
+		if (slot->state == EMPTY) {
+			shard.used++;
+		}
+		slot->key = key;
+		slot->value = V();
+		slot->state = FULL;
+		shard.live++;
+		_size++;
+		return *slot;
+	}
+
+	void eraseSlot(Shard& shard, Slot& slot) {
+		// release what the key and value hold, keep the tombstone
+		slot.key = K();
+		slot.value = V();
+		slot.state = DELETED;
+		shard.live--;
+		_size--;
+	}
+
+	void rehash(Shard& shard) {
+		size_t capacity = 8;
+		while (capacity * 3 < (shard.live + 1) * 4 * 2) {
+			capacity *= 2;
+		}
+		std::vector<Slot> oldSlots(capacity);
+		oldSlots.swap(shard.slots);
+		shard.used = shard.live;
+
+		const size_t mask = capacity - 1;
+		for (Slot& oldSlot : oldSlots) {
+			if (oldSlot.state != FULL) {
+				continue;
+			}
+			size_t i = hashOf(oldSlot.key) & mask;
+			while (shard.slots[i].state == FULL) {
+				i = (i + 1) & mask;
+			}
+			shard.slots[i].key = std::move(oldSlot.key);
+			shard.slots[i].value = std::move(oldSlot.value);
+			shard.slots[i].state = FULL;
+		}
+	}
+
+	template<class P>
+	void waitShard(Shard& shard, std::unique_lock<std::mutex>& lk, P pred) {
+		if (pred()) {
+			return;
+		}
+		// the value is changed by another task
+		Executor::BlockingScope blocking;
+		shard.waiters++;
+		shard.changed.wait(lk, pred);
+		shard.waiters--;
+	}
+
+	void notifyShard(Shard& shard) {
+		// called with the shard lock held
+		if (shard.waiters > 0) {
+			shard.changed.notify_all();
+		}
+	}
+
+	Shard _shards[CONCURRENT_MAP_SHARDS];
+	std::atomic<size_t> _size;
+};
+
+#endif /* CONCURRENTHASHMAP_HH_ */
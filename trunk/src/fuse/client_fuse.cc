@@ -293,6 +293,8 @@ static int ncvfs_read(const char *path, char *buf, size_t size, off_t offset, st
 
 		// return immediately if data is cached, otherwise retrieve data from OSDs
 		uint32_t retstat = _fileDataCache->readDataCache(segmentId, primary, bufptr, readSize, segmentOffset);
+		if (retstat == 0)
+			break;
 		bufptr += retstat;
 		sizeRead += retstat;
 		lastSegmentCount = segmentCount;
@@ -130,14 +130,31 @@ uint32_t FileDataCache::readDataCache(uint64_t segmentId, uint32_t primary,
                 offset, size);
     }
 
-    // no matter whether cached, getSegment check cache first
     uint32_t sockfd = _clientCommunicator->getSockfdFromId(primary);
+
+    // small uncached read, fetch only the requested bytes
+    if (size <= RANGE_READ_MAX_SIZE
+            && !_storageModule->locateSegmentCache(segmentId)) {
+        if (_clientCommunicator->getSegmentRange(sockfd, segmentId,
+                SEGMENT_RANGE_WHOLE_SEGMENT, offset, size, (char*) buf)) {
+            return size;
+        }
+        debug("Range read of %" PRIu64 " not served, get whole segment\n",
+                segmentId);
+    }
+
+    // no matter whether cached, getSegment check cache first
     struct SegmentData segmentCache = client->getSegment(
             _clientId, sockfd, segmentId);
 
-    memcpy(buf, segmentCache.buf + offset, size);
+    // a segment shorter than the read returns the bytes it holds
+    uint32_t copySize = 0;
+    if (offset < segmentCache.info.segLength) {
+        copySize = min(size, segmentCache.info.segLength - offset);
+        memcpy(buf, segmentCache.buf + offset, copySize);
+    }
     updateLru(segmentId);
-    return size;
+    return copySize;
 }
 
 uint32_t FileDataCache::writeDataCache(uint64_t segmentId, uint32_t primary,
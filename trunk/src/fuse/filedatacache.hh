@@ -13,6 +13,7 @@
 #include "../common/enums.hh"
 #include "../common/segmentdata.hh"
 #include "../datastructure/ringbuffer.hh"
+#include "../datastructure/concurrenthashmap.hh"
 
 
 class FileDataCache {
@@ -36,7 +37,7 @@ class FileDataCache {
 
         RWMutex* obtainRWMutex(uint64_t segmentId);
 
-		ConcurrentMap<uint64_t, uint32_t> _writeBackSegmentPrimary;
+		ConcurrentHashMap<uint64_t, uint32_t> _writeBackSegmentPrimary;
 
 		uint32_t _segmentSize;
 		string _codingSetting;
@@ -106,6 +106,7 @@ void Monitor::OsdStatUpdateReplyProcessor(uint32_t requestId, uint32_t sockfd,
 void Monitor::OsdShutdownProcessor(uint32_t requestId, uint32_t sockfd,
 		uint32_t osdId) {
 	_statModule->removeStatById(osdId);
+	_statModule->broadcastOsdShutdown(_monitorCommunicator, osdId);
 }
 
 void Monitor::getPrimaryListProcessor(uint32_t requestId, uint32_t sockfd,
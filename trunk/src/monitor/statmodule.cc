@@ -2,6 +2,7 @@
 #include "../common/onlineosd.hh"
 #include "../common/debug.hh"
 #include "../protocol/status/newosdregistermsg.hh"
+#include "../protocol/status/osdshutdownmsg.hh"
 #include <ctime>
 
 
@@ -44,19 +45,27 @@ void StatModule::removeStatById (uint32_t osdId) {
 	_osdStatMap.erase(osdId);
 }
 
-void StatModule::removeStatBySockfd (uint32_t sockfd) {
-	// Set to OFFLINE
-	lock_guard<mutex> lk(osdStatMapMutex);
-	map<uint32_t, struct OsdStat>::iterator p;
-	p = _osdStatMap.begin();
-	while (p != _osdStatMap.end()) {
-		if (p->second.osdSockfd == sockfd)
-			p->second.osdHealth = OFFLINE;
-			//_osdStatMap.erase(p++);
-			//else
-		p++;
-	}	
+vector<uint32_t> StatModule::removeStatBySockfd (uint32_t sockfd) {
+	vector<uint32_t> offlineOsdList;
+	{
+		// Set to OFFLINE
+		lock_guard<mutex> lk(osdStatMapMutex);
+		map<uint32_t, struct OsdStat>::iterator p;
+		p = _osdStatMap.begin();
+		while (p != _osdStatMap.end()) {
+			if (p->second.osdSockfd == sockfd) {
+				if (p->second.osdHealth == ONLINE)
+					offlineOsdList.push_back(p->first);
+				p->second.osdHealth = OFFLINE;
+			}
+				//_osdStatMap.erase(p++);
+				//else
+			p++;
+		}	
+	}
 	debug_yellow("Delete sockfd = %" PRIu32 "\n", sockfd);
+
+	return offlineOsdList;
 }
 
 void StatModule::setStatById (uint32_t osdId, uint32_t sockfd, 
@@ -128,6 +137,29 @@ void StatModule::broadcastNewOsd(Communicator* communicator,
 	}
 }
 
+void StatModule::broadcastOsdShutdown(Communicator* communicator,
+	uint32_t osdId) {
+
+	// addMessage may block, so the messages are sent outside the lock
+	vector<uint32_t> sockfdList;
+	{
+		lock_guard<mutex> lk(osdStatMapMutex);
+		for (auto& entry: _osdStatMap) {
+			if (entry.second.osdHealth == ONLINE && entry.first != osdId) {
+				sockfdList.push_back(entry.second.osdSockfd);
+			}
+		}
+	}
+
+	for (uint32_t sockfd : sockfdList) {
+		OsdShutdownMsg* osdShutdownMsg = new OsdShutdownMsg(
+			communicator, sockfd, osdId);
+		osdShutdownMsg->prepareProtocolMsg();
+
+		communicator->addMessage(osdShutdownMsg);
+	}
+}
+
 
 void StatModule::getOsdStatus(vector<uint32_t>& osdListRef, 
 	vector<bool>& osdStatusRef) {
@@ -32,10 +32,12 @@ public:
 	void removeStatById (uint32_t osdId);
 
 	/**  
-	 * Remove an osd status entry by its osdId 
+	 * Set an osd status entry to OFFLINE by its socket
+	 * The caller tells the online osds with broadcastOsdShutdown
 	 * @param sockfd OSD socket id
+	 * @return IDs of the osds that went offline
 	 */
-	void removeStatBySockfd (uint32_t sockfd);
+	vector<uint32_t> removeStatBySockfd (uint32_t sockfd);
 
 
 	/**
@@ -78,6 +80,13 @@ public:
 	void broadcastNewOsd(Communicator* communicator, uint32_t osdId, 
 		uint32_t ip, uint32_t port);
 
+	/**
+	 * When an osd goes offline, broadcast its id to all online osds
+	 * @param communicator pointer to monitor communicator
+	 * @param osdId OSD ID that went offline
+	 */
+	void broadcastOsdShutdown(Communicator* communicator, uint32_t osdId);
+
 	/**
 	 * When a get osd status request for degraded read
 	 * @param osdListRef request reference of osd list
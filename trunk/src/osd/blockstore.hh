@@ -0,0 +1,144 @@
+#ifndef __BLOCKSTORE_HH__
+#define __BLOCKSTORE_HH__
+
+#include <stdint.h>
+#include <vector>
+#include "ioengine.hh"
+#include "../common/define.hh"
+
+/**
+ * Backend holding the bytes of blocks and delta blocks on an OSD
+ *
+ * A block is addressed by (segmentId, blockId, BLOCK_STORE_NO_DELTA) and a
+ * delta block by (segmentId, blockId, deltaId). Offsets are relative to the
+ * start of the block or delta block. Reads and writes are resolved into
+ * requests on open files, which the StorageModule runs on its IoEngine.
+ * The StorageModule keeps the locking and the delta bookkeeping; a backend
+ * only has to be thread-safe across different blocks.
+ */
+
+class BlockStore {
+public:
+
+    virtual ~BlockStore() {
+    }
+
+    /**
+     * Create an empty block, discarding any old content
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     * @param length Expected length of the block (0 if unknown)
+     */
+
+    virtual void create(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId, uint32_t length) = 0;
+
+    /**
+     * Resolve a read of a range of a block into I/O requests
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     * @param buf Pointer to destination buffer (already malloc-ed)
+     * @param offset Offset in the block
+     * @param length Length to read
+     * @param batch Batch to append the requests to
+     */
+
+    virtual void prepareRead(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch) = 0;
+
+    /**
+     * Resolve ranges of a block into read requests on files and pin them,
+     * so the files can still be read after the block lock is released.
+     * Until the matching unpin(), writes to the block go to new space and
+     * the space it drops is not reused
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param ranges Ranges of the block
+     * @param batch Batch to append the requests to
+     * @return true if pinned, false (nothing appended) if the ranges cannot
+     * be kept unchanged and have to be read into memory
+     */
+
+    virtual bool pinRanges(uint64_t segmentId, uint32_t blockId,
+            const vector<offset_length_t>& ranges,
+            vector<IoRequest>& batch) = 0;
+
+    /**
+     * Release a pin taken by pinRanges()
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     */
+
+    virtual void unpin(uint64_t segmentId, uint32_t blockId) = 0;
+
+    /**
+     * Resolve a write to a range of a block into I/O requests, allocating
+     * the range if needed
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     * @param buf Pointer to source buffer
+     * @param offset Offset in the block
+     * @param length Length to write
+     * @param batch Batch to append the requests to
+     */
+
+    virtual void prepareWrite(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch) = 0;
+
+    /**
+     * Allocate space for a range of a block without writing it
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param offset Offset in the block
+     * @param length Length to allocate
+     */
+
+    virtual void reserve(uint64_t segmentId, uint32_t blockId,
+            uint64_t offset, uint32_t length) = 0;
+
+    /**
+     * Remove a block and release its space
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     */
+
+    virtual void remove(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId) = 0;
+
+    /**
+     * Resolve the data sync making the written content of a block durable
+     * into IO_SYNC requests
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     * @param batch Batch to append the requests to
+     */
+
+    virtual void prepareSync(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId, vector<IoRequest>& batch) = 0;
+
+    /**
+     * Release resources held for a block that is not accessed soon
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     */
+
+    virtual void close(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId) = 0;
+
+    /**
+     * Get the bytes occupied by blocks, used while set up
+     * @return Bytes occupied by blocks
+     */
+
+    virtual uint64_t getUsage() = 0;
+};
+
+#endif
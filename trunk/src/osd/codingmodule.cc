@@ -69,6 +69,17 @@ block_list_t CodingModule::getRequiredBlockSymbols(CodingScheme codingScheme,
 			segmentSize, setting);
 }
 
+block_list_t CodingModule::getRangeBlockSymbols(CodingScheme codingScheme,
+		uint64_t offset, uint32_t length, vector<bool> blockStatus,
+		uint32_t segmentSize, string setting) {
+	return getCoding(codingScheme)->getRangeBlockSymbols(offset, length,
+			blockStatus, segmentSize, setting);
+}
+
+bool CodingModule::canDecodeFromAnyBlocks(CodingScheme codingScheme) {
+	return getCoding(codingScheme)->canDecodeFromAnyBlocks();
+}
+
 block_list_t CodingModule::getRepairBlockSymbols(CodingScheme codingScheme,
 		vector<uint32_t> failedBlocks, vector<bool> blockStatus,
 		uint32_t segmentSize, string setting) {
@@ -24,6 +24,8 @@ class CodingModule {
 
         /**
          * Encode an segment to a list of blocks
+         * RS and Cauchy segments are encoded in cache-sized stripes in
+         * parallel, see CodingContextCache::encodeSegment()
          * @param codingScheme Coding Scheme
          * @param segmentData SegmentData structure
          * @param setting Setting for the coding scheme
@@ -72,6 +74,30 @@ class CodingModule {
         block_list_t getRequiredBlockSymbols(CodingScheme codingScheme,
                 vector<bool> blockStatus, uint32_t segmentSize, string setting);
 
+        /**
+         * Get the list of blocks holding a byte range of the segment
+         * @param codingScheme Coding Scheme
+         * @param offset Offset of the range in the segment
+         * @param length Length of the range
+         * @param blockStatus A bool array containing the status of the OSD
+         * @param segmentSize Segment size
+         * @param setting Setting for the coding scheme
+         * @return List of block ID and offset length in segment order,
+         * empty if the range needs a decode
+         */
+
+        block_list_t getRangeBlockSymbols(CodingScheme codingScheme,
+                uint64_t offset, uint32_t length, vector<bool> blockStatus,
+                uint32_t segmentSize, string setting);
+
+        /**
+         * Whether any blocks chosen by getRequiredBlockSymbols can decode
+         * @param codingScheme Coding Scheme
+         * @return true for MDS codes
+         */
+
+        bool canDecodeFromAnyBlocks(CodingScheme codingScheme);
+
         /**
          * Get the number of blocks that the scheme uses
          * @param codingScheme Coding Scheme
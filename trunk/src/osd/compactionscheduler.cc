@@ -0,0 +1,167 @@
+/*
+ * compactionscheduler.cc
+ */
+
+#include <iostream>
+#include <chrono>
+#include "compactionscheduler.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+
+static uint64_t getSteadyTime() {
+    return chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CompactionScheduler::CompactionScheduler(
+        function<uint64_t(uint64_t, uint32_t, bool)> mergeFunction) :
+        _mergeFunction(mergeFunction) {
+    _backlogDeltas = 0;
+    _backlogBytes = 0;
+    _lastForegroundIo = getSteadyTime();
+    _backgroundMergeCount = 0;
+    _inlineMergeCount = 0;
+    _mergedBytes = 0;
+    _throttledTime = 0;
+    _isRunning = true;
+    _compactionThread = thread(&CompactionScheduler::compactionLoop, this);
+}
+
+CompactionScheduler::~CompactionScheduler() {
+    {
+        lock_guard<mutex> lk(_backlogMutex);
+        _isRunning = false;
+    }
+    _backlogCond.notify_all();
+    _compactionThread.join();
+}
+
+void CompactionScheduler::recordDelta(uint64_t segmentId, uint32_t blockId,
+        bool isParity, uint32_t deltaCount, uint32_t deltaLength,
+        uint32_t reserveUsedPercent) {
+
+    bool isOverWatermark = reserveUsedPercent >= COMPACTION_WATERMARK;
+    {
+        lock_guard<mutex> lk(_backlogMutex);
+        const pair<uint64_t, uint32_t> key = make_pair(segmentId, blockId);
+        CompactionEntry& entry = _backlog[key];
+        removeFromOrder(key, entry);
+        _backlogDeltas += deltaCount - entry.deltaCount;
+        _backlogBytes += deltaLength;
+        entry.isParity = isParity;
+        entry.deltaCount = deltaCount;
+        entry.deltaBytes += deltaLength;
+        entry.reserveUsedPercent = reserveUsedPercent;
+        addToOrder(key, entry);
+    }
+
+    if (isOverWatermark) {
+        _backlogCond.notify_one();
+    }
+}
+
+void CompactionScheduler::recordMerge(uint64_t segmentId, uint32_t blockId,
+        bool isInline) {
+
+    if (isInline) {
+        _inlineMergeCount++;
+    }
+
+    lock_guard<mutex> lk(_backlogMutex);
+    auto it = _backlog.find(make_pair(segmentId, blockId));
+    if (it == _backlog.end()) {
+        return;
+    }
+    _backlogDeltas -= it->second.deltaCount;
+    _backlogBytes -= it->second.deltaBytes;
+    removeFromOrder(it->first, it->second);
+    _backlog.erase(it);
+}
+
+void CompactionScheduler::recordForegroundIo() {
+    _lastForegroundIo = getSteadyTime();
+}
+
+void CompactionScheduler::printStat() {
+    lock_guard<mutex> lk(_backlogMutex);
+    cout << "Compaction: backlog blocks = " << _backlog.size() << " deltas = "
+            << _backlogDeltas << " bytes = " << _backlogBytes
+            << " background merges = " << _backgroundMergeCount
+            << " inline merges = " << _inlineMergeCount << " merged bytes = "
+            << _mergedBytes << " throttled = " << _throttledTime << " us"
+            << endl;
+}
+
+//
+// PRIVATE FUNCTIONS
+//
+
+bool CompactionScheduler::pickBlock(bool isIdle,
+        pair<uint64_t, uint32_t>& key, CompactionEntry& entry) {
+
+    // the block with the most deltas is the last of the order
+    const set<pair<uint32_t, pair<uint64_t, uint32_t>>>& order =
+            isIdle ? _deltaCountOrder : _watermarkOrder;
+    if (order.empty()) {
+        return false;
+    }
+    key = order.rbegin()->second;
+    entry = _backlog[key];
+    return true;
+}
+
+void CompactionScheduler::addToOrder(const pair<uint64_t, uint32_t>& key,
+        const CompactionEntry& entry) {
+    _deltaCountOrder.insert(make_pair(entry.deltaCount, key));
+    if (entry.reserveUsedPercent >= COMPACTION_WATERMARK) {
+        _watermarkOrder.insert(make_pair(entry.deltaCount, key));
+    }
+}
+
+void CompactionScheduler::removeFromOrder(const pair<uint64_t, uint32_t>& key,
+        const CompactionEntry& entry) {
+    _deltaCountOrder.erase(make_pair(entry.deltaCount, key));
+    _watermarkOrder.erase(make_pair(entry.deltaCount, key));
+}
+
+bool CompactionScheduler::isIdle() {
+    return getSteadyTime() - _lastForegroundIo >= COMPACTION_IDLE_TIME;
+}
+
+void CompactionScheduler::compactionLoop() {
+    while (true) {
+        pair<uint64_t, uint32_t> key;
+        CompactionEntry entry;
+        bool isIdleNow = isIdle();
+        {
+            unique_lock<mutex> lk(_backlogMutex);
+            if (!_isRunning) {
+                return;
+            }
+            if (!pickBlock(isIdleNow, key, entry)) {
+                _backlogCond.wait_for(lk,
+                        chrono::microseconds(COMPACTION_POLL_INTERVAL));
+                continue;
+            }
+        }
+
+        debug(
+                "Compacting Segment ID = %" PRIu64 " Block ID = %" PRIu32 " deltaCount = %" PRIu32 " idle = %d\n",
+                key.first, key.second, entry.deltaCount, isIdleNow);
+
+        // the merge removes the block from the backlog
+        const uint64_t byteMerged = _mergeFunction(key.first, key.second,
+                entry.isParity);
+        _backgroundMergeCount++;
+        _mergedBytes += byteMerged;
+
+        // leave the disk to foreground I/O: pace to COMPACTION_RATE
+        if (!isIdle()) {
+            const uint64_t pause = byteMerged * 1000000 / COMPACTION_RATE;
+            unique_lock<mutex> lk(_backlogMutex);
+            _backlogCond.wait_for(lk, chrono::microseconds(pause),
+                    [&] {return !_isRunning;});
+            _throttledTime += pause;
+        }
+    }
+}
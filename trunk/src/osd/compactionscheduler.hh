@@ -0,0 +1,153 @@
+#ifndef __COMPACTIONSCHEDULER_HH__
+#define __COMPACTIONSCHEDULER_HH__
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+/**
+ * A block with deltas waiting to be merged
+ */
+
+struct CompactionEntry {
+    bool isParity;
+    uint32_t deltaCount;
+    uint32_t deltaBytes; // bytes of deltas written since the last merge
+    uint32_t reserveUsedPercent; // share of the reserved space used
+};
+
+/**
+ * Background merging of the deltas of PLR parity blocks
+ *
+ * The StorageModule reports every delta it writes and every merge it does.
+ * A compaction thread merges a block once its reserved space is
+ * COMPACTION_WATERMARK percent used, or any block with deltas once no
+ * foreground I/O was seen for COMPACTION_IDLE_TIME. The block with the
+ * most deltas goes first. While foreground I/O is running, merge I/O is
+ * paced to COMPACTION_RATE. Merges done inline by a writer whose reserve
+ * ran out are counted separately; they show that compaction falls behind.
+ */
+
+class CompactionScheduler {
+public:
+
+    /**
+     * Constructor, starts the compaction thread
+     * @param mergeFunction Merges a block with the block lock taken and
+     * returns the bytes read and written (segmentId, blockId, isParity)
+     */
+
+    CompactionScheduler(
+            function<uint64_t(uint64_t, uint32_t, bool)> mergeFunction);
+
+    /**
+     * Destructor, stops the compaction thread
+     */
+
+    ~CompactionScheduler();
+
+    /**
+     * Record a delta written to a block (block lock held by the caller)
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param isParity Whether the block is a parity block
+     * @param deltaCount Number of deltas of the block
+     * @param deltaLength Length of the delta written
+     * @param reserveUsedPercent Share of the reserved space used
+     */
+
+    void recordDelta(uint64_t segmentId, uint32_t blockId, bool isParity,
+            uint32_t deltaCount, uint32_t deltaLength,
+            uint32_t reserveUsedPercent);
+
+    /**
+     * Record that the deltas of a block were merged (block lock held by
+     * the caller)
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param isInline Whether a writer merged because the reserve ran out
+     */
+
+    void recordMerge(uint64_t segmentId, uint32_t blockId, bool isInline);
+
+    /**
+     * Record foreground I/O, which throttles compaction
+     */
+
+    void recordForegroundIo();
+
+    /**
+     * Print the backlog and the merges done
+     */
+
+    void printStat();
+
+private:
+
+    /**
+     * Pick the next block to merge (_backlogMutex held)
+     * @param isIdle Whether the OSD has no foreground I/O
+     * @param key Key of the picked block
+     * @param entry Entry of the picked block
+     * @return FALSE if there is no block to merge
+     */
+
+    bool pickBlock(bool isIdle, pair<uint64_t, uint32_t>& key,
+            CompactionEntry& entry);
+
+    /**
+     * Add a backlog entry to the delta count orders (_backlogMutex held)
+     * @param key Key of the block
+     * @param entry Entry of the block
+     */
+
+    void addToOrder(const pair<uint64_t, uint32_t>& key,
+            const CompactionEntry& entry);
+
+    /**
+     * Remove a backlog entry from the delta count orders (_backlogMutex
+     * held)
+     * @param key Key of the block
+     * @param entry Entry of the block
+     */
+
+    void removeFromOrder(const pair<uint64_t, uint32_t>& key,
+            const CompactionEntry& entry);
+
+    /**
+     * Check whether foreground I/O was seen recently
+     * @return TRUE if no foreground I/O for COMPACTION_IDLE_TIME
+     */
+
+    bool isIdle();
+
+    void compactionLoop();
+
+    function<uint64_t(uint64_t, uint32_t, bool)> _mergeFunction;
+
+    map<pair<uint64_t, uint32_t>, CompactionEntry> _backlog;
+    set<pair<uint32_t, pair<uint64_t, uint32_t>>> _deltaCountOrder; // all blocks
+    set<pair<uint32_t, pair<uint64_t, uint32_t>>> _watermarkOrder; // reserve over watermark
+    uint64_t _backlogDeltas;
+    uint64_t _backlogBytes;
+    mutex _backlogMutex;
+    condition_variable _backlogCond;
+
+    atomic<uint64_t> _lastForegroundIo; // steady clock, in us
+    atomic<uint64_t> _backgroundMergeCount;
+    atomic<uint64_t> _inlineMergeCount;
+    atomic<uint64_t> _mergedBytes;
+    atomic<uint64_t> _throttledTime; // us slept to pace merge I/O
+
+    bool _isRunning;
+    thread _compactionThread;
+};
+
+#endif
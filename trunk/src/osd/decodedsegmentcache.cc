@@ -0,0 +1,200 @@
+#include <iostream>
+#include "decodedsegmentcache.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+#include "../common/memorypool.hh"
+
+DecodedSegmentCache::DecodedSegmentCache(uint64_t capacity) {
+    _capacity = capacity;
+    _inCapacity = capacity * SEGMENT_CACHE_IN_PERCENT / 100;
+    _usedBytes = 0;
+    _inBytes = 0;
+    _epoch = 0;
+    _hitCount = 0;
+    _missCount = 0;
+    _evictCount = 0;
+}
+
+DecodedSegmentCache::~DecodedSegmentCache() {
+    lock_guard<mutex> lk(_cacheMutex);
+    for (auto& entry : _entryMap) {
+        if (entry.second->pinCount == 0) {
+            MemoryPool::getInstance().poolFree(entry.second->segmentData.buf);
+            delete entry.second;
+        }
+    }
+}
+
+DecodedSegmentEntry* DecodedSegmentCache::acquire(uint64_t segmentId) {
+    lock_guard<mutex> lk(_cacheMutex);
+
+    auto it = _entryMap.find(segmentId);
+    if (it == _entryMap.end()) {
+        _missCount++;
+        return NULL;
+    }
+
+    DecodedSegmentEntry* entry = it->second;
+    if (entry->isInAm) {
+        _am.splice(_am.end(), _am, entry->position);
+    }
+    entry->pinCount++;
+    _hitCount++;
+    return entry;
+}
+
+void DecodedSegmentCache::release(DecodedSegmentEntry* entry) {
+    lock_guard<mutex> lk(_cacheMutex);
+
+    entry->pinCount--;
+    if (entry->pinCount == 0) {
+        if (entry->isStale) {
+            MemoryPool::getInstance().poolFree(entry->segmentData.buf);
+            delete entry;
+        } else if (_usedBytes > _capacity) {
+            evict();
+        }
+    }
+}
+
+uint64_t DecodedSegmentCache::getEpoch() {
+    lock_guard<mutex> lk(_cacheMutex);
+    return _epoch;
+}
+
+bool DecodedSegmentCache::insert(uint64_t segmentId, SegmentData segmentData,
+        uint64_t epoch) {
+    lock_guard<mutex> lk(_cacheMutex);
+
+    const uint32_t segLength = segmentData.info.segLength;
+    if (epoch != _epoch || segLength > _capacity
+            || _entryMap.count(segmentId)) {
+        return false;
+    }
+
+    DecodedSegmentEntry* entry = new DecodedSegmentEntry();
+    entry->segmentData = segmentData;
+    entry->pinCount = 0;
+    entry->isStale = false;
+
+    auto ghost = _ghostMap.find(segmentId);
+    if (ghost != _ghostMap.end()) {
+        // read again soon after leaving A1in
+        _a1out.erase(ghost->second);
+        _ghostMap.erase(ghost);
+        entry->isInAm = true;
+        entry->position = _am.insert(_am.end(), segmentId);
+    } else {
+        entry->isInAm = false;
+        entry->position = _a1in.insert(_a1in.end(), segmentId);
+        _inBytes += segLength;
+    }
+
+    _entryMap[segmentId] = entry;
+    _usedBytes += segLength;
+    evict();
+
+    return true;
+}
+
+void DecodedSegmentCache::invalidate(uint64_t segmentId) {
+    lock_guard<mutex> lk(_cacheMutex);
+
+    _epoch++;
+    auto ghost = _ghostMap.find(segmentId);
+    if (ghost != _ghostMap.end()) {
+        _a1out.erase(ghost->second);
+        _ghostMap.erase(ghost);
+    }
+
+    auto it = _entryMap.find(segmentId);
+    if (it != _entryMap.end()) {
+        removeEntry(segmentId, it->second);
+    }
+}
+
+void DecodedSegmentCache::printStat() {
+    lock_guard<mutex> lk(_cacheMutex);
+
+    const uint64_t hitCount = _hitCount;
+    const uint64_t missCount = _missCount;
+    const double hitRatio =
+            (hitCount + missCount) ?
+                    (double) hitCount / (hitCount + missCount) : 0;
+
+    cout << "Decoded Segment Cache: hit = " << hitCount << " miss = "
+            << missCount << " hit ratio = " << hitRatio << " evicted = "
+            << _evictCount << " used = " << _usedBytes << " / " << _capacity
+            << " segments = " << _entryMap.size() << endl;
+}
+
+//
+// PRIVATE FUNCTIONS
+//
+
+void DecodedSegmentCache::evict() {
+    while (_usedBytes > _capacity) {
+
+        // take from A1in while it is over its share, otherwise from Am
+        list<uint64_t>* queue = (_inBytes > _inCapacity || _am.empty()) ?
+                &_a1in : &_am;
+
+        list<uint64_t>::iterator victim = queue->begin();
+        while (victim != queue->end() && _entryMap[*victim]->pinCount > 0) {
+            victim++;
+        }
+        if (victim == queue->end()) {
+            queue = (queue == &_a1in) ? &_am : &_a1in;
+            victim = queue->begin();
+            while (victim != queue->end() && _entryMap[*victim]->pinCount > 0) {
+                victim++;
+            }
+            if (victim == queue->end()) {
+                // every segment is in use, shrink when they are released
+                return;
+            }
+        }
+
+        const uint64_t segmentId = *victim;
+        if (queue == &_a1in) {
+            addGhost(segmentId);
+        }
+        removeEntry(segmentId, _entryMap[segmentId]);
+        _evictCount++;
+
+        debug("Decoded segment %" PRIu64 " evicted, used = %" PRIu64 "\n",
+                segmentId, _usedBytes);
+    }
+}
+
+void DecodedSegmentCache::addGhost(uint64_t segmentId) {
+    if (_ghostMap.count(segmentId)) {
+        return;
+    }
+    if (_a1out.size() >= SEGMENT_CACHE_GHOSTS) {
+        _ghostMap.erase(_a1out.front());
+        _a1out.pop_front();
+    }
+    _ghostMap[segmentId] = _a1out.insert(_a1out.end(), segmentId);
+}
+
+void DecodedSegmentCache::removeEntry(uint64_t segmentId,
+        DecodedSegmentEntry* entry) {
+
+    const uint32_t segLength = entry->segmentData.info.segLength;
+    if (entry->isInAm) {
+        _am.erase(entry->position);
+    } else {
+        _a1in.erase(entry->position);
+        _inBytes -= segLength;
+    }
+    _usedBytes -= segLength;
+    _entryMap.erase(segmentId);
+
+    if (entry->pinCount == 0) {
+        MemoryPool::getInstance().poolFree(entry->segmentData.buf);
+        delete entry;
+    } else {
+        entry->isStale = true;
+    }
+}
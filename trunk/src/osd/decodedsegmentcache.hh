@@ -0,0 +1,144 @@
+#ifndef __DECODEDSEGMENTCACHE_HH__
+#define __DECODEDSEGMENTCACHE_HH__
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "../common/segmentdata.hh"
+
+using namespace std;
+
+/**
+ * A decoded segment kept by the DecodedSegmentCache
+ */
+
+struct DecodedSegmentEntry {
+    SegmentData segmentData;
+    uint32_t pinCount; // readers using segmentData
+    bool isInAm; // in the frequently read queue
+    bool isStale; // invalidated, freed by the last reader
+    list<uint64_t>::iterator position;
+};
+
+/**
+ * Size-bounded cache of decoded segments on the primary, with 2Q admission
+ *
+ * A segment read for the first time enters A1in, a FIFO of about
+ * SEGMENT_CACHE_IN_PERCENT of the cache. When it leaves A1in only its ID is
+ * remembered in A1out; a segment read again while in A1out is admitted to
+ * Am, an LRU holding the rest of the cache. A scan of segments read once
+ * therefore cannot push out the segments read repeatedly.
+ *
+ * Readers pin an entry while they use its buffer. Pinned entries are not
+ * evicted, and an invalidated pinned entry is freed by its last reader.
+ */
+
+class DecodedSegmentCache {
+public:
+
+    /**
+     * Constructor
+     * @param capacity Bytes of decoded segments to keep
+     */
+
+    DecodedSegmentCache(uint64_t capacity);
+
+    /**
+     * Destructor, frees every unpinned segment
+     */
+
+    ~DecodedSegmentCache();
+
+    /**
+     * Find a segment and pin it
+     * @param segmentId Segment ID
+     * @return Pinned entry, NULL if not cached
+     */
+
+    DecodedSegmentEntry* acquire(uint64_t segmentId);
+
+    /**
+     * Unpin an entry returned by acquire
+     * @param entry Pinned entry
+     */
+
+    void release(DecodedSegmentEntry* entry);
+
+    /**
+     * Get the invalidation epoch, taken before a segment is fetched so that
+     * an update finishing during the fetch keeps the result out of the cache
+     * @return Current epoch
+     */
+
+    uint64_t getEpoch();
+
+    /**
+     * Offer a decoded segment to the cache, which owns its buffer if taken
+     * @param segmentId Segment ID
+     * @param segmentData Decoded segment, buffer from MemoryPool
+     * @param epoch Epoch taken before the segment was fetched
+     * @return true if cached, false if the caller should free the buffer
+     */
+
+    bool insert(uint64_t segmentId, SegmentData segmentData, uint64_t epoch);
+
+    /**
+     * Drop a segment after it is updated
+     * @param segmentId Segment ID
+     */
+
+    void invalidate(uint64_t segmentId);
+
+    /**
+     * Print the hit ratio and usage of the cache
+     */
+
+    void printStat();
+
+private:
+
+    /**
+     * Evict unpinned segments until the cache fits in its capacity
+     * Caller must hold _cacheMutex
+     */
+
+    void evict();
+
+    /**
+     * Remember the ID of a segment evicted from A1in
+     * Caller must hold _cacheMutex
+     * @param segmentId Segment ID
+     */
+
+    void addGhost(uint64_t segmentId);
+
+    /**
+     * Remove an entry from its queue and the map, free it if unpinned
+     * Caller must hold _cacheMutex
+     * @param segmentId Segment ID
+     * @param entry Entry of the segment
+     */
+
+    void removeEntry(uint64_t segmentId, DecodedSegmentEntry* entry);
+
+    uint64_t _capacity;
+    uint64_t _inCapacity;
+    uint64_t _usedBytes;
+    uint64_t _inBytes;
+    uint64_t _epoch;
+
+    unordered_map<uint64_t, DecodedSegmentEntry*> _entryMap;
+    list<uint64_t> _a1in; // oldest at front
+    list<uint64_t> _am; // least recently read at front
+    list<uint64_t> _a1out; // oldest at front
+    unordered_map<uint64_t, list<uint64_t>::iterator> _ghostMap;
+    mutex _cacheMutex;
+
+    atomic<uint64_t> _hitCount;
+    atomic<uint64_t> _missCount;
+    atomic<uint64_t> _evictCount;
+};
+
+#endif
@@ -0,0 +1,603 @@
+/*
+ * extentblockstore.cc
+ */
+
+#include <linux/falloc.h>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "extentblockstore.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+
+#define EXTENT_NONE UINT32_MAX
+
+ExtentBlockStore::ExtentBlockStore(string blockFolder) {
+
+    // append a '/' if not present
+    if (blockFolder[blockFolder.length() - 1] != '/') {
+        blockFolder.append("/");
+    }
+    _blockFolder = blockFolder;
+    _indexPath = _blockFolder + "extent.index";
+    _indexFd = -1;
+    _activeExtent = EXTENT_NONE;
+    _activeTail = 0;
+    _liveBytes = 0;
+
+    // extents are never deleted, so their IDs have no holes
+    struct stat st;
+    while (stat((_blockFolder + "extent." + to_string(_extentFd.size())).c_str(),
+            &st) == 0) {
+        openExtent(_extentFd.size());
+    }
+
+    loadIndex();
+
+    for (uint32_t i = 0; i < _extentFd.size(); i++) {
+        if (_extentLiveBytes[i] == 0) {
+            _freeExtentList.push_back(i);
+        }
+    }
+
+    resumeActiveExtent();
+
+    debug("Extent store loaded %zu extents %zu blocks %" PRIu64 " bytes\n",
+            _extentFd.size(), _index.size(), _liveBytes);
+}
+
+ExtentBlockStore::~ExtentBlockStore() {
+    for (int fd : _extentFd) {
+        ::close(fd);
+    }
+    if (_indexFd >= 0) {
+        ::close(_indexFd);
+    }
+}
+
+void ExtentBlockStore::create(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, uint32_t length) {
+
+    const ExtentKey key = {segmentId, blockId, deltaId};
+
+    lock_guard<mutex> lk(_indexMutex);
+    dropPieces(key);
+
+    // allocate the whole block at once so that it stays contiguous
+    if (length > 0) {
+        allocate(key, 0, length);
+    }
+}
+
+void ExtentBlockStore::prepareRead(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+        vector<IoRequest>& batch) {
+
+    const ExtentKey key = {segmentId, blockId, deltaId};
+    vector<IoRequest> ioList;
+    {
+        lock_guard<mutex> lk(_indexMutex);
+        ioList = mapRange(key, buf, offset, length, false);
+    }
+
+    if (ioList.empty() && length > 0) {
+        debug_error(
+                "Block not stored Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 " Offset = %" PRIu64 " Length = %" PRIu32 "\n",
+                segmentId, blockId, deltaId, offset, length);
+        exit(-1);
+    }
+
+    batch.insert(batch.end(), ioList.begin(), ioList.end());
+}
+
+bool ExtentBlockStore::pinRanges(uint64_t segmentId, uint32_t blockId,
+        const vector<offset_length_t>& ranges, vector<IoRequest>& batch) {
+
+    const ExtentKey key = {segmentId, blockId, BLOCK_STORE_NO_DELTA};
+    vector<IoRequest> ioList;
+
+    lock_guard<mutex> lk(_indexMutex);
+    for (offset_length_t range : ranges) {
+        vector<IoRequest> rangeIoList = mapRange(key, NULL, range.first,
+                range.second, false);
+        if (rangeIoList.empty() && range.second > 0) {
+            return false;
+        }
+        ioList.insert(ioList.end(), rangeIoList.begin(), rangeIoList.end());
+    }
+    _pinCount[key]++;
+
+    batch.insert(batch.end(), ioList.begin(), ioList.end());
+    return true;
+}
+
+void ExtentBlockStore::unpin(uint64_t segmentId, uint32_t blockId) {
+
+    const ExtentKey key = {segmentId, blockId, BLOCK_STORE_NO_DELTA};
+
+    lock_guard<mutex> lk(_indexMutex);
+    auto it = _pinCount.find(key);
+    if (it == _pinCount.end()) {
+        debug_error("Block not pinned Segment ID = %" PRIu64 " Block ID = %" PRIu32 "\n",
+                segmentId, blockId);
+        return;
+    }
+    if (--it->second > 0) {
+        return;
+    }
+    _pinCount.erase(it);
+
+    auto retired = _retiredPieces.find(key);
+    if (retired != _retiredPieces.end()) {
+        for (const ExtentPiece& piece : retired->second) {
+            releasePiece(piece);
+        }
+        _retiredPieces.erase(retired);
+    }
+}
+
+void ExtentBlockStore::prepareWrite(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+        vector<IoRequest>& batch) {
+
+    const ExtentKey key = {segmentId, blockId, deltaId};
+    vector<IoRequest> ioList;
+    {
+        lock_guard<mutex> lk(_indexMutex);
+
+        // the pinned pieces may still be sent, write the range to new ones
+        auto it = _index.find(key);
+        if (it != _index.end() && _pinCount.count(key)) {
+            carveRange(it->second, offset, offset + length,
+                    _retiredPieces[key]);
+        }
+
+        ioList = mapRange(key, buf, offset, length, true);
+    }
+    for (IoRequest& request : ioList) {
+        request.type = IO_WRITE;
+    }
+
+    batch.insert(batch.end(), ioList.begin(), ioList.end());
+}
+
+void ExtentBlockStore::reserve(uint64_t segmentId, uint32_t blockId,
+        uint64_t offset, uint32_t length) {
+
+    const ExtentKey key = {segmentId, blockId, BLOCK_STORE_NO_DELTA};
+
+    // extents are preallocated, so allocating the pieces is enough
+    lock_guard<mutex> lk(_indexMutex);
+    mapRange(key, NULL, offset, length, true);
+}
+
+void ExtentBlockStore::remove(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId) {
+
+    const ExtentKey key = {segmentId, blockId, deltaId};
+
+    lock_guard<mutex> lk(_indexMutex);
+    dropPieces(key);
+}
+
+void ExtentBlockStore::prepareSync(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, vector<IoRequest>& batch) {
+
+    // the extents holding the block, and the index locating it
+    const ExtentKey key = {segmentId, blockId, deltaId};
+    vector<int> fdList;
+    {
+        lock_guard<mutex> lk(_indexMutex);
+        auto it = _index.find(key);
+        if (it == _index.end()) {
+            return;
+        }
+        for (const ExtentPiece& piece : it->second) {
+            fdList.push_back(_extentFd[piece.extentId]);
+        }
+    }
+    fdList.push_back(_indexFd);
+    sort(fdList.begin(), fdList.end());
+    fdList.erase(unique(fdList.begin(), fdList.end()), fdList.end());
+
+    for (int fd : fdList) {
+        IoRequest request;
+        request.fd = fd;
+        request.type = IO_SYNC;
+        request.ownsFd = false;
+        request.buf = NULL;
+        request.offset = 0;
+        request.length = 0;
+        batch.push_back(request);
+    }
+}
+
+void ExtentBlockStore::close(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId) {
+    // extents stay open
+}
+
+uint64_t ExtentBlockStore::getUsage() {
+    lock_guard<mutex> lk(_indexMutex);
+
+    // holes are only reused once their extent is empty
+    uint64_t usage = 0;
+    for (uint32_t i = 0; i < _extentFd.size(); i++) {
+        if (i == _activeExtent) {
+            usage += _activeTail;
+        } else if (_extentLiveBytes[i] != 0) {
+            usage += EXTENT_FILE_SIZE;
+        }
+    }
+    return usage;
+}
+
+vector<IoRequest> ExtentBlockStore::mapRange(const ExtentKey& key, char* buf,
+        uint64_t offset, uint32_t length, bool allocate) {
+
+    const uint64_t end = offset + length;
+
+    if (allocate) {
+        // find the holes first, as allocating changes the piece list
+        vector<offset_length_t> holeList;
+        uint64_t cur = offset;
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            for (const ExtentPiece& piece : it->second) {
+                const uint64_t pieceEnd = (uint64_t) piece.logicalOffset
+                        + piece.length;
+                if (pieceEnd <= cur) {
+                    continue;
+                }
+                if (piece.logicalOffset >= end) {
+                    break;
+                }
+                if (piece.logicalOffset > cur) {
+                    holeList.push_back(
+                            make_pair(cur, piece.logicalOffset - cur));
+                }
+                cur = pieceEnd;
+            }
+        }
+        if (cur < end) {
+            holeList.push_back(make_pair(cur, end - cur));
+        }
+        for (offset_length_t hole : holeList) {
+            this->allocate(key, hole.first, hole.second);
+        }
+    }
+
+    vector<IoRequest> ioList;
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return {};
+    }
+
+    uint64_t cur = offset;
+    for (const ExtentPiece& piece : it->second) {
+        const uint64_t pieceEnd = (uint64_t) piece.logicalOffset + piece.length;
+        if (pieceEnd <= cur) {
+            continue;
+        }
+        if (piece.logicalOffset >= end || piece.logicalOffset > cur) {
+            break;
+        }
+        IoRequest request;
+        request.fd = _extentFd[piece.extentId];
+        request.type = IO_READ;
+        request.ownsFd = false; // extents stay open
+        request.buf = buf + (cur - offset);
+        request.offset = piece.extentOffset + (cur - piece.logicalOffset);
+        request.length = min(pieceEnd, end) - cur;
+        ioList.push_back(request);
+        cur += request.length;
+    }
+
+    if (cur < end) { // part of the range is not stored
+        return {};
+    }
+    return ioList;
+}
+
+void ExtentBlockStore::allocate(const ExtentKey& key, uint32_t logicalOffset,
+        uint32_t length) {
+
+    // a piece never crosses the end of an extent
+    while (length > 0) {
+        if (_activeExtent == EXTENT_NONE || _activeTail == EXTENT_FILE_SIZE) {
+            switchActiveExtent();
+        }
+
+        ExtentPiece piece;
+        piece.logicalOffset = logicalOffset;
+        piece.length = min((uint64_t) length,
+                (uint64_t) EXTENT_FILE_SIZE - _activeTail);
+        piece.extentId = _activeExtent;
+        piece.extentOffset = _activeTail;
+
+        _activeTail += piece.length;
+        _extentLiveBytes[_activeExtent] += piece.length;
+        _liveBytes += piece.length;
+
+        addPiece(key, piece);
+        logRecord(EXTENT_INDEX_PUT, key, piece);
+
+        logicalOffset += piece.length;
+        length -= piece.length;
+    }
+}
+
+void ExtentBlockStore::addPiece(const ExtentKey& key, const ExtentPiece& piece) {
+
+    vector<ExtentPiece>& pieceList = _index[key];
+
+    // a piece replaces the range of earlier ones, which only overlap when
+    // the index is replayed after a write to a pinned block
+    vector<ExtentPiece> replaced;
+    carveRange(pieceList, piece.logicalOffset,
+            (uint64_t) piece.logicalOffset + piece.length, replaced);
+
+    auto it = upper_bound(pieceList.begin(), pieceList.end(), piece,
+            [](const ExtentPiece& a, const ExtentPiece& b) {
+                return a.logicalOffset < b.logicalOffset;
+            });
+
+    if (it != pieceList.begin()) {
+        ExtentPiece& prev = *(it - 1);
+        if (prev.extentId == piece.extentId
+                && prev.logicalOffset + prev.length == piece.logicalOffset
+                && prev.extentOffset + prev.length == piece.extentOffset) {
+            prev.length += piece.length;
+            return;
+        }
+    }
+    pieceList.insert(it, piece);
+}
+
+void ExtentBlockStore::carveRange(vector<ExtentPiece>& pieceList,
+        uint64_t offset, uint64_t end, vector<ExtentPiece>& carved) {
+
+    vector<ExtentPiece> keptList;
+    for (const ExtentPiece& piece : pieceList) {
+        const uint64_t pieceEnd = (uint64_t) piece.logicalOffset + piece.length;
+        if (pieceEnd <= offset || piece.logicalOffset >= end) {
+            keptList.push_back(piece);
+            continue;
+        }
+
+        // split into the parts before, inside and after the range
+        const uint64_t from = max(offset, (uint64_t) piece.logicalOffset);
+        const uint64_t to = min(end, pieceEnd);
+        if (piece.logicalOffset < from) {
+            ExtentPiece head = piece;
+            head.length = from - piece.logicalOffset;
+            keptList.push_back(head);
+        }
+        ExtentPiece middle = piece;
+        middle.logicalOffset = from;
+        middle.length = to - from;
+        middle.extentOffset = piece.extentOffset + (from - piece.logicalOffset);
+        carved.push_back(middle);
+        if (to < pieceEnd) {
+            ExtentPiece tail = piece;
+            tail.logicalOffset = to;
+            tail.length = pieceEnd - to;
+            tail.extentOffset = piece.extentOffset + (to - piece.logicalOffset);
+            keptList.push_back(tail);
+        }
+    }
+    pieceList.swap(keptList);
+}
+
+void ExtentBlockStore::dropPieces(const ExtentKey& key) {
+
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return;
+    }
+
+    // the pieces of a pinned block may still be sent
+    if (_pinCount.count(key)) {
+        vector<ExtentPiece>& retiredList = _retiredPieces[key];
+        retiredList.insert(retiredList.end(), it->second.begin(),
+                it->second.end());
+    } else {
+        for (const ExtentPiece& piece : it->second) {
+            releasePiece(piece);
+        }
+    }
+    _index.erase(it);
+
+    logRecord(EXTENT_INDEX_REMOVE, key, {});
+}
+
+void ExtentBlockStore::releasePiece(const ExtentPiece& piece) {
+
+    // punch while holding the lock, or a reused extent could lose new data
+    if (fallocate(_extentFd[piece.extentId],
+            FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, piece.extentOffset,
+            piece.length) != 0) {
+        debug("Failed to punch extent %" PRIu32 "\n", piece.extentId);
+    }
+    _extentLiveBytes[piece.extentId] -= piece.length;
+    _liveBytes -= piece.length;
+    if (_extentLiveBytes[piece.extentId] == 0
+            && piece.extentId != _activeExtent) {
+        _freeExtentList.push_back(piece.extentId);
+    }
+}
+
+void ExtentBlockStore::switchActiveExtent() {
+
+    // an emptied active extent can be appended from the start again
+    if (_activeExtent == EXTENT_NONE || _extentLiveBytes[_activeExtent] != 0) {
+        if (_freeExtentList.empty()) {
+            _activeExtent = _extentFd.size();
+        } else {
+            _activeExtent = _freeExtentList.front();
+            _freeExtentList.pop_front();
+        }
+    }
+
+    if (_activeExtent == _extentFd.size()) {
+        openExtent(_activeExtent);
+    } else {
+        // allocate the punched holes again
+        if (posix_fallocate(_extentFd[_activeExtent], 0, EXTENT_FILE_SIZE)
+                != 0) {
+            debug_error("Failed to reserve extent %" PRIu32 "\n",
+                    _activeExtent);
+            exit(-1);
+        }
+    }
+    _activeTail = 0;
+
+    debug("Active extent = %" PRIu32 "\n", _activeExtent);
+}
+
+void ExtentBlockStore::resumeActiveExtent() {
+
+    // the end of the last piece of each extent
+    vector<uint64_t> usedEnd(_extentFd.size(), 0);
+    for (auto& entry : _index) {
+        for (const ExtentPiece& piece : entry.second) {
+            usedEnd[piece.extentId] = max(usedEnd[piece.extentId],
+                    piece.extentOffset + piece.length);
+        }
+    }
+
+    // the extent with the longest free tail, normally the one active when
+    // the store was closed
+    for (uint32_t i = 0; i < _extentFd.size(); i++) {
+        if (_extentLiveBytes[i] == 0 || usedEnd[i] == EXTENT_FILE_SIZE) {
+            continue;
+        }
+        if (_activeExtent == EXTENT_NONE || usedEnd[i] < _activeTail) {
+            _activeExtent = i;
+            _activeTail = usedEnd[i];
+        }
+    }
+
+    if (_activeExtent == EXTENT_NONE) {
+        return;
+    }
+
+    // the tail may have been punched by removals
+    if (posix_fallocate(_extentFd[_activeExtent], _activeTail,
+            EXTENT_FILE_SIZE - _activeTail) != 0) {
+        debug_error("Failed to reserve extent %" PRIu32 "\n", _activeExtent);
+        exit(-1);
+    }
+
+    debug("Active extent = %" PRIu32 " resumed at %" PRIu64 "\n",
+            _activeExtent, _activeTail);
+}
+
+int ExtentBlockStore::openExtent(uint32_t extentId) {
+
+    const string extentPath = _blockFolder + "extent." + to_string(extentId);
+
+    int fd = open(extentPath.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("open");
+        exit(-1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < EXTENT_FILE_SIZE) {
+        if (posix_fallocate(fd, 0, EXTENT_FILE_SIZE) != 0) {
+            debug_error("Failed to reserve space: %s\n", extentPath.c_str());
+            exit(-1);
+        }
+    }
+
+    if (_extentFd.size() <= extentId) {
+        _extentFd.resize(extentId + 1, -1);
+        _extentLiveBytes.resize(extentId + 1, 0);
+    }
+    _extentFd[extentId] = fd;
+
+    return fd;
+}
+
+void ExtentBlockStore::logRecord(uint32_t op, const ExtentKey& key,
+        const ExtentPiece& piece) {
+
+    ExtentIndexRecord record;
+    record.op = op;
+    record.segmentId = key.segmentId;
+    record.blockId = key.blockId;
+    record.deltaId = key.deltaId;
+    record.logicalOffset = piece.logicalOffset;
+    record.length = piece.length;
+    record.extentId = piece.extentId;
+    record.extentOffset = piece.extentOffset;
+
+    if (::write(_indexFd, &record, sizeof(record)) != sizeof(record)) {
+        perror("write");
+        debug_error("Failed to log to %s\n", _indexPath.c_str());
+        exit(-1);
+    }
+}
+
+void ExtentBlockStore::loadIndex() {
+
+    // replay the log, a torn record at the end is ignored
+    int fd = open(_indexPath.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ExtentIndexRecord record;
+        while (::read(fd, &record, sizeof(record)) == sizeof(record)) {
+            const ExtentKey key = {record.segmentId, record.blockId,
+                    record.deltaId};
+            if (record.op == EXTENT_INDEX_REMOVE) {
+                _index.erase(key);
+            } else if (record.op == EXTENT_INDEX_PUT
+                    && record.extentId < _extentFd.size()) {
+                ExtentPiece piece;
+                piece.logicalOffset = record.logicalOffset;
+                piece.length = record.length;
+                piece.extentId = record.extentId;
+                piece.extentOffset = record.extentOffset;
+                addPiece(key, piece);
+            } else {
+                debug_error("Invalid index record op = %" PRIu32 " extent = %" PRIu32 "\n",
+                        record.op, record.extentId);
+            }
+        }
+        ::close(fd);
+    }
+
+    // rewrite the log with only the live pieces
+    const string tmpPath = _indexPath + ".tmp";
+    _indexFd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+            S_IRUSR | S_IWUSR);
+    if (_indexFd < 0) {
+        perror("open");
+        exit(-1);
+    }
+
+    for (auto& entry : _index) {
+        for (const ExtentPiece& piece : entry.second) {
+            _extentLiveBytes[piece.extentId] += piece.length;
+            _liveBytes += piece.length;
+            logRecord(EXTENT_INDEX_PUT, entry.first, piece);
+        }
+    }
+
+    fsync(_indexFd);
+    ::close(_indexFd);
+    if (rename(tmpPath.c_str(), _indexPath.c_str()) != 0) {
+        perror("rename");
+        exit(-1);
+    }
+
+    _indexFd = open(_indexPath.c_str(), O_WRONLY | O_APPEND);
+    if (_indexFd < 0) {
+        perror("open");
+        exit(-1);
+    }
+}
@@ -0,0 +1,245 @@
+#ifndef __EXTENTBLOCKSTORE_HH__
+#define __EXTENTBLOCKSTORE_HH__
+
+#include <string>
+#include <stdint.h>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "blockstore.hh"
+
+#define EXTENT_INDEX_PUT 1
+#define EXTENT_INDEX_REMOVE 2
+
+using namespace std;
+
+/**
+ * Key of a block or a delta block in the ExtentBlockStore
+ */
+
+struct ExtentKey {
+    uint64_t segmentId;
+    uint32_t blockId;
+    uint32_t deltaId;
+
+    bool operator==(const ExtentKey& other) const {
+        return segmentId == other.segmentId && blockId == other.blockId
+                && deltaId == other.deltaId;
+    }
+};
+
+struct ExtentKeyHash {
+    size_t operator()(const ExtentKey& key) const {
+        return hash<uint64_t>()(key.segmentId * 31 + key.blockId)
+                ^ hash<uint32_t>()(key.deltaId);
+    }
+};
+
+/**
+ * A range of a block stored contiguously in an extent file
+ */
+
+struct ExtentPiece {
+    uint32_t logicalOffset; // offset in the block
+    uint32_t length;
+    uint32_t extentId;
+    uint64_t extentOffset; // offset in the extent file
+};
+
+/**
+ * Record appended to the index log, one per allocated piece or removal
+ */
+
+struct ExtentIndexRecord {
+    uint32_t op;
+    uint32_t blockId;
+    uint64_t segmentId;
+    uint32_t deltaId;
+    uint32_t logicalOffset;
+    uint32_t length;
+    uint32_t extentId;
+    uint64_t extentOffset;
+};
+
+/**
+ * BlockStore appending blocks and delta blocks to large preallocated extent
+ * files (extent.<id> in the block folder)
+ *
+ * Space is handed out from the tail of one active extent, so the first
+ * write of every block and delta is sequential on disk. Overwrites land in
+ * place, unless the block is pinned while it is sent from the extents: then
+ * the range goes to new pieces at the tail, and the replaced pieces are kept
+ * until the last unpin. Each allocation is logged to an append-only index
+ * (extent.index), where a piece replaces the range of earlier ones, which
+ * is replayed and rewritten compactly on start up. Removed pieces are
+ * punched out of their extent, and an extent whose pieces are all removed
+ * is handed out again. Holes of an extent with live pieces are not reused
+ * and are counted as used. Every extent file stays open for the lifetime of
+ * the store.
+ */
+
+class ExtentBlockStore: public BlockStore {
+public:
+
+    /**
+     * Constructor, loads the index and opens the extents
+     * @param blockFolder Location where extents are stored
+     */
+
+    ExtentBlockStore(string blockFolder);
+
+    /**
+     * Destructor, closes the extents and the index
+     */
+
+    ~ExtentBlockStore();
+
+    void create(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            uint32_t length);
+    void prepareRead(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch);
+    bool pinRanges(uint64_t segmentId, uint32_t blockId,
+            const vector<offset_length_t>& ranges, vector<IoRequest>& batch);
+    void unpin(uint64_t segmentId, uint32_t blockId);
+    void prepareWrite(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch);
+    void reserve(uint64_t segmentId, uint32_t blockId, uint64_t offset,
+            uint32_t length);
+    void remove(uint64_t segmentId, uint32_t blockId, uint32_t deltaId);
+    void prepareSync(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            vector<IoRequest>& batch);
+    void close(uint64_t segmentId, uint32_t blockId, uint32_t deltaId);
+
+    /**
+     * Sum the space not available to new blocks: the whole of every extent
+     * holding a live piece, and the used part of the active extent
+     * @return Bytes occupied by blocks
+     */
+
+    uint64_t getUsage();
+
+private:
+
+    /**
+     * Resolve a range of a block to requests on extent files, allocating
+     * the parts which are not stored yet if allocate is set (lock held by
+     * the caller)
+     * @param key Block key
+     * @param buf Buffer of the range, the requests point into it
+     * @param offset Offset in the block
+     * @param length Length of the range
+     * @param allocate Whether to allocate missing parts
+     * @return Read requests covering the block range in order, empty if a
+     * part is missing and allocate is not set
+     */
+
+    vector<IoRequest> mapRange(const ExtentKey& key, char* buf,
+            uint64_t offset, uint32_t length, bool allocate);
+
+    /**
+     * Append a piece for a range of a block at the tail of the active
+     * extent and log it (lock held by the caller)
+     * @param key Block key
+     * @param logicalOffset Offset in the block
+     * @param length Length of the range
+     */
+
+    void allocate(const ExtentKey& key, uint32_t logicalOffset,
+            uint32_t length);
+
+    /**
+     * Add a piece to the in-memory index, merging it with the last piece
+     * of the block if both are contiguous (lock held by the caller)
+     * @param key Block key
+     * @param piece Piece to add
+     */
+
+    void addPiece(const ExtentKey& key, const ExtentPiece& piece);
+
+    /**
+     * Cut a range of a block out of its pieces, splitting the pieces
+     * crossing the range boundaries
+     * @param pieceList Pieces of the block, sorted by offset
+     * @param offset Offset of the range in the block
+     * @param end End of the range in the block
+     * @param carved Vector to append the parts cut out to
+     */
+
+    void carveRange(vector<ExtentPiece>& pieceList, uint64_t offset,
+            uint64_t end, vector<ExtentPiece>& carved);
+
+    /**
+     * Drop every piece of a block, punch them out of their extents and log
+     * the removal (lock held by the caller)
+     * @param key Block key
+     */
+
+    void dropPieces(const ExtentKey& key);
+
+    /**
+     * Punch a piece which is no longer referenced out of its extent and
+     * free the extent if it becomes empty (lock held by the caller)
+     * @param piece Piece to release
+     */
+
+    void releasePiece(const ExtentPiece& piece);
+
+    /**
+     * Seal the active extent and start appending to a free or new one
+     * (lock held by the caller)
+     */
+
+    void switchActiveExtent();
+
+    /**
+     * After the index is loaded, continue appending at the free tail of a
+     * partly used extent rather than leaving it unused
+     */
+
+    void resumeActiveExtent();
+
+    /**
+     * Open an extent file, creating and preallocating it if needed
+     * @param extentId Extent ID
+     * @return File descriptor
+     */
+
+    int openExtent(uint32_t extentId);
+
+    /**
+     * Append a record to the index log (lock held by the caller)
+     * @param op EXTENT_INDEX_PUT or EXTENT_INDEX_REMOVE
+     * @param key Block key
+     * @param piece Piece allocated, ignored for EXTENT_INDEX_REMOVE
+     */
+
+    void logRecord(uint32_t op, const ExtentKey& key, const ExtentPiece& piece);
+
+    /**
+     * Rebuild the index from the index log, then rewrite the log with only
+     * the live pieces
+     */
+
+    void loadIndex();
+
+    string _blockFolder;
+    string _indexPath;
+    int _indexFd;
+
+    unordered_map<ExtentKey, vector<ExtentPiece>, ExtentKeyHash> _index;
+    unordered_map<ExtentKey, uint32_t, ExtentKeyHash> _pinCount;
+    // pieces replaced or removed while pinned, released on the last unpin
+    unordered_map<ExtentKey, vector<ExtentPiece>, ExtentKeyHash> _retiredPieces;
+    vector<int> _extentFd;
+    vector<uint64_t> _extentLiveBytes;
+    list<uint32_t> _freeExtentList;
+    uint32_t _activeExtent;
+    uint64_t _activeTail;
+    uint64_t _liveBytes;
+    mutex _indexMutex;
+};
+
+#endif
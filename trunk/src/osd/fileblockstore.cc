@@ -0,0 +1,244 @@
+/*
+ * fileblockstore.cc
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+#include "fileblockstore.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+
+FileBlockStore::FileBlockStore(string blockFolder) {
+    _openedFile = new FileLruCache<string, FILE*>(MAX_OPEN_FILES);
+
+    // append a '/' if not present
+    if (blockFolder[blockFolder.length() - 1] != '/') {
+        blockFolder.append("/");
+    }
+    _blockFolder = blockFolder;
+}
+
+FileBlockStore::~FileBlockStore() {
+    delete _openedFile;
+}
+
+void FileBlockStore::create(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, uint32_t length) {
+    createFile(generatePath(segmentId, blockId, deltaId));
+}
+
+void FileBlockStore::prepareRead(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+        vector<IoRequest>& batch) {
+
+    const string filepath = generatePath(segmentId, blockId, deltaId);
+
+    debug("Read File :%s\n", filepath.c_str());
+
+    FILE* file = openFile(filepath);
+
+    if (file == NULL) { // cannot open file
+        debug("%s\n", "Cannot read");
+        perror("open");
+        exit(-1);
+    }
+
+    batch.push_back(makeRequest(file, IO_READ, buf, offset, length));
+}
+
+bool FileBlockStore::pinRanges(uint64_t segmentId, uint32_t blockId,
+        const vector<offset_length_t>& ranges, vector<IoRequest>& batch) {
+    return false;
+}
+
+void FileBlockStore::unpin(uint64_t segmentId, uint32_t blockId) {
+}
+
+void FileBlockStore::prepareWrite(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, char* buf, uint64_t offset, uint32_t length,
+        vector<IoRequest>& batch) {
+
+    const string filepath = generatePath(segmentId, blockId, deltaId);
+
+    FILE* file = openFile(filepath);
+
+    if (file == NULL) { // cannot open file
+        debug("%s\n", "Cannot write");
+        perror("open");
+        exit(-1);
+    }
+
+    batch.push_back(makeRequest(file, IO_WRITE, buf, offset, length));
+}
+
+void FileBlockStore::reserve(uint64_t segmentId, uint32_t blockId,
+        uint64_t offset, uint32_t length) {
+
+    const string filepath = generatePath(segmentId, blockId,
+            BLOCK_STORE_NO_DELTA);
+
+    FILE* file = openFile(filepath);
+
+    if (file == NULL || posix_fallocate(fileno(file), offset, length) != 0) {
+        debug_error("Failed to reserve space: %s\n", filepath.c_str());
+        exit(-1);
+    }
+}
+
+void FileBlockStore::remove(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId) {
+    const string filepath = generatePath(segmentId, blockId, deltaId);
+    tryCloseFile(filepath);
+    ::remove(filepath.c_str());
+}
+
+void FileBlockStore::prepareSync(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId, vector<IoRequest>& batch) {
+
+    // a file closed by the cache still needs its data synced
+    IoRequest request;
+    request.fd = open(generatePath(segmentId, blockId, deltaId).c_str(),
+            O_RDONLY);
+    if (request.fd < 0) { // removed by a merge
+        return;
+    }
+    request.type = IO_SYNC;
+    request.ownsFd = true;
+    request.buf = NULL;
+    request.offset = 0;
+    request.length = 0;
+    batch.push_back(request);
+}
+
+void FileBlockStore::close(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId) {
+    tryCloseFile(generatePath(segmentId, blockId, deltaId));
+}
+
+uint64_t FileBlockStore::getUsage() {
+
+    uint64_t usage = 0;
+    struct dirent* dent;
+    DIR* srcdir;
+
+    srcdir = opendir(_blockFolder.c_str());
+    if (srcdir == NULL) {
+        perror("opendir");
+        exit(-1);
+    }
+
+    while ((dent = readdir(srcdir)) != NULL) {
+        struct stat st;
+
+        if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
+            continue;
+
+        if (fstatat(dirfd(srcdir), dent->d_name, &st, 0) < 0) {
+            perror(dent->d_name);
+            continue;
+        }
+
+        usage += (uint64_t)st.st_size;
+    }
+    closedir(srcdir);
+
+    return usage;
+}
+
+IoRequest FileBlockStore::makeRequest(FILE* file, IoType type, char* buf,
+        uint64_t offset, uint32_t length) {
+
+    // the cache may close the file before the request runs
+    IoRequest request;
+    request.fd = dup(fileno(file));
+    if (request.fd < 0) {
+        perror("dup");
+        exit(-1);
+    }
+    request.type = type;
+    request.ownsFd = true;
+    request.buf = buf;
+    request.offset = offset;
+    request.length = length;
+    return request;
+}
+
+string FileBlockStore::generatePath(uint64_t segmentId, uint32_t blockId,
+        uint32_t deltaId) {
+
+    if (deltaId == BLOCK_STORE_NO_DELTA) {
+        return _blockFolder + to_string(segmentId) + "." + to_string(blockId);
+    }
+    return _blockFolder + to_string(segmentId) + "." + to_string(blockId) + "."
+            + to_string(deltaId);
+}
+
+/**
+ * Create and open a new file
+ */
+
+FILE* FileBlockStore::createFile(string filepath) {
+
+// open file for read/write
+// create new if not exist
+    FILE* filePtr;
+    try {
+        filePtr = _openedFile->get(filepath);
+    } catch (out_of_range& oor) { // file pointer not found in cache
+        filePtr = fopen(filepath.c_str(), "wb+");
+        debug("OPEN1: %s\n", filepath.c_str());
+
+        if (filePtr == NULL) {
+            debug("%s\n", "Unable to create file!");
+            return NULL;
+        }
+
+        // add file pointer to map
+        _openedFile->insert(filepath, filePtr);
+    }
+
+    return filePtr;
+}
+
+/**
+ * Open an existing file, return pointer directly if file is already open
+ */
+
+FILE* FileBlockStore::openFile(string filepath) {
+
+    FILE* filePtr = NULL;
+    try {
+        filePtr = _openedFile->get(filepath);
+    } catch (out_of_range& oor) { // file pointer not found in cache
+        filePtr = fopen(filepath.c_str(), "rb+");
+        debug("OPEN2: %s\n", filepath.c_str());
+
+        if (filePtr == NULL) {
+            debug("Unable to open file at %s\n", filepath.c_str());
+            perror("fopen()");
+            return NULL;
+        }
+
+        // add file pointer to map
+        _openedFile->insert(filepath, filePtr);
+    }
+
+    return filePtr;
+}
+
+void FileBlockStore::tryCloseFile(string filepath) {
+    FILE* filePtr = NULL;
+    try {
+        filePtr = _openedFile->get(filepath);
+        fclose(filePtr);
+        debug("CLOSE1: %s\n", filepath.c_str());
+        _openedFile->remove(filepath);
+    } catch (out_of_range& oor) { // file pointer not found in cache
+        return;
+    }
+}
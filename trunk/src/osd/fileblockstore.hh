@@ -0,0 +1,115 @@
+#ifndef __FILEBLOCKSTORE_HH__
+#define __FILEBLOCKSTORE_HH__
+
+#include <string>
+#include <stdint.h>
+#include <stdio.h>
+#include "blockstore.hh"
+#include "filelrucache.hh"
+
+using namespace std;
+
+/**
+ * BlockStore keeping each block and each delta block in a file of its own
+ * (<segmentId>.<blockId>[.<deltaId>] in the block folder)
+ *
+ * Blocks are overwritten in place, so ranges are never pinned and blocks
+ * are always sent from memory.
+ */
+
+class FileBlockStore: public BlockStore {
+public:
+
+    /**
+     * Constructor
+     * @param blockFolder Location where blocks are stored
+     */
+
+    FileBlockStore(string blockFolder);
+
+    /**
+     * Destructor, closes the opened files
+     */
+
+    ~FileBlockStore();
+
+    void create(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            uint32_t length);
+    void prepareRead(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch);
+    bool pinRanges(uint64_t segmentId, uint32_t blockId,
+            const vector<offset_length_t>& ranges, vector<IoRequest>& batch);
+    void unpin(uint64_t segmentId, uint32_t blockId);
+    void prepareWrite(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            char* buf, uint64_t offset, uint32_t length,
+            vector<IoRequest>& batch);
+    void reserve(uint64_t segmentId, uint32_t blockId, uint64_t offset,
+            uint32_t length);
+    void remove(uint64_t segmentId, uint32_t blockId, uint32_t deltaId);
+    void prepareSync(uint64_t segmentId, uint32_t blockId, uint32_t deltaId,
+            vector<IoRequest>& batch);
+    void close(uint64_t segmentId, uint32_t blockId, uint32_t deltaId);
+
+    /**
+     * Sum the size of every file in the block folder
+     * @return Bytes occupied by blocks
+     */
+
+    uint64_t getUsage();
+
+private:
+
+    /**
+     * Return the file path of a block or a delta block
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param deltaId Delta ID, BLOCK_STORE_NO_DELTA for the block itself
+     * @return filepath of the block in the filesystem
+     */
+
+    string generatePath(uint64_t segmentId, uint32_t blockId,
+            uint32_t deltaId);
+
+    /**
+     * Build a request on a private descriptor of an opened file
+     * @param file Opened file
+     * @param type IO_READ or IO_WRITE
+     * @param buf Pointer to the buffer
+     * @param offset Offset in the file
+     * @param length Length of the request
+     * @return Request owning its descriptor
+     */
+
+    IoRequest makeRequest(FILE* file, IoType type, char* buf,
+            uint64_t offset, uint32_t length);
+
+    /**
+     * Create a file on disk and open it
+     * @param filepath Path of the file on storage
+     * @return Pointer to the opened file
+     */
+
+    FILE* createFile(string filepath);
+
+    /**
+     * Retrieve the opened file pointer if file is already open
+     * Open the file on disk if file is not already open
+     * @param filepath Path to the file on disk
+     * @return Pointer to the opened file
+     */
+
+    FILE* openFile(string filepath);
+
+    /**
+     * Try to close the file before remove
+     * @param filepath Path to the file on disk
+     */
+
+    void tryCloseFile(string filepath);
+
+    FileLruCache<string, FILE*>* _openedFile;
+    string _blockFolder;
+};
+
+#endif
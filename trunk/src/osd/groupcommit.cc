@@ -0,0 +1,114 @@
+/*
+ * groupcommit.cc
+ */
+
+#include <iostream>
+#include <chrono>
+#include "groupcommit.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+#include "../common/executor.hh"
+
+GroupCommit::GroupCommit(IoEngine* ioEngine) :
+        _ioEngine(ioEngine) {
+    _pendingWriters = 0;
+    _openRound = 1;
+    _durableRound = 0;
+    _roundCount = 0;
+    _writerCount = 0;
+    _syncCount = 0;
+    _isRunning = true;
+    _commitThread = thread(&GroupCommit::commitLoop, this);
+}
+
+GroupCommit::~GroupCommit() {
+    {
+        lock_guard<mutex> lk(_commitMutex);
+        _isRunning = false;
+    }
+    _pendingCond.notify_all();
+    _commitThread.join();
+}
+
+void GroupCommit::commit(const vector<IoRequest>& syncList) {
+
+    if (syncList.empty()) {
+        return;
+    }
+
+    unique_lock<mutex> lk(_commitMutex);
+
+    // a file already in the round is synced once, descriptors owned by the
+    // request are closed instead
+    for (const IoRequest& request : syncList) {
+        bool isDuplicate = false;
+        if (!request.ownsFd) {
+            for (const IoRequest& pending : _pendingList) {
+                if (!pending.ownsFd && pending.fd == request.fd) {
+                    isDuplicate = true;
+                    break;
+                }
+            }
+        }
+        if (isDuplicate) {
+            continue;
+        }
+        _pendingList.push_back(request);
+    }
+
+    const uint64_t round = _openRound;
+    _pendingWriters++;
+    if (_pendingWriters == 1 || _pendingWriters >= GROUP_COMMIT_MAX_BATCH) {
+        _pendingCond.notify_one();
+    }
+
+    Executor::BlockingScope blocking;
+    _durableCond.wait(lk, [&] {return _durableRound >= round;});
+}
+
+void GroupCommit::printStat() {
+    cout << "Group Commit: rounds = " << _roundCount << " writes = "
+            << _writerCount << " syncs = " << _syncCount << endl;
+}
+
+//
+// PRIVATE FUNCTIONS
+//
+
+void GroupCommit::commitLoop() {
+    while (true) {
+        vector<IoRequest> syncList;
+        uint64_t round;
+        {
+            unique_lock<mutex> lk(_commitMutex);
+            _pendingCond.wait(lk,
+                    [&] {return _pendingWriters > 0 || !_isRunning;});
+            if (_pendingWriters == 0) {
+                return;
+            }
+
+            // let more writers join the round
+            _pendingCond.wait_for(lk,
+                    chrono::microseconds(GROUP_COMMIT_WINDOW),
+                    [&] {return _pendingWriters >= GROUP_COMMIT_MAX_BATCH || !_isRunning;});
+
+            syncList.swap(_pendingList);
+            _writerCount += _pendingWriters;
+            _pendingWriters = 0;
+            round = _openRound++;
+        }
+
+        _ioEngine->execute(syncList);
+        _roundCount++;
+        _syncCount += syncList.size();
+
+        debug("Group commit round %" PRIu64 " synced %zu files\n", round,
+                syncList.size());
+
+        {
+            lock_guard<mutex> lk(_commitMutex);
+            _durableRound = round;
+        }
+        _durableCond.notify_all();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef __GROUPCOMMIT_HH__
+#define __GROUPCOMMIT_HH__
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "ioengine.hh"
+
+using namespace std;
+
+/**
+ * Group commit of the data syncs of block and delta writes
+ *
+ * A writer hands over the IO_SYNC requests covering its write and waits.
+ * A commit thread gathers the requests arriving within GROUP_COMMIT_WINDOW
+ * (or until GROUP_COMMIT_MAX_BATCH are waiting), syncs each file once for
+ * all of them on the IoEngine, and then releases every writer of the
+ * round. It is only used with the extent block store, where writes append
+ * to a few shared extent files and a round costs a handful of syncs however
+ * many blocks were written. Blocks of the file block store are files of
+ * their own, so a round would save no sync and only add the window.
+ * Acknowledgements sent after commit() therefore follow the sync.
+ */
+
+class GroupCommit {
+public:
+
+    /**
+     * Constructor, starts the commit thread
+     * @param ioEngine Engine running the syncs
+     */
+
+    GroupCommit(IoEngine* ioEngine);
+
+    /**
+     * Destructor, commits the waiting writers and stops the commit thread
+     */
+
+    ~GroupCommit();
+
+    /**
+     * Wait until the files of a write are synced
+     * @param syncList IO_SYNC requests covering the write
+     */
+
+    void commit(const vector<IoRequest>& syncList);
+
+    /**
+     * Print the number of rounds, writes and syncs
+     */
+
+    void printStat();
+
+private:
+    void commitLoop();
+
+    IoEngine* _ioEngine;
+
+    vector<IoRequest> _pendingList;
+    uint32_t _pendingWriters;
+    uint64_t _openRound; // round collecting the writers now
+    uint64_t _durableRound; // last round synced
+    mutex _commitMutex;
+    condition_variable _pendingCond;
+    condition_variable _durableCond;
+
+    atomic<uint64_t> _roundCount;
+    atomic<uint64_t> _writerCount;
+    atomic<uint64_t> _syncCount;
+
+    bool _isRunning;
+    thread _commitThread;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * ioengine.cc
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include "ioengine.hh"
+#include "uringioengine.hh"
+#include "../common/debug.hh"
+#include "../common/define.hh"
+#include "../common/executor.hh"
+
+IoEngine* IoEngine::createIoEngine() {
+#ifdef USE_IO_URING
+    if (UringIoEngine::isSupported()) {
+        return new UringIoEngine(IO_URING_DEPTH);
+    }
+    debug_yellow("%s\n", "io_uring not supported, use I/O threads");
+#endif
+    return new ThreadIoEngine(IO_THREADS);
+}
+
+void IoEngine::execute(const vector<IoRequest>& batch) {
+
+#ifdef NO_WRITE
+    for (const IoRequest& request : batch) {
+        if (request.ownsFd) {
+            close(request.fd);
+        }
+    }
+    return;
+#endif
+
+    mutex doneMutex;
+    condition_variable doneCond;
+    bool isDone = false;
+    int32_t result = 0;
+
+    submit(batch, [&](int32_t ret) {
+        lock_guard<mutex> lk(doneMutex);
+        result = ret;
+        isDone = true;
+        doneCond.notify_one();
+    });
+
+    {
+        Executor::BlockingScope blocking;
+        unique_lock<mutex> lk(doneMutex);
+        doneCond.wait(lk, [&] {return isDone;});
+    }
+
+    if (result < 0) {
+        debug_error("I/O failed: %s\n", strerror(-result));
+        exit(-1);
+    }
+}
+
+IoEngine::IoBatch* IoEngine::createBatch(uint32_t count,
+        function<void(int32_t)> callback) {
+    IoBatch* ioBatch = new IoBatch();
+    ioBatch->remaining = count;
+    ioBatch->result = 0;
+    ioBatch->callback = callback;
+    return ioBatch;
+}
+
+void IoEngine::completeRequest(IoBatch* ioBatch, const IoRequest& request,
+        int32_t result) {
+
+    if (request.ownsFd) {
+        close(request.fd);
+    }
+
+    // keep the first error
+    if (result < 0) {
+        int32_t expected = 0;
+        ioBatch->result.compare_exchange_strong(expected, result);
+    }
+
+    if (--ioBatch->remaining == 0) {
+        ioBatch->callback(ioBatch->result);
+        delete ioBatch;
+    }
+}
+
+int32_t IoEngine::runRequest(const IoRequest& request) {
+
+    if (request.type == IO_SYNC) {
+        return fdatasync(request.fd) == 0 ? 0 : -errno;
+    }
+
+    uint32_t done = 0;
+    while (done < request.length) {
+        ssize_t ret;
+        if (request.type == IO_WRITE) {
+            ret = pwrite(request.fd, request.buf + done, request.length - done,
+                    request.offset + done);
+        } else {
+            ret = pread(request.fd, request.buf + done, request.length - done,
+                    request.offset + done);
+        }
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            return -errno;
+        }
+        if (ret == 0) { // read beyond the end of file
+            return -EIO;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+ThreadIoEngine::ThreadIoEngine(uint32_t numThreads) {
+    _isRunning = true;
+    for (uint32_t i = 0; i < numThreads; i++) {
+        _threadList.push_back(thread(&ThreadIoEngine::threadLoop, this));
+    }
+}
+
+ThreadIoEngine::~ThreadIoEngine() {
+    {
+        lock_guard<mutex> lk(_queueMutex);
+        _isRunning = false;
+    }
+    _queueCond.notify_all();
+    for (thread& t : _threadList) {
+        t.join();
+    }
+}
+
+void ThreadIoEngine::submit(const vector<IoRequest>& batch,
+        function<void(int32_t)> callback) {
+
+    if (batch.empty()) {
+        callback(0);
+        return;
+    }
+
+    IoBatch* ioBatch = createBatch(batch.size(), callback);
+    {
+        lock_guard<mutex> lk(_queueMutex);
+        for (const IoRequest& request : batch) {
+            _requestQueue.push_back(make_pair(request, ioBatch));
+        }
+    }
+    _queueCond.notify_all();
+}
+
+void ThreadIoEngine::threadLoop() {
+    while (true) {
+        pair<IoRequest, IoBatch*> entry;
+        {
+            unique_lock<mutex> lk(_queueMutex);
+            _queueCond.wait(lk,
+                    [&] {return !_requestQueue.empty() || !_isRunning;});
+            if (_requestQueue.empty()) {
+                return;
+            }
+            entry = _requestQueue.front();
+            _requestQueue.pop_front();
+        }
+        completeRequest(entry.second, entry.first, runRequest(entry.first));
+    }
+}
@@ -0,0 +1,157 @@
+#ifndef __IOENGINE_HH__
+#define __IOENGINE_HH__
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+enum IoType {
+    IO_READ, IO_WRITE, IO_SYNC
+};
+
+/**
+ * A positioned read or write on an open file, or a data sync of the file
+ */
+
+struct IoRequest {
+    int fd;
+    IoType type;
+    bool ownsFd; // close fd once the request completes
+    char* buf;
+    uint64_t offset;
+    uint32_t length;
+};
+
+/**
+ * Engine running the disk I/O of the StorageModule
+ *
+ * A batch of requests is submitted at once and completes through a single
+ * callback, so a worker thread can keep several requests queued on the
+ * disk instead of one blocking pread / pwrite at a time.
+ */
+
+class IoEngine {
+public:
+
+    virtual ~IoEngine() {
+    }
+
+    /**
+     * Create the engine for this host: io_uring if USE_IO_URING is defined
+     * and the kernel supports it, a thread pool otherwise
+     * @return New engine
+     */
+
+    static IoEngine* createIoEngine();
+
+    /**
+     * Queue a batch of requests
+     * @param batch Requests, the buffers must stay valid until the callback
+     * @param callback Called once every request completed, with 0 or the
+     * first -errno. It runs on an I/O thread and must not block.
+     */
+
+    virtual void submit(const vector<IoRequest>& batch,
+            function<void(int32_t)> callback) = 0;
+
+    /**
+     * Submit a batch and wait for it, exit on failure
+     * @param batch Requests
+     */
+
+    void execute(const vector<IoRequest>& batch);
+
+    /**
+     * Get the name of the engine for logging
+     * @return Name of the engine
+     */
+
+    virtual const char* getName() = 0;
+
+protected:
+
+    /**
+     * Completion state of a submitted batch
+     */
+
+    struct IoBatch {
+        atomic<uint32_t> remaining;
+        atomic<int32_t> result;
+        function<void(int32_t)> callback;
+    };
+
+    /**
+     * Create the completion state of a batch
+     * @param count Number of requests in the batch
+     * @param callback Callback of the batch
+     * @return Completion state, freed by the last completeRequest
+     */
+
+    static IoBatch* createBatch(uint32_t count,
+            function<void(int32_t)> callback);
+
+    /**
+     * Account for a finished request, run the callback after the last one
+     * @param ioBatch Batch of the request
+     * @param request Finished request
+     * @param result 0 or -errno
+     */
+
+    static void completeRequest(IoBatch* ioBatch, const IoRequest& request,
+            int32_t result);
+
+    /**
+     * Run a request with pread / pwrite / fdatasync until done
+     * @param request Request to run
+     * @return 0 or -errno
+     */
+
+    static int32_t runRequest(const IoRequest& request);
+};
+
+/**
+ * IoEngine running requests on a pool of threads with pread / pwrite, for
+ * kernels without io_uring
+ */
+
+class ThreadIoEngine: public IoEngine {
+public:
+
+    /**
+     * Constructor
+     * @param numThreads Number of I/O threads, the disk queue depth
+     */
+
+    ThreadIoEngine(uint32_t numThreads);
+
+    /**
+     * Destructor, stops the threads after the queued requests
+     */
+
+    ~ThreadIoEngine();
+
+    void submit(const vector<IoRequest>& batch,
+            function<void(int32_t)> callback);
+
+    const char* getName() {
+        return "THREAD";
+    }
+
+private:
+    void threadLoop();
+
+    deque<pair<IoRequest, IoBatch*> > _requestQueue;
+    vector<thread> _threadList;
+    mutex _queueMutex;
+    condition_variable _queueCond;
+    bool _isRunning;
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include "../common/define.hh"
 #include "../common/metadata.hh"
 #include "../common/convertor.hh"
+#include "../common/memorypool.hh"
 #include "../config/config.hh"
 #include "../protocol/status/osdstartupmsg.hh"
 #include "../protocol/status/osdshutdownmsg.hh"
@@ -23,15 +24,15 @@
 
 // for random srand() time() rand() getloadavg()
 #include <stdlib.h>
+#include <unistd.h>
 #include <time.h>
 #include <string.h>
 #include <sys/statvfs.h>
 
 mutex latencyMutex;
 
-#include "../../lib/threadpool/threadpool.hpp"
-boost::threadpool::pool _blocktp;
-boost::threadpool::pool _recoverytp;
+#include <boost/bind.hpp>
+#include "../common/executor.hh"
 
 // Global Variables
 extern ConfigLayer* configLayer;
@@ -50,10 +51,6 @@ Osd::Osd(uint32_t selfId) {
 
     srand(time(NULL)); //random test
 
-    uint32_t _numThreads = configLayer->getConfigInt("ThreadPool>NumThreads");
-    _blocktp.size_controller().resize(_numThreads);
-    _recoverytp.size_controller().resize(RECOVERY_THREADS);
-
     _reportCacheInterval = configLayer->getConfigLong(
             "Storage>ReportCacheInterval");
 
@@ -68,6 +65,11 @@ Osd::Osd(uint32_t selfId) {
     _updateId = 0;
     _recoverytpId = 0;
 
+    _segmentInfoCache = new LruCache<uint64_t, SegmentTransferOsdInfo>(
+            SEGMENT_INFO_CACHE_SIZE);
+    _hasOnlineOsdMap = false;
+    _decodedSegmentCache = new DecodedSegmentCache(SEGMENT_CACHE_SIZE);
+
     _latencyList.reserve(1000000);
 }
 
@@ -75,6 +77,8 @@ Osd::~Osd() {
     //delete _blockLocationCache;
     delete _storageModule;
     delete _osdCommunicator;
+    delete _segmentInfoCache;
+    delete _decodedSegmentCache;
 }
 
 void Osd::freeSegment(uint64_t segmentId, SegmentData segmentData) {
@@ -96,9 +100,21 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
                 segmentId);
     }
 
+    // serve a decoded segment from memory
+    DecodedSegmentEntry* cacheEntry = _decodedSegmentCache->acquire(segmentId);
+    if (cacheEntry != NULL) {
+        if (!localRetrieve) {
+            _osdCommunicator->sendSegment(_osdId, sockfd,
+                    cacheEntry->segmentData);
+        }
+        _decodedSegmentCache->release(cacheEntry);
+        return;
+    }
+
     segmentRequestCountMutex.lock();
     if (!_segmentRequestCount.count(segmentId)) {
         _segmentRequestCount.set(segmentId, 1);
+        _segmentCacheEpoch.set(segmentId, _decodedSegmentCache->getEpoch());
         mutex* tempMutex = new mutex();
         _segmentDownloadMutex.set(segmentId, tempMutex);
         _segmentDataMap.set(segmentId, { });
@@ -106,33 +122,32 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
     } else {
         _segmentRequestCount.increment(segmentId);
     }
-    struct SegmentData& segmentData = _segmentDataMap.get(segmentId);
     segmentRequestCountMutex.unlock();
 
     {
-        lock_guard<mutex> lk(*(_segmentDownloadMutex.get(segmentId)));
+        // waiting for another download must not hold a FOREGROUND slot,
+        // the download needs those slots for its block transfers
+        unique_lock<mutex> lk(*(_segmentDownloadMutex.get(segmentId)),
+                defer_lock);
+        {
+            Executor::BlockingScope blocking;
+            lk.lock();
+        }
 
         if (!_isSegmentDownloaded.get(segmentId)) {
 
-            // TODO: check if osd list exists in cache
+            // 1. get segment information from cache or MDS
 
-            // 1. ask MDS to get segment information
-
-            SegmentTransferOsdInfo segmentInfo =
-                    _osdCommunicator->getSegmentInfoRequest(segmentId,
-                            _osdId);
+            SegmentTransferOsdInfo segmentInfo = getSegmentInfo(segmentId);
 
             const CodingScheme codingScheme = segmentInfo._codingScheme;
             const string codingSetting = segmentInfo._codingSetting;
             const uint32_t segmentSize = segmentInfo._size;
 
             // bool array to store osdStatus
-            vector<bool> blockStatus =
-                    _osdCommunicator->getOsdStatusRequest(
-                            segmentInfo._osdList);
+            vector<bool> blockStatus = getOsdStatus(segmentInfo._osdList);
 
             // check which blocks are needed to request
-            uint32_t totalNumOfBlocks = segmentInfo._osdList.size();
             block_list_t requiredBlockSymbols =
                     _codingModule->getRequiredBlockSymbols(codingScheme,
                             blockStatus, segmentSize, codingSetting);
@@ -145,88 +160,38 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
                 exit(-1);
             }
 
-            // 2. initialize list and count
-
-            const uint32_t blockCount = requiredBlockSymbols.size();
-
-            _downloadBlockRemaining.set(segmentId, blockCount);
-            _downloadBlockData.set(segmentId,
-                    vector<struct BlockData>(totalNumOfBlocks));
-            vector<struct BlockData>& blockDataList =
-                    _downloadBlockData.get(segmentId);
-
-            debug("PendingBlockCount = %" PRIu32 "\n", blockCount);
-
-            // 3. request blocks
-            // case 1: load from disk
-            // case 2: request from OSD
-            // case 3: already requested
-
-            for (auto blockSymbols : requiredBlockSymbols) {
-
-                const uint32_t blockId = blockSymbols.first;
-                const uint32_t osdId = segmentInfo._osdList[blockId];
-                const uint32_t parityCount = _codingModule->getParityNumber(codingScheme, codingSetting);
-                bool isParity = (blockId >= totalNumOfBlocks - parityCount);
-
-                if (osdId == _osdId) {
-
-                    // read block from disk
+            // 2. fetch blocks
 
-                    BlockData blockData = _storageModule->getBlock (segmentId, blockId, isParity, blockSymbols.second, true);
-
-                    // blockDataList reserved space for "all blocks"
-                    // only fill in data for "required blocks"
-                    blockDataList[blockId] = blockData;
-
-                    _downloadBlockRemaining.decrement(segmentId);
-                    debug(
-                            "Read from local block for Segment ID = %" PRIu64 " Block ID = %" PRIu32 " blockData.info.blockID = %" PRIu32 "\n",
-                            segmentId, blockId, blockData.info.blockId);
-
-                } else {
-                    // request block from other OSD
-                    debug("sending request for block %" PRIu32 "\n", blockId);
-                    _osdCommunicator->getBlockRequest(osdId, segmentId, blockId,
-                            blockSymbols.second, DOWNLOAD, isParity);
-                }
+            vector<struct BlockData> blockDataList;
+#ifdef HEDGED_READ
+            if (_codingModule->canDecodeFromAnyBlocks(codingScheme)) {
+                blockDataList = fetchBlocksHedged(segmentId, segmentInfo,
+                        blockStatus, requiredBlockSymbols);
+            } else
+#endif
+            {
+                blockDataList = fetchBlocks(segmentId, segmentInfo,
+                        requiredBlockSymbols);
             }
 
-            // 4. wait until all blocks have arrived
-
-            while (1) {
-                if (_downloadBlockRemaining.get(segmentId) == 0) {
+            // 3. decode blocks
 
-                    // 5. decode blocks
-
-                    debug(
-                            "[DOWNLOAD] Start Decoding with %d scheme and settings = %s\n",
-                            (int )codingScheme, codingSetting.c_str());
-                    segmentData = _codingModule->decodeBlockToSegment(
-                            codingScheme, blockDataList,
-                            requiredBlockSymbols, segmentSize,
-                            codingSetting);
-
-                    // clean up block data
-                    _downloadBlockRemaining.erase(segmentId);
-
-                    for (auto blockSymbols : requiredBlockSymbols) {
-                        uint32_t i = blockSymbols.first;
-                        debug(
-                                "%" PRIu32 " free block %" PRIu32 " addr = %p\n",
-                                i, blockDataList[i].info.blockId,
-                                blockDataList[i].buf);
-                        MemoryPool::getInstance().poolFree(
-                                blockDataList[i].buf);
-                        debug("%" PRIu32 " block %" PRIu32 " free-d\n", i,
-                                blockDataList[i].info.blockId);
-                    }
-                    _downloadBlockData.erase(segmentId);
+            debug(
+                    "[DOWNLOAD] Start Decoding with %d scheme and settings = %s\n",
+                    (int )codingScheme, codingSetting.c_str());
+            _segmentDataMap.set(segmentId,
+                    _codingModule->decodeBlockToSegment(codingScheme,
+                            blockDataList, requiredBlockSymbols, segmentSize,
+                            codingSetting));
 
-                    break;
-                } else {
-                    usleep(USLEEP_DURATION); // 0.01s
-                }
+            // clean up block data
+            for (auto blockSymbols : requiredBlockSymbols) {
+                uint32_t i = blockSymbols.first;
+                debug("%" PRIu32 " free block %" PRIu32 " addr = %p\n", i,
+                        blockDataList[i].info.blockId, blockDataList[i].buf);
+                MemoryPool::getInstance().poolFree(blockDataList[i].buf);
+                debug("%" PRIu32 " block %" PRIu32 " free-d\n", i,
+                        blockDataList[i].info.blockId);
             }
 
             debug("%s\n", "[DOWNLOAD] Send Segment");
@@ -235,12 +200,15 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
         }
     }
 
-    // 5. send segment if not localRetrieve
+    // the downloader has stored the decoded segment
+    struct SegmentData segmentData = _segmentDataMap.get(segmentId);
+
+    // 4. send segment if not localRetrieve
     if (!localRetrieve) {
         _osdCommunicator->sendSegment(_osdId, sockfd, segmentData);
     }
 
-    // 6. cache and free
+    // 5. cache and free
     segmentRequestCountMutex.lock();
     bool isLocked = true;
 
@@ -250,12 +218,18 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
 
         // make a copy of segmentData and then erase
         SegmentData tempSegmentData = segmentData;
+        const uint64_t cacheEpoch = _segmentCacheEpoch.get(segmentId);
         _segmentDataMap.erase(segmentId);
+        _segmentCacheEpoch.erase(segmentId);
 
         segmentRequestCountMutex.unlock();
         isLocked = false;
 
-        freeSegment(segmentId, tempSegmentData);
+        // keep the segment unless it was updated while being fetched
+        if (!_decodedSegmentCache->insert(segmentId, tempSegmentData,
+                cacheEpoch)) {
+            freeSegment(segmentId, tempSegmentData);
+        }
 
         debug("%s\n", "[DOWNLOAD] Cleanup completed");
     }
@@ -266,10 +240,266 @@ void Osd::getSegmentRequestProcessor(uint32_t requestId, uint32_t sockfd,
 
 }
 
+vector<BlockData> Osd::fetchBlocks(uint64_t segmentId,
+        const SegmentTransferOsdInfo& segmentInfo,
+        const block_list_t& requiredBlockSymbols) {
+
+    const CodingScheme codingScheme = segmentInfo._codingScheme;
+    const string codingSetting = segmentInfo._codingSetting;
+    const uint32_t totalNumOfBlocks = segmentInfo._osdList.size();
+
+    // 1. initialize list and count
+
+    const uint32_t blockCount = requiredBlockSymbols.size();
+
+    _downloadBlockRemaining.set(segmentId, blockCount);
+    _downloadBlockData.set(segmentId,
+            vector<struct BlockData>(totalNumOfBlocks));
+
+    debug("PendingBlockCount = %" PRIu32 "\n", blockCount);
+
+    // 2. request blocks
+    // case 1: load from disk
+    // case 2: request from OSD
+    // case 3: already requested
+
+    for (auto blockSymbols : requiredBlockSymbols) {
+
+        const uint32_t blockId = blockSymbols.first;
+        const uint32_t osdId = segmentInfo._osdList[blockId];
+        const uint32_t parityCount = _codingModule->getParityNumber(codingScheme, codingSetting);
+        bool isParity = (blockId >= totalNumOfBlocks - parityCount);
+
+        if (osdId == _osdId) {
+
+            // read block from disk
+
+            BlockData blockData = _storageModule->getBlock (segmentId, blockId, isParity, blockSymbols.second, true);
+
+            // blockDataList reserved space for "all blocks"
+            // only fill in data for "required blocks"
+            _downloadBlockData.update(segmentId,
+                    [&](vector<struct BlockData>& blockDataList) {
+                        blockDataList[blockId] = blockData;
+                    });
+
+            _downloadBlockRemaining.decrement(segmentId);
+            debug(
+                    "Read from local block for Segment ID = %" PRIu64 " Block ID = %" PRIu32 " blockData.info.blockID = %" PRIu32 "\n",
+                    segmentId, blockId, blockData.info.blockId);
+
+        } else {
+            // request block from other OSD
+            debug("sending request for block %" PRIu32 "\n", blockId);
+            _osdCommunicator->getBlockRequest(osdId, segmentId, blockId,
+                    blockSymbols.second, DOWNLOAD, isParity);
+        }
+    }
+
+    // 3. wait until all blocks have arrived
+
+    _downloadBlockRemaining.waitValue(segmentId, 0);
+
+    vector<struct BlockData> blockDataList = _downloadBlockData.get(segmentId);
+    _downloadBlockRemaining.erase(segmentId);
+    _downloadBlockData.erase(segmentId);
+
+    return blockDataList;
+}
+
+vector<BlockData> Osd::fetchBlocksHedged(uint64_t segmentId,
+        const SegmentTransferOsdInfo& segmentInfo,
+        const vector<bool>& blockStatus, block_list_t& requiredBlockSymbols) {
+
+    const CodingScheme codingScheme = segmentInfo._codingScheme;
+    const string codingSetting = segmentInfo._codingSetting;
+    const uint32_t totalNumOfBlocks = segmentInfo._osdList.size();
+    const uint32_t parityCount = _codingModule->getParityNumber(codingScheme,
+            codingSetting);
+    const uint32_t blockCount = requiredBlockSymbols.size();
+    const uint32_t blockSize = requiredBlockSymbols[0].second[0].second;
+
+    // rank the healthy blocks, data blocks before parity blocks so that
+    // parity is only fetched to hedge or replace a data block, then local
+    // first and by typical latency
+    const vector<uint32_t> estimates = _osdLatencyTracker.getEstimates(
+            segmentInfo._osdList);
+    vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < totalNumOfBlocks; i++) {
+        if (blockStatus[i]) {
+            candidates.push_back(i);
+        }
+    }
+    stable_sort(candidates.begin(), candidates.end(),
+            [&](uint32_t a, uint32_t b) {
+                const bool isParityA = (a >= totalNumOfBlocks - parityCount);
+                const bool isParityB = (b >= totalNumOfBlocks - parityCount);
+                if (isParityA != isParityB) {
+                    return isParityB;
+                }
+                const uint32_t osdA = segmentInfo._osdList[a];
+                const uint32_t osdB = segmentInfo._osdList[b];
+                if ((osdA == _osdId) != (osdB == _osdId)) {
+                    return osdA == _osdId;
+                }
+                return estimates[a] < estimates[b];
+            });
+
+    shared_ptr<HedgedRead> read = make_shared<HedgedRead>();
+    read->blockDataList.resize(totalNumOfBlocks);
+    read->isArrived.assign(totalNumOfBlocks, false);
+    read->arrivedCount = 0;
+    read->failedCount = 0;
+    read->isFinished = false;
+
+    uint32_t requestCount = 0;
+    auto requestBlock = [&]() {
+        const uint32_t blockId = candidates[requestCount++];
+        const uint32_t osdId = segmentInfo._osdList[blockId];
+        const bool isParity = (blockId >= totalNumOfBlocks - parityCount);
+        Executor::getInstance().schedule(FOREGROUND_TASK, [=]() {
+            fetchHedgedBlock(read, segmentId, blockId, osdId, isParity,
+                    blockSize);
+        });
+    };
+
+    for (uint32_t i = 0; i < blockCount; i++) {
+        requestBlock();
+    }
+
+    unique_lock<mutex> lk(read->hedgedMutex);
+    while (read->arrivedCount < blockCount) {
+
+        const uint32_t pendingCount = requestCount - read->arrivedCount
+                - read->failedCount;
+
+        // replace failed requests
+        if (read->arrivedCount + pendingCount < blockCount) {
+            if (requestCount == candidates.size()) {
+                debug_error(
+                        "Not enough blocks available to rebuild Segment ID %" PRIu64 "\n",
+                        segmentId);
+                exit(-1);
+            }
+            lk.unlock();
+            requestBlock();
+            lk.lock();
+            continue;
+        }
+
+        // wait for the slowest pending OSD to reach its hedge delay
+        uint32_t hedgeDelay = 0;
+        for (uint32_t i = 0; i < requestCount; i++) {
+            if (!read->isArrived[candidates[i]]) {
+                hedgeDelay = max(hedgeDelay, _osdLatencyTracker.getHedgeDelay(
+                        segmentInfo._osdList[candidates[i]]));
+            }
+        }
+
+        const uint32_t doneCount = read->arrivedCount + read->failedCount;
+        bool isChanged;
+        {
+            Executor::BlockingScope blocking;
+            isChanged = read->changed.wait_for(lk,
+                    chrono::microseconds(hedgeDelay), [&] {
+                        return read->arrivedCount + read->failedCount
+                                != doneCount;
+                    });
+        }
+
+        if (!isChanged && requestCount < candidates.size()) {
+            debug("Hedging Segment ID = %" PRIu64 " with Block ID = %" PRIu32 "\n",
+                    segmentId, candidates[requestCount]);
+            lk.unlock();
+            requestBlock();
+            lk.lock();
+        }
+    }
+    read->isFinished = true;
+
+    // decode with the blocks that arrived first
+    requiredBlockSymbols = _codingModule->getRequiredBlockSymbols(codingScheme,
+            read->isArrived, segmentInfo._size, codingSetting);
+
+    vector<BlockData> blockDataList = read->blockDataList;
+    vector<bool> isRequired(totalNumOfBlocks, false);
+    for (auto blockSymbols : requiredBlockSymbols) {
+        isRequired[blockSymbols.first] = true;
+    }
+    for (uint32_t i = 0; i < totalNumOfBlocks; i++) {
+        if (read->isArrived[i] && !isRequired[i]) {
+            MemoryPool::getInstance().poolFree(blockDataList[i].buf);
+        }
+    }
+
+    return blockDataList;
+}
+
+void Osd::fetchHedgedBlock(shared_ptr<HedgedRead> read, uint64_t segmentId,
+        uint32_t blockId, uint32_t osdId, bool isParity, uint32_t blockSize) {
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+
+    BlockData blockData;
+    blockData.info.segmentId = segmentId;
+    blockData.info.blockId = blockId;
+    blockData.info.blockSize = blockSize;
+    blockData.info.offlenVector = { make_pair(0, blockSize) };
+    blockData.buf = MemoryPool::getInstance().poolMalloc(blockSize);
+
+    bool isServed = true;
+    if (osdId == _osdId) {
+        readBlockRange(segmentId, blockId, isParity, 0, blockSize,
+                blockData.buf);
+    } else {
+        isServed = _osdCommunicator->getSegmentRange(
+                _osdCommunicator->getSockfdFromId(osdId), segmentId, blockId,
+                0, blockSize, blockData.buf, isParity);
+    }
+
+    if (isServed) {
+        _osdLatencyTracker.record(osdId,
+                chrono::duration_cast<chrono::microseconds>(Clock::now() - t0).count());
+    }
+
+    lock_guard<mutex> lk(read->hedgedMutex);
+    if (!isServed || read->isFinished) {
+        MemoryPool::getInstance().poolFree(blockData.buf);
+        if (!isServed) {
+            read->failedCount++;
+        }
+    } else {
+        read->blockDataList[blockId] = blockData;
+        read->isArrived[blockId] = true;
+        read->arrivedCount++;
+    }
+    read->changed.notify_all();
+}
+
 void Osd::getBlockRequestProcessor(uint32_t requestId, uint32_t sockfd,
         uint64_t segmentId, uint32_t blockId, vector<offset_length_t> symbols,
         DataMsgType dataMsgType, bool isParity) {
 
+    // a block stored as is goes from its files to the socket
+    vector<BlockFileRange> fileRanges;
+    if (_storageModule->getBlockFileRanges(segmentId, blockId, isParity,
+            symbols, fileRanges)) {
+        BlockData blockData;
+        blockData.info.segmentId = segmentId;
+        blockData.info.blockId = blockId;
+        blockData.info.blockSize = StorageModule::getCombinedLength(symbols);
+        blockData.info.offlenVector = symbols;
+        blockData.buf = NULL;
+
+        _osdCommunicator->sendBlockFile(sockfd, blockData, fileRanges,
+                dataMsgType);
+        for (const BlockFileRange& fileRange : fileRanges) {
+            close(fileRange.fd);
+        }
+        return;
+    }
+
     BlockData blockData = _storageModule->getBlock (segmentId, blockId, isParity, symbols, true);
 
     _osdCommunicator->sendBlock(sockfd, blockData, dataMsgType);
@@ -277,6 +507,140 @@ void Osd::getBlockRequestProcessor(uint32_t requestId, uint32_t sockfd,
     debug("Block ID = %" PRIu32 " free-d\n", blockId);
 }
 
+void Osd::getSegmentRangeRequestProcessor(uint32_t requestId, uint32_t sockfd,
+        uint64_t segmentId, uint32_t blockId, uint64_t offset,
+        uint32_t length, bool isParity) {
+
+    // the range comes from the network, only serve it inside the block or
+    // segment
+    SegmentTransferOsdInfo segmentInfo = getSegmentInfo(segmentId);
+    uint64_t rangeLimit = segmentInfo._size;
+    if (blockId != SEGMENT_RANGE_WHOLE_SEGMENT && segmentInfo._size != 0) {
+        rangeLimit = _codingModule->getBlockSize(segmentInfo._codingScheme,
+                segmentInfo._codingSetting, segmentInfo._size);
+    }
+    if (length == 0 || offset > rangeLimit || length > rangeLimit - offset) {
+        debug_error("Range %" PRIu64 " + %" PRIu32 " of Segment ID = %" PRIu64
+                " Block ID = %" PRIu32 " is out of bound\n", offset, length,
+                segmentId, blockId);
+        _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId,
+                false, NULL, 0);
+        return;
+    }
+
+    // range of a block held by this OSD, from its file if in one piece
+    if (blockId != SEGMENT_RANGE_WHOLE_SEGMENT) {
+        vector<BlockFileRange> fileRanges;
+        if (_storageModule->getBlockFileRanges(segmentId, blockId, isParity,
+                { make_pair(offset, length) }, fileRanges)
+                && fileRanges.size() == 1) {
+            _osdCommunicator->replySegmentRangeFile(requestId, sockfd,
+                    segmentId, fileRanges[0]);
+        } else {
+            char* buf = MemoryPool::getInstance().poolMalloc(length);
+            readBlockRange(segmentId, blockId, isParity, offset, length, buf);
+            _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId,
+                    true, buf, length);
+        }
+        for (const BlockFileRange& fileRange : fileRanges) {
+            close(fileRange.fd);
+        }
+        return;
+    }
+
+    // range of a decoded segment in memory
+    DecodedSegmentEntry* cacheEntry = _decodedSegmentCache->acquire(segmentId);
+    if (cacheEntry != NULL) {
+        const SegmentData& segmentData = cacheEntry->segmentData;
+        const bool isServed = offset + length <= segmentData.info.segLength;
+        char* buf = NULL;
+        if (isServed) {
+            buf = MemoryPool::getInstance().poolMalloc(length);
+            memcpy(buf, segmentData.buf + offset, length);
+        }
+        _decodedSegmentCache->release(cacheEntry);
+        _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId,
+                isServed, buf, isServed ? length : 0);
+        return;
+    }
+
+    // range of a segment, only served if it can be copied from data blocks
+    vector<bool> blockStatus = getOsdStatus(segmentInfo._osdList);
+
+    block_list_t rangeBlockSymbols = _codingModule->getRangeBlockSymbols(
+            segmentInfo._codingScheme, offset, length, blockStatus,
+            segmentInfo._size, segmentInfo._codingSetting);
+
+    if (rangeBlockSymbols.empty()) {
+        debug("Range %" PRIu64 " + %" PRIu32 " of Segment ID = %" PRIu64 " needs decoding\n",
+                offset, length, segmentId);
+        _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId,
+                false, NULL, 0);
+        return;
+    }
+
+    uint32_t rangeLength = 0;
+    for (auto blockSymbols : rangeBlockSymbols) {
+        rangeLength += blockSymbols.second[0].second;
+    }
+    char* buf = MemoryPool::getInstance().poolMalloc(rangeLength);
+    atomic<bool> isServed(true);
+
+    // fetch the pieces of the range in parallel
+    {
+        TaskGroup rangeTasks(FOREGROUND_TASK);
+        uint32_t bufOffset = 0;
+        for (auto blockSymbols : rangeBlockSymbols) {
+            const uint32_t rangeBlockId = blockSymbols.first;
+            const offset_length_t symbol = blockSymbols.second[0];
+            const uint32_t osdId = segmentInfo._osdList[rangeBlockId];
+            char* dst = buf + bufOffset;
+            bufOffset += symbol.second;
+
+            rangeTasks.run([=, &isServed]() {
+                if (osdId == _osdId) {
+                    readBlockRange(segmentId, rangeBlockId, false,
+                            symbol.first, symbol.second, dst);
+                } else {
+                    const uint32_t dstSockfd =
+                            _osdCommunicator->getSockfdFromId(osdId);
+                    if (!_osdCommunicator->getSegmentRange(dstSockfd,
+                            segmentId, rangeBlockId, symbol.first,
+                            symbol.second, dst)) {
+                        isServed = false;
+                    }
+                }
+            });
+        }
+    }
+
+    if (!isServed) {
+        MemoryPool::getInstance().poolFree(buf);
+        _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId,
+                false, NULL, 0);
+        return;
+    }
+
+    _osdCommunicator->replySegmentRange(requestId, sockfd, segmentId, true,
+            buf, rangeLength);
+}
+
+void Osd::readBlockRange(uint64_t segmentId, uint32_t blockId, bool isParity,
+        uint32_t offset, uint32_t length, char* buf) {
+
+    BlockData blockData = _storageModule->getBlock(segmentId, blockId,
+            isParity, { make_pair(offset, length) }, true);
+
+    // a merged block is returned whole
+    const offset_length_t& returned = blockData.info.offlenVector[0];
+    if (returned.first != offset || returned.second != length) {
+        memcpy(buf, blockData.buf + offset, length);
+    } else {
+        memcpy(buf, blockData.buf, length);
+    }
+    MemoryPool::getInstance().poolFree(blockData.buf);
+}
+
 void Osd::retrieveRecoveryBlock(uint32_t recoverytpId, uint32_t osdId,
         uint64_t segmentId, uint32_t blockId,
         vector<offset_length_t> &offsetLength, BlockData &repairedBlock,
@@ -299,12 +663,7 @@ void Osd::retrieveRecoveryBlock(uint32_t recoverytpId, uint32_t osdId,
         const string blockKey = to_string(segmentId) + "." + to_string(blockId);
 
         // wait for recovery of the same block to complete
-        while (_isPendingRecovery.count(blockKey)) {
-            debug("NEED TO WAIT for %s\n", blockKey.c_str());
-            usleep(USLEEP_DURATION);
-        }
-
-        _isPendingRecovery.set(blockKey, true);
+        _isPendingRecovery.waitInit(blockKey, true);
 
         _osdCommunicator->getBlockRequest(osdId, segmentId, blockId,
                 offsetLength, RECOVERY, isParity);
@@ -318,7 +677,7 @@ void Osd::retrieveRecoveryBlock(uint32_t recoverytpId, uint32_t osdId,
                         segmentId, blockId);
                 break;
             } else {
-                usleep(USLEEP_DURATION); // sleep 0.01s
+                _isPendingRecovery.waitValue(blockKey, false);
             }
         }
 
@@ -345,8 +704,7 @@ DataMsgType Osd::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
     _codingSettingMap.set(segmentId, codingSetting);
 
     // determine dataMsgType
-    SegmentTransferOsdInfo segmentInfo =
-            _osdCommunicator->getSegmentInfoRequest(segmentId, _osdId);
+    SegmentTransferOsdInfo segmentInfo = getSegmentInfo(segmentId);
 
     debug("SegmentInfo id = %" PRIu64 " size = %" PRIu32 "\n", segmentInfo._id,
             segmentInfo._size);
@@ -359,10 +717,8 @@ DataMsgType Osd::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
     }
 
     if (dataMsgType == UPLOAD) {
-        // reduce memory consumption by limiting the number processing segments
-        while (_pendingSegmentChunk.size() > MAX_NUM_PROCESSING_SEGMENT) {
-            usleep(USLEEP_DURATION);
-        }
+        // the transfer window bounds a single connection only
+        admitSegmentUpload(sockfd, segmentId);
         _pendingSegmentChunk.set(segmentId, chunkCount);
     } else if (dataMsgType == UPDATE) {
         _pendingUpdateSegmentChunk.set(updateKey, chunkCount);
@@ -371,10 +727,40 @@ DataMsgType Osd::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
         exit(-1);
     }
 
-    // create segment and cache
-    _storageModule->createSegmentTransferCache(segmentId, segLength, bufLength,
-            dataMsgType, updateKey);
+    bool isStreamed = false;
+#ifdef STREAM_ENCODE
+    isStreamed = (dataMsgType == UPLOAD && !isSmallSegment && segLength > 0
+            && SegmentEncoder::isSupported(codingScheme));
+#endif
+
+    if (isStreamed) {
+        // encode and send the blocks while the chunks arrive
+        startSegmentStream(segmentId, segLength, codingSetting);
+    } else {
+        // create segment and cache
+        _storageModule->createSegmentTransferCache(segmentId, segLength,
+                bufLength, dataMsgType, updateKey);
+    }
     if (!isSmallSegment) {
+        vector<EarlyChunk> earlyChunks;
+        {
+            lock_guard<mutex> lk(_segmentTransferMutex);
+            _segmentTransferType[updateKey] = dataMsgType;
+            auto it = _earlyChunks.find(updateKey);
+            if (it != _earlyChunks.end()) {
+                earlyChunks.swap(it->second);
+                _earlyChunks.erase(it);
+            }
+        }
+
+        // replay the chunks that arrived before the transfer was set up
+        for (const EarlyChunk& chunk : earlyChunks) {
+            writeSegmentChunk(chunk.segmentId, chunk.offset, chunk.length,
+                    dataMsgType, updateKey, chunk.buf);
+            MemoryPool::getInstance().poolFree(chunk.recvBuf);
+            _osdCommunicator->returnCredit(chunk.sockfd, chunk.length);
+        }
+
         _osdCommunicator->replyPutSegmentInit(requestId, sockfd, segmentId,
                 dataMsgType);
     }
@@ -382,6 +768,189 @@ DataMsgType Osd::putSegmentInitProcessor(uint32_t requestId, uint32_t sockfd,
 	return dataMsgType;
 }
 
+void Osd::admitSegmentUpload(uint32_t sockfd, uint64_t segmentId) {
+    unique_lock<mutex> lk(_uploadAdmissionMutex);
+
+    // chunks of this segment stay parked in the window of the connection
+    // while it waits, so only a connection without uploads in progress waits
+    if (_admittedUploadCount[sockfd] == 0) {
+        Executor::BlockingScope blocking;
+        _uploadAdmissionCond.wait(lk,
+                [&] {return _admittedUploads.size() < MAX_NUM_PROCESSING_SEGMENT;});
+    }
+
+    _admittedUploads[segmentId] = sockfd;
+    _admittedUploadCount[sockfd]++;
+}
+
+void Osd::releaseSegmentUpload(uint64_t segmentId) {
+    {
+        lock_guard<mutex> lk(_uploadAdmissionMutex);
+        auto it = _admittedUploads.find(segmentId);
+        if (it == _admittedUploads.end()) {
+            return;
+        }
+        if (--_admittedUploadCount[it->second] == 0) {
+            _admittedUploadCount.erase(it->second);
+        }
+        _admittedUploads.erase(it);
+    }
+    _uploadAdmissionCond.notify_all();
+}
+
+void Osd::startSegmentStream(uint64_t segmentId, uint32_t segLength,
+        CodingSetting codingSetting) {
+
+    SegmentStream* stream = new SegmentStream();
+    stream->codingSetting = codingSetting;
+    stream->segLength = segLength;
+    stream->encoder = new SegmentEncoder(codingSetting.codingScheme,
+            codingSetting.setting, segLength);
+    SegmentEncoder* encoder = stream->encoder;
+    const uint32_t blockCount = encoder->getBlockCount();
+    const uint32_t blockSize = encoder->getBlockSize();
+
+    // the block size is known before any data arrives
+    stream->blockLocationList = _osdCommunicator->getOsdListRequest(segmentId,
+            MONITOR, blockCount, _osdId, blockSize);
+    vector<atomic<uint32_t>> sentPieceCount(blockCount);
+    stream->sentPieceCount.swap(sentPieceCount);
+    for (uint32_t i = blockCount - encoder->getParityCount(); i < blockCount;
+            i++) {
+        stream->parityList.push_back(stream->blockLocationList[i]);
+    }
+
+    // open the block transfers together, pieces are sent as they complete
+    {
+        TaskGroup initTasks(FOREGROUND_TASK);
+        for (uint32_t i = 0; i < blockCount; i++) {
+            const uint32_t osdId = stream->blockLocationList[i].osdId;
+            if (osdId == _osdId) {
+                continue;
+            }
+            const uint32_t dstSockfd = _osdCommunicator->getSockfdFromId(osdId);
+            const uint32_t pieceCount = encoder->getPieceCount(i);
+            initTasks.run([=]() {
+                _osdCommunicator->putBlockInit(dstSockfd, segmentId, i,
+                        blockSize, pieceCount, UPLOAD, "");
+            });
+        }
+    }
+
+    debug("Streaming Segment %" PRIu64 " in %" PRIu32 " blocks of %" PRIu32 "\n",
+            segmentId, blockCount, blockSize);
+
+    _segmentStreams.set(segmentId, stream);
+    sendBlockPieces(segmentId, stream, encoder->getPaddingPieces());
+}
+
+void Osd::sendBlockPieces(uint64_t segmentId, SegmentStream* stream,
+        const vector<BlockPiece>& pieces) {
+    for (const BlockPiece& piece : pieces) {
+        const uint32_t osdId = stream->blockLocationList[piece.blockId].osdId;
+        if (osdId == _osdId) {
+            continue;
+        }
+        _osdCommunicator->putBlockData(
+                _osdCommunicator->getSockfdFromId(osdId), segmentId,
+                piece.blockId, stream->encoder->getBlock(piece.blockId),
+                piece.offset, piece.length, UPLOAD, "");
+        stream->sentPieceCount[piece.blockId]++;
+    }
+}
+
+void Osd::finishSegmentStream(uint32_t requestId, uint32_t sockfd,
+        uint64_t segmentId) {
+
+    SegmentStream* stream = _segmentStreams.get(segmentId);
+    SegmentEncoder* encoder = stream->encoder;
+    const CodingSetting& codingSetting = stream->codingSetting;
+    _codingSettingMap.erase(segmentId);
+
+    if (!encoder->isComplete()) {
+        debug_error("Segment %" PRIu64 " ended before all stripes arrived\n",
+                segmentId);
+
+        // abort the block transfers, a secondary discards its block once the
+        // pieces sent have arrived, so the encoder is no longer referenced
+        {
+            TaskGroup abortTasks(FOREGROUND_TASK);
+            for (uint32_t i = 0; i < encoder->getBlockCount(); i++) {
+                const uint32_t osdId = stream->blockLocationList[i].osdId;
+                if (osdId == _osdId) {
+                    continue;
+                }
+                const uint32_t dstSockfd = _osdCommunicator->getSockfdFromId(
+                        osdId);
+                const uint32_t unsentCount = encoder->getPieceCount(i)
+                        - stream->sentPieceCount[i];
+                abortTasks.run([=]() {
+                    _osdCommunicator->putBlockEnd(dstSockfd, segmentId, i,
+                            UPLOAD, "", { }, stream->parityList,
+                            codingSetting.codingScheme, codingSetting.setting,
+                            stream->segLength, true, unsentCount);
+                });
+            }
+        }
+
+        _pendingSegmentChunk.erase(segmentId);
+        _segmentStreams.erase(segmentId);
+        releaseSegmentUpload(segmentId);
+        _osdCommunicator->replyPutSegmentEnd(requestId, sockfd, segmentId,
+                false, true);
+        delete encoder;
+        delete stream;
+        return;
+    }
+
+    // all pieces are queued, wait for the secondaries to store them
+    vector<uint32_t> nodeList;
+    {
+        TaskGroup endTasks(FOREGROUND_TASK);
+        for (uint32_t i = 0; i < encoder->getBlockCount(); i++) {
+            const uint32_t osdId = stream->blockLocationList[i].osdId;
+            nodeList.push_back(osdId);
+            if (osdId != _osdId) {
+                const uint32_t dstSockfd = _osdCommunicator->getSockfdFromId(
+                        osdId);
+                endTasks.run([=]() {
+                    _osdCommunicator->putBlockEnd(dstSockfd, segmentId, i,
+                            UPLOAD, "", { }, stream->parityList,
+                            codingSetting.codingScheme, codingSetting.setting,
+                            stream->segLength);
+                });
+                continue;
+            }
+
+            const uint32_t blockSize = encoder->getBlockSize();
+            _storageModule->createBlock(segmentId, i, blockSize);
+            if (_updateScheme == PLR
+                    && i >= encoder->getBlockCount() - encoder->getParityCount()) {
+                _storageModule->reserveBlockSpace(segmentId, i, 0, blockSize,
+                        blockSize + _reservedSpaceSize);
+            }
+            _storageModule->writeBlock(segmentId, i, encoder->getBlock(i), 0,
+                    blockSize);
+            _storageModule->flushBlock(segmentId, i);
+        }
+    }
+
+    _pendingSegmentChunk.erase(segmentId);
+    _segmentStreams.erase(segmentId);
+    releaseSegmentUpload(segmentId);
+
+    // Acknowledge MDS for Segment Upload Completed
+    _osdCommunicator->segmentUploadAck(segmentId, stream->segLength,
+            codingSetting.codingScheme, codingSetting.setting, nodeList);
+
+    cout << "Segment " << segmentId << " uploaded" << endl;
+
+    _osdCommunicator->replyPutSegmentEnd(requestId, sockfd, segmentId, false);
+
+    delete encoder;
+    delete stream;
+}
+
 void Osd::distributeBlock(uint64_t segmentId, const struct BlockData blockData,
         const struct BlockLocation& blockLocation, enum DataMsgType dataMsgType,
         uint32_t blocktpId) {
@@ -474,6 +1043,11 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
         exit(-1);
     }
 
+    if (!isSmallSegment) {
+        lock_guard<mutex> lk(_segmentTransferMutex);
+        _segmentTransferType.erase(updateKey);
+    }
+
     // TODO: check integrity of segment received
     while (1) {
 
@@ -488,6 +1062,11 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
             Clock::time_point t0 = Clock::now();
 #endif
 
+            if (dataMsgType == UPLOAD && _segmentStreams.count(segmentId)) {
+                finishSegmentStream(requestId, sockfd, segmentId);
+                break;
+            }
+
             // if all chunks have arrived
             struct SegmentData segmentCache = _storageModule->getSegmentTransferCache(
                     segmentId, dataMsgType, updateKey);
@@ -520,9 +1099,7 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
                         segmentCache.info.segLength, codingSetting.setting,
                         offsetLength);
                 // retrieve old secondary OSD list
-                SegmentTransferOsdInfo segmentInfo =
-                        _osdCommunicator->getSegmentInfoRequest(segmentId,
-                                _osdId);
+                SegmentTransferOsdInfo segmentInfo = getSegmentInfo(segmentId);
 
                 // copy to blockLocationList
                 for (uint32_t i = 0; i < segmentInfo._osdList.size(); i++) {
@@ -573,9 +1150,7 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
                             blockData.info.offlenVector);
                 }
 
-                debug("Thread Pool Status %d/%d/%d\n", (int )_blocktp.active(),
-                        (int )_blocktp.pending(), (int )_blocktp.size());
-                _blocktp.schedule(
+                Executor::getInstance().schedule(FOREGROUND_TASK,
                         boost::bind(&Osd::distributeBlock, this, segmentId,
                                 blockData,
                                 blockLocationList[blockData.info.blockId],
@@ -586,19 +1161,20 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
 
             }
             // block until all blocks retrieved
-            while (_blocktpRequestCount.get(blocktpId) > 0) {
-                usleep(USLEEP_DURATION);
-            }
+            _blocktpRequestCount.waitValue(blocktpId, 0);
             _blocktpRequestCount.erase(blocktpId);
 
             if (dataMsgType == UPLOAD) {
                 _pendingSegmentChunk.erase(segmentId);
+                releaseSegmentUpload(segmentId);
                 // Acknowledge MDS for Segment Upload Completed
                 _osdCommunicator->segmentUploadAck(segmentId,
                         segmentCache.info.segLength, codingSetting.codingScheme,
                         codingSetting.setting, nodeList);
             } else {
                 _pendingUpdateSegmentChunk.erase(updateKey);
+                invalidateSegmentInfo(segmentId);
+                _decodedSegmentCache->invalidate(segmentId);
             }
 
             cout << "Segment " << segmentId << " uploaded" << endl;
@@ -619,14 +1195,37 @@ void Osd::putSegmentEndProcessor(uint32_t requestId, uint32_t sockfd,
 
             _storageModule->closeSegmentTransferCache(segmentId, dataMsgType, updateKey);
             break;
+        } else if (dataMsgType == UPLOAD) {
+            _pendingSegmentChunk.waitValue(segmentId, 0);
         } else {
-            usleep(USLEEP_DURATION); // sleep 0.01s
+            _pendingUpdateSegmentChunk.waitValue(updateKey, 0);
         }
 
     }
 
 }
 
+void Osd::commitSegmentProcessor(uint32_t requestId, uint32_t sockfd,
+        uint64_t segmentId, uint32_t segLength, CodingScheme codingScheme,
+        string codingSetting, vector<uint32_t> nodeList) {
+
+    if (nodeList.empty() || nodeList[0] != _osdId) {
+        debug_error("Segment %" PRIu64 " committed to OSD %" PRIu32
+                " which is not its primary\n", segmentId, _osdId);
+        _osdCommunicator->replyUploadSegmentAck(requestId, sockfd, segmentId,
+                true);
+        return;
+    }
+
+    // Acknowledge MDS for Segment Upload Completed
+    _osdCommunicator->segmentUploadAck(segmentId, segLength, codingScheme,
+            codingSetting, nodeList);
+
+    cout << "Segment " << segmentId << " committed" << endl;
+
+    _osdCommunicator->replyUploadSegmentAck(requestId, sockfd, segmentId);
+}
+
 vector<BlockData> Osd::computeDelta(uint64_t segmentId, uint32_t blockId,
         BlockData newBlock, vector<offset_length_t> offsetLength, vector<uint32_t> parityVector) {
 
@@ -685,7 +1284,7 @@ void Osd::sendDelta(uint64_t segmentId, uint32_t blockId, BlockData newBlock,
                 segmentId, blockLocation.blockId, blockLocation.osdId);
 
         uint32_t blocktpId = ++_blocktpId;
-        _blocktp.schedule(
+        Executor::getInstance().schedule(FOREGROUND_TASK,
                 boost::bind(&Osd::distributeBlock, this, segmentId, delta,
                         blockLocation, PARITY, blocktpId));
     }
@@ -695,7 +1294,8 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
         uint64_t segmentId, uint32_t blockId, DataMsgType dataMsgType,
         string updateKey, vector<offset_length_t> offsetLength,
         vector<BlockLocation> parityList, CodingScheme codingScheme,
-        string codingSetting, uint64_t segmentSize) {
+        string codingSetting, uint64_t segmentSize, bool isAborted,
+        uint32_t unsentChunkCount) {
 
     // TODO: check integrity of block received
     const string blockKey = to_string(segmentId) + "." + to_string(blockId);
@@ -713,7 +1313,7 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
                         blockId);
                 break;
             } else {
-                usleep(USLEEP_DURATION); // sleep 0.01s
+                _pendingRecoveryBlockChunk.waitValue(blockKey, 0);
             }
         }
     } else if (dataMsgType == UPDATE) {
@@ -754,7 +1354,7 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
                         blockId);
                 break;
             } else {
-                usleep(USLEEP_DURATION);
+                _pendingUpdateBlockChunk.waitValue(updateKey, 0);
             }
         }
     } else if (dataMsgType == PARITY) { // means PARITY UPDATE
@@ -798,13 +1398,23 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
                         blockId);
                 break;
             } else {
-                usleep(USLEEP_DURATION);
+                _pendingUpdateBlockChunk.waitValue(updateKey, 0);
             }
         }
     } else if (dataMsgType == DOWNLOAD || dataMsgType == UPLOAD) {
+        // an aborted upload only waits for the chunks that were sent
+        if (isAborted && dataMsgType == UPLOAD) {
+            _pendingBlockChunk.fetchAdd(blockKey, -unsentChunkCount);
+        }
         while (1) {
             if (_pendingBlockChunk.get(blockKey) == 0) {
-                if (dataMsgType == DOWNLOAD) {
+                if (isAborted && dataMsgType == UPLOAD) {
+                    debug_error("[UPLOAD] block %" PRIu64 ".%" PRIu32 " aborted\n",
+                            segmentId, blockId);
+                    MemoryPool::getInstance().poolFree(
+                            _uploadBlockData.get(blockKey).buf);
+                    _uploadBlockData.erase(blockKey);
+                } else if (dataMsgType == DOWNLOAD) {
                     // for download, do nothing, handled by getSegmentRequestProcessor
                     _downloadBlockRemaining.decrement(segmentId);
                     debug(
@@ -849,7 +1459,7 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
                         blockId);
                 break;
             } else {
-                usleep(USLEEP_DURATION); // sleep 0.01s
+                _pendingBlockChunk.waitValue(blockKey, 0);
             }
         }
     } else {
@@ -857,13 +1467,46 @@ void Osd::putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
     }
 }
 
-uint32_t Osd::putSegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
+bool Osd::putSegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
         uint64_t segmentId, uint64_t offset, uint32_t length,
-        DataMsgType dataMsgType, string updateKey, char* buf) {
+        DataMsgType dataMsgType, string updateKey, char* buf,
+        char* recvBuf) {
+
+    // chunks are sent right behind the init request, before its reply,
+    // and those arriving first are kept for the init to replay
+    if (dataMsgType == DEFAULT_DATA_MSG) {
+        lock_guard<mutex> lk(_segmentTransferMutex);
+        auto it = _segmentTransferType.find(updateKey);
+        if (it == _segmentTransferType.end()) {
+            EarlyChunk chunk;
+            chunk.sockfd = sockfd;
+            chunk.segmentId = segmentId;
+            chunk.offset = offset;
+            chunk.length = length;
+            chunk.buf = buf;
+            chunk.recvBuf = recvBuf;
+            _earlyChunks[updateKey].push_back(chunk);
+            return false;
+        }
+        dataMsgType = it->second;
+    }
+
+    writeSegmentChunk(segmentId, offset, length, dataMsgType, updateKey, buf);
+    return true;
+}
 
-    uint32_t byteWritten;
-    byteWritten = _storageModule->writeSegmentTransferCache(segmentId, buf, offset,
-            length, dataMsgType, updateKey);
+void Osd::writeSegmentChunk(uint64_t segmentId, uint64_t offset,
+        uint32_t length, DataMsgType dataMsgType, string updateKey,
+        char* buf) {
+
+    SegmentStream* stream;
+    if (dataMsgType == UPLOAD && _segmentStreams.find(segmentId, stream)) {
+        sendBlockPieces(segmentId, stream,
+                stream->encoder->write(buf, offset, length));
+    } else {
+        _storageModule->writeSegmentTransferCache(segmentId, buf, offset,
+                length, dataMsgType, updateKey);
+    }
 
     if (dataMsgType == UPLOAD) {
         _pendingSegmentChunk.decrement(segmentId);
@@ -872,8 +1515,6 @@ uint32_t Osd::putSegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
     } else {
         debug_error("Invalid dataMsgType = %d\n", dataMsgType);
     }
-
-    return byteWritten;
 }
 
 void Osd::putBlockInitProcessor(uint32_t requestId, uint32_t sockfd,
@@ -888,11 +1529,15 @@ void Osd::putBlockInitProcessor(uint32_t requestId, uint32_t sockfd,
 
     if (dataMsgType == DOWNLOAD) {
         _pendingBlockChunk.set(blockKey, chunkCount);
-        struct BlockData& blockData = _downloadBlockData.get(segmentId)[blockId];
-        blockData.info.segmentId = segmentId;
-        blockData.info.blockId = blockId;
-        blockData.info.blockSize = length;
-        blockData.buf = MemoryPool::getInstance().poolMalloc(length);
+        char* buf = MemoryPool::getInstance().poolMalloc(length);
+        _downloadBlockData.update(segmentId,
+                [&](vector<struct BlockData>& blockDataList) {
+                    struct BlockData& blockData = blockDataList[blockId];
+                    blockData.info.segmentId = segmentId;
+                    blockData.info.blockId = blockId;
+                    blockData.info.blockSize = length;
+                    blockData.buf = buf;
+                });
     } else {
         BlockData blockData;
         blockData.info.segmentId = segmentId;
@@ -924,21 +1569,28 @@ uint32_t Osd::putBlockDataProcessor(uint32_t requestId, uint32_t sockfd,
 
     uint32_t chunkLeft = 0;
 
+    // look up the block buffer under the map lock, copy outside of it
+    char* blockBuf = NULL;
+    auto getBuf = [&](struct BlockData& blockData) {blockBuf = blockData.buf;};
+
     if (dataMsgType == RECOVERY) {
-        struct BlockData& blockData = _recoveryBlockData.get(blockKey);
-        memcpy(blockData.buf + offset, buf, length);
+        _recoveryBlockData.update(blockKey, getBuf);
+        memcpy(blockBuf + offset, buf, length);
         chunkLeft = _pendingRecoveryBlockChunk.decrement(blockKey);
     } else if (dataMsgType == DOWNLOAD) {
-        struct BlockData& blockData = _downloadBlockData.get(segmentId)[blockId];
-        memcpy(blockData.buf + offset, buf, length);
+        _downloadBlockData.update(segmentId,
+                [&](vector<struct BlockData>& blockDataList) {
+                    getBuf(blockDataList[blockId]);
+                });
+        memcpy(blockBuf + offset, buf, length);
         chunkLeft = _pendingBlockChunk.decrement(blockKey);
     } else if (dataMsgType == UPLOAD) {
-        struct BlockData& blockData = _uploadBlockData.get(blockKey);
-        memcpy(blockData.buf + offset, buf, length);
+        _uploadBlockData.update(blockKey, getBuf);
+        memcpy(blockBuf + offset, buf, length);
         chunkLeft = _pendingBlockChunk.decrement(blockKey);
     } else if (dataMsgType == UPDATE || dataMsgType == PARITY) {
-        struct BlockData& blockData = _updateBlockData.get(updateKey);
-        memcpy(blockData.buf + offset, buf, length);
+        _updateBlockData.update(updateKey, getBuf);
+        memcpy(blockBuf + offset, buf, length);
         chunkLeft = _pendingUpdateBlockChunk.decrement(updateKey);
     } else {
         debug_error("Invalid data message type = %d\n", dataMsgType);
@@ -967,7 +1619,8 @@ void Osd::repairSegmentInfoProcessor(uint32_t requestId, uint32_t sockfd,
 
     //    lock_guard<mutex> lk(recoveryMutex);
 
-    // get coding information from MDS
+    // get coding information from MDS, the OSD list is about to change
+    invalidateSegmentInfo(segmentId);
     SegmentTransferOsdInfo segmentInfo =
             _osdCommunicator->getSegmentInfoRequest(segmentId, _osdId, true,
             true);
@@ -1012,7 +1665,7 @@ void Osd::repairSegmentInfoProcessor(uint32_t requestId, uint32_t sockfd,
                 "[RECOVERY] Need to obtain %zu symbols in block %" PRIu32 " from OSD %" PRIu32 "\n",
                 offsetLength.size(), blockId, osdId);
 
-        _recoverytp.schedule(
+        Executor::getInstance().schedule(RECOVERY_TASK,
                 boost::bind(&Osd::retrieveRecoveryBlock, this, recoverytpId,
                         osdId, segmentId, blockId, offsetLength,
                         boost::ref(repairBlockData[blockId]), isParity));
@@ -1020,10 +1673,8 @@ void Osd::repairSegmentInfoProcessor(uint32_t requestId, uint32_t sockfd,
     }
 
     // block until all recovery blocks retrieved
-    while (_recoverytpRequestCount.get(recoverytpId) > 0) {
-        usleep(USLEEP_DURATION);
-    }
-    _recoverytpRequestCount.erase(requestId);
+    _recoverytpRequestCount.waitValue(recoverytpId, 0);
+    _recoverytpRequestCount.erase(recoverytpId);
 
     debug_cyan(
             "[RECOVERY] Performing Repair for Segment %" PRIu64 " setting = %s\n",
@@ -1064,6 +1715,9 @@ void Osd::repairSegmentInfoProcessor(uint32_t requestId, uint32_t sockfd,
     _osdCommunicator->repairBlockAck(segmentId, repairBlockList,
             repairBlockOsdList);
 
+    // a lookup during the repair may have cached the old OSD list
+    invalidateSegmentInfo(segmentId);
+
     debug("[RECOVERY] Recovery completed for segment %" PRIu64 "\n", segmentId);
 }
 
@@ -1076,6 +1730,7 @@ void Osd::OsdStatUpdateRequestProcessor(uint32_t requestId, uint32_t sockfd) {
 
 void Osd::NewOsdRegisterProcessor(uint32_t requestId, uint32_t sockfd,
         uint32_t osdId, uint32_t osdIp, uint32_t osdPort) {
+    _onlineOsdMap.set(osdId, true);
     if (_osdId > osdId) {
         // Do connect
         _osdCommunicator->connectToOsd(osdIp, osdPort);
@@ -1085,7 +1740,9 @@ void Osd::NewOsdRegisterProcessor(uint32_t requestId, uint32_t sockfd,
 void Osd::OnlineOsdListProcessor(uint32_t requestId, uint32_t sockfd,
         vector<struct OnlineOsd>& onlineOsdList) {
 
+    _onlineOsdMap.set(_osdId, true);
     for (uint32_t i = 0; i < onlineOsdList.size(); ++i) {
+        _onlineOsdMap.set(onlineOsdList[i].osdId, true);
         if (_osdId > onlineOsdList[i].osdId) {
             // Do connect
             _osdCommunicator->connectToOsd(onlineOsdList[i].osdIp,
@@ -1093,6 +1750,45 @@ void Osd::OnlineOsdListProcessor(uint32_t requestId, uint32_t sockfd,
 
         }
     }
+    _hasOnlineOsdMap = true;
+}
+
+void Osd::OsdShutdownProcessor(uint32_t requestId, uint32_t sockfd,
+        uint32_t osdId) {
+    debug_yellow("OSD %" PRIu32 " is offline\n", osdId);
+    _onlineOsdMap.erase(osdId);
+}
+
+SegmentTransferOsdInfo Osd::getSegmentInfo(uint64_t segmentId) {
+    SegmentTransferOsdInfo segmentInfo;
+    if (_segmentInfoCache->tryGet(segmentId, segmentInfo)) {
+        return segmentInfo;
+    }
+
+    segmentInfo = _osdCommunicator->getSegmentInfoRequest(segmentId, _osdId);
+
+    // a segment not uploaded yet is not cached
+    if (segmentInfo._size != 0) {
+        _segmentInfoCache->insert(segmentId, segmentInfo);
+    }
+    return segmentInfo;
+}
+
+void Osd::invalidateSegmentInfo(uint64_t segmentId) {
+    _segmentInfoCache->remove(segmentId);
+}
+
+vector<bool> Osd::getOsdStatus(const vector<uint32_t>& osdList) {
+    if (!_hasOnlineOsdMap) {
+        return _osdCommunicator->getOsdStatusRequest(osdList);
+    }
+
+    vector<bool> osdStatus;
+    osdStatus.reserve(osdList.size());
+    for (uint32_t osdId : osdList) {
+        osdStatus.push_back(_onlineOsdMap.count(osdId) != 0);
+    }
+    return osdStatus;
 }
 
 uint32_t Osd::getCpuLoadavg(int idx) {
@@ -1138,3 +1834,15 @@ void Osd::dumpLatency() {
     fsync (fileno(f));
     fclose(f);
 }
+
+void Osd::dumpSegmentCacheStat() {
+    _decodedSegmentCache->printStat();
+}
+
+void Osd::dumpCompactionStat() {
+    _storageModule->printCompactionStat();
+}
+
+void Osd::dumpGroupCommitStat() {
+    _storageModule->printGroupCommitStat();
+}
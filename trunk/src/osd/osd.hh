@@ -7,6 +7,11 @@
 #include <stdint.h>
 #include <vector>
 #include <set>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "osd_communicator.hh"
 #include "storagemodule.hh"
 #include "codingmodule.hh"
@@ -16,7 +21,52 @@
 #include "../common/blocklocation.hh"
 #include "../common/onlineosd.hh"
 #include "../protocol/message.hh"
-#include "../datastructure/concurrentmap.hh"
+#include "../coding/segmentencoder.hh"
+#include "../datastructure/concurrenthashmap.hh"
+#include "../cache/lru_cache.hh"
+#include "decodedsegmentcache.hh"
+#include "osdlatencytracker.hh"
+
+/**
+ * Segment chunk that arrived before the init of its transfer
+ */
+
+struct EarlyChunk {
+    uint32_t sockfd;
+    uint64_t segmentId;
+    uint64_t offset;
+    uint32_t length;
+    char* buf;
+    char* recvBuf; // receive buffer holding buf, freed after the replay
+};
+
+/**
+ * Upload that is encoded and sent to the secondaries while it arrives
+ */
+
+struct SegmentStream {
+    CodingSetting codingSetting;
+    uint32_t segLength;
+    SegmentEncoder* encoder;
+    vector<BlockLocation> blockLocationList;
+    vector<BlockLocation> parityList;
+    vector<atomic<uint32_t>> sentPieceCount; // by blockId
+};
+
+/**
+ * Blocks of a hedged read, shared with the fetches that may finish after
+ * the read has decoded
+ */
+
+struct HedgedRead {
+    mutex hedgedMutex;
+    condition_variable changed;
+    vector<BlockData> blockDataList;
+    vector<bool> isArrived;
+    uint32_t arrivedCount;
+    uint32_t failedCount;
+    bool isFinished; // blocks arriving later are freed
+};
 
 /**
  * Central class of OSD
@@ -101,6 +151,23 @@ public:
             uint64_t segmentId, uint32_t blockId,
             vector<offset_length_t> symbols, DataMsgType dataMsgType, bool isParity);
 
+    /**
+     * Action when a getSegmentRangeRequest is received
+     * Serve a block range from disk, or a segment range from the data
+     * blocks holding it if no decode is needed
+     * @param requestId Request ID
+     * @param sockfd Socket descriptor of message source
+     * @param segmentId Segment ID
+     * @param blockId Block ID, SEGMENT_RANGE_WHOLE_SEGMENT for a segment range
+     * @param offset Offset of the range
+     * @param length Length of the range
+     * @param isParity Whether the block is a parity block
+     */
+
+    void getSegmentRangeRequestProcessor(uint32_t requestId, uint32_t sockfd,
+            uint64_t segmentId, uint32_t blockId, uint64_t offset,
+            uint32_t length, bool isParity);
+
     /**
      * Action when a getRecoveryBlockRequest is received
      * @param requestId Request ID
@@ -159,6 +226,23 @@ public:
             uint64_t segmentId, DataMsgType dataMsgType, string updateKey,
             vector<offset_length_t> offsetLength, bool isSmallSegment = false);
 
+    /**
+     * Action when a client that encoded a segment itself commits it
+     * The blocks are stored on the OSDs already, the primary only
+     * acknowledges the upload to the MDS
+     * @param requestId Request ID
+     * @param sockfd Socket descriptor of message source
+     * @param segmentId Segment ID
+     * @param segLength Segment length
+     * @param codingScheme Coding Scheme
+     * @param codingSetting Coding Setting
+     * @param nodeList OSD of each block, the primary first
+     */
+
+    void commitSegmentProcessor(uint32_t requestId, uint32_t sockfd,
+            uint64_t segmentId, uint32_t segLength, CodingScheme codingScheme,
+            string codingSetting, vector<uint32_t> nodeList);
+
     /**
      * Action when an segment trunk is received
      * @param requestId Request ID
@@ -169,12 +253,15 @@ public:
      * @param dataMsgType Data Msg Type
      * @param updateKey Update Key
      * @param buf Pointer to buffer
-     * @return Length of trunk if success, -1 if failure
+     * @param recvBuf Receive buffer holding buf
+     * @return false if the trunk arrived before the init and recvBuf is
+     * kept until the init replays it, with the transfer credit of the trunk
      */
 
-    uint32_t putSegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
+    bool putSegmentDataProcessor(uint32_t requestId, uint32_t sockfd,
             uint64_t segmentId, uint64_t offset, uint32_t length,
-            DataMsgType dataMsgType, string updateKey, char* buf);
+            DataMsgType dataMsgType, string updateKey, char* buf,
+            char* recvBuf);
 
     /**
      * Action when a putBlockInitRequest is received
@@ -231,13 +318,17 @@ public:
      * @param sockfd Socket descriptor of message source
      * @param segmentId Segment ID
      * @param blockId Block ID
+     * @param isAborted Discard the block once the chunks sent have arrived
+     * (UPLOAD only)
+     * @param unsentChunkCount Chunks announced in the init but never sent
      */
 
     void putBlockEndProcessor(uint32_t requestId, uint32_t sockfd,
             uint64_t segmentId, uint32_t blockId, DataMsgType dataMsgType,
             string updateKey, vector<offset_length_t> offsetLength,
             vector<BlockLocation> parityList, CodingScheme codingScheme,
-            string codingSetting, uint64_t segmentSize);
+            string codingSetting, uint64_t segmentSize, bool isAborted,
+            uint32_t unsentChunkCount);
 
     /**
      * Action when a recovery request is received
@@ -279,6 +370,15 @@ public:
     void OnlineOsdListProcessor(uint32_t requestId, uint32_t sockfd,
             vector<struct OnlineOsd>& onlineOsdList);
 
+    /**
+     * Action when a monitor tells an osd went offline
+     * @param requestId Request ID
+     * @param sockfd Socket descriptor of message source
+     * @param osdId the id of the offline osd
+     */
+    void OsdShutdownProcessor(uint32_t requestId, uint32_t sockfd,
+            uint32_t osdId);
+
     // getters
 
     /**
@@ -328,6 +428,24 @@ public:
 
     void dumpLatency();
 
+    /**
+     * Print the hit ratio of the decoded segment cache
+     */
+
+    void dumpSegmentCacheStat();
+
+    /**
+     * Print the backlog of the parity delta compaction
+     */
+
+    void dumpCompactionStat();
+
+    /**
+     * Print the rounds and syncs of the group commit
+     */
+
+    void dumpGroupCommitStat();
+
 private:
 
     /**
@@ -353,6 +471,44 @@ private:
 
     uint32_t saveBlockToStorage(BlockData blockData);
 
+    /**
+     * Get the coding information and OSD list of a segment, from the
+     * cache if possible, otherwise from the MDS
+     * @param segmentId Segment ID
+     * @return SegmentTransferOsdInfo structure, _size = 0 if not found
+     */
+
+    SegmentTransferOsdInfo getSegmentInfo(uint64_t segmentId);
+
+    /**
+     * Drop the cached information of a segment after it changes
+     * @param segmentId Segment ID
+     */
+
+    void invalidateSegmentInfo(uint64_t segmentId);
+
+    /**
+     * Get the status of the OSDs from the membership pushed by the monitor,
+     * ask the monitor if the membership has not arrived yet
+     * @param osdList List of OSD ID
+     * @return Bool array of OSD status (true = up, false = down)
+     */
+
+    vector<bool> getOsdStatus(const vector<uint32_t>& osdList);
+
+    /**
+     * Read a range of a block from the storage
+     * @param segmentId ID of the segment that the block is belonged to
+     * @param blockId Target Block ID
+     * @param isParity Whether the block is a parity block
+     * @param offset Offset of the range inside the block
+     * @param length Length of the range
+     * @param buf Buffer to store the range
+     */
+
+    void readBlockRange(uint64_t segmentId, uint32_t blockId, bool isParity,
+            uint32_t offset, uint32_t length, char* buf);
+
     /**
      * Perform degraded read of an segment
      * @param segmentId ID of the segment to read
@@ -369,6 +525,113 @@ private:
 
     void freeSegment(uint64_t segmentId, SegmentData segmentData);
 
+    /**
+     * Pick the secondaries of an upload and open the block transfers
+     * @param segmentId Segment ID
+     * @param segLength Segment length
+     * @param codingSetting Coding scheme and setting
+     */
+
+    void startSegmentStream(uint64_t segmentId, uint32_t segLength,
+            CodingSetting codingSetting);
+
+    /**
+     * Wait until fewer than MAX_NUM_PROCESSING_SEGMENT uploads are in progress
+     * A connection with an upload in progress is admitted at once, as its
+     * next chunks may be queued behind the ones of the new segment
+     * @param sockfd Socket descriptor of the client
+     * @param segmentId Segment ID
+     */
+
+    void admitSegmentUpload(uint32_t sockfd, uint64_t segmentId);
+
+    /**
+     * Release the admission of a finished upload
+     * @param segmentId Segment ID
+     */
+
+    void releaseSegmentUpload(uint64_t segmentId);
+
+    /**
+     * Write a segment trunk to the cache or the encoder of its transfer
+     * @param segmentId Segment ID
+     * @param offset Offset of the trunk in the segment
+     * @param length Length of trunk
+     * @param dataMsgType Data Msg Type
+     * @param updateKey Update Key
+     * @param buf Pointer to buffer
+     */
+
+    void writeSegmentChunk(uint64_t segmentId, uint64_t offset,
+            uint32_t length, DataMsgType dataMsgType, string updateKey,
+            char* buf);
+
+    /**
+     * Fetch the required blocks of a segment and wait for all of them
+     * @param segmentId Segment ID
+     * @param segmentInfo Coding information and OSD list of the segment
+     * @param requiredBlockSymbols Blocks and symbols to fetch
+     * @return List of all blocks, filled for the required ones
+     */
+
+    vector<BlockData> fetchBlocks(uint64_t segmentId,
+            const SegmentTransferOsdInfo& segmentInfo,
+            const block_list_t& requiredBlockSymbols);
+
+    /**
+     * Fetch any k blocks of a segment encoded with an MDS code
+     * The healthy data blocks are requested first, fastest first, and
+     * another block, parity once the data blocks are exhausted, is
+     * requested whenever a request fails or the fetches run past the hedge
+     * delay of their OSDs
+     * @param segmentId Segment ID
+     * @param segmentInfo Coding information and OSD list of the segment
+     * @param blockStatus Status of the OSDs holding the blocks
+     * @param requiredBlockSymbols In: k blocks with whole-block symbols,
+     * out: the blocks to decode with
+     * @return List of all blocks, filled for the blocks to decode with
+     */
+
+    vector<BlockData> fetchBlocksHedged(uint64_t segmentId,
+            const SegmentTransferOsdInfo& segmentInfo,
+            const vector<bool>& blockStatus,
+            block_list_t& requiredBlockSymbols);
+
+    /**
+     * Fetch a whole block for a hedged read and record the OSD latency
+     * @param read Hedged read
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param osdId OSD holding the block
+     * @param isParity Whether the block is a parity block
+     * @param blockSize Size of the block
+     */
+
+    void fetchHedgedBlock(shared_ptr<HedgedRead> read, uint64_t segmentId,
+            uint32_t blockId, uint32_t osdId, bool isParity,
+            uint32_t blockSize);
+
+    /**
+     * Send the completed pieces of a streamed upload to the secondaries
+     * Pieces of the blocks kept by this OSD are written at the end
+     * @param segmentId Segment ID
+     * @param stream Streamed upload
+     * @param pieces Pieces from SegmentEncoder
+     */
+
+    void sendBlockPieces(uint64_t segmentId, SegmentStream* stream,
+            const vector<BlockPiece>& pieces);
+
+    /**
+     * Close the block transfers of a streamed upload and acknowledge it
+     * @param requestId Request ID
+     * @param sockfd Socket descriptor of the client
+     * @param segmentId Segment ID
+     */
+
+    void finishSegmentStream(uint32_t requestId, uint32_t sockfd,
+            uint64_t segmentId);
+
     /**
      * Stores the list of OSDs that store a certain block
      */
@@ -396,36 +659,56 @@ private:
     uint32_t _osdId;
 
     // upload
-    ConcurrentMap<uint64_t, uint32_t> _pendingSegmentChunk;
-    ConcurrentMap<uint64_t, struct CodingSetting> _codingSettingMap;
-    ConcurrentMap<string, BlockData> _uploadBlockData;
+    ConcurrentHashMap<uint64_t, uint32_t> _pendingSegmentChunk;
+    map<string, DataMsgType> _segmentTransferType; // by updateKey
+    map<string, vector<EarlyChunk>> _earlyChunks; // by updateKey
+    mutex _segmentTransferMutex;
+    ConcurrentHashMap<uint64_t, struct CodingSetting> _codingSettingMap;
+    ConcurrentHashMap<string, BlockData> _uploadBlockData;
+    ConcurrentHashMap<uint64_t, SegmentStream*> _segmentStreams;
+    map<uint64_t, uint32_t> _admittedUploads; // segmentId -> sockfd
+    map<uint32_t, uint32_t> _admittedUploadCount; // by sockfd
+    mutex _uploadAdmissionMutex;
+    condition_variable _uploadAdmissionCond;
 
     // download
-    ConcurrentMap<uint32_t, uint32_t> _blocktpRequestCount;
+    ConcurrentHashMap<uint32_t, uint32_t> _blocktpRequestCount;
     atomic<uint32_t> _blocktpId;
 
-    ConcurrentMap<uint64_t, vector<struct BlockData>> _downloadBlockData;
-    ConcurrentMap<uint64_t, uint32_t> _downloadBlockRemaining;
-    ConcurrentMap<uint64_t, uint32_t> _segmentRequestCount;
-    ConcurrentMap<uint64_t, mutex*> _segmentDownloadMutex;
-    ConcurrentMap<uint64_t, SegmentData> _segmentDataMap;
-    ConcurrentMap<uint64_t, bool> _isSegmentDownloaded;
+    ConcurrentHashMap<uint64_t, vector<struct BlockData>> _downloadBlockData;
+    ConcurrentHashMap<uint64_t, uint32_t> _downloadBlockRemaining;
+    ConcurrentHashMap<uint64_t, uint32_t> _segmentRequestCount;
+    ConcurrentHashMap<uint64_t, mutex*> _segmentDownloadMutex;
+    ConcurrentHashMap<uint64_t, SegmentData> _segmentDataMap;
+    ConcurrentHashMap<uint64_t, bool> _isSegmentDownloaded;
+    ConcurrentHashMap<uint64_t, uint64_t> _segmentCacheEpoch;
 
     // recovery
-    ConcurrentMap<string, bool> _isPendingRecovery;
-    ConcurrentMap<string, uint32_t> _pendingRecoveryBlockChunk;
-    ConcurrentMap<string, BlockData> _recoveryBlockData;
-    ConcurrentMap<uint32_t, uint32_t> _recoverytpRequestCount;
+    ConcurrentHashMap<string, bool> _isPendingRecovery;
+    ConcurrentHashMap<string, uint32_t> _pendingRecoveryBlockChunk;
+    ConcurrentHashMap<string, BlockData> _recoveryBlockData;
+    ConcurrentHashMap<uint32_t, uint32_t> _recoverytpRequestCount;
     atomic<uint32_t> _recoverytpId;
 
     // update
-    ConcurrentMap<string, BlockData> _updateBlockData;
-    ConcurrentMap<string, uint32_t> _pendingUpdateSegmentChunk;
-    ConcurrentMap<string, uint32_t> _pendingUpdateBlockChunk;
+    ConcurrentHashMap<string, BlockData> _updateBlockData;
+    ConcurrentHashMap<string, uint32_t> _pendingUpdateSegmentChunk;
+    ConcurrentHashMap<string, uint32_t> _pendingUpdateBlockChunk;
     atomic<uint32_t> _updateId;
 
     // upload / download
-    ConcurrentMap<string, uint32_t> _pendingBlockChunk;
+    ConcurrentHashMap<string, uint32_t> _pendingBlockChunk;
+
+    // block fetch latencies for hedged reads
+    OsdLatencyTracker _osdLatencyTracker;
+
+    // decoded segments served without fetching blocks
+    DecodedSegmentCache* _decodedSegmentCache;
+
+    // segment info and membership
+    LruCache<uint64_t, SegmentTransferOsdInfo>* _segmentInfoCache;
+    ConcurrentHashMap<uint32_t, bool> _onlineOsdMap;
+    atomic<bool> _hasOnlineOsdMap;
 
     // cache report
     uint32_t _reportCacheInterval;
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <cstdio>
+#include <unistd.h>
 #include "osd.hh"
 #include "osd_communicator.hh"
 #include "../common/enums.hh"
@@ -13,6 +14,8 @@
 #include "../common/segmentdata.hh"
 #include "../common/metadata.hh"
 #include "../protocol/metadata/uploadsegmentack.hh"
+#include "../protocol/metadata/uploadsegmentackreply.hh"
+#include "../protocol/transfer/getsegmentrangereply.hh"
 #include "../protocol/metadata/listdirectoryrequest.hh"
 #include "../protocol/metadata/getsegmentinforequest.hh"
 #include "../protocol/transfer/putsegmentinitreply.hh"
@@ -69,16 +72,60 @@ void OsdCommunicator::replyPutBlockInit(uint32_t requestId,
 }
 
 void OsdCommunicator::replyPutSegmentEnd(uint32_t requestId,
-		uint32_t connectionId, uint64_t segmentId, bool isSmallSegment) {
+		uint32_t connectionId, uint64_t segmentId, bool isSmallSegment,
+		bool isFailed) {
 
 	SegmentTransferEndReplyMsg* putSegmentEndReplyMsg =
 			new SegmentTransferEndReplyMsg(this, requestId, connectionId,
-					segmentId, isSmallSegment);
+					segmentId, isSmallSegment, isFailed);
 	putSegmentEndReplyMsg->prepareProtocolMsg();
 
 	addMessage(putSegmentEndReplyMsg);
 }
 
+void OsdCommunicator::replyUploadSegmentAck(uint32_t requestId,
+		uint32_t connectionId, uint64_t segmentId, bool isFailed) {
+
+	UploadSegmentAckReplyMsg* uploadSegmentAckReplyMsg =
+			new UploadSegmentAckReplyMsg(this, requestId, connectionId,
+					segmentId, isFailed);
+	uploadSegmentAckReplyMsg->prepareProtocolMsg();
+
+	addMessage(uploadSegmentAckReplyMsg);
+}
+
+void OsdCommunicator::replySegmentRange(uint32_t requestId,
+		uint32_t connectionId, uint64_t segmentId, bool isServed, char* buf,
+		uint32_t length) {
+
+	GetSegmentRangeReplyMsg* getSegmentRangeReplyMsg =
+			new GetSegmentRangeReplyMsg(this, requestId, connectionId,
+					segmentId, isServed, buf, length);
+	getSegmentRangeReplyMsg->prepareProtocolMsg();
+
+	addMessage(getSegmentRangeReplyMsg);
+}
+
+void OsdCommunicator::replySegmentRangeFile(uint32_t requestId,
+		uint32_t connectionId, uint64_t segmentId, BlockFileRange fileRange) {
+
+	GetSegmentRangeReplyMsg* getSegmentRangeReplyMsg =
+			new GetSegmentRangeReplyMsg(this, requestId, connectionId,
+					segmentId, true, NULL, 0);
+	getSegmentRangeReplyMsg->prepareProtocolMsg();
+
+	// the message closes its own descriptor once the range is sent
+	const int fd = dup(fileRange.fd);
+	if (fd < 0) {
+		perror("dup");
+		exit(-1);
+	}
+	getSegmentRangeReplyMsg->preparePayloadFile(fd, fileRange.offset,
+			fileRange.length, fileRange.pin);
+
+	addMessage(getSegmentRangeReplyMsg);
+}
+
 void OsdCommunicator::replyPutBlockEnd(uint32_t requestId,
 		uint32_t connectionId, uint64_t segmentId, uint32_t blockId,
 		uint32_t waitOnRequestId) {
@@ -103,59 +150,6 @@ uint32_t OsdCommunicator::reportOsdFailure(uint32_t osdId) {
 	return 0;
 }
 
-uint32_t OsdCommunicator::sendBlock(uint32_t sockfd, struct BlockData blockData,
-		DataMsgType dataMsgType, string updateKey) {
-
-	uint64_t segmentId = blockData.info.segmentId;
-	uint32_t blockId = blockData.info.blockId;
-    // this is buffer length held in the BlockData, not the block size
-	uint32_t length = blockData.info.blockSize; 
-	char* buf = blockData.buf;
-	const uint32_t chunkCount = ((length - 1) / _chunkSize) + 1;
-
-	vector<offset_length_t> offsetLength = blockData.info.offlenVector;
-	vector<BlockLocation> parityList = blockData.info.parityVector;
-
-	// step 1: send init message, wait for ack
-
-    debug("XXXXX segmentId = %" PRIu64 " blockid = %" PRIu32 " blocksize = %" PRIu32 "\n", segmentId, blockId, length);
-	debug("Put Block Init to FD = %" PRIu32 "\n", sockfd);
-	putBlockInit(sockfd, segmentId, blockId, length, chunkCount, dataMsgType, updateKey);
-	debug("Put Block Init ACK-ed from FD = %" PRIu32 "\n", sockfd);
-
-	// step 2: send data
-
-	uint64_t byteToSend = 0;
-	uint64_t byteProcessed = 0;
-	uint64_t byteRemaining = length;
-
-	while (byteProcessed < length) {
-
-		if (byteRemaining > _chunkSize) {
-			byteToSend = _chunkSize;
-		} else {
-			byteToSend = byteRemaining;
-		}
-
-		putBlockData(sockfd, segmentId, blockId, buf, byteProcessed, byteToSend,
-				dataMsgType, updateKey);
-		byteProcessed += byteToSend;
-		byteRemaining -= byteToSend;
-
-	}
-
-	// Step 3: Send End message
-
-    putBlockEnd(sockfd, segmentId, blockId, dataMsgType, updateKey,
-            offsetLength, parityList, blockData.info.codingScheme,
-            blockData.info.codingSetting, blockData.info.segmentSize);
-
-	cout << "Put Block ID = " << segmentId << "." << blockId << " Finished"
-			<< endl;
-
-	return 0;
-}
-
 void OsdCommunicator::getBlockRequest(uint32_t osdId, uint64_t segmentId,
 		uint32_t blockId, vector<offset_length_t> symbols, DataMsgType dataMsgType, bool isParity) {
 
@@ -168,28 +162,6 @@ void OsdCommunicator::getBlockRequest(uint32_t osdId, uint64_t segmentId,
 
 }
 
-vector<struct BlockLocation> OsdCommunicator::getOsdListRequest(
-		uint64_t segmentId, ComponentType dstComponent, uint32_t blockCount,
-		uint32_t primaryId, uint64_t blockSize) {
-
-	GetSecondaryListRequestMsg* getSecondaryListRequestMsg =
-			new GetSecondaryListRequestMsg(this, getMonitorSockfd(), blockCount,
-					primaryId, blockSize);
-	getSecondaryListRequestMsg->prepareProtocolMsg();
-
-	addMessage(getSecondaryListRequestMsg, true);
-	MessageStatus status = getSecondaryListRequestMsg->waitForStatusChange();
-
-	if (status == READY) {
-		vector<struct BlockLocation> osdList =
-				getSecondaryListRequestMsg->getSecondaryList();
-		waitAndDelete(getSecondaryListRequestMsg);
-		return osdList;
-	}
-
-	return {};
-}
-
 vector<bool> OsdCommunicator::getOsdStatusRequest(vector<uint32_t> osdIdList) {
 
 	GetOsdStatusRequestMsg* getOsdStatusRequestMsg = new GetOsdStatusRequestMsg(
@@ -217,71 +189,6 @@ uint32_t OsdCommunicator::sendBlockAck(uint64_t segmentId, uint32_t blockId,
 // PRIVATE FUNCTIONS
 //
 
-void OsdCommunicator::putBlockInit(uint32_t sockfd, uint64_t segmentId,
-		uint32_t blockId, uint32_t length, uint32_t chunkCount,
-		DataMsgType dataMsgType, string updateKey) {
-
-	// Step 1 of the upload process
-
-	PutBlockInitRequestMsg* putBlockInitRequestMsg = new PutBlockInitRequestMsg(
-			this, sockfd, segmentId, blockId, length, chunkCount, dataMsgType,
-			updateKey);
-
-	putBlockInitRequestMsg->prepareProtocolMsg();
-	addMessage(putBlockInitRequestMsg, true);
-
-	MessageStatus status = putBlockInitRequestMsg->waitForStatusChange();
-	if (status == READY) {
-		waitAndDelete(putBlockInitRequestMsg);
-		return;
-	} else {
-		debug_error("Put Block Init Failed %" PRIu64 ".%" PRIu32 "\n",
-				segmentId, blockId);
-		exit(-1);
-	}
-
-}
-
-void OsdCommunicator::putBlockData(uint32_t sockfd, uint64_t segmentId,
-		uint32_t blockId, char* buf, uint64_t offset, uint32_t length,
-		DataMsgType dataMsgType, string updateKey) {
-
-	// Step 2 of the upload process
-	BlockDataMsg* blockDataMsg = new BlockDataMsg(this, sockfd, segmentId,
-			blockId, offset, length, dataMsgType, updateKey);
-
-	blockDataMsg->prepareProtocolMsg();
-	blockDataMsg->preparePayload(buf + offset, length);
-
-	addMessage(blockDataMsg, false);
-}
-
-void OsdCommunicator::putBlockEnd(uint32_t sockfd, uint64_t segmentId,
-		uint32_t blockId, DataMsgType dataMsgType, string updateKey,
-		vector<offset_length_t> offsetLength, vector<BlockLocation> parityList,
-		CodingScheme codingScheme, string codingSetting, uint64_t segmentSize) {
-
-	// Step 3 of the upload process
-
-	BlockTransferEndRequestMsg* blockTransferEndRequestMsg =
-			new BlockTransferEndRequestMsg(this, sockfd, segmentId, blockId,
-					dataMsgType, updateKey, offsetLength, parityList,
-					codingScheme, codingSetting, segmentSize);
-
-	blockTransferEndRequestMsg->prepareProtocolMsg();
-	addMessage(blockTransferEndRequestMsg, true);
-
-	MessageStatus status = blockTransferEndRequestMsg->waitForStatusChange();
-	if (status == READY) {
-		waitAndDelete(blockTransferEndRequestMsg);
-		return;
-	} else {
-		debug_error("Block Transfer End Failed %" PRIu64 ".%" PRIu32 "\n",
-				segmentId, blockId);
-		exit(-1);
-	}
-}
-
 void OsdCommunicator::segmentUploadAck(uint64_t segmentId, uint32_t segmentSize,
 		CodingScheme codingScheme, string codingSetting,
 		vector<uint32_t> nodeList) {
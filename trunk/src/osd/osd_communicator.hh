@@ -59,10 +59,48 @@ public:
 	 * @param requestId Request ID
 	 * @param connectionId Connection ID
 	 * @param segmentId Segment ID
+	 * @param isSmallSegment Whether the segment was sent in one message
+	 * @param isFailed Whether the segment could not be stored
 	 */
 
 	void replyPutSegmentEnd(uint32_t requestId, uint32_t connectionId,
-			uint64_t segmentId, bool isSmallSegment = false);
+			uint64_t segmentId, bool isSmallSegment = false,
+			bool isFailed = false);
+
+	/**
+	 * Reply the commit of a segment encoded by the client
+	 * @param requestId Request ID
+	 * @param connectionId Connection ID
+	 * @param segmentId Segment ID
+	 * @param isFailed Whether the commit was rejected
+	 */
+
+	void replyUploadSegmentAck(uint32_t requestId, uint32_t connectionId,
+			uint64_t segmentId, bool isFailed = false);
+
+	/**
+	 * Reply a byte range of a segment or a block
+	 * @param requestId Request ID
+	 * @param connectionId Connection ID
+	 * @param segmentId Segment ID
+	 * @param isServed Whether buf holds the range
+	 * @param buf Buffer from MemoryPool, freed after it is sent
+	 * @param length Length of the range
+	 */
+
+	void replySegmentRange(uint32_t requestId, uint32_t connectionId,
+			uint64_t segmentId, bool isServed, char* buf, uint32_t length);
+
+	/**
+	 * Reply a byte range of a block straight from the file holding it
+	 * @param requestId Request ID
+	 * @param connectionId Connection ID
+	 * @param segmentId Segment ID
+	 * @param fileRange Range of the file, the descriptor is duplicated
+	 */
+
+	void replySegmentRangeFile(uint32_t requestId, uint32_t connectionId,
+			uint64_t segmentId, BlockFileRange fileRange);
 
 	/**
 	 * Reply to PutBlockEndRequest / RecoveryBlockData
@@ -104,17 +142,6 @@ public:
 
 	uint32_t reportOsdFailure(uint32_t osdId);
 
-	/**
-	 * Send a block to another OSD
-	 * @param sockfd Socket Descriptor of the destination
-	 * @param blockData BlockData structure
-	 * @param dataMsgType Data Msg Type
-	 * @return 0 if success, -1 if failure
-	 */
-
-	uint32_t sendBlock(uint32_t sockfd, struct BlockData blockData,
-			DataMsgType dataMsgType, string updateKey = "");
-
 	/**
 	 * Send a request to get a block to other OSD
 	 * @param osdId Target Osd ID
@@ -127,18 +154,6 @@ public:
 	void getBlockRequest(uint32_t osdId, uint64_t segmentId, uint32_t blockId,
 			vector<offset_length_t> symbols, DataMsgType dataMsgType, bool isParity);
 
-	/**
-	 * Send a request to get the secondary OSD list of an segment from MDS/Monitor
-	 * @param segmentId Segment ID for query
-	 * @param dstComponent Type of the component to request (MDS / MONITOR)
-	 * @param blockCount (optional) Request a specific number of OSD to hold data
-	 * @return List of OSD ID that should contain the segment
-	 */
-
-	vector<struct BlockLocation> getOsdListRequest(uint64_t segmentId,
-			ComponentType dstComponent, uint32_t blockCount, uint32_t primaryId,
-			uint64_t blockSize);
-
 	/**
 	 * Send an acknowledgement to inform the dstComponent that the block is stored
 	 * @param segmentId ID of the segment that the block is belonged to
@@ -199,53 +214,6 @@ public:
 
 	void repairBlockAck(uint64_t segmentId, vector<uint32_t> repairBlockList,
 			vector<uint32_t> repairBlockOsdList);
-private:
-
-	/**
-	 * Initiate upload process to OSD (Step 1)
-	 * @param sockfd Destination OSD Socket Descriptor
-	 * @param segmentId Segment ID
-	 * @param blockId Block ID
-	 * @param length Size of the segment
-	 * @param chunkCount Number of chunks that will be sent
-	 * @param dataMsgType Data Msg Type
-	 * @param updateKey Update key
-	 */
-
-	void putBlockInit(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
-			uint32_t length, uint32_t chunkCount, DataMsgType dataMsgType, string updateKey);
-
-	/**
-	 * Send an segment chunk to OSD (Step 2)
-	 * @param sockfd Destination OSD Socket Descriptor
-	 * @param segmentId Segment ID
-	 * @param blockId Block ID
-	 * @param buf Buffer containing the segment
-	 * @param offset Offset of the chunk inside the buffer
-	 * @param length Length of the chunk
-	 * @param dataMsgType Data Msg Type
-	 * @param updateKey Update key
-	 */
-
-	void putBlockData(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
-			char* buf, uint64_t offset, uint32_t length,
-			DataMsgType dataMsgType, string updateKey);
-
-	/**
-	 * Finalise upload process to OSD (Step 3)
-	 * @param sockfd Destination OSD Socket Descriptor
-	 * @param segmentId Segment ID
-	 * @param blockId Block ID
-	 * @param dataMsgType Data Msg Type
-	 * @param updateKey Update key
-	 * @param offsetLength <offset, length> for block updates
-	 */
-
-    void putBlockEnd(uint32_t sockfd, uint64_t segmentId, uint32_t blockId,
-            DataMsgType dataMsgType, string updateKey,
-            vector<offset_length_t> offsetLength,
-            vector<BlockLocation> parityList, CodingScheme codingScheme,
-            string codingSetting, uint64_t segmentSize);
 
 };
 
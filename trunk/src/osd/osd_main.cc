@@ -34,6 +34,9 @@ void sighandler(int signum) {
 		fflush (stdout);
 		osd->dumpLatency();
 		cout << "done" << endl;
+		osd->dumpSegmentCacheStat();
+		osd->dumpCompactionStat();
+		osd->dumpGroupCommitStat();
 	}
 }
 
@@ -46,6 +49,8 @@ int main(int argc, char* argv[]) {
 
 	signal(SIGINT, sighandler);
 	signal(SIGUSR1, sighandler);
+	// blocks sent with sendfile to a closed socket must not kill the OSD
+	signal(SIGPIPE, SIG_IGN);
 
 	// handle segFault for debug
 	Debug::DeathHandler dh;
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include "osdlatencytracker.hh"
+#include "../common/define.hh"
+
+void OsdLatencyTracker::record(uint32_t osdId, uint32_t latency) {
+    lock_guard<mutex> lk(_trackerMutex);
+
+    LatencyWindow& window = _windowMap[osdId];
+    if (window.samples.size() < HEDGE_LATENCY_SAMPLES) {
+        window.samples.push_back(latency);
+    } else {
+        window.samples[window.next] = latency;
+        window.next = (window.next + 1) % HEDGE_LATENCY_SAMPLES;
+    }
+}
+
+vector<uint32_t> OsdLatencyTracker::getEstimates(
+        const vector<uint32_t>& osdList) {
+
+    vector<uint32_t> estimates(osdList.size(), 0);
+    vector<bool> isKnown(osdList.size(), false);
+    vector<uint32_t> knownEstimates;
+    for (uint32_t i = 0; i < osdList.size(); i++) {
+        if (getPercentile(osdList[i], 50, estimates[i])) {
+            isKnown[i] = true;
+            knownEstimates.push_back(estimates[i]);
+        }
+    }
+
+    if (knownEstimates.empty()) {
+        return estimates;
+    }
+
+    const uint32_t rank = (knownEstimates.size() - 1) / 2;
+    nth_element(knownEstimates.begin(), knownEstimates.begin() + rank,
+            knownEstimates.end());
+    for (uint32_t i = 0; i < osdList.size(); i++) {
+        if (!isKnown[i]) {
+            estimates[i] = knownEstimates[rank];
+        }
+    }
+    return estimates;
+}
+
+uint32_t OsdLatencyTracker::getHedgeDelay(uint32_t osdId) {
+    uint32_t latency = 0;
+    if (!getPercentile(osdId, HEDGE_PERCENTILE, latency)) {
+        return HEDGE_DEFAULT_DELAY;
+    }
+    return max(latency, (uint32_t) HEDGE_MIN_DELAY);
+}
+
+bool OsdLatencyTracker::getPercentile(uint32_t osdId, uint32_t percentile,
+        uint32_t& latency) {
+
+    vector<uint32_t> samples;
+    {
+        lock_guard<mutex> lk(_trackerMutex);
+        auto it = _windowMap.find(osdId);
+        if (it == _windowMap.end()
+                || it->second.samples.size() < HEDGE_MIN_SAMPLES) {
+            return false;
+        }
+        samples = it->second.samples;
+    }
+
+    const uint32_t rank = (samples.size() - 1) * percentile / 100;
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    latency = samples[rank];
+    return true;
+}
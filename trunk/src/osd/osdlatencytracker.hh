@@ -0,0 +1,71 @@
+#ifndef __OSDLATENCYTRACKER_HH__
+#define __OSDLATENCYTRACKER_HH__
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * Recent block fetch latencies of each OSD, used to order the block
+ * requests of a read and to decide when a hedged request is sent
+ */
+
+class OsdLatencyTracker {
+public:
+
+    /**
+     * Record the latency of a block fetched from an OSD
+     * @param osdId OSD ID
+     * @param latency Latency in microseconds
+     */
+
+    void record(uint32_t osdId, uint32_t latency);
+
+    /**
+     * Get the typical (median) latency of each OSD of a list. An OSD with
+     * too few samples gets the median estimate of the others, so it is
+     * ranked neither ahead of nor behind the OSDs that are known
+     * @param osdList OSD IDs
+     * @return Latency in microseconds of each OSD, 0 if none is known
+     */
+
+    vector<uint32_t> getEstimates(const vector<uint32_t>& osdList);
+
+    /**
+     * Get how long to wait for an OSD before hedging, the
+     * HEDGE_PERCENTILE latency of its recent fetches
+     * @param osdId OSD ID
+     * @return Delay in microseconds, HEDGE_DEFAULT_DELAY if too few samples
+     */
+
+    uint32_t getHedgeDelay(uint32_t osdId);
+
+private:
+
+    /**
+     * Get a percentile of the recent latencies of an OSD
+     * @param osdId OSD ID
+     * @param percentile Percentile, 0 - 100
+     * @param latency Result in microseconds
+     * @return false if there are fewer than HEDGE_MIN_SAMPLES samples
+     */
+
+    bool getPercentile(uint32_t osdId, uint32_t percentile, uint32_t& latency);
+
+    struct LatencyWindow {
+        vector<uint32_t> samples;
+        uint32_t next; // oldest sample once the window is full
+
+        LatencyWindow() :
+                next(0) {
+        }
+    };
+
+    unordered_map<uint32_t, LatencyWindow> _windowMap;
+    mutex _trackerMutex;
+};
+
+#endif
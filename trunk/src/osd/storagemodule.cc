@@ -16,11 +16,14 @@
 #include <fcntl.h> /* Definition of AT_* constants */
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <dirent.h>
 #include "storagemodule.hh"
+#include "fileblockstore.hh"
+#include "extentblockstore.hh"
+#include "compactionscheduler.hh"
 #include "../common/debug.hh"
 #include "../common/define.hh"
 #include "../common/convertor.hh"
+#include "../common/enumtostring.hh"
 #include "../coding/coding.hh"
 
 // global variable defined in each component
@@ -32,7 +35,6 @@ mutex updateCacheMutex;
 mutex diskCacheMutex;
 
 StorageModule::StorageModule() {
-    _openedFile = new FileLruCache<string, FILE*>(MAX_OPEN_FILES);
     _segmentUploadCache = {};
     _segmentUpdateCache = {};
     _blockFolder = configLayer->getConfigString("Storage>BlockLocation");
@@ -44,6 +46,16 @@ StorageModule::StorageModule() {
         _reservedSpaceSize = 0; // important
     }
 
+    // only PLR keeps deltas in a reserve that needs merging
+    if (_updateScheme == PLR) {
+        _compactionScheduler = new CompactionScheduler(
+                [this](uint64_t segmentId, uint32_t blockId, bool isParity) {
+                    return compactBlock(segmentId, blockId, isParity);
+                });
+    } else {
+        _compactionScheduler = NULL;
+    }
+
     struct stat st;
     if (stat(_blockFolder.c_str(), &st) != 0) {
         debug("%s does not exist, make directory automatically\n",
@@ -58,16 +70,35 @@ StorageModule::StorageModule() {
     _maxBlockCapacity = stringToByte(
             configLayer->getConfigString("Storage>BlockCapacity"));
 
+    _ioEngine = IoEngine::createIoEngine();
+
+    // one file per block unless the extent store is configured, only the
+    // shared extent files gain from syncing the writers in rounds
+    BlockStoreType blockStoreType = FILE_BLOCK_STORE;
+    if (configLayer->getConfigInt("Storage>BlockStore") == EXTENT_BLOCK_STORE) {
+        blockStoreType = EXTENT_BLOCK_STORE;
+        _blockStore = new ExtentBlockStore(_blockFolder);
+        _groupCommit = new GroupCommit(_ioEngine);
+    } else {
+        _blockStore = new FileBlockStore(_blockFolder);
+        _groupCommit = NULL;
+    }
+
     cout << "=== STORAGE ===" << endl;
     cout << "Block Storage Location = " << _blockFolder << " Size = "
             << formatSize(_maxBlockCapacity) << endl;
+    cout << "Block Store = " << EnumToString::toString(blockStoreType) << endl;
+    cout << "I/O Engine = " << _ioEngine->getName() << endl;
     cout << "===============" << endl;
 
     initializeStorageStatus();
 }
 
 StorageModule::~StorageModule() {
-
+    delete _compactionScheduler;
+    delete _groupCommit;
+    delete _blockStore;
+    delete _ioEngine;
 }
 
 void StorageModule::initializeStorageStatus() {
@@ -76,53 +107,18 @@ void StorageModule::initializeStorageStatus() {
     // initialize segments
     //
 
-    _freeBlockSpace = _maxBlockCapacity;
-    _currentBlockUsage = 0;
-
-    struct dirent* dent;
-    DIR* srcdir;
-
     //
     // initialize blocks
     //
 
-    srcdir = opendir(_blockFolder.c_str());
-    if (srcdir == NULL) {
-        perror("opendir");
-        exit(-1);
-    }
-
-    while ((dent = readdir(srcdir)) != NULL) {
-        struct stat st;
-
-        if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
-            continue;
-
-        if (fstatat(dirfd(srcdir), dent->d_name, &st, 0) < 0) {
-            perror(dent->d_name);
-            continue;
-        }
-
-        // save file info
-        _freeBlockSpace -= (uint64_t)st.st_size;
-        _currentBlockUsage += (uint64_t)st.st_size;
-
-    }
-    closedir(srcdir);
+    _currentBlockUsage = _blockStore->getUsage();
+    _freeBlockSpace = _maxBlockCapacity - _currentBlockUsage;
 
     cout << "Block Storage Usage: " << formatSize(_currentBlockUsage) << "/"
             << formatSize(_maxBlockCapacity) << endl;
 
 }
 
-uint64_t StorageModule::getFilesize(string filepath) {
-
-    struct stat st;
-    stat(filepath.c_str(), &st);
-    return (uint64_t) st.st_size;
-
-}
-
 void StorageModule::createSegmentTransferCache(uint64_t segmentId, uint32_t segLength,
         uint32_t bufLength, DataMsgType dataMsgType, string updateKey) {
 
@@ -164,18 +160,16 @@ void StorageModule::createBlock(uint64_t segmentId, uint32_t blockId,
 
     const string blockKey = getBlockKey (segmentId, blockId);
 
-    const string filepath = generateBlockPath(segmentId, blockId, _blockFolder);
-
     debug(
-            "Block created ObjID = %" PRIu64 " BlockID = %" PRIu32 " Length = %" PRIu32 " Path = %s\n",
-            segmentId, blockId, length, filepath.c_str());
+            "Block created ObjID = %" PRIu64 " BlockID = %" PRIu32 " Length = %" PRIu32 "\n",
+            segmentId, blockId, length);
 
     // initialize delta information
     {
         RWMutex* rwmutex = obtainRWMutex(blockKey);
         writeLock wtlock(*rwmutex);
 
-        createFile(filepath);
+        _blockStore->create(segmentId, blockId, BLOCK_STORE_NO_DELTA, length);
 
         _deltaIdMap.set(blockKey, 0);
         _deltaLocationMap.set(blockKey, vector<DeltaLocation>());
@@ -192,18 +186,11 @@ void StorageModule::reserveBlockSpace(uint64_t segmentId, uint32_t blockId,
 
     const string blockKey = getBlockKey (segmentId, blockId);
 
-    const string filepath = generateBlockPath(segmentId, blockId, _blockFolder);
-
-    FILE* ptr = openFile(filepath);
-
     {
         RWMutex* rwmutex = obtainRWMutex(blockKey);
         writeLock wtlock(*rwmutex);
 
-        if (posix_fallocate (fileno (ptr), offset, reserveLength) < 0) {
-            debug_error ("Failed to reserve space: %s\n", filepath.c_str());
-            exit (-1);
-        }
+        _blockStore->reserve(segmentId, blockId, offset, reserveLength);
 
         ReserveSpaceInfo reserveSpaceInfo;
         reserveSpaceInfo.currentOffset = blockSize;
@@ -221,13 +208,11 @@ void StorageModule::createDeltaBlock(uint64_t segmentId, uint32_t blockId,
         return;
     }
 
-    const string filepath = generateDeltaBlockPath(segmentId, blockId, deltaId,
-            _blockFolder);
-    createFile(filepath);
+    _blockStore->create(segmentId, blockId, deltaId, 0);
 
     debug(
-            "Delta Block created ObjID = %" PRIu64 " BlockID = %" PRIu32 " DeltaID = %" PRIu32 " Path = %s\n",
-            segmentId, blockId, deltaId, filepath.c_str());
+            "Delta Block created ObjID = %" PRIu64 " BlockID = %" PRIu32 " DeltaID = %" PRIu32 "\n",
+            segmentId, blockId, deltaId);
 }
 
 uint32_t StorageModule::getDeltaCount (uint32_t segmentId, uint32_t blockId) {
@@ -247,10 +232,11 @@ uint32_t StorageModule::getNextDeltaId (uint32_t segmentId, uint32_t blockId) {
 struct BlockData StorageModule::readBlock(uint64_t segmentId, uint32_t blockId,
         vector<offset_length_t> symbols) {
 
+    markForegroundIo();
+
     uint32_t combinedLength = getCombinedLength(symbols);
 
     struct BlockData blockData;
-    string blockPath = generateBlockPath(segmentId, blockId, _blockFolder);
     blockData.info.segmentId = segmentId;
     blockData.info.blockId = blockId;
     blockData.info.blockSize = combinedLength;
@@ -258,16 +244,19 @@ struct BlockData StorageModule::readBlock(uint64_t segmentId, uint32_t blockId,
     blockData.buf = MemoryPool::getInstance().poolMalloc(combinedLength);
     char* bufptr = blockData.buf;
 
-    //uint32_t blockOffset = 0;
+    // read all symbols in one batch
+    vector<IoRequest> batch;
     for (auto offsetLengthPair : symbols) {
         uint32_t offset = offsetLengthPair.first;
         uint32_t length = offsetLengthPair.second;
         debug(
-                "READ BLOCK Symbol %s offset = %" PRIu32 " length = %" PRIu32 "\n",
-                blockPath.c_str(), offset, length);
-        readFile(blockPath, bufptr, offset, length, false);
+                "READ BLOCK Symbol %" PRIu64 ".%" PRIu32 " offset = %" PRIu32 " length = %" PRIu32 "\n",
+                segmentId, blockId, offset, length);
+        _blockStore->prepareRead(segmentId, blockId, BLOCK_STORE_NO_DELTA,
+                bufptr, offset, length, batch);
         bufptr += length;
     }
+    _ioEngine->execute(batch);
 
     debug("Segment ID = %" PRIu64 " Block ID = %" PRIu32 " read %zu symbols\n",
             segmentId, blockId, symbols.size());
@@ -297,15 +286,10 @@ BlockData StorageModule::doReadDelta(uint64_t segmentId, uint32_t blockId,
 
     string blockKey = getBlockKey(segmentId, blockId);
 
-    string blockPath;
-    if (isReserve) {
-        blockPath = generateBlockPath(segmentId, blockId, _blockFolder);
-    } else {
-        blockPath = generateDeltaBlockPath(segmentId, blockId, deltaId,
-                _blockFolder);
-    }
+    // deltas in the reserve are stored behind the block itself
+    const uint32_t storeDeltaId = isReserve ? BLOCK_STORE_NO_DELTA : deltaId;
 
-    debug ("Read delta from blockPath = %s\n", blockPath.c_str());
+    debug ("Read delta %" PRIu32 " isReserve = %d\n", deltaId, isReserve);
 
     string deltaKey = generateDeltaKey (segmentId, blockId, deltaId);
     vector<offset_length_t> offsetLength = _deltaOffsetLength.get(deltaKey);
@@ -321,12 +305,16 @@ BlockData StorageModule::doReadDelta(uint64_t segmentId, uint32_t blockId,
     blockData.buf = MemoryPool::getInstance().poolMalloc(combinedLength);
 
     // read whole delta block into memory
-    readFile(blockPath, blockData.buf, offset, combinedLength, false);
+    vector<IoRequest> batch;
+    _blockStore->prepareRead(segmentId, blockId, storeDeltaId, blockData.buf,
+            offset, combinedLength, batch);
+    _ioEngine->execute(batch);
 
     return blockData;
 }
 
 BlockData StorageModule::getBlock (uint64_t segmentId, uint32_t blockId, bool isParity, vector<offset_length_t> symbols, bool needLock) {
+    markForegroundIo();
     if (isParity) {
         if (_updateScheme == FO) {
             return readBlock(segmentId, blockId, symbols);
@@ -342,10 +330,60 @@ BlockData StorageModule::getBlock (uint64_t segmentId, uint32_t blockId, bool is
     }
 }
 
+bool StorageModule::getBlockFileRanges(uint64_t segmentId, uint32_t blockId,
+        bool isParity, vector<offset_length_t> symbols,
+        vector<BlockFileRange>& fileRanges) {
+
+#ifdef NO_WRITE
+    return false;
+#endif
+
+    // the lock is only held while the ranges are resolved, the ranges are
+    // sent later and the pin keeps them unchanged until then
+    vector<IoRequest> batch;
+    {
+        readLock rdlock(*obtainRWMutex(getBlockKey(segmentId, blockId)));
+
+        // only blocks that getBlock reads as stored, deltas need a merge
+        const bool isMerged = isParity ?
+                _updateScheme != FO : _updateScheme == FL;
+        if (isMerged || getDeltaCount(segmentId, blockId) > 0) {
+            return false;
+        }
+
+        markForegroundIo();
+
+        if (!_blockStore->pinRanges(segmentId, blockId, symbols, batch)) {
+            return false;
+        }
+    }
+
+    // released from the sender thread after the last range is sent
+    BlockStore* blockStore = _blockStore;
+    shared_ptr<void> pin(blockStore, [segmentId, blockId](BlockStore* store) {
+        store->unpin(segmentId, blockId);
+    });
+
+    // the descriptors go to the caller, shared ones are duplicated
+    for (const IoRequest& request : batch) {
+        BlockFileRange fileRange;
+        fileRange.fd = request.ownsFd ? request.fd : dup(request.fd);
+        if (fileRange.fd < 0) {
+            perror("dup");
+            exit(-1);
+        }
+        fileRange.offset = request.offset;
+        fileRange.length = request.length;
+        fileRange.pin = pin;
+        fileRanges.push_back(fileRange);
+    }
+
+    return true;
+}
+
 // this function is only thread-safe when needLock == true
 BlockData StorageModule::getMergedBlock (uint64_t segmentId, uint32_t blockId, bool isParity, bool needLock) {
 
-    const string blockPath = generateBlockPath(segmentId, blockId, _blockFolder);
     const string blockKey = getBlockKey (segmentId, blockId);
 
     RWMutex* rwmutex = obtainRWMutex(blockKey);
@@ -371,35 +409,48 @@ BlockData StorageModule::getMergedBlock (uint64_t segmentId, uint32_t blockId, b
             "Getting merged block for segment ID %" PRIu64 " block ID %" PRIu32 " isParity = %d blockSize = %" PRIu32 " deltaCount = %" PRIu32 "\n",
             segmentId, blockId, isParity, blockData.info.blockSize, deltaCount);
 
-    // read block + reserve to wholeBuf
+    // read block + reserve to wholeBuf, and the delta blocks, in one batch
     const uint32_t byteToRead = _reserveSpaceMap.get(blockKey).currentOffset;
     char* wholeBuf = MemoryPool::getInstance().poolMalloc(byteToRead);
-    readFile(blockPath, wholeBuf, 0, byteToRead, false);
+    vector<IoRequest> batch;
+    _blockStore->prepareRead(segmentId, blockId, BLOCK_STORE_NO_DELTA,
+            wholeBuf, 0, byteToRead, batch);
+
+    const vector<DeltaLocation> deltaLocationList = _deltaLocationMap.get(blockKey);
+    vector<BlockData> deltaList (deltaLocationList.size());
+    for (uint32_t i = 0; i < deltaLocationList.size(); i++) {
+        const uint32_t deltaId = deltaLocationList[i].deltaId;
+        string deltaKey = generateDeltaKey (segmentId, blockId, deltaId);
+        vector<offset_length_t> offsetLength = _deltaOffsetLength.get(deltaKey);
+        uint32_t combinedLength = getCombinedLength(offsetLength);
+
+        BlockData& delta = deltaList[i];
+        delta.info.segmentId = segmentId;
+        delta.info.blockId = blockId;
+        delta.info.blockSize = combinedLength; // size of delta
+        delta.info.offlenVector = offsetLength;
+        delta.buf = MemoryPool::getInstance().poolMalloc(combinedLength);
+
+        // delta in reserved space is copied from wholeBuf after the read
+        if (deltaLocationList[i].isReserveSpace) {
+            debug ("Reading from Reserve Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 "\n", segmentId, blockId, deltaId);
+        } else {
+            debug ("Reading from Delta Block Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 "\n", segmentId, blockId, deltaId);
+            _blockStore->prepareRead(segmentId, blockId, deltaId, delta.buf, 0,
+                    combinedLength, batch);
+        }
+    }
+    _ioEngine->execute(batch);
 
     // copy to blockData part
     blockData.buf = MemoryPool::getInstance().poolMalloc(blockData.info.blockSize);
     memcpy (blockData.buf, wholeBuf, blockData.info.blockSize);
 
     // for each delta block, merge into parity for each <offset, length> using XOR
-    BlockData delta;
-    for (DeltaLocation deltaLocation : _deltaLocationMap.get(blockKey)) {
-        const uint32_t deltaId = deltaLocation.deltaId;
-
-        // read from reserved space if delta is inside
-        if (deltaLocation.isReserveSpace) {
-            debug ("Reading from Reserve Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 "\n", segmentId, blockId, deltaId);
-            string deltaKey = generateDeltaKey (segmentId, blockId, deltaId);
-            vector<offset_length_t> offsetLength = _deltaOffsetLength.get(deltaKey);
-            uint32_t combinedLength = getCombinedLength(offsetLength);
-            delta.info.segmentId = segmentId;
-            delta.info.blockId = blockId;
-            delta.info.blockSize = combinedLength; // size of delta
-            delta.info.offlenVector = offsetLength;
-            delta.buf = MemoryPool::getInstance().poolMalloc(combinedLength);
-            memcpy (delta.buf, wholeBuf + deltaLocation.offsetLength.first, combinedLength);
-        } else {
-            debug ("Reading from Delta Block Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 "\n", segmentId, blockId, deltaId);
-            delta = readDeltaBlock(segmentId, blockId, deltaId);
+    for (uint32_t i = 0; i < deltaLocationList.size(); i++) {
+        BlockData& delta = deltaList[i];
+        if (deltaLocationList[i].isReserveSpace) {
+            memcpy (delta.buf, wholeBuf + deltaLocationList[i].offsetLength.first, delta.info.blockSize);
         }
 
         // perform merging
@@ -425,7 +476,6 @@ BlockData StorageModule::getMergedBlock (uint64_t segmentId, uint32_t blockId, b
 void StorageModule::mergeBlock (uint64_t segmentId, uint32_t blockId, bool isParity) {
 
     const string blockKey = getBlockKey (segmentId, blockId);
-    const string blockPath = generateBlockPath(segmentId, blockId, _blockFolder);
     uint32_t deltaCount = getDeltaCount(segmentId, blockId);
     debug ("Merge Block deltaCount = %" PRIu32 "\n", deltaCount);
     if (deltaCount == 0) {
@@ -436,28 +486,27 @@ void StorageModule::mergeBlock (uint64_t segmentId, uint32_t blockId, bool isPar
     BlockData blockData = getMergedBlock(segmentId, blockId, isParity, false);
 
     // save the whole merged parity into disk
-    updateBlock(segmentId, blockId, blockData);
-    tryCloseFile(blockPath);
+    updateBlock(segmentId, blockId, blockData, false);
+    _blockStore->close(segmentId, blockId, BLOCK_STORE_NO_DELTA);
 
     MemoryPool::getInstance().poolFree(blockData.buf);
 
     // remove deltas which are not in reserve
-    vector<DeltaLocation> &deltaLocationList = _deltaLocationMap.get(blockKey);
+    vector<DeltaLocation> deltaLocationList = _deltaLocationMap.get(blockKey);
     for (DeltaLocation deltaLocation : deltaLocationList) {
         if (!deltaLocation.isReserveSpace) {
-            const string deltaBlockPath = generateDeltaBlockPath(segmentId, blockId, deltaLocation.deltaId,
-                    _blockFolder);
-
             // remove delta from disk
-            tryCloseFile(deltaBlockPath);
-            remove(deltaBlockPath.c_str());
+            _blockStore->remove(segmentId, blockId, deltaLocation.deltaId);
         }
     }
 
     // remove all delta information
-    deltaLocationList.clear();
-    _reserveSpaceMap.get(blockKey).remainingReserveSpace = _reservedSpaceSize;
-    _reserveSpaceMap.get(blockKey).currentOffset = blockData.info.blockSize;
+    _deltaLocationMap.update(blockKey,
+            [](vector<DeltaLocation>& list) {list.clear();});
+    _reserveSpaceMap.update(blockKey, [&](ReserveSpaceInfo& info) {
+        info.remainingReserveSpace = _reservedSpaceSize;
+        info.currentOffset = blockData.info.blockSize;
+    });
 }
 
 uint32_t StorageModule::writeSegmentTransferCache(uint64_t segmentId, char* buf,
@@ -499,14 +548,19 @@ uint32_t StorageModule::writeSegmentTransferCache(uint64_t segmentId, char* buf,
 uint32_t StorageModule::writeBlock(uint64_t segmentId, uint32_t blockId,
         char* buf, uint64_t offsetInBlock, uint32_t length) {
 
+    markForegroundIo();
+
     const string blockKey = getBlockKey (segmentId, blockId);
     RWMutex* rwmutex = obtainRWMutex(blockKey);
     writeLock wtlock(*rwmutex);
 
     uint32_t byteWritten = 0;
 
-    string filepath = generateBlockPath(segmentId, blockId, _blockFolder);
-    byteWritten = writeFile(filepath, buf, offsetInBlock, length, false);
+    vector<IoRequest> batch;
+    _blockStore->prepareWrite(segmentId, blockId, BLOCK_STORE_NO_DELTA, buf,
+            offsetInBlock, length, batch);
+    _ioEngine->execute(batch);
+    byteWritten = length;
 
     debug(
             "Segment ID = %" PRIu64 " Block ID = %" PRIu32 " write %" PRIu32 " bytes at offset %" PRIu64 "\n",
@@ -520,6 +574,8 @@ uint32_t StorageModule::writeBlock(uint64_t segmentId, uint32_t blockId,
 uint32_t StorageModule::writeDeltaBlock(uint64_t segmentId, uint32_t blockId,
         uint32_t deltaId, char* buf, vector<offset_length_t> offsetLength, bool isParity) {
 
+    markForegroundIo();
+
     const string blockKey = getBlockKey (segmentId, blockId);
     RWMutex* rwmutex = obtainRWMutex(blockKey);
     writeLock wtlock(*rwmutex);
@@ -539,19 +595,23 @@ uint32_t StorageModule::writeDeltaBlock(uint64_t segmentId, uint32_t blockId,
     const string deltaKey = generateDeltaKey (segmentId, blockId, deltaId);
     const uint32_t combinedLength = getCombinedLength(offsetLength);
 
-    ReserveSpaceInfo &reserveSpaceInfo = _reserveSpaceMap.get(blockKey);
+    ReserveSpaceInfo reserveSpaceInfo = _reserveSpaceMap.get(blockKey);
 
     DeltaLocation deltaLocation;
     deltaLocation.blockId = blockId;
     deltaLocation.deltaId = deltaId;
 
     uint32_t currentOffset = 0;
-    string filepath = "";
+    uint32_t storeDeltaId = BLOCK_STORE_NO_DELTA;
     if (isParity && combinedLength <= _reservedSpaceSize) {
         if (reserveSpaceInfo.remainingReserveSpace < combinedLength) {
-            // merge existing block and write again
+            // merge existing block and write again, compaction fell behind
             debug ("need merge remaining = %" PRIu32 " length = %" PRIu32 " deltaId = %" PRIu32 "\n", reserveSpaceInfo.remainingReserveSpace, combinedLength, deltaId);
             mergeBlock(segmentId, blockId, true);
+            if (_compactionScheduler != NULL) {
+                _compactionScheduler->recordMerge(segmentId, blockId, true);
+            }
+            reserveSpaceInfo = _reserveSpaceMap.get(blockKey);
 
 #ifdef LATENCY_TEST
             typedef chrono::high_resolution_clock Clock;
@@ -561,15 +621,14 @@ uint32_t StorageModule::writeDeltaBlock(uint64_t segmentId, uint32_t blockId,
         }
 
         currentOffset = reserveSpaceInfo.currentOffset;
-        filepath = generateBlockPath(segmentId, blockId, _blockFolder);
+        storeDeltaId = BLOCK_STORE_NO_DELTA;
         deltaLocation.offsetLength = make_pair(currentOffset, combinedLength);
         deltaLocation.isReserveSpace = true;
         debug ("block %" PRIu32 " written to reserve\n", blockId);
     } else {    // data block or delta too large
         createDeltaBlock(segmentId, blockId, deltaId, false);
         currentOffset = 0;
-        filepath = generateDeltaBlockPath(segmentId, blockId, deltaId,
-                _blockFolder);
+        storeDeltaId = deltaId;
         deltaLocation.offsetLength = make_pair(0, combinedLength);
         deltaLocation.isReserveSpace = false;
         debug ("block %" PRIu32 " written to delta\n", blockId);
@@ -578,7 +637,11 @@ uint32_t StorageModule::writeDeltaBlock(uint64_t segmentId, uint32_t blockId,
     uint32_t byteWritten = 0;
 
     // write delta block
-    byteWritten = writeFile(filepath, buf, currentOffset, combinedLength, false);
+    vector<IoRequest> batch;
+    _blockStore->prepareWrite(segmentId, blockId, storeDeltaId, buf,
+            currentOffset, combinedLength, batch);
+    _ioEngine->execute(batch);
+    byteWritten = combinedLength;
 
     debug(
             "Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Delta ID = %" PRIu32 " write %" PRIu32 " bytes\n",
@@ -588,31 +651,96 @@ uint32_t StorageModule::writeDeltaBlock(uint64_t segmentId, uint32_t blockId,
 
     // if stored in reserve space
     if (deltaLocation.isReserveSpace) {
-        reserveSpaceInfo.currentOffset += combinedLength;
-        reserveSpaceInfo.remainingReserveSpace -= combinedLength;
+        _reserveSpaceMap.update(blockKey, [&](ReserveSpaceInfo& info) {
+            info.currentOffset += combinedLength;
+            info.remainingReserveSpace -= combinedLength;
+        });
     }
 
     _deltaOffsetLength.set(deltaKey, offsetLength);
-    _deltaLocationMap.get(blockKey).push_back(deltaLocation);
+    _deltaLocationMap.upsert(blockKey,
+            [&](vector<DeltaLocation>& list) {list.push_back(deltaLocation);});
+
+    if (_compactionScheduler != NULL && isParity) {
+        const uint32_t remainingReserveSpace =
+                _reserveSpaceMap.get(blockKey).remainingReserveSpace;
+        const uint32_t reserveUsedPercent = _reservedSpaceSize ?
+                (_reservedSpaceSize - remainingReserveSpace) * 100
+                        / _reservedSpaceSize : 100;
+        _compactionScheduler->recordDelta(segmentId, blockId, isParity,
+                getDeltaCount(segmentId, blockId), combinedLength,
+                reserveUsedPercent);
+    }
 
     return byteWritten;
 }
 
+uint64_t StorageModule::compactBlock(uint64_t segmentId, uint32_t blockId,
+        bool isParity) {
+
+    const string blockKey = getBlockKey (segmentId, blockId);
+    RWMutex* rwmutex = obtainRWMutex(blockKey);
+    writeLock wtlock(*rwmutex);
+
+    // block + reserve are read, the block is written back
+    uint64_t byteMerged = 0;
+    if (getDeltaCount(segmentId, blockId) > 0) {
+        const ReserveSpaceInfo reserveSpaceInfo = _reserveSpaceMap.get(blockKey);
+        byteMerged = (uint64_t) reserveSpaceInfo.currentOffset
+                + reserveSpaceInfo.blockSize;
+        mergeBlock(segmentId, blockId, isParity);
+    }
+    _compactionScheduler->recordMerge(segmentId, blockId, false);
+
+    return byteMerged;
+}
+
+void StorageModule::printGroupCommitStat() {
+    if (_groupCommit != NULL) {
+        _groupCommit->printStat();
+    } else {
+        cout << "Group Commit: off" << endl;
+    }
+}
+
+void StorageModule::printCompactionStat() {
+    if (_compactionScheduler != NULL) {
+        _compactionScheduler->printStat();
+    }
+}
+
+void StorageModule::markForegroundIo() {
+    if (_compactionScheduler != NULL) {
+        _compactionScheduler->recordForegroundIo();
+    }
+}
+
 uint32_t StorageModule::updateBlock(uint64_t segmentId, uint32_t blockId,
-        BlockData blockData) {
+        BlockData blockData, bool needLock) {
+
+    // readers resolving the block see it either before or after the update
+    RWMutex* rwmutex = obtainRWMutex(getBlockKey(segmentId, blockId));
+    writeLock wtlock(*rwmutex, boost::defer_lock);
+    if (needLock) {
+        wtlock.lock();
+    }
 
     uint32_t byteWritten = 0;
     uint32_t curOffset = 0;
 
-    string filepath = generateBlockPath(segmentId, blockId, _blockFolder);
+    // write all ranges in one batch
+    vector<IoRequest> batch;
 
     for (offset_length_t offsetLength : blockData.info.offlenVector) {
         debug("Update block offset %" PRIu32 " length %" PRIu32 "\n",
                 offsetLength.first, offsetLength.second);
-        byteWritten += writeFile(filepath, blockData.buf + curOffset,
-                offsetLength.first, offsetLength.second, false);
+        _blockStore->prepareWrite(segmentId, blockId, BLOCK_STORE_NO_DELTA,
+                blockData.buf + curOffset, offsetLength.first,
+                offsetLength.second, batch);
+        byteWritten += offsetLength.second;
         curOffset += offsetLength.second;
     }
+    _ioEngine->execute(batch);
     return byteWritten;
 }
 
@@ -647,195 +775,39 @@ void StorageModule::closeSegmentTransferCache(uint64_t segmentId,
     debug("Segment Cache ID = %" PRIu64 " closed\n", segmentId);
 }
 
-void StorageModule::flushFile(string filePath) {
-    FILE* filePtr = NULL;
-    try {
-        filePtr = _openedFile->get(filePath);
-        fflush(filePtr);
+void StorageModule::flushBlock(uint64_t segmentId, uint32_t blockId) {
 #ifdef USE_FSYNC
-        fsync(fileno(filePtr));
+    vector<IoRequest> syncList;
+    _blockStore->prepareSync(segmentId, blockId, BLOCK_STORE_NO_DELTA,
+            syncList);
+    syncFiles(syncList);
 #endif
-    } catch (out_of_range& oor) { // file pointer not found in cache
-        return; // file already closed by cache, do nothing
-    }
-    return;
-}
-
-
-void StorageModule::flushBlock(uint64_t segmentId, uint32_t blockId) {
-
-    string filepath = generateBlockPath(segmentId, blockId, _blockFolder);
-    flushFile(filepath);
 }
 
 void StorageModule::flushDeltaBlock(uint64_t segmentId, uint32_t blockId, uint32_t deltaId, bool isParity) {
-
-    string filepath = generateDeltaBlockPath(segmentId, blockId, deltaId, _blockFolder);
-    flushFile(filepath);
-}
-
-uint32_t StorageModule::readFile(string filepath, char* buf, uint64_t offset,
-        uint32_t length, bool isCache, int priority) {
-
-// cache and segment share different mutex
-    //lock_guard<mutex> lk(fileMutex[isCache]);
-
-    debug("Read File :%s\n", filepath.c_str());
-
-    FILE* file = openFile(filepath);
-
-    if (file == NULL) { // cannot open file
-        debug("%s\n", "Cannot read");
-        perror("open");
-        exit(-1);
-    }
-
-#ifndef NO_WRITE
-// Read file contents into buffer
-    uint32_t byteRead = pread(fileno(file), buf, length, offset);
-#else
-	uint32_t byteRead = length;
-#endif
-
-    if (byteRead != length) {
-        debug_error(
-                "ERROR: Length = %" PRIu32 ", Offset = %" PRIu64 ", byteRead = %" PRIu32 "\n",
-                length, offset, byteRead);
-        perror("pread()");
-        exit(-1);
-    }
-
-    return byteRead;
-}
-
-uint32_t StorageModule::writeFile(string filepath, char* buf, uint64_t offset,
-        uint32_t length, bool isCache, int priority) {
-
-// cache and segment share different mutex
-    //lock_guard<mutex> lk(fileMutex[isCache]);
-
-    FILE* file = openFile(filepath);
-
-    if (file == NULL) { // cannot open file
-        debug("%s\n", "Cannot write");
-        perror("open");
-        exit(-1);
-    }
-
-#ifndef NO_WRITE
-// Write file contents from buffer
-    uint32_t byteWritten = pwrite(fileno(file), buf, length, offset);
-#else
-	uint32_t byteWritten = length;
-#endif
-
-    if (byteWritten != length) {
-        debug_error("ERROR: Length = %d, byteWritten = %d\n", length,
-                byteWritten);
-        exit(-1);
-    }
-
-    return byteWritten;
-}
-
-string StorageModule::generateBlockPath(uint64_t segmentId, uint32_t blockId,
-        string blockFolder) {
-
-// append a '/' if not present
-    if (blockFolder[blockFolder.length() - 1] != '/') {
-        blockFolder.append("/");
-    }
-
-    return blockFolder + to_string(segmentId) + "." + to_string(blockId);
-}
-
-string StorageModule::generateDeltaBlockPath(uint64_t segmentId,
-        uint32_t blockId, uint32_t deltaId, string blockFolder) {
-
-// append a '/' if not present
-    if (blockFolder[blockFolder.length() - 1] != '/') {
-        blockFolder.append("/");
-    }
-
-    return blockFolder + to_string(segmentId) + "." + to_string(blockId) + "."
-            + to_string(deltaId);
-}
-
-/**
- * Create and open a new file
- */
-
-FILE* StorageModule::createFile(string filepath) {
-
-// open file for read/write
-// create new if not exist
-    FILE* filePtr;
-    try {
-        filePtr = _openedFile->get(filepath);
-    } catch (out_of_range& oor) { // file pointer not found in cache
-        filePtr = fopen(filepath.c_str(), "wb+");
-        debug("OPEN1: %s\n", filepath.c_str());
-
-        if (filePtr == NULL) {
-            debug("%s\n", "Unable to create file!");
-            return NULL;
-        }
-
-        // set buffer to zero to avoid memory leak
-        //setvbuf(filePtr, NULL, _IONBF, 0);
-
-        // add file pointer to map
-        _openedFile->insert(filepath, filePtr);
-
-        /*
-         openedFileMutex.lock();
-         _openedFile[filepath] = filePtr;
-         openedFileMutex.unlock();
-         */
-    }
-
-    return filePtr;
-}
-
-/**
- * Open an existing file, return pointer directly if file is already open
- */
-
-FILE* StorageModule::openFile(string filepath) {
-
-    FILE* filePtr = NULL;
-    try {
-        filePtr = _openedFile->get(filepath);
-    } catch (out_of_range& oor) { // file pointer not found in cache
-        filePtr = fopen(filepath.c_str(), "rb+");
-        debug("OPEN2: %s\n", filepath.c_str());
-
-        if (filePtr == NULL) {
-            debug("Unable to open file at %s\n", filepath.c_str());
-            perror("fopen()");
-            return NULL;
+#ifdef USE_FSYNC
+    const string blockKey = getBlockKey (segmentId, blockId);
+    vector<IoRequest> syncList;
+    {
+        RWMutex* rwmutex = obtainRWMutex(blockKey);
+        readLock rdlock(*rwmutex);
+
+        // a delta in the reserve space or already merged lives in the block
+        uint32_t storeDeltaId = BLOCK_STORE_NO_DELTA;
+        vector<DeltaLocation> deltaLocationList;
+        if (_deltaLocationMap.find(blockKey, deltaLocationList)) {
+            for (const DeltaLocation& deltaLocation : deltaLocationList) {
+                if (deltaLocation.deltaId == deltaId
+                        && !deltaLocation.isReserveSpace) {
+                    storeDeltaId = deltaId;
+                    break;
+                }
+            }
         }
-
-        // set buffer to zero to avoid memory leak
-        // setvbuf(filePtr, NULL, _IONBF, 0);
-
-        // add file pointer to map
-        _openedFile->insert(filepath, filePtr);
-    }
-
-    return filePtr;
-}
-
-void StorageModule::tryCloseFile(string filepath) {
-    FILE* filePtr = NULL;
-    try {
-        filePtr = _openedFile->get(filepath);
-        fclose(filePtr);
-        debug("CLOSE1: %s\n", filepath.c_str());
-        _openedFile->remove(filepath);
-    } catch (out_of_range& oor) { // file pointer not found in cache
-        return;
+        _blockStore->prepareSync(segmentId, blockId, storeDeltaId, syncList);
     }
+    syncFiles(syncList);
+#endif
 }
 
 struct SegmentData StorageModule::getSegmentTransferCache(uint64_t segmentId,
@@ -905,6 +877,14 @@ uint32_t StorageModule::getCombinedLength(vector<offset_length_t> offsetLength)
 }
 
 
+void StorageModule::syncFiles(const vector<IoRequest>& syncList) {
+    if (_groupCommit != NULL) {
+        _groupCommit->commit(syncList);
+    } else {
+        _ioEngine->execute(syncList);
+    }
+}
+
 RWMutex* StorageModule::obtainRWMutex(string blockKey) {
     // obtain rwmutex for this segment
     _deltaRWMutexMapMutex.lock();
@@ -11,9 +11,11 @@
 #include "../common/memorypool.hh"
 #include "../common/blockdata.hh"
 #include "../common/segmentdata.hh"
-#include "../datastructure/concurrentmap.hh"
+#include "../datastructure/concurrenthashmap.hh"
 #include "../common/enums.hh"
-#include "filelrucache.hh"
+#include "blockstore.hh"
+#include "compactionscheduler.hh"
+#include "groupcommit.hh"
 #include "reservespaceinfo.hh"
 #include "deltalocation.hh"
 
@@ -87,6 +89,23 @@ public:
     BlockData getBlock(uint64_t segmentId, uint32_t blockId, bool isParity,
             vector<offset_length_t> symbols, bool needLock);
 
+    /**
+     * Locate symbols of a block in the files holding them, to be sent
+     * without reading them into memory. The caller closes the descriptors.
+     * The ranges pin the block in the BlockStore until the last copy of
+     * them is released, so writes meanwhile do not change the sent bytes
+     * @param segmentId Segment ID
+     * @param blockId Block ID
+     * @param isParity Whether the block is a parity block
+     * @param symbols A list of <offset, length> tuples
+     * @param fileRanges Ranges of the files holding the symbols, in order
+     * @return false if the block has to be read with getBlock
+     */
+
+    bool getBlockFileRanges(uint64_t segmentId, uint32_t blockId,
+            bool isParity, vector<offset_length_t> symbols,
+            vector<BlockFileRange>& fileRanges);
+
     /**
      * Read symbols from a block
      * @param segmentId Segment ID
@@ -141,11 +160,13 @@ public:
      * @param segmentId Segment ID
      * @param blockId Block ID
      * @param blockData BlockData struct
+     * @param needLock Whether to take the block lock (false if the caller
+     * has it)
      * @return Number of bytes written
      */
 
     uint32_t updateBlock(uint64_t segmentId, uint32_t blockId,
-            BlockData blockData);
+            BlockData blockData, bool needLock = true);
 
     /**
      * Close and remove the segment cache after the transfer is finished
@@ -155,8 +176,6 @@ public:
     void closeSegmentTransferCache(uint64_t segmentId, DataMsgType dataMsgType,
             string updateKey);
 
-    void flushFile(string filepath);
-
     struct SegmentData getSegmentTransferCache(uint64_t segmentId,
             DataMsgType dataMsgType, string updateKey = "");
 
@@ -209,6 +228,18 @@ public:
 
     static uint32_t getCombinedLength(vector<offset_length_t> offsetLength);
 
+    /**
+     * Print the backlog of the background compaction (PLR only)
+     */
+
+    void printCompactionStat();
+
+    /**
+     * Print the rounds and syncs of the group commit
+     */
+
+    void printGroupCommitStat();
+
 private:
 
     /**
@@ -223,74 +254,30 @@ private:
     void updateBlockFreespace(uint32_t size);
 
     /**
-     * Open a file and read data to buffer
-     * @param filepath Path of the file in the storage
-     * @param buf Pointer to destination buffer (already malloc-ed)
-     * @param offset Offset in the file
-     * @param length Length to read
-     * @return Number of bytes read
-     */
-
-    uint32_t readFile(string filepath, char* buf, uint64_t offset,
-            uint32_t length, bool isCache, int priority = 10);
-
-    /**
-     * Open a file and write data from buffer
-     * @param filepath Path of the file in the storage
-     * @param buf Pointer to source buffer
-     * @param offset Offset in the file
-     * @param length Length to write
-     * @return Number of bytes written
-     */
-
-    uint32_t writeFile(string filepath, char* buf, uint64_t offset,
-            uint32_t length, bool isCache, int priority = 10);
-
-    /**
-     * Return the block path given Segment ID and Block ID
+     * Merge the deltas of a block for the compaction scheduler
      * @param segmentId Segment ID
      * @param blockId Block ID
-     * @param blockFolder Location where blocks are stored
-     * @return filepath of the block in the filesystem
+     * @param isParity Whether the block is a parity block
+     * @return Bytes read and written by the merge
      */
 
-    string generateBlockPath(uint64_t segmentId, uint32_t blockId,
-            string blockFolder);
-    string generateDeltaBlockPath(uint64_t segmentId, uint32_t blockId,
-            uint32_t deltaId, string blockFolder);
+    uint64_t compactBlock(uint64_t segmentId, uint32_t blockId, bool isParity);
 
     /**
-     * Create a file on disk and open it
-     * @param filepath Path of the file on storage
-     * @return Pointer to the opened file
+     * Tell the compaction scheduler that foreground I/O is running
      */
 
-    FILE* createFile(string filepath);
+    void markForegroundIo();
 
-    /**
-     * Retrieve the opened file pointer if file is already open
-     * Open the file on disk if file is not already open
-     * @param filepath Path to the file on disk
-     * @return Pointer to the opened file
-     */
-
-    FILE* openFile(string filepath);
-
-    /**
-     * Try to close the file before remove
-     * @param filepath Path to the file on disk
-     */
-
-    void tryCloseFile(string filepath);
+    RWMutex* obtainRWMutex(string blockKey);
 
     /**
-     * Open the file and finds the size of it
-     * @param filepath Path to the file on disk
-     * @return Size of the file
+     * Sync the files of a write, in a group commit round with the extent
+     * block store, right away with the file block store
+     * @param syncList IO_SYNC requests covering the write
      */
-    uint64_t getFilesize(string filepath);
 
-    RWMutex* obtainRWMutex(string blockKey);
+    void syncFiles(const vector<IoRequest>& syncList);
 
 //    DeltaLocation getDeltaLocation (uint64_t segmentId, uint32_t blockId, uint32_t deltaId);
     string getBlockKey(uint64_t segmentId, uint32_t blockId);
@@ -298,7 +285,10 @@ private:
     string generateDeltaKey(uint64_t segmentId, uint32_t blockId,
             uint32_t deltaId);
 
-    FileLruCache<string, FILE*>* _openedFile;
+    BlockStore* _blockStore;
+    IoEngine* _ioEngine;
+    GroupCommit* _groupCommit; // NULL with the file block store
+    CompactionScheduler* _compactionScheduler;
     map<uint64_t, struct SegmentData> _segmentUploadCache;
     map<string, struct SegmentData> _segmentUpdateCache;
     string _blockFolder;
@@ -307,10 +297,10 @@ private:
     atomic<uint64_t> _freeBlockSpace;
     atomic<uint64_t> _currentBlockUsage;
 
-    ConcurrentMap<string, uint32_t> _deltaIdMap;
-    ConcurrentMap<string, vector<offset_length_t>> _deltaOffsetLength;
-    ConcurrentMap<string, vector<DeltaLocation>> _deltaLocationMap;
-    ConcurrentMap<string, ReserveSpaceInfo> _reserveSpaceMap;
+    ConcurrentHashMap<string, uint32_t> _deltaIdMap;
+    ConcurrentHashMap<string, vector<offset_length_t>> _deltaOffsetLength;
+    ConcurrentHashMap<string, vector<DeltaLocation>> _deltaLocationMap;
+    ConcurrentHashMap<string, ReserveSpaceInfo> _reserveSpaceMap;
 
     unordered_map<string, boost::shared_mutex*> _deltaRWMutexMap;
     mutex _deltaRWMutexMapMutex;
@@ -0,0 +1,255 @@
+/*
+ * uringioengine.cc
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uringioengine.hh"
+#include "../common/debug.hh"
+
+static int ioUringSetup(uint32_t entries, struct io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ringFd, uint32_t toSubmit, uint32_t minComplete,
+        uint32_t flags) {
+    return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags,
+            NULL, 0);
+}
+
+bool UringIoEngine::isSupported() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ringFd = ioUringSetup(1, &params);
+    if (ringFd < 0) {
+        return false;
+    }
+    close(ringFd);
+    return true;
+}
+
+UringIoEngine::UringIoEngine(uint32_t depth) {
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    _ringFd = ioUringSetup(depth, &params);
+    if (_ringFd < 0) {
+        perror("io_uring_setup");
+        exit(-1);
+    }
+    _sqEntries = params.sq_entries;
+    _cqEntries = params.cq_entries;
+
+    // map the submission ring, the completion ring and the entries
+    _sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _cqSize = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool isSingleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (isSingleMmap) {
+        _sqSize = _cqSize = max(_sqSize, _cqSize);
+    }
+
+    _sqPtr = mmap(NULL, _sqSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+    if (_sqPtr == MAP_FAILED) {
+        perror("mmap");
+        exit(-1);
+    }
+    if (isSingleMmap) {
+        _cqPtr = _sqPtr;
+    } else {
+        _cqPtr = mmap(NULL, _cqSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+        if (_cqPtr == MAP_FAILED) {
+            perror("mmap");
+            exit(-1);
+        }
+    }
+    _sqes = (struct io_uring_sqe*) mmap(NULL,
+            params.sq_entries * sizeof(struct io_uring_sqe),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd,
+            IORING_OFF_SQES);
+    if (_sqes == MAP_FAILED) {
+        perror("mmap");
+        exit(-1);
+    }
+
+    char* sq = (char*) _sqPtr;
+    _sqHead = (uint32_t*) (sq + params.sq_off.head);
+    _sqTail = (uint32_t*) (sq + params.sq_off.tail);
+    _sqMask = (uint32_t*) (sq + params.sq_off.ring_mask);
+    _sqArray = (uint32_t*) (sq + params.sq_off.array);
+    char* cq = (char*) _cqPtr;
+    _cqHead = (uint32_t*) (cq + params.cq_off.head);
+    _cqTail = (uint32_t*) (cq + params.cq_off.tail);
+    _cqMask = (uint32_t*) (cq + params.cq_off.ring_mask);
+    _cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    _inflight = 0;
+    _pending = 0;
+    _isRunning = true;
+    _completionThread = thread(&UringIoEngine::completionLoop, this);
+}
+
+UringIoEngine::~UringIoEngine() {
+    {
+        // a no-op wakes the completion thread up to see the stop
+        lock_guard<mutex> lk(_submitMutex);
+        _isRunning = false;
+        pushEntry(NULL);
+        _inflight++;
+        flushEntries();
+    }
+    _completionThread.join();
+
+    munmap(_sqes, _sqEntries * sizeof(struct io_uring_sqe));
+    if (_cqPtr != _sqPtr) {
+        munmap(_cqPtr, _cqSize);
+    }
+    munmap(_sqPtr, _sqSize);
+    close(_ringFd);
+}
+
+void UringIoEngine::submit(const vector<IoRequest>& batch,
+        function<void(int32_t)> callback) {
+
+    if (batch.empty()) {
+        callback(0);
+        return;
+    }
+
+    IoBatch* ioBatch = createBatch(batch.size(), callback);
+
+    unique_lock<mutex> lk(_submitMutex);
+    for (const IoRequest& request : batch) {
+        // never hold more operations than the completion ring can take
+        while (_inflight >= _cqEntries) {
+            flushEntries();
+            _spaceCond.wait(lk);
+        }
+        UringOp* op = new UringOp();
+        op->request = request;
+        op->ioBatch = ioBatch;
+        op->done = 0;
+        op->iov.iov_base = request.buf;
+        op->iov.iov_len = request.length;
+        pushEntry(op);
+        _inflight++;
+    }
+    flushEntries();
+}
+
+void UringIoEngine::pushEntry(UringOp* op) {
+
+    uint32_t tail = *_sqTail;
+    if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) == _sqEntries) {
+        flushEntries();
+    }
+
+    const uint32_t index = tail & *_sqMask;
+    struct io_uring_sqe* sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    if (op == NULL) {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+    } else if (op->request.type == IO_SYNC) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = op->request.fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = (uint64_t) op;
+    } else {
+        sqe->opcode =
+                op->request.type == IO_WRITE ?
+                        IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = op->request.fd;
+        sqe->addr = (uint64_t) &op->iov;
+        sqe->len = 1;
+        sqe->off = op->request.offset + op->done;
+        sqe->user_data = (uint64_t) op;
+    }
+    _sqArray[index] = index;
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    _pending++;
+}
+
+void UringIoEngine::flushEntries() {
+    while (_pending > 0) {
+        int ret = ioUringEnter(_ringFd, _pending, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            perror("io_uring_enter");
+            exit(-1);
+        }
+        _pending -= ret;
+    }
+}
+
+void UringIoEngine::completionLoop() {
+    while (true) {
+        if (ioUringEnter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0
+                && errno != EINTR) {
+            perror("io_uring_enter");
+            exit(-1);
+        }
+
+        vector<UringOp*> resubmitList;
+        uint32_t freed = 0;
+
+        uint32_t head = *_cqHead;
+        const uint32_t tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe* cqe = &_cqes[head & *_cqMask];
+            UringOp* op = (UringOp*) cqe->user_data;
+            const int32_t res = cqe->res;
+            head++;
+
+            if (op == NULL) {
+                freed++;
+                continue;
+            }
+
+            int32_t result = 0;
+            if (res < 0) {
+                result = res;
+            } else if (op->done + res < op->request.length) {
+                if (res == 0) { // read beyond the end of file
+                    result = -EIO;
+                } else { // short transfer, submit the rest
+                    op->done += res;
+                    op->iov.iov_base = op->request.buf + op->done;
+                    op->iov.iov_len = op->request.length - op->done;
+                    resubmitList.push_back(op);
+                    continue;
+                }
+            }
+
+            completeRequest(op->ioBatch, op->request, result);
+            delete op;
+            freed++;
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+        bool isStopped;
+        {
+            lock_guard<mutex> lk(_submitMutex);
+            for (UringOp* op : resubmitList) {
+                pushEntry(op);
+            }
+            flushEntries();
+            _inflight -= freed;
+            isStopped = !_isRunning && _inflight == 0;
+        }
+        _spaceCond.notify_all();
+
+        if (isStopped) {
+            return;
+        }
+    }
+}
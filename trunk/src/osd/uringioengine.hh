@@ -0,0 +1,110 @@
+#ifndef __URINGIOENGINE_HH__
+#define __URINGIOENGINE_HH__
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "ioengine.hh"
+
+using namespace std;
+
+/**
+ * IoEngine submitting requests to an io_uring of the kernel
+ *
+ * Any thread fills submission entries under a mutex and enters the ring
+ * once per batch. A completion thread waits on the completion ring and
+ * runs the batch callbacks, resubmitting the rest of a short transfer.
+ * The number of requests in the ring is kept within the completion ring
+ * size so that no completion is dropped. The ring is driven by raw system
+ * calls, no library is needed.
+ */
+
+class UringIoEngine: public IoEngine {
+public:
+
+    /**
+     * Check whether the kernel supports io_uring
+     * @return TRUE if a ring can be set up
+     */
+
+    static bool isSupported();
+
+    /**
+     * Constructor, sets up the ring and starts the completion thread
+     * @param depth Number of submission entries
+     */
+
+    UringIoEngine(uint32_t depth);
+
+    /**
+     * Destructor, waits for the requests in the ring and frees it
+     */
+
+    ~UringIoEngine();
+
+    void submit(const vector<IoRequest>& batch,
+            function<void(int32_t)> callback);
+
+    const char* getName() {
+        return "IO_URING";
+    }
+
+private:
+
+    /**
+     * A request in the ring
+     */
+
+    struct UringOp {
+        IoRequest request;
+        IoBatch* ioBatch;
+        uint32_t done; // bytes transferred so far
+        struct iovec iov;
+    };
+
+    /**
+     * Put an operation in the submission ring (_submitMutex held)
+     * @param op Operation, NULL for a no-op waking the completion thread
+     */
+
+    void pushEntry(UringOp* op);
+
+    /**
+     * Enter the ring to submit the pending entries (_submitMutex held)
+     */
+
+    void flushEntries();
+
+    void completionLoop();
+
+    int _ringFd;
+    uint32_t _sqEntries;
+    uint32_t _cqEntries;
+
+    void* _sqPtr;
+    size_t _sqSize;
+    void* _cqPtr;
+    size_t _cqSize;
+    struct io_uring_sqe* _sqes;
+
+    uint32_t* _sqHead;
+    uint32_t* _sqTail;
+    uint32_t* _sqMask;
+    uint32_t* _sqArray;
+    uint32_t* _cqHead;
+    uint32_t* _cqTail;
+    uint32_t* _cqMask;
+    struct io_uring_cqe* _cqes;
+
+    mutex _submitMutex;
+    condition_variable _spaceCond;
+    uint32_t _inflight; // operations in the ring
+    uint32_t _pending; // entries not yet submitted
+    bool _isRunning;
+    thread _completionThread;
+};
+
+#endif
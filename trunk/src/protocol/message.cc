@@ -4,6 +4,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include <ios>
@@ -11,6 +12,7 @@
 #include "../common/debug.hh"
 #include "../common/enums.hh"
 #include "../common/enumtostring.hh"
+#include "../common/executor.hh"
 #include "../common/memorypool.hh"
 #include "../common/debug.hh"
 #include "../common/msgmemorypool.hh"
@@ -19,6 +21,7 @@
 using namespace std;
 
 Message::Message() {
+	_payloadFd = -1;
 }
 
 Message::Message(Communicator* communicator) {
@@ -26,11 +29,13 @@ Message::Message(Communicator* communicator) {
 	memset(&_msgHeader, 0, sizeof(struct MsgHeader));
 	_protocolMsg = "";
 	_payload = NULL;
+	_payloadFd = -1;
+	_payloadFileOffset = 0;
 	_recvBuf = NULL;
 	_expectReply = false;
 	_deletable = false;
 	_communicator = communicator; // needed by communicator->findWaitReplyMessage()
-	_threadPoolSize = NUM_THREADS_PER_MSG; // default thread pool size
+	_taskClass = CONTROL_TASK; // replies and small requests by default
 }
 
 void* Message::operator new (size_t n) {
@@ -44,6 +49,9 @@ void Message::operator delete (void* p){
 
 Message::~Message() {
 	//debug ("%s\n", "message destructor");
+	if (_payloadFd != -1) {
+		close(_payloadFd);
+	}
 }
 
 void Message::setProtocolType(MsgType protocolType) {
@@ -96,6 +104,17 @@ uint32_t Message::preparePayload(char* buf, uint32_t length) {
 	return 0;
 }
 
+uint32_t Message::preparePayloadFile(int fd, uint64_t offset,
+		uint32_t length, shared_ptr<void> payloadPin) {
+
+	_payloadFd = fd;
+	_payloadFileOffset = offset;
+	_payloadPin = payloadPin;
+	_msgHeader.payloadSize = length;
+
+	return 0;
+}
+
 struct MsgHeader Message::getMsgHeader() {
 	return _msgHeader;
 }
@@ -108,6 +127,14 @@ char* Message::getPayload() {
 	return _payload;
 }
 
+int Message::getPayloadFd() {
+	return _payloadFd;
+}
+
+uint64_t Message::getPayloadFileOffset() {
+	return _payloadFileOffset;
+}
+
 uint32_t Message::getSockfd() {
 	return _sockfd;
 }
@@ -118,6 +145,8 @@ bool Message::isExpectReply() {
 
 MessageStatus Message::waitForStatusChange() {
 	debug("%s\n", "waitforstatuschange");
+	// the reply is handled by another task
+	Executor::BlockingScope blocking;
 	return _status.get_future().get();
 }
 
@@ -134,8 +163,8 @@ void Message::setExpectReply(bool expectReply) {
 	_expectReply = expectReply;
 }
 
-uint32_t Message::getThreadPoolSize() {
-	return _threadPoolSize;
+TaskClass Message::getTaskClass() {
+	return _taskClass;
 }
 
 void Message::handle() {
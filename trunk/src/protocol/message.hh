@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <future>
+#include <memory>
 #include <iostream>
 
 #include "../common/enums.hh"
@@ -73,6 +74,20 @@ public:
 
 	uint32_t preparePayload(char* buf, uint32_t length);
 
+	/**
+	 * Send the payload from a file without copying it to memory
+	 * The message owns the descriptor and closes it when deleted
+	 * @param fd File descriptor of the payload
+	 * @param offset Offset of the payload in the file
+	 * @param length Length of the payload
+	 * @param payloadPin Pin keeping the file range unchanged, released
+	 * when the message is deleted after it is sent
+	 * @return 0
+	 */
+
+	uint32_t preparePayloadFile(int fd, uint64_t offset, uint32_t length,
+			shared_ptr<void> payloadPin = shared_ptr<void>());
+
 
 	//
 	// for receive
@@ -118,6 +133,8 @@ public:
 	struct MsgHeader getMsgHeader ();
 	string getProtocolMsg();
 	char* getPayload();
+	int getPayloadFd();
+	uint64_t getPayloadFileOffset();
 	bool isExpectReply();
 	bool isDeletable();
 
@@ -144,11 +161,11 @@ public:
 	void setExpectReply (bool expectReply);
 
 	/**
-	 * Get the thread pool size of this type of message
-	 * @return Size of thread pool for this type of message
+	 * Get the executor class that handles this type of message
+	 * @return Task class of this type of message
 	 */
 
-	uint32_t getThreadPoolSize();
+	TaskClass getTaskClass();
 
 	/**
 	 * DEBUG: Print the MsgHeader
@@ -170,11 +187,14 @@ public:
 
 
 protected:
-	uint32_t _threadPoolSize;
+	TaskClass _taskClass;
 	uint32_t _sockfd;		// destination
 	struct MsgHeader _msgHeader;
 	string _protocolMsg;
 	char* _payload;
+	int _payloadFd;		// payload sent from a file if not -1
+	uint64_t _payloadFileOffset;
+	shared_ptr<void> _payloadPin;	// held until the payload file is sent
 	char* _recvBuf;		// buffer created to store header + protocol + payload in recvMessage
 	bool _expectReply;
 	Communicator* _communicator;
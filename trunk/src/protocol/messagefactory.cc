@@ -38,6 +38,9 @@
 #include "transfer/segmenttransferendrequest.hh"
 #include "transfer/segmentdatamsg.hh"
 #include "transfer/blockdatamsg.hh"
+#include "transfer/transfercreditmsg.hh"
+#include "transfer/getsegmentrangerequest.hh"
+#include "transfer/getsegmentrangereply.hh"
 #include "transfer/getblockinitrequest.hh"
 #include "transfer/getsegmentrequest.hh"
 #include "transfer/putsmallsegmentrequest.hh"
@@ -186,6 +189,15 @@ Message* MessageFactory::createMessage(Communicator* communicator,
 	case (PUT_SMALL_SEGMENT_REQUEST):
 	    return new PutSmallSegmentRequestMsg(communicator);
 	    break;
+	case (TRANSFER_CREDIT):
+		return new TransferCreditMsg(communicator);
+		break;
+	case (GET_SEGMENT_RANGE_REQUEST):
+		return new GetSegmentRangeRequestMsg(communicator);
+		break;
+	case (GET_SEGMENT_RANGE_REPLY):
+		return new GetSegmentRangeReplyMsg(communicator);
+		break;
 
 	//STATUS
 	case (OSD_STARTUP):
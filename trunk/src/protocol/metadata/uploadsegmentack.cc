@@ -12,6 +12,11 @@
 extern Mds* mds;
 #endif
 
+#ifdef COMPILE_FOR_OSD
+#include "../../osd/osd.hh"
+extern Osd* osd;
+#endif
+
 UploadSegmentAckMsg::UploadSegmentAckMsg(Communicator* communicator) :
 		Message(communicator) {
 }
@@ -80,6 +85,9 @@ void UploadSegmentAckMsg::doHandle() {
 #ifdef COMPILE_FOR_MDS
 	mds->uploadSegmentAckProcessor(_msgHeader.requestId, _sockfd, _segmentId, _segmentSize, _codingScheme, _codingSetting, _nodeList);
 #endif
+#ifdef COMPILE_FOR_OSD
+	osd->commitSegmentProcessor(_msgHeader.requestId, _sockfd, _segmentId, _segmentSize, _codingScheme, _codingSetting, _nodeList);
+#endif
 }
 
 void UploadSegmentAckMsg::printProtocol() {
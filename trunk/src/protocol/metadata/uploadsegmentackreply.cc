@@ -13,11 +13,12 @@ UploadSegmentAckReplyMsg::UploadSegmentAckReplyMsg(Communicator* communicator) :
 }
 
 UploadSegmentAckReplyMsg::UploadSegmentAckReplyMsg(Communicator* communicator,
-		uint32_t requestId, uint32_t sockfd, uint64_t segmentId) :
+		uint32_t requestId, uint32_t sockfd, uint64_t segmentId, bool isFailed) :
 		Message(communicator) {
 	_msgHeader.requestId = requestId;
 	_sockfd = sockfd;
 	_segmentId = segmentId;
+	_isFailed = isFailed;
 }
 
 void UploadSegmentAckReplyMsg::prepareProtocolMsg() {
@@ -26,6 +27,7 @@ void UploadSegmentAckReplyMsg::prepareProtocolMsg() {
 	ncvfs::UploadSegmentAckReplyPro uploadSegmentAckReplyPro;
 
 	uploadSegmentAckReplyPro.set_segmentid((long long int) _segmentId);
+	uploadSegmentAckReplyPro.set_isfailed(_isFailed);
 
 	if (!uploadSegmentAckReplyPro.SerializeToString(&serializedString)) {
 		cerr << "Failed to write string." << endl;
@@ -47,12 +49,13 @@ void UploadSegmentAckReplyMsg::parse(char* buf) {
 			_msgHeader.protocolMsgSize);
 
 	_segmentId = uploadSegmentAckReplyPro.segmentid();
+	_isFailed = uploadSegmentAckReplyPro.isfailed();
 	return;
 }
 
 void UploadSegmentAckReplyMsg::doHandle() {
 	UploadSegmentAckMsg* uploadSegmentAckMsg = (UploadSegmentAckMsg*) _communicator->popWaitReplyMessage(_msgHeader.requestId);
-    uploadSegmentAckMsg->setStatus(READY);
+    uploadSegmentAckMsg->setStatus(_isFailed ? FAILED : READY);
 }
 
 void UploadSegmentAckReplyMsg::printProtocol() {
@@ -33,7 +33,7 @@ public:
 	 * @param	communicator	Communicator the Message belongs to
 	 */
 	UploadSegmentAckReplyMsg(Communicator* communicator, uint32_t requestId, 
-        uint32_t sockfd, uint64_t segmentId);
+        uint32_t sockfd, uint64_t segmentId, bool isFailed = false);
 
 	/**
 	 * Copy values in private variables to protocol message
@@ -66,6 +66,7 @@ public:
 
 private:
 	uint64_t _segmentId;
+	bool _isFailed; // the commit was rejected
 };
 
 #endif
@@ -9,6 +9,11 @@
 extern Monitor* monitor;
 #endif
 
+#ifdef COMPILE_FOR_OSD
+#include "../../osd/osd.hh"
+extern Osd* osd;
+#endif
+
 OsdShutdownMsg::OsdShutdownMsg(Communicator* communicator) :
 		Message(communicator) {
 
@@ -55,6 +60,9 @@ void OsdShutdownMsg::doHandle() {
 #ifdef COMPILE_FOR_MONITOR
 	monitor->OsdShutdownProcessor(_msgHeader.requestId, _sockfd, _osdId);
 #endif
+#ifdef COMPILE_FOR_OSD
+	osd->OsdShutdownProcessor(_msgHeader.requestId, _sockfd, _osdId);
+#endif
 }
 
 void OsdShutdownMsg::printProtocol() {
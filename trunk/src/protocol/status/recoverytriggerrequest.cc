@@ -14,7 +14,7 @@ extern Mds* mds;
 
 RecoveryTriggerRequestMsg::RecoveryTriggerRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = RECOVERY_TASK;
 }
 
 RecoveryTriggerRequestMsg::RecoveryTriggerRequestMsg(Communicator* communicator,
@@ -18,7 +18,7 @@ extern Mds* mds;
 
 RepairSegmentInfoMsg::RepairSegmentInfoMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = RECOVERY_TASK;
 }
 
 RepairSegmentInfoMsg::RepairSegmentInfoMsg(Communicator* communicator,
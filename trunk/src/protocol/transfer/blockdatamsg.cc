@@ -15,7 +15,7 @@ extern Client* client;
 
 BlockDataMsg::BlockDataMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 BlockDataMsg::BlockDataMsg(Communicator* communicator, uint32_t osdSockfd,
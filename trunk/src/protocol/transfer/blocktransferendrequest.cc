@@ -12,14 +12,17 @@ extern Osd* osd;
 BlockTransferEndRequestMsg::BlockTransferEndRequestMsg(
 		Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
+	_isAborted = false;
+	_unsentChunkCount = 0;
 }
 
 BlockTransferEndRequestMsg::BlockTransferEndRequestMsg(
         Communicator* communicator, uint32_t osdSockfd, uint64_t segmentId,
         uint32_t blockId, DataMsgType dataMsgType, string updateKey,
         vector<offset_length_t> offsetLength, vector<BlockLocation> parityList,
-        CodingScheme codingScheme, string codingSetting, uint64_t segmentSize) :
+        CodingScheme codingScheme, string codingSetting, uint64_t segmentSize,
+        bool isAborted, uint32_t unsentChunkCount) :
         Message(communicator) {
 
 	_sockfd = osdSockfd;
@@ -32,6 +35,8 @@ BlockTransferEndRequestMsg::BlockTransferEndRequestMsg(
 	_codingScheme = codingScheme;
 	_codingSetting = codingSetting;
 	_segmentSize = segmentSize;
+	_isAborted = isAborted;
+	_unsentChunkCount = unsentChunkCount;
 }
 
 void BlockTransferEndRequestMsg::prepareProtocolMsg() {
@@ -47,6 +52,8 @@ void BlockTransferEndRequestMsg::prepareProtocolMsg() {
             (ncvfs::PutSegmentInitRequestPro_CodingScheme) _codingScheme);
     blockTransferEndRequestPro.set_codingsetting(_codingSetting);
     blockTransferEndRequestPro.set_segmentsize(_segmentSize);
+	blockTransferEndRequestPro.set_isaborted(_isAborted);
+	blockTransferEndRequestPro.set_unsentchunkcount(_unsentChunkCount);
 
 	vector<offset_length_t>::iterator it;
 	for (it = _offsetLength.begin(); it < _offsetLength.end(); ++it) {
@@ -90,6 +97,8 @@ void BlockTransferEndRequestMsg::parse(char* buf) {
 	_codingScheme = (CodingScheme) blockTransferEndRequestPro.codingscheme();
 	_codingSetting = blockTransferEndRequestPro.codingsetting();
 	_segmentSize = blockTransferEndRequestPro.segmentsize();
+	_isAborted = blockTransferEndRequestPro.isaborted();
+	_unsentChunkCount = blockTransferEndRequestPro.unsentchunkcount();
 
 	for (int i = 0; i < blockTransferEndRequestPro.offsetlength_size(); ++i) {
 		offset_length_t tempOffsetLength;
@@ -117,13 +126,14 @@ void BlockTransferEndRequestMsg::parse(char* buf) {
 void BlockTransferEndRequestMsg::doHandle() {
 #ifdef COMPILE_FOR_OSD
 	osd->putBlockEndProcessor(_msgHeader.requestId, _sockfd, _segmentId,
-			_blockId, _dataMsgType, _updateKey, _offsetLength, _parityList, _codingScheme, _codingSetting, _segmentSize);
+			_blockId, _dataMsgType, _updateKey, _offsetLength, _parityList, _codingScheme, _codingSetting, _segmentSize,
+			_isAborted, _unsentChunkCount);
 #endif
 }
 
 void BlockTransferEndRequestMsg::printProtocol() {
 	debug(
-            "[BLOCK_TRANSFER_END_REQUEST] Segment ID = %" PRIu64 ", Block ID = %" PRIu32 ", dataMsgType = %d, codingScheme = %d, codingSetting = %s\n",
+            "[BLOCK_TRANSFER_END_REQUEST] Segment ID = %" PRIu64 ", Block ID = %" PRIu32 ", dataMsgType = %d, codingScheme = %d, codingSetting = %s, isAborted = %d\n",
             _segmentId, _blockId, _dataMsgType, _codingScheme,
-            _codingSetting.c_str());
+            _codingSetting.c_str(), _isAborted);
 }
@@ -19,7 +19,8 @@ public:
             uint64_t segmentId, uint32_t blockId, DataMsgType dataMsgType,
             string updateKey, vector<offset_length_t> offsetLength,
             vector<BlockLocation> parityList, CodingScheme codingScheme,
-            string codingSetting, uint64_t segmentSize);
+            string codingSetting, uint64_t segmentSize, bool isAborted,
+            uint32_t unsentChunkCount);
 
 	/**
 	 * Copy values in private variables to protocol message
@@ -60,6 +61,8 @@ private:
 	CodingScheme _codingScheme;
 	string _codingSetting;
 	uint64_t _segmentSize;
+	bool _isAborted;
+	uint32_t _unsentChunkCount;
 };
 
 #endif
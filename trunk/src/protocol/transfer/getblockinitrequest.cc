@@ -10,7 +10,7 @@ extern Osd* osd;
 
 GetBlockInitRequestMsg::GetBlockInitRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 GetBlockInitRequestMsg::GetBlockInitRequestMsg(Communicator* communicator,
@@ -0,0 +1,85 @@
+#include "getsegmentrangerequest.hh"
+#include "getsegmentrangereply.hh"
+#include "../../common/debug.hh"
+#include "../../protocol/message.pb.h"
+#include "../../common/enums.hh"
+#include "../../common/memorypool.hh"
+
+GetSegmentRangeReplyMsg::GetSegmentRangeReplyMsg(Communicator* communicator) :
+		Message(communicator) {
+	_taskClass = FOREGROUND_TASK;
+	_ownBuf = NULL;
+}
+
+GetSegmentRangeReplyMsg::GetSegmentRangeReplyMsg(Communicator* communicator,
+		uint32_t requestId, uint32_t dstSockfd, uint64_t segmentId,
+		bool isServed, char* buf, uint32_t length) :
+		Message(communicator) {
+
+	_msgHeader.requestId = requestId;
+	_sockfd = dstSockfd;
+	_segmentId = segmentId;
+	_isServed = isServed;
+	_ownBuf = buf;
+
+	if (isServed) {
+		preparePayload(buf, length);
+	}
+}
+
+GetSegmentRangeReplyMsg::~GetSegmentRangeReplyMsg() {
+	// only the sending side owns its buffer, received payload is in recvBuf
+	if (_ownBuf != NULL) {
+		MemoryPool::getInstance().poolFree(_ownBuf);
+	}
+}
+
+void GetSegmentRangeReplyMsg::prepareProtocolMsg() {
+	string serializedString;
+
+	ncvfs::GetSegmentRangeReplyPro getSegmentRangeReplyPro;
+	getSegmentRangeReplyPro.set_segmentid(_segmentId);
+	getSegmentRangeReplyPro.set_isserved(_isServed);
+
+	if (!getSegmentRangeReplyPro.SerializeToString(&serializedString)) {
+		cerr << "Failed to write string." << endl;
+		return;
+	}
+
+	setProtocolSize(serializedString.length());
+	setProtocolType(GET_SEGMENT_RANGE_REPLY);
+	setProtocolMsg(serializedString);
+
+}
+
+void GetSegmentRangeReplyMsg::parse(char* buf) {
+
+	memcpy(&_msgHeader, buf, sizeof(struct MsgHeader));
+
+	ncvfs::GetSegmentRangeReplyPro getSegmentRangeReplyPro;
+	getSegmentRangeReplyPro.ParseFromArray(buf + sizeof(struct MsgHeader),
+			_msgHeader.protocolMsgSize);
+
+	_segmentId = getSegmentRangeReplyPro.segmentid();
+	_isServed = getSegmentRangeReplyPro.isserved();
+
+}
+
+void GetSegmentRangeReplyMsg::doHandle() {
+	GetSegmentRangeRequestMsg* getSegmentRangeRequestMsg =
+			(GetSegmentRangeRequestMsg*) _communicator->popWaitReplyMessage(
+					_msgHeader.requestId);
+
+	if (_isServed && _msgHeader.payloadSize == getSegmentRangeRequestMsg->getLength()) {
+		memcpy(getSegmentRangeRequestMsg->getBuf(), _payload,
+				_msgHeader.payloadSize);
+		getSegmentRangeRequestMsg->setIsServed(true);
+	}
+	getSegmentRangeRequestMsg->setStatus(READY);
+}
+
+void GetSegmentRangeReplyMsg::printProtocol() {
+	debug(
+			"[GET_SEGMENT_RANGE_REPLY] Segment ID = %" PRIu64 " isServed = %d Length = %" PRIu32 "\n",
+			_segmentId, _isServed, _msgHeader.payloadSize);
+}
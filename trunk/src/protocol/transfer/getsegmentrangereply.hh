@@ -0,0 +1,70 @@
+#ifndef __GET_SEGMENT_RANGE_REPLY_HH__
+#define __GET_SEGMENT_RANGE_REPLY_HH__
+
+#include "../message.hh"
+
+using namespace std;
+
+/**
+ * Extends the Message class
+ * Return the bytes of a range as payload, or isServed = false if the
+ * range cannot be served without decoding the segment
+ */
+
+class GetSegmentRangeReplyMsg: public Message {
+public:
+
+	GetSegmentRangeReplyMsg(Communicator* communicator);
+
+	/**
+	 * @param communicator
+	 * @param requestId Request ID of the GetSegmentRangeRequestMsg
+	 * @param dstSockfd Socket of the requester
+	 * @param segmentId Segment ID
+	 * @param isServed Whether the payload holds the range
+	 * @param buf Buffer from MemoryPool holding the range, freed with the message
+	 * @param length Length of the range
+	 */
+
+	GetSegmentRangeReplyMsg(Communicator* communicator, uint32_t requestId,
+			uint32_t dstSockfd, uint64_t segmentId, bool isServed, char* buf,
+			uint32_t length);
+
+	~GetSegmentRangeReplyMsg();
+
+	/**
+	 * Copy values in private variables to protocol message
+	 * Serialize protocol message and copy to private variable
+	 */
+
+	void prepareProtocolMsg();
+
+	/**
+	 * Override
+	 * Parse message from raw buffer
+	 * @param buf Raw buffer storing header + protocol + payload
+	 */
+
+	void parse(char* buf);
+
+	/**
+	 * Override
+	 * Execute the corresponding Processor
+	 */
+
+	void doHandle();
+
+	/**
+	 * Override
+	 * DEBUG: print protocol message
+	 */
+
+	void printProtocol();
+
+private:
+	uint64_t _segmentId;
+	bool _isServed;
+	char* _ownBuf;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "getsegmentrangerequest.hh"
+#include "../../common/debug.hh"
+#include "../../protocol/message.pb.h"
+#include "../../common/enums.hh"
+
+#ifdef COMPILE_FOR_OSD
+#include "../../osd/osd.hh"
+extern Osd* osd;
+#endif
+
+GetSegmentRangeRequestMsg::GetSegmentRangeRequestMsg(Communicator* communicator) :
+		Message(communicator) {
+	_taskClass = FOREGROUND_TASK;
+	_buf = NULL;
+	_isServed = false;
+}
+
+GetSegmentRangeRequestMsg::GetSegmentRangeRequestMsg(Communicator* communicator,
+		uint32_t dstSockfd, uint64_t segmentId, uint32_t blockId,
+		uint64_t offset, uint32_t length, char* buf, bool isParity) :
+		Message(communicator) {
+
+	_sockfd = dstSockfd;
+	_segmentId = segmentId;
+	_blockId = blockId;
+	_offset = offset;
+	_length = length;
+	_isParity = isParity;
+	_buf = buf;
+	_isServed = false;
+}
+
+void GetSegmentRangeRequestMsg::prepareProtocolMsg() {
+	string serializedString;
+
+	ncvfs::GetSegmentRangeRequestPro getSegmentRangeRequestPro;
+	getSegmentRangeRequestPro.set_segmentid(_segmentId);
+	getSegmentRangeRequestPro.set_blockid(_blockId);
+	getSegmentRangeRequestPro.set_offset(_offset);
+	getSegmentRangeRequestPro.set_length(_length);
+	getSegmentRangeRequestPro.set_isparity(_isParity);
+
+	if (!getSegmentRangeRequestPro.SerializeToString(&serializedString)) {
+		cerr << "Failed to write string." << endl;
+		return;
+	}
+
+	setProtocolSize(serializedString.length());
+	setProtocolType(GET_SEGMENT_RANGE_REQUEST);
+	setProtocolMsg(serializedString);
+
+}
+
+void GetSegmentRangeRequestMsg::parse(char* buf) {
+
+	memcpy(&_msgHeader, buf, sizeof(struct MsgHeader));
+
+	ncvfs::GetSegmentRangeRequestPro getSegmentRangeRequestPro;
+	getSegmentRangeRequestPro.ParseFromArray(buf + sizeof(struct MsgHeader),
+			_msgHeader.protocolMsgSize);
+
+	_segmentId = getSegmentRangeRequestPro.segmentid();
+	_blockId = getSegmentRangeRequestPro.blockid();
+	_offset = getSegmentRangeRequestPro.offset();
+	_length = getSegmentRangeRequestPro.length();
+	_isParity = getSegmentRangeRequestPro.isparity();
+
+}
+
+void GetSegmentRangeRequestMsg::doHandle() {
+#ifdef COMPILE_FOR_OSD
+	osd->getSegmentRangeRequestProcessor(_msgHeader.requestId, _sockfd,
+			_segmentId, _blockId, _offset, _length, _isParity);
+#endif
+}
+
+void GetSegmentRangeRequestMsg::printProtocol() {
+	debug(
+			"[GET_SEGMENT_RANGE_REQUEST] Segment ID = %" PRIu64 " Block ID = %" PRIu32 " Offset = %" PRIu64 " Length = %" PRIu32 "\n",
+			_segmentId, _blockId, _offset, _length);
+}
+
+uint32_t GetSegmentRangeRequestMsg::getLength() {
+	return _length;
+}
+
+char* GetSegmentRangeRequestMsg::getBuf() {
+	return _buf;
+}
+
+bool GetSegmentRangeRequestMsg::getIsServed() {
+	return _isServed;
+}
+
+void GetSegmentRangeRequestMsg::setIsServed(bool isServed) {
+	_isServed = isServed;
+}
@@ -0,0 +1,80 @@
+#ifndef __GET_SEGMENT_RANGE_REQUEST_HH__
+#define __GET_SEGMENT_RANGE_REQUEST_HH__
+
+#include "../message.hh"
+
+using namespace std;
+
+/**
+ * Extends the Message class
+ * Request a byte range of a segment (client -> primary)
+ * or of a block (primary -> OSD)
+ */
+
+class GetSegmentRangeRequestMsg: public Message {
+public:
+
+	GetSegmentRangeRequestMsg(Communicator* communicator);
+
+	/**
+	 * @param communicator
+	 * @param dstSockfd Socket of the destination
+	 * @param segmentId Segment ID
+	 * @param blockId Block ID, SEGMENT_RANGE_WHOLE_SEGMENT for a segment range
+	 * @param offset Offset of the range inside the segment / block
+	 * @param length Length of the range
+	 * @param buf Buffer to receive the range, at least length bytes
+	 * @param isParity Whether the block is a parity block
+	 */
+
+	GetSegmentRangeRequestMsg(Communicator* communicator, uint32_t dstSockfd,
+			uint64_t segmentId, uint32_t blockId, uint64_t offset,
+			uint32_t length, char* buf, bool isParity = false);
+
+	/**
+	 * Copy values in private variables to protocol message
+	 * Serialize protocol message and copy to private variable
+	 */
+
+	void prepareProtocolMsg();
+
+	/**
+	 * Override
+	 * Parse message from raw buffer
+	 * @param buf Raw buffer storing header + protocol + payload
+	 */
+
+	void parse(char* buf);
+
+	/**
+	 * Override
+	 * Execute the corresponding Processor
+	 */
+
+	void doHandle();
+
+	/**
+	 * Override
+	 * DEBUG: print protocol message
+	 */
+
+	void printProtocol();
+
+	uint32_t getLength();
+	char* getBuf();
+	bool getIsServed();
+	void setIsServed(bool isServed);
+
+private:
+	uint64_t _segmentId;
+	uint32_t _blockId;
+	uint64_t _offset;
+	uint32_t _length;
+	bool _isParity;
+
+	// reply
+	char* _buf;
+	bool _isServed;
+};
+
+#endif
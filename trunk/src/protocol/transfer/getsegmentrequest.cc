@@ -11,7 +11,7 @@ extern Osd* osd;
 
 GetSegmentRequestMsg::GetSegmentRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 GetSegmentRequestMsg::GetSegmentRequestMsg(Communicator* communicator,
@@ -10,7 +10,7 @@ extern Osd* osd;
 
 PutBlockInitRequestMsg::PutBlockInitRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 PutBlockInitRequestMsg::PutBlockInitRequestMsg(Communicator* communicator,
@@ -16,7 +16,7 @@ extern Client* client;
 
 PutSegmentInitRequestMsg::PutSegmentInitRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 PutSegmentInitRequestMsg::PutSegmentInitRequestMsg(Communicator* communicator,
@@ -16,7 +16,7 @@ extern Client* client;
 
 PutSmallSegmentRequestMsg::PutSmallSegmentRequestMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 PutSmallSegmentRequestMsg::PutSmallSegmentRequestMsg(Communicator* communicator,
@@ -16,7 +16,7 @@ extern Client* client;
 
 SegmentDataMsg::SegmentDataMsg(Communicator* communicator) :
 		Message(communicator) {
-
+	_taskClass = FOREGROUND_TASK;
 }
 
 SegmentDataMsg::SegmentDataMsg(Communicator* communicator, uint32_t osdSockfd,
@@ -69,11 +69,16 @@ void SegmentDataMsg::parse(char* buf) {
 
 void SegmentDataMsg::doHandle() {
 #ifdef COMPILE_FOR_OSD
-	osd->putSegmentDataProcessor(_msgHeader.requestId, _sockfd, _segmentId, _offset, _length, _dataMsgType, _updateKey, _payload);
+	if (!osd->putSegmentDataProcessor(_msgHeader.requestId, _sockfd, _segmentId, _offset, _length, _dataMsgType, _updateKey, _payload, _recvBuf)) {
+		// kept until the init replays it, which also returns the credit
+		_recvBuf = NULL;
+		return;
+	}
 #endif
 #ifdef COMPILE_FOR_CLIENT
 	client->SegmentDataProcessor(_msgHeader.requestId, _sockfd, _segmentId, _offset, _length, _payload);
 #endif
+	_communicator->returnCredit(_sockfd, _length);
 }
 
 void SegmentDataMsg::printProtocol() {
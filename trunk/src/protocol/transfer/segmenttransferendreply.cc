@@ -12,13 +12,15 @@ SegmentTransferEndReplyMsg::SegmentTransferEndReplyMsg(Communicator* communicato
 }
 
 SegmentTransferEndReplyMsg::SegmentTransferEndReplyMsg(Communicator* communicator,
-		uint32_t requestId, uint32_t dstSockfd, uint64_t segmentId, bool isSmallSegment) :
+		uint32_t requestId, uint32_t dstSockfd, uint64_t segmentId, bool isSmallSegment,
+		bool isFailed) :
 		Message(communicator) {
 
 	_msgHeader.requestId = requestId;
 	_sockfd = dstSockfd;
 	_segmentId = segmentId;
 	_isSmallSegment = isSmallSegment;
+	_isFailed = isFailed;
 }
 
 void SegmentTransferEndReplyMsg::prepareProtocolMsg() {
@@ -27,6 +29,7 @@ void SegmentTransferEndReplyMsg::prepareProtocolMsg() {
 	ncvfs::SegmentTransferEndReplyPro segmentTransferEndReplyPro;
 	segmentTransferEndReplyPro.set_segmentid(_segmentId);
 	segmentTransferEndReplyPro.set_issmallsegment(_isSmallSegment);
+	segmentTransferEndReplyPro.set_isfailed(_isFailed);
 
 	if (!segmentTransferEndReplyPro.SerializeToString(&serializedString)) {
 		cerr << "Failed to write string." << endl;
@@ -49,6 +52,7 @@ void SegmentTransferEndReplyMsg::parse(char* buf) {
 
 	_segmentId = segmentTransferEndReplyPro.segmentid();
 	_isSmallSegment = segmentTransferEndReplyPro.issmallsegment();
+	_isFailed = segmentTransferEndReplyPro.isfailed();
 
 }
 
@@ -57,12 +61,12 @@ void SegmentTransferEndReplyMsg::doHandle() {
         PutSmallSegmentRequestMsg* putSmallSegmentRequestMsg =
                 (PutSmallSegmentRequestMsg*) _communicator->popWaitReplyMessage(
                         _msgHeader.requestId);
-        putSmallSegmentRequestMsg->setStatus(READY);
+        putSmallSegmentRequestMsg->setStatus(_isFailed ? FAILED : READY);
     } else {
         SegmentTransferEndRequestMsg* putSegmentEndRequestMsg =
                 (SegmentTransferEndRequestMsg*) _communicator->popWaitReplyMessage(
                         _msgHeader.requestId);
-        putSegmentEndRequestMsg->setStatus(READY);
+        putSegmentEndRequestMsg->setStatus(_isFailed ? FAILED : READY);
     }
 }
 
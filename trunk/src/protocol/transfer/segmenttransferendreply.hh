@@ -16,7 +16,7 @@ public:
 	SegmentTransferEndReplyMsg(Communicator* communicator);
 
 	SegmentTransferEndReplyMsg(Communicator* communicator, uint32_t requestId, uint32_t dstSockfd,
-			uint64_t segmentId, bool isSmallSegment = false);
+			uint64_t segmentId, bool isSmallSegment = false, bool isFailed = false);
 
 	/**
 	 * Copy values in private variables to protocol message
@@ -50,6 +50,7 @@ public:
 private:
 	uint64_t _segmentId;
 	bool _isSmallSegment;
+	bool _isFailed; // the segment was not stored
 };
 
 #endif
@@ -16,7 +16,7 @@ extern Client* client;
 SegmentTransferEndRequestMsg::SegmentTransferEndRequestMsg(
 		Communicator* communicator) :
 		Message(communicator) {
-	_threadPoolSize = 4;
+	_taskClass = FOREGROUND_TASK;
 }
 
 SegmentTransferEndRequestMsg::SegmentTransferEndRequestMsg(
@@ -0,0 +1,53 @@
+#include "transfercreditmsg.hh"
+#include "../../common/debug.hh"
+#include "../../protocol/message.pb.h"
+#include "../../common/enums.hh"
+
+TransferCreditMsg::TransferCreditMsg(Communicator* communicator) :
+		Message(communicator) {
+
+}
+
+TransferCreditMsg::TransferCreditMsg(Communicator* communicator,
+		uint32_t dstSockfd, uint32_t credit) :
+		Message(communicator) {
+
+	_sockfd = dstSockfd;
+	_credit = credit;
+}
+
+void TransferCreditMsg::prepareProtocolMsg() {
+	string serializedString;
+
+	ncvfs::TransferCreditPro transferCreditPro;
+	transferCreditPro.set_credit(_credit);
+
+	if (!transferCreditPro.SerializeToString(&serializedString)) {
+		cerr << "Failed to write string." << endl;
+		return;
+	}
+
+	setProtocolSize(serializedString.length());
+	setProtocolType(TRANSFER_CREDIT);
+	setProtocolMsg(serializedString);
+
+}
+
+void TransferCreditMsg::parse(char* buf) {
+
+	memcpy(&_msgHeader, buf, sizeof(struct MsgHeader));
+
+	ncvfs::TransferCreditPro transferCreditPro;
+	transferCreditPro.ParseFromArray(buf + sizeof(struct MsgHeader),
+			_msgHeader.protocolMsgSize);
+
+	_credit = transferCreditPro.credit();
+}
+
+void TransferCreditMsg::doHandle() {
+	_communicator->addSendCredit(_sockfd, _credit);
+}
+
+void TransferCreditMsg::printProtocol() {
+	debug("[TRANSFER_CREDIT] Credit = %" PRIu32 "\n", _credit);
+}
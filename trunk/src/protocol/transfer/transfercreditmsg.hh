@@ -0,0 +1,60 @@
+#ifndef __TRANSFERCREDITMSG_HH__
+#define __TRANSFERCREDITMSG_HH__
+
+#include "../message.hh"
+
+using namespace std;
+
+/**
+ * Extends the Message class
+ * Return credit for segment data that the receiver has handled
+ */
+
+class TransferCreditMsg: public Message {
+public:
+
+	TransferCreditMsg(Communicator* communicator);
+
+	/**
+	 * @param communicator
+	 * @param dstSockfd Socket of the sender of the segment data
+	 * @param credit Number of bytes handled
+	 */
+
+	TransferCreditMsg(Communicator* communicator, uint32_t dstSockfd,
+			uint32_t credit);
+
+	/**
+	 * Copy values in private variables to protocol message
+	 * Serialize protocol message and copy to private variable
+	 */
+
+	void prepareProtocolMsg();
+
+	/**
+	 * Override
+	 * Parse message from raw buffer
+	 * @param buf Raw buffer storing header + protocol + payload
+	 */
+
+	void parse(char* buf);
+
+	/**
+	 * Override
+	 * Execute the corresponding Processor
+	 */
+
+	void doHandle();
+
+	/**
+	 * Override
+	 * DEBUG: print protocol message
+	 */
+
+	void printProtocol();
+
+private:
+	uint32_t _credit;
+};
+
+#endif